@@ -3,6 +3,7 @@ from __future__ import annotations
 import os
 import sys
 import array
+import asyncio
 import collections.abc
 from typing import (
     Any,
@@ -17,6 +18,7 @@ from typing import (
 )
 from collections.abc import Iterator
 from collections.abc import Sequence
+from multiprocessing.shared_memory import SharedMemory
 
 del annotations
 
@@ -37,6 +39,12 @@ HAS_SCRIPT_SURFACE: bool = ...
 """
 .. versionadded:: 1.12.0
 """
+HAS_SCRIPT_INTERPRETER: bool = ...
+"""
+Whether :func:`replay_script` is available.
+
+.. versionadded:: 1.30.0
+"""
 HAS_SVG_SURFACE: bool = ...
 HAS_TEE_SURFACE: bool = ...
 """
@@ -66,6 +74,15 @@ The default color palette index. See :meth:`FontOptions.set_color_palette`
 .. versionadded:: 1.25.0 Only available with cairo 1.17.8+
 """
 
+TRACEMALLOC_DOMAIN: int = ...
+"""
+The :mod:`tracemalloc` domain in which the pixel memory allocated by cairo for
+image surfaces is traced. Use :class:`tracemalloc.DomainFilter` to include or
+exclude it from snapshots. See also :func:`memory_stats`.
+
+.. versionadded:: 1.30.0
+"""
+
 version: str = ...
 """the pycairo version, as a string"""
 
@@ -128,6 +145,196 @@ def cairo_version_string() -> str:
     """
 
 
+def context_stats() -> dict[str, tuple[int, float]]:
+    """
+    :returns: a dict mapping each operation category to a tuple of the number
+        of calls and the total time spent in cairo, in seconds
+
+    Returns the operation statistics of all contexts which had
+    :meth:`Context.set_stats_enabled` turned on, accumulated over the lifetime
+    of the process or since the last call to :func:`reset_context_stats`. The
+    categories are the same as for :meth:`Context.stats`. Operations of
+    contexts which are drawing on other threads at the time of the call may
+    not be included yet.
+
+    .. versionadded:: 1.30.0
+    """
+
+
+def reset_context_stats() -> None:
+    """
+    Resets the process wide totals returned by :func:`context_stats` to zero.
+    The statistics of individual contexts are not affected.
+
+    .. versionadded:: 1.30.0
+    """
+
+
+def output_stats() -> dict[str, int]:
+    """
+    :returns: a dict with the keys ``"fragments"`` and ``"bytes"`` (the
+        number and total size of the pieces of output cairo produced),
+        ``"python_writes"`` (calls of ``write()`` on file objects),
+        ``"direct_writes"`` (writes to the file descriptor without the GIL)
+        and ``"python_writes_saved"``
+
+    Returns the statistics of the output written to file objects by
+    :class:`PDFSurface`, :class:`PSSurface`, :class:`SVGSurface`,
+    :class:`ScriptDevice` and :meth:`Surface.write_to_png`, accumulated over
+    the lifetime of the process or since the last call to
+    :func:`reset_output_stats`.
+
+    Output is collected in a native buffer and written out in large chunks,
+    directly to the file descriptor for files returned by :func:`open`, and
+    with one ``write()`` call per chunk for other file objects like
+    :class:`io.BytesIO`. The statistics of a stream are added to the totals
+    when it gets flushed.
+
+    .. versionadded:: 1.30.0
+    """
+
+
+def reset_output_stats() -> None:
+    """
+    Resets the totals returned by :func:`output_stats` to zero.
+
+    .. versionadded:: 1.30.0
+    """
+
+
+def replay_script(
+    script: Union[_PathLike, _FileLike, bytes, bytearray, memoryview],
+    target: Surface,
+) -> None:
+    """
+    :param script: a cairo-script, as a filename, a binary file object to
+        read it from, or any object supporting the buffer protocol, like
+        :class:`bytes` or an :class:`mmap.mmap`
+    :param target: the surface to draw on
+    :raises Error: if the script is invalid or drawing failed
+
+    Plays back a cairo-script, as written by :class:`ScriptDevice`, onto
+    *target* using the cairo-script interpreter. The first surface the
+    script creates is replaced by *target*, so a recording can be rendered
+    onto an image, PDF or any other surface. Further surfaces of the script
+    are created similar to *target* and only used as drawing sources. The
+    script runs in C without the GIL.
+
+    To render at a different size use :meth:`Surface.set_device_scale` on
+    *target* before replaying.
+
+    Only available if pycairo was built with the cairo-script-interpreter
+    library, see :data:`HAS_SCRIPT_INTERPRETER`.
+
+    .. versionadded:: 1.30.0
+    """
+
+
+def write_pngs(
+    items: Sequence[tuple[Surface, Union[_PathLike, _FileLike]]],
+    threads: int = 0,
+) -> list[Status]:
+    """
+    :param items: ``(surface, fobj)`` tuples, where *fobj* is a filename or
+        a writable file object like for :meth:`Surface.write_to_png`
+    :param threads: the number of threads to use, including the calling
+        one, or 0 to use one per CPU
+    :returns: the :class:`Status` of each item, :attr:`Status.SUCCESS` if it
+        was written
+    :raises ValueError: if *threads* is negative
+    :raises TypeError: if an item isn't a ``(surface, fobj)`` tuple
+
+    Writes each surface as a PNG image, encoding them concurrently on native
+    threads without holding the GIL. Failing items don't stop the others;
+    their errors are reported in the returned list instead of being raised.
+
+    Writing to file objects which aren't backed by a file descriptor needs
+    the GIL for each chunk of output, so filenames give the best speedup.
+    The surfaces must not be drawn to by other threads until this returns.
+
+    .. versionadded:: 1.30.0
+    """
+
+
+def memory_stats() -> dict[str, Any]:
+    """
+    :returns: a dict with the keys ``"surfaces"``, ``"pixel_bytes"``,
+        ``"peak_pixel_bytes"`` and ``"pool_idle_bytes"``
+
+    Returns statistics about the surfaces currently alive which were created
+    by or passed through pycairo. ``"surfaces"`` maps the surface type, for
+    example ``"image"`` or ``"pdf"``, to the number of live surfaces of that
+    type. ``"pixel_bytes"`` is the size of the pixel memory allocated for
+    the live image surfaces pycairo created and ``"peak_pixel_bytes"`` the
+    highest value
+    it has reached so far in this process. ``"pool_idle_bytes"`` is the memory
+    kept by all :class:`SurfacePool` objects for reuse, which isn't part of
+    ``"pixel_bytes"``.
+
+    Only images created by :class:`ImageSurface`,
+    :meth:`ImageSurface.create_from_png`,
+    :meth:`ImageSurface.create_from_pixels`, :meth:`Surface.create_similar`,
+    :meth:`Surface.create_similar_image`, :meth:`Surface.map_to_image` and
+    :class:`SurfacePool` count with their memory. Other image surfaces, like
+    the ones created with :meth:`ImageSurface.create_for_data` or passed in
+    by other libraries, are counted, but their memory is not, since it
+    belongs to someone else.
+    The same goes for images returned by :meth:`Surface.map_to_image` for an
+    :class:`ImageSurface`, while images mapped from other surface types are
+    counted with their memory until they get unmapped.
+    The pixel memory of a surface is released when the surface is finished
+    or destroyed.
+
+    The same pixel allocations, including the idle buffers of pools, are also
+    reported to :mod:`tracemalloc` in the :data:`TRACEMALLOC_DOMAIN` domain
+    when tracing is active.
+
+    .. versionadded:: 1.30.0
+    """
+
+
+def set_image_memory_limit(
+    limit: Optional[int], timeout: Optional[float] = 0.0
+) -> None:
+    """
+    :param limit: the maximum number of bytes of pixel memory for all live
+        image surfaces, or :obj:`None` to remove the limit
+    :param timeout: how long to wait for memory to be released, in seconds.
+        ``0`` fails immediately and :obj:`None` waits forever.
+    :raises ValueError: if *limit* or *timeout* are negative
+
+    Sets a process wide budget for the pixel memory of image surfaces, as
+    reported by :func:`memory_stats`. :class:`ImageSurface`,
+    :meth:`Surface.create_similar_image` and :meth:`Surface.map_to_image`
+    check the size of the new image against the budget before allocating it
+    and raise :exc:`cairo.MemoryError` if it doesn't fit. An image returned by
+    :meth:`Surface.map_to_image` counts against the budget until it gets
+    unmapped, unless it shares the memory of an :class:`ImageSurface`.
+    Idle buffers kept by :class:`SurfacePool` objects count as well, and are
+    freed before an allocation fails or waits.
+
+    If *timeout* isn't zero the allocation instead waits until enough memory
+    gets released by other surfaces being finished or destroyed, for example
+    by other threads, and only fails once the timeout has passed. Surfaces
+    larger than the limit itself fail right away.
+
+    By default there is no limit.
+
+    .. versionadded:: 1.30.0
+    """
+
+
+def get_image_memory_limit() -> Optional[int]:
+    """
+    :returns: the current image memory limit in bytes, or :obj:`None` if there
+        is none
+
+    See :func:`set_image_memory_limit`.
+
+    .. versionadded:: 1.30.0
+    """
+
+
 class Path:
     """
     *Path* cannot be instantiated directly, it is created by calling
@@ -2111,6 +2318,13 @@ else:
         _WritableBuffer = Union[bytearray, memoryview, array.array[Any]]
     else:
         _WritableBuffer = Union[bytearray, memoryview, array.array]
+if sys.version_info >= (3, 12):
+    _DoubleBuffer = collections.abc.Buffer
+else:
+    if TYPE_CHECKING:
+        _DoubleBuffer = Union[memoryview, array.array[float]]
+    else:
+        _DoubleBuffer = Union[memoryview, array.array]
 
 
 class Surface:
@@ -2230,6 +2444,39 @@ class Surface:
         the only valid operations on a Surface are flushing and finishing it.
         Further drawing to the surface will not affect the surface but will
         instead trigger a `cairo.Error` exception.
+
+        :raises BufferError: if the pixel data of an :class:`ImageSurface` is
+            still exported, for example by a memoryview returned from
+            :meth:`ImageSurface.get_data`.
+
+        .. versionchanged:: 1.30.0
+            Raises :exc:`BufferError` while the pixel data is exported
+        """
+
+    def finish_async(self) -> asyncio.Future[None]:
+        """
+        :returns: a future of the running event loop, done once the surface
+            is finished
+        :raises BufferError: if the pixel data of an :class:`ImageSurface` is
+            still exported
+        :raises RuntimeError: if there is no running event loop or the
+            surface is already being finished
+
+        Like :meth:`finish`, but runs on a native worker thread and returns an
+        awaitable future, so finishing a large document surface doesn't block
+        the event loop::
+
+            await surface.finish_async()
+
+        Errors are raised when awaiting the future. The workers are shared by
+        all ``*_async()`` methods and there is at most one per CPU; no
+        executor thread is used. The surface must not be used until the
+        future is done; from the call on the pixel data of an
+        :class:`ImageSurface` can't be exported anymore, as if it was already
+        finished. Cancelling the future doesn't stop finishing the
+        surface.
+
+        .. versionadded:: 1.30.0
         """
 
     def flush(self) -> None:
@@ -2250,6 +2497,16 @@ class Surface:
         .. versionadded:: 1.2
         """
 
+    def get_deduplicate_images(self) -> bool:
+        """
+        :returns: whether image sources drawn on the surface get a content
+            based unique ID
+
+        See :meth:`set_deduplicate_images`.
+
+        .. versionadded:: 1.30.0
+        """
+
     def get_device(self) -> Optional[Device]:
         """
         :returns: the device or :obj:`None` if the surface does not have an
@@ -2453,6 +2710,31 @@ class Surface:
         .. versionadded:: 1.2
         """
 
+    def set_deduplicate_images(self, enabled: bool) -> None:
+        """
+        :param enabled: whether to tag image sources with a content based
+            unique ID
+
+        PDF, PS and SVG output embeds an image once per
+        :data:`MIME_TYPE_UNIQUE_ID`, but images without one, like the same
+        logo loaded anew for every page, are embedded again each time they
+        are drawn. If enabled, every :class:`ImageSurface` used as a source or
+        mask by a :class:`Context` drawing on this surface gets a unique ID
+        computed from a hash of its pixels (see
+        :meth:`ImageSurface.set_unique_id_from_content`), so images with equal
+        contents are only embedded once. Unique IDs set with
+        :meth:`set_mime_data` are kept.
+
+        The pixels are hashed the first time the image is set as a source
+        and again only after it was drawn on or marked dirty with
+        :meth:`Surface.mark_dirty`, since cairo drops the unique ID then.
+        Enable this on the surface
+        the contexts draw on, for example on the :class:`RecordingSurface`
+        passed to :meth:`PDFSurface.queue_page`.
+
+        .. versionadded:: 1.30.0
+        """
+
     def set_mime_data(self, mime_type: str, data: Optional[bytes]) -> None:
         """
         :param mime_type: the MIME type of the image data
@@ -2480,6 +2762,29 @@ class Surface:
         .. versionadded:: 1.12.0
         """
 
+    def set_mime_data_from_file(self, mime_type: str, path: _PathLike) -> None:
+        """
+        :param mime_type: the MIME type of the image data
+            (:ref:`constants_MIME_TYPE`)
+        :param path: the file holding the image data
+        :raises OSError: if the file can't be opened or mapped
+        :raises ValueError: if the file is empty
+
+        Like :meth:`set_mime_data`, but maps the file into memory instead of
+        reading it, for example to embed the original JPEG files of many
+        images into a PDF without holding all of them in RAM. The mapping is
+        released when the MIME data is replaced or removed, or the surface and
+        everything drawn from it are gone. The file must not be changed in
+        the meantime.
+
+        :meth:`get_mime_data` returns a copy of the data as :class:`bytes`.
+
+        Only available on systems providing ``mmap()``, like Linux and
+        macOS.
+
+        .. versionadded:: 1.30.0
+        """
+
     def show_page(self) -> None:
         """
         Emits and clears the current page for backends that support multiple
@@ -2512,6 +2817,25 @@ class Surface:
 
         Writes the contents of *Surface* to *fobj* as a PNG image. *fobj* can either be
         a filename or a file object opened in binary mode.
+
+        .. versionchanged:: 1.30.0
+            The PNG data is written to file objects in large chunks, see
+            :func:`output_stats`.
+        """
+
+    def write_to_png_async(self, fobj: Union[_FileLike, _PathLike]) -> asyncio.Future[None]:
+        """
+        :param fobj: a filename or writable file object
+        :returns: a future of the running event loop, done once the PNG is
+            written
+        :raises RuntimeError: if there is no running event loop
+
+        Like :meth:`write_to_png`, but encodes the PNG on a native worker
+        thread, see :meth:`finish_async`. Errors are raised when awaiting the
+        future. File objects get written to from the worker thread. The
+        surface must not be drawn to until the future is done.
+
+        .. versionadded:: 1.30.0
         """
 
     def unmap_image(self, image: ImageSurface) -> None:
@@ -2540,19 +2864,103 @@ class ImageSurface(Surface):
     A *cairo.ImageSurface* provides the ability to render to memory buffers
     either allocated by cairo or by the calling code. The supported image
     formats are those defined in :class:`cairo.Format`.
+
+    *ImageSurface* implements the buffer protocol, so the pixel data can be
+    passed directly to :class:`memoryview` or :func:`numpy.asarray`. The data
+    is exported with the shape ``(height, width, channels)`` using the row
+    stride of the surface:
+
+    * :attr:`Format.ARGB32`, :attr:`Format.RGB24`: 4 channels of unsigned
+      bytes, in native endian pixel order
+    * :attr:`Format.A8`: 1 channel of unsigned bytes
+    * :attr:`Format.RGB16_565`: 1 channel of native 16 bit integers
+    * :attr:`Format.RGB30`: 1 channel of native 32 bit integers
+    * :attr:`Format.RGB96F`, :attr:`Format.RGBA128F`: 3 and 4 channels of
+      floats
+    * :attr:`Format.A1`: the raw bytes of each row, with the shape
+      ``(height, stride)``
+
+    While the buffer is exported the surface can't be finished and
+    :meth:`Surface.finish` raises :exc:`BufferError`.
+
+    .. versionchanged:: 1.30.0
+        Implements the buffer protocol
     """
 
-    def __init__(self, format: Format, width: int, height: int) -> None:
+    def __init__(
+        self,
+        format: Format,
+        width: int,
+        height: int,
+        allocator: str = "default",
+    ) -> None:
         """
         :param format: format of pixels in the surface to create
         :param width: width of the surface, in pixels
         :param height: height of the surface, in pixels
+        :param allocator: how the pixel memory is allocated:
+
+            * ``"default"``: by cairo
+            * ``"aligned64"``: by pycairo, with every row starting at a 64
+              byte boundary
+            * ``"hugepage"``: like ``"aligned64"``, but mapped using huge
+              pages where the platform supports them. On Linux reserved huge
+              pages are used if available, otherwise transparent huge pages
+              are requested. Elsewhere this is the same as ``"aligned64"``.
+
         :returns: a new *ImageSurface*
+        :raises ValueError: if *allocator* is unknown
 
         Creates an *ImageSurface* of the specified format and dimensions. Initially
         the surface contents are all 0. (Specifically, within each pixel, each
         color or alpha channel belonging to format will be 0. The contents of bits
         within a pixel, but not belonging to the given format are undefined).
+
+        Huge pages reduce TLB misses and the number of page faults when
+        drawing on large surfaces for the first time. With a custom
+        *allocator* the stride can be larger than the one returned by
+        :meth:`Format.stride_for_width`. The memory is freed when the
+        surface is finished.
+
+        .. versionchanged:: 1.30.0
+            Added the *allocator* parameter
+        """
+
+    def convert_to(
+        self,
+        data: _WritableBuffer,
+        layout: Union[str, Format],
+        stride: int = ...,
+    ) -> None:
+        """
+        :param data: a writable buffer the pixels get written to, see
+            :class:`_WritableBuffer`
+        :param layout: the pixel layout to write, either one of ``"RGBA"``,
+            ``"BGRA"``, ``"ARGB"``, ``"RGB"``, ``"BGR"`` and ``"L"``, or a
+            :class:`Format`
+        :param stride: the number of bytes between the start of rows in
+            *data*. If not given the rows are tightly packed for the byte
+            layouts and :meth:`Format.stride_for_width` is used for a
+            :class:`Format`.
+        :raises ValueError: if the format of the surface or *layout* isn't
+            supported
+        :raises TypeError: if *data* is not long enough
+
+        Converts the content of the surface and writes it to *data*.
+
+        The byte layouts contain 8 bit channels in the given byte order with
+        straight, not premultiplied, alpha, as used by PIL or most image
+        encoders. ``"RGB"`` and ``"BGR"`` drop the alpha channel and ``"L"``
+        writes the luminance. Converting to a :class:`Format` keeps the alpha
+        premultiplied, like drawing the surface with
+        :attr:`Operator.SOURCE` onto a surface in that format would.
+
+        The supported formats are :attr:`Format.ARGB32`,
+        :attr:`Format.RGB24`, :attr:`Format.A8`, :attr:`Format.RGB16_565`,
+        :attr:`Format.RGB96F` and :attr:`Format.RGBA128F`. The surface gets
+        flushed before reading.
+
+        .. versionadded:: 1.30.0
         """
 
     @classmethod
@@ -2593,6 +3001,87 @@ class ImageSurface(Surface):
         :meth:`cairo.Format.stride_for_width` for example code.
         """
 
+    @classmethod
+    def create_for_mmap(
+        cls,
+        path: _PathLike,
+        format: Format,
+        width: int,
+        height: int,
+        stride: int = ...,
+        mode: str = "r+",
+        sync: bool = False,
+    ) -> ImageSurface:
+        """
+        :param path: the file to map
+        :param format: the format of pixels in the file
+        :param width: the width of the image
+        :param height: the height of the image
+        :param stride: the number of bytes between the start of rows in the
+            file. If not given the value from
+            :meth:`cairo.Format.stride_for_width` is used.
+        :param mode: ``"r+"`` to map an existing file, ``"w+"`` to create
+            or overwrite the file and size it for the image, or ``"c"`` to
+            map an existing file copy-on-write, so changes are never written
+            back to the file.
+        :param sync: if the pixels should be written back to the file on
+            :meth:`Surface.flush` and :meth:`Surface.finish`. Otherwise the
+            operating system writes them back whenever it sees fit.
+        :returns: a new *ImageSurface*
+        :raises OSError: if the file can't be opened or mapped
+        :raises ValueError: if the file is smaller than *stride* * *height*
+            bytes
+
+        Creates an *ImageSurface* whose pixel data is a memory mapping of
+        *path*, starting at the beginning of the file. The pixels are stored
+        in the file in the same layout as :meth:`create_for_data` expects. A
+        "w+" file starts out with all pixels set to 0.
+
+        The mapping lives until the surface is finished, which lets the
+        operating system page out parts of very large images which are not
+        used and lets other processes read the image without copying it.
+
+        Only available on systems providing ``mmap()``, like Linux and
+        macOS.
+
+        .. versionadded:: 1.30.0
+        """
+
+    @classmethod
+    def create_from_pixels(
+        cls,
+        data: Union[bytes, _WritableBuffer],
+        layout: Union[str, Format],
+        width: int,
+        height: int,
+        stride: int = ...,
+    ) -> ImageSurface:
+        """
+        :param data: the pixels to read, any object implementing the buffer
+            protocol
+        :param layout: the pixel layout of *data*, see :meth:`convert_to`
+        :param width: the width of the image in *data*
+        :param height: the height of the image in *data*
+        :param stride: the number of bytes between the start of rows in
+            *data*, see :meth:`convert_to`
+        :returns: a new *ImageSurface*
+        :raises ValueError: if *layout* isn't supported
+        :raises TypeError: if *data* is not long enough
+
+        Creates a new *ImageSurface* with a copy of the pixels in *data*,
+        which are converted to the format cairo uses. The ``"RGBA"``,
+        ``"BGRA"`` and ``"ARGB"`` layouts are expected to have straight
+        alpha and create a :attr:`Format.ARGB32` surface, ``"RGB"``, ``"BGR"``
+        and ``"L"`` create a :attr:`Format.RGB24` surface. For a
+        :class:`Format` the surface uses that format and the data is copied
+        as is.
+
+        Unlike :meth:`create_for_data` the surface doesn't reference *data*
+        after it is created.
+
+        .. versionadded:: 1.30.0
+        """
+
     @classmethod
     def create_from_png(cls, fobj: Union[_PathLike, _FileLike]) -> ImageSurface:
         """
@@ -2606,6 +3095,23 @@ class ImageSurface(Surface):
         binary mode.
         """
 
+    @classmethod
+    def create_from_png_async(
+            cls, fobj: Union[_PathLike, _FileLike]) -> asyncio.Future[ImageSurface]:
+        """
+        :param fobj:
+            a :obj:`_PathLike`, file, or file-like object of the PNG to load.
+        :returns: a future of the running event loop resolving to the new
+            *ImageSurface*
+        :raises RuntimeError: if there is no running event loop
+
+        Like :meth:`create_from_png`, but decodes the PNG on a native worker
+        thread, see :meth:`Surface.finish_async`. File objects get read from
+        the worker thread.
+
+        .. versionadded:: 1.30.0
+        """
+
     format_stride_for_width = Format.stride_for_width
     """
     See :meth:`cairo.Format.stride_for_width`.
@@ -2613,6 +3119,36 @@ class ImageSurface(Surface):
     .. versionadded:: 1.6
     """
 
+    @classmethod
+    def create_shared(
+        cls,
+        format: Format,
+        width: int,
+        height: int,
+        name: Optional[str] = None,
+    ) -> ImageSurface:
+        """
+        :param format: the format of pixels in the surface to create
+        :param width: width of the surface, in pixels
+        :param height: height of the surface, in pixels
+        :param name: the name of the shared memory segment to create. If not
+            given a unique name is chosen.
+        :returns: a new *ImageSurface*
+        :raises FileExistsError: if a segment with *name* already exists
+
+        Creates an *ImageSurface* whose pixel data lives in a new
+        :class:`multiprocessing.shared_memory.SharedMemory` segment, using
+        the stride from :meth:`cairo.Format.stride_for_width`. Other
+        processes can draw into the same pixels by passing the name of the
+        segment, see :meth:`get_shared_memory`, to :meth:`open_shared`.
+
+        The creating process owns the segment and has to call
+        :meth:`multiprocessing.shared_memory.SharedMemory.unlink` once it is
+        no longer needed.
+
+        .. versionadded:: 1.30.0
+        """
+
     def get_data(self) -> memoryview:
         """
         :returns: a Python memoryview object for the data of the *ImageSurface*,
@@ -2630,6 +3166,11 @@ class ImageSurface(Surface):
         .. versionchanged:: 1.28.0
             Will warn in case the surface is already finished. In a future version
             this will raise instead.
+
+        .. versionchanged:: 1.30.0
+            Returns an empty memoryview in case the surface is already
+            finished. The returned memoryview keeps the buffer of the surface
+            exported until it is released.
         """
 
     def get_format(self) -> Format:
@@ -2645,6 +3186,17 @@ class ImageSurface(Surface):
         :returns: the height of the *ImageSurface* in pixels.
         """
 
+    def get_shared_memory(self) -> Optional[SharedMemory]:
+        """
+        :returns: the shared memory segment containing the pixel data, or
+            :obj:`None` if the surface wasn't created with
+            :meth:`create_shared` or :meth:`open_shared`.
+
+        The segment stays open as long as the surface exists.
+
+        .. versionadded:: 1.30.0
+        """
+
     def get_stride(self) -> int:
         """
         :returns: the stride of the *ImageSurface* in bytes. The stride is the
@@ -2657,6 +3209,131 @@ class ImageSurface(Surface):
         :returns: the width of the *ImageSurface* in pixels.
         """
 
+    def set_unique_id_from_content(self) -> None:
+        """
+        Sets the :data:`MIME_TYPE_UNIQUE_ID` of the surface to a 64 bit hash
+        of its pixels, format and size, replacing any unique ID set before.
+        Surfaces with equal contents get the same ID, which vector backends
+        use to embed them only once. Call it again after drawing on the
+        surface, the ID isn't updated automatically.
+
+        .. versionadded:: 1.30.0
+        """
+
+    @classmethod
+    def open_shared(
+        cls,
+        name: str,
+        format: Format,
+        width: int,
+        height: int,
+        stride: int = ...,
+    ) -> ImageSurface:
+        """
+        :param name: the name of an existing shared memory segment
+        :param format: the format of pixels in the segment
+        :param width: the width of the image
+        :param height: the height of the image
+        :param stride: the number of bytes between the start of rows. If not
+            given the value from :meth:`cairo.Format.stride_for_width` is
+            used.
+        :returns: a new *ImageSurface*
+        :raises FileNotFoundError: if there is no segment named *name*
+        :raises TypeError: if the segment is too small for the image
+
+        Creates an *ImageSurface* for the pixels in an existing
+        :class:`multiprocessing.shared_memory.SharedMemory` segment, for
+        example one created by :meth:`create_shared` in another process.
+        Drawing on the surface is visible to all processes with the segment
+        open, after a call to :meth:`Surface.flush`. Concurrent drawing to the
+        same pixels has to be synchronized by the caller.
+
+        Opening a segment doesn't register it with the resource tracker of
+        :mod:`multiprocessing`, so it isn't unlinked when this process exits.
+
+        .. versionadded:: 1.30.0
+        """
+
+
+class SurfacePool:
+    """
+    A *SurfacePool* hands out :class:`ImageSurface` objects and keeps their
+    pixel memory once they are finished, to use it again for the next
+    surface with the same format and size. This avoids allocating and
+    clearing fresh memory for each frame when many short-lived surfaces of
+    the same size are used, for example when rendering tiles or animation
+    frames.
+
+    Surfaces are returned to the pool when they are finished, either by
+    :meth:`release`, :meth:`Surface.finish` or by leaving their ``with``
+    block, or when they are garbage collected. Only the pixel memory is
+    reused, every surface acquired from the pool is a new object without
+    mime data, user data or device offset from its predecessor.
+
+    Idle buffers count against the limit set with
+    :func:`set_image_memory_limit`, and get freed if an allocation would
+    exceed it otherwise.
+
+    ::
+
+        pool = cairo.SurfacePool()
+        for tile in tiles:
+            with pool.acquire(cairo.Format.ARGB32, 256, 256) as surface:
+                render(surface, tile)
+
+    .. versionadded:: 1.30.0
+    """
+
+    def __init__(self, max_size: int = 16) -> None:
+        """
+        :param max_size: the maximum number of idle buffers kept. If a
+            surface is returned to a full pool the least recently returned
+            buffer is freed.
+        :raises ValueError: if *max_size* is negative
+        """
+
+    def acquire(self, format: Format, width: int, height: int) -> ImageSurface:
+        """
+        :param format: the format of the surface
+        :param width: the width of the surface in pixels
+        :param height: the height of the surface in pixels
+        :returns: a new *ImageSurface* with all pixels cleared to zero
+        :raises ValueError: if *width* or *height* are negative or *format*
+            is invalid
+        :raises MemoryError: if the image memory limit set with
+            :func:`set_image_memory_limit` would be exceeded
+
+        Creates a surface using an idle buffer of the same format and size if
+        there is one, otherwise new memory is allocated.
+        """
+
+    def release(self, surface: ImageSurface) -> None:
+        """
+        :param surface: a surface returned by :meth:`acquire` of this pool
+        :raises ValueError: if *surface* wasn't acquired from this pool
+
+        Finishes *surface* and returns its memory to the pool. Same as
+        calling :meth:`Surface.finish`.
+        """
+
+    def clear(self) -> None:
+        """
+        Frees all idle buffers. Surfaces still in use are not affected and
+        are returned to the pool when finished.
+        """
+
+    def stats(self) -> dict[str, int]:
+        """
+        :returns: a dict with the following keys:
+
+            * ``hits``: number of :meth:`acquire` calls which reused a buffer
+            * ``misses``: number of :meth:`acquire` calls which had to
+              allocate a new buffer
+            * ``discarded``: number of buffers freed because the pool was full
+            * ``idle``: number of buffers currently kept by the pool
+            * ``idle_bytes``: size of all idle buffers in bytes
+        """
+
 
 class SurfacePattern(Pattern):
     def __init__(self, surface: Surface) -> None:
@@ -2672,6 +3349,62 @@ class SurfacePattern(Pattern):
         """
 
 
+class PickBuffer:
+    """
+    A *PickBuffer* records which feature was drawn last at each pixel,
+    making it possible to find the feature under the mouse cursor with a
+    single pixel read instead of testing the geometry of every feature with
+    :meth:`Context.in_fill`.
+
+    It contains a :attr:`Format.RGB24` image which gets the fills and
+    strokes of a :class:`Context` mirrored into it, see
+    :meth:`Context.set_pick_buffer`. Each shape is drawn without
+    antialiasing and with the current pick ID as color, so the pixels
+    contain exact IDs. Multiple contexts can draw into the same pick
+    buffer.
+
+    ::
+
+        pick = cairo.PickBuffer(width, height)
+        ctx.set_pick_buffer(pick)
+        for feature_id, feature in enumerate(features, 1):
+            ctx.set_pick_id(feature_id)
+            draw(ctx, feature)
+
+        feature_id = pick.lookup(mouse_x, mouse_y)
+
+    .. versionadded:: 1.30.0
+    """
+
+    def __init__(self, width: int, height: int) -> None:
+        """
+        :param width: the width in pixels, usually the one of the target
+            surface
+        :param height: the height in pixels
+        :raises cairo.Error: if the size is invalid
+        """
+
+    def clear(self) -> None:
+        """
+        Sets all pixels to 0, meaning no feature.
+        """
+
+    def get_surface(self) -> ImageSurface:
+        """
+        :returns: the image containing the IDs, in the lower 24 bits of each
+            pixel. Can be used for looking up many positions at once, for
+            example with :func:`numpy.asarray`.
+        """
+
+    def lookup(self, x: int, y: int) -> int:
+        """
+        :param x: the X position in pixels
+        :param y: the Y position in pixels
+        :returns: the ID drawn last at the pixel, or 0 if there was none or
+            the position is outside of the buffer
+        """
+
+
 class Context(Generic[_SomeSurface]):
     """
     *Context* is the main object used when drawing with cairo. To draw with cairo,
@@ -2771,6 +3504,44 @@ class Context(Generic[_SomeSurface]):
         the direction of the arc between the two angles.
         """
 
+    def blit_many(
+        self,
+        atlas: Surface,
+        src_rects: _DoubleBuffer,
+        dst_points: _DoubleBuffer,
+        alphas: Optional[_DoubleBuffer] = None,
+    ) -> None:
+        """
+        :param atlas: the surface containing all sprites
+        :param src_rects: ``x, y, width, height`` of the sprite in *atlas*
+            for each blit, see :class:`_DoubleBuffer`
+        :param dst_points: ``x, y`` of the top left corner in user space for
+            each blit
+        :param alphas: optional opacity for each blit, between 0 and 1
+        :raises TypeError: if a buffer doesn't contain doubles
+        :raises ValueError: if the buffers don't describe the same number of
+            blits
+
+        Composites many rectangular parts of *atlas* using the current
+        operator, clip and transformation. Each blit does the same as::
+
+            ctx.set_source_surface(atlas, x - src_x, y - src_y)
+            ctx.rectangle(x, y, width, height)
+            ctx.fill()  # or clip() + paint_with_alpha(alpha)
+
+        but all blits are done in one call without holding the GIL, which
+        makes drawing thousands of markers or icons per frame fast. The
+        source and clip are left unchanged and the current path is cleared.
+
+        ::
+
+            src = array.array("d", [0, 0, 16, 16, 16, 0, 16, 16])
+            dst = array.array("d", [10, 10, 50, 20])
+            ctx.blit_many(atlas, src, dst)
+
+        .. versionadded:: 1.30.0
+        """
+
     def clip(self) -> None:
         """
         Establishes a new clip region by intersecting the current clip region
@@ -2941,6 +3712,43 @@ class Context(Generic[_SomeSurface]):
         transforming *(dx,dy)*.
         """
 
+    def draw_instances(
+        self,
+        path: Path,
+        transforms: _DoubleBuffer,
+        colors: Optional[_DoubleBuffer] = None,
+        mode: str = "fill",
+    ) -> None:
+        """
+        :param path: the shape to draw, in user space of each instance
+        :param transforms: ``xx, yx, xy, yy, x0, y0`` for each instance, the
+            same layout as :class:`Matrix`, see :class:`_DoubleBuffer`
+        :param colors: optional ``red, green, blue, alpha`` source color for
+            each instance
+        :param mode: ``"fill"`` or ``"stroke"``
+        :raises TypeError: if a buffer doesn't contain doubles
+        :raises ValueError: if *mode* is unknown or *transforms* and
+            *colors* don't describe the same number of instances
+
+        Draws *path* once for each transformation, for example for arrows
+        in a vector field or map markers. Each instance does the same as::
+
+            ctx.save()
+            ctx.transform(cairo.Matrix(xx, yx, xy, yy, x0, y0))
+            ctx.new_path()
+            ctx.append_path(path)
+            ctx.set_source_rgba(red, green, blue, alpha)
+            ctx.fill()  # or ctx.stroke()
+            ctx.restore()
+
+        but all instances are drawn in one call without holding the GIL.
+        Without *colors* the current source is used. When stroking, the line
+        width and dashes are scaled by each transformation like in the code
+        above. The current path is cleared.
+
+        .. versionadded:: 1.30.0
+        """
+
     def fill(self) -> None:
         """
         A drawing operator that fills the current path according to the current
@@ -3147,6 +3955,21 @@ class Context(Generic[_SomeSurface]):
             for a :class:`Context`.
         """
 
+    def get_pick_buffer(self) -> Optional[PickBuffer]:
+        """
+        :returns: the pick buffer set with :meth:`set_pick_buffer` or
+            :obj:`None`
+
+        .. versionadded:: 1.30.0
+        """
+
+    def get_pick_id(self) -> int:
+        """
+        :returns: the pick ID set with :meth:`set_pick_id`, 0 by default
+
+        .. versionadded:: 1.30.0
+        """
+
     def get_scaled_font(self) -> ScaledFont:
         """
         :returns: the current :class:`ScaledFont` for a :class:`Context`.
@@ -3159,6 +3982,15 @@ class Context(Generic[_SomeSurface]):
         :returns: the current source :class:`Pattern` for  a :class:`Context`.
         """
 
+    def get_stats_enabled(self) -> bool:
+        """
+        :returns: whether operation statistics are collected for this context
+
+        See :meth:`Context.set_stats_enabled`.
+
+        .. versionadded:: 1.30.0
+        """
+
     def get_target(self) -> _SomeSurface:
         """
         :returns: the target :class:`Surface` for the :class:`Context`
@@ -3224,6 +4056,21 @@ class Context(Generic[_SomeSurface]):
         .. versionadded:: 1.12.0
         """
 
+    def in_clip_many(self, points: _DoubleBuffer) -> bytes:
+        """
+        :param points: ``x, y`` for each point to test, see
+            :class:`_DoubleBuffer`
+        :returns: one byte for each point, 1 if it is inside the current clip
+            and 0 otherwise
+        :raises TypeError: if *points* isn't a buffer of doubles
+
+        Like :meth:`in_clip`, but tests all points in one call without
+        holding the GIL. The result can be turned into an array with
+        ``numpy.frombuffer(result, dtype=bool)``.
+
+        .. versionadded:: 1.30.0
+        """
+
     def in_fill(self, x: float, y: float) -> bool:
         """
         :param x: X coordinate of the point to test
@@ -3236,6 +4083,22 @@ class Context(Generic[_SomeSurface]):
         :meth:`Context.fill_preserve`.
         """
 
+    def in_fill_many(self, points: _DoubleBuffer) -> bytes:
+        """
+        :param points: ``x, y`` for each point to test, see
+            :class:`_DoubleBuffer`
+        :returns: one byte for each point, 1 if it is inside the area that
+            would be affected by :meth:`fill` and 0 otherwise
+        :raises TypeError: if *points* isn't a buffer of doubles
+
+        Like :meth:`in_fill`, but tests all points in one call without
+        holding the GIL, for example for selecting data points with a lasso.
+        Points outside of :meth:`fill_extents` are rejected without looking
+        at the path.
+
+        .. versionadded:: 1.30.0
+        """
+
     def in_stroke(self, x: float, y: float) -> bool:
         """
         :param x: X coordinate of the point to test
@@ -3251,6 +4114,21 @@ class Context(Generic[_SomeSurface]):
         :meth:`Context.set_dash`, and :meth:`Context.stroke_preserve`.
         """
 
+    def in_stroke_many(self, points: _DoubleBuffer) -> bytes:
+        """
+        :param points: ``x, y`` for each point to test, see
+            :class:`_DoubleBuffer`
+        :returns: one byte for each point, 1 if it is inside the area that
+            would be affected by :meth:`stroke` and 0 otherwise
+        :raises TypeError: if *points* isn't a buffer of doubles
+
+        Like :meth:`in_stroke`, but tests all points in one call without
+        holding the GIL. Points outside of :meth:`stroke_extents` are
+        rejected without looking at the path.
+
+        .. versionadded:: 1.30.0
+        """
+
     def line_to(self, x: float, y: float) -> None:
         """
         :param x: the X coordinate of the end of the new line
@@ -3364,6 +4242,34 @@ class Context(Generic[_SomeSurface]):
         .. versionadded:: 1.6
         """
 
+    def polyline(self, points: _DoubleBuffer, decimate: bool = True) -> int:
+        """
+        :param points: ``x, y`` in user space for each point of the line, see
+            :class:`_DoubleBuffer`
+        :param decimate: whether to drop points which don't change the
+            rendered result at the current resolution
+        :returns: the number of points added to the path
+        :raises TypeError: if *points* isn't a buffer of doubles
+
+        Adds a polyline to the current path, starting a new sub-path at the
+        first point like :meth:`move_to` and continuing with
+        :meth:`line_to` for the other points. Points with a NaN or infinite
+        coordinate leave a gap, the line continues with a new sub-path at
+        the next valid point.
+
+        With *decimate*, consecutive points falling into the same pixel
+        column in device space, using the current transformation and the
+        device scale of the target, are reduced to the first, last, lowest
+        and highest of them (M4 aggregation). Stroking the result with a
+        line width of up to a pixel rasterizes to the same pixels as the
+        full line, which makes plotting series with many more samples than
+        pixels much faster. Changing the transformation afterwards, or
+        drawing the path on a surface with a higher resolution, can make
+        the dropped points visible.
+
+        .. versionadded:: 1.30.0
+        """
+
     def pop_group(self) -> SurfacePattern:
         """
         :returns: a newly created :class:`SurfacePattern` containing the results
@@ -3861,6 +4767,44 @@ class Context(Generic[_SomeSurface]):
         The default operator is :attr:`cairo.Operator.OVER`.
         """
 
+    def set_pick_buffer(self, pick: Optional[PickBuffer]) -> None:
+        """
+        :param pick: the pick buffer to draw IDs into, or :obj:`None` to stop
+            drawing into one
+        :raises TypeError: if *pick* isn't a :class:`PickBuffer` or
+            :obj:`None`
+
+        Sets a pick buffer which gets every fill and stroke done by this
+        context mirrored into it, with the current pick ID as color. Only
+        :meth:`fill`, :meth:`fill_preserve`, :meth:`stroke` and
+        :meth:`stroke_preserve` are mirrored, using the current path,
+        transformation, fill rule and line style. The clip is applied if
+        it consists of rectangles only, as reported by
+        :meth:`copy_clip_rectangle_list`.
+
+        The device scale and offset of the target surface are copied to the
+        pick buffer, so that its pixels line up with the ones of the
+        target.
+
+        See :meth:`set_pick_id`.
+
+        .. versionadded:: 1.30.0
+        """
+
+    def set_pick_id(self, id: int) -> None:
+        """
+        :param id: the ID to draw into the pick buffer, between 0 and
+            0xffffff. 0 turns mirroring off.
+        :raises ValueError: if *id* is out of range
+
+        Sets the ID used for the following fills and strokes in the pick
+        buffer set with :meth:`set_pick_buffer`. The ID isn't part of the
+        graphics state and isn't affected by :meth:`save` and
+        :meth:`restore`.
+
+        .. versionadded:: 1.30.0
+        """
+
     def set_scaled_font(self, scaled_font: ScaledFont) -> None:
         """
         :param scaled_font: a :class:`ScaledFont`
@@ -3957,6 +4901,29 @@ class Context(Generic[_SomeSurface]):
         :meth:`.Pattern.set_extend`).
         """
 
+    def set_stats_enabled(self, enabled: bool) -> None:
+        """
+        :param enabled: whether to collect operation statistics
+
+        Enables or disables the collection of operation statistics for this
+        context. While enabled, pycairo counts each drawing operation and
+        measures the time spent inside cairo for it, without taking the GIL.
+        The results are available through :meth:`Context.stats` and are also
+        added to the process wide totals returned by :func:`context_stats`.
+
+        Operations are grouped into the categories ``"path"``, ``"fill"``,
+        ``"stroke"``, ``"paint"``, ``"mask"``, ``"clip"``, ``"show_text"``,
+        ``"show_glyphs"`` and ``"show_page"``. Path construction calls like
+        :meth:`Context.line_to` are only counted, not timed. Mirroring a fill
+        or stroke into a :class:`PickBuffer` isn't part of its time.
+
+        Disabling the statistics discards the per-context counters. When
+        disabled, which is the default, the overhead per operation is a single
+        lookup.
+
+        .. versionadded:: 1.30.0
+        """
+
     def set_tolerance(self, tolerance: float) -> None:
         """
         :param tolerance: the tolerance, in device units (typically pixels)
@@ -4052,6 +5019,18 @@ class Context(Generic[_SomeSurface]):
         See :class:`TextCluster` for constraints on valid clusters.
         """
 
+    def stats(self) -> dict[str, tuple[int, float]]:
+        """
+        :returns: a dict mapping each operation category to a tuple of the
+            number of calls and the total time spent in cairo, in seconds
+        :raises RuntimeError: if statistics aren't enabled
+
+        Returns the operation statistics collected since
+        :meth:`Context.set_stats_enabled` was called for this context.
+
+        .. versionadded:: 1.30.0
+        """
+
     def stroke(self) -> None:
         """
         A drawing operator that strokes the current path according to the
@@ -4721,7 +5700,12 @@ class PDFSurface(Surface):
         :returns: a new *PDFSurface* of the specified size in points to be
             written to *fobj*.
 
+        Output to a file object is buffered and only complete after
+        :meth:`Surface.finish`, see :func:`output_stats`.
+
         .. versionadded:: 1.2
+        .. versionchanged:: 1.30.0
+            Output to file objects is buffered natively.
         """
 
     def set_custom_metadata(self, name: str, value: Optional[str]) -> None:
@@ -4761,6 +5745,53 @@ class PDFSurface(Surface):
         .. versionadded:: 1.2
         """
 
+    def queue_page(self, page: RecordingSurface, max_pending: int = 2) -> None:
+        """
+        :param page: the contents of the page
+        :param max_pending: the maximum number of pages waiting to be written
+        :raises ValueError: if *max_pending* is less than 1
+        :raises Error: if writing one of the previously queued pages failed
+
+        Adds *page* to the document as the next page. The contents of *page*
+        are copied, and replayed into the document followed by
+        :meth:`Context.show_page` on a background thread, so Python can draw
+        the next page into the same or a new :class:`RecordingSurface` while
+        the previous one is compressed and written out.
+
+        If *max_pending* pages are waiting already, this blocks until one of
+        them is written, which limits the memory used by queued pages.
+
+        Methods of the surface which change the document, like
+        :meth:`Surface.show_page`, :meth:`Surface.finish`,
+        :meth:`set_page_label` or :meth:`set_size`, wait for the queued pages
+        before they take effect, as do creating a :class:`Context` for the
+        surface and :meth:`Context.show_page`. The pages are
+        also written if the surface gets garbage collected. A
+        :class:`Context` created for the surface before calling this must
+        not be used for drawing until :meth:`wait_pages` returns.
+
+        ::
+
+            with cairo.PDFSurface("out.pdf", 595, 842) as surface:
+                for item in items:
+                    page = cairo.RecordingSurface(
+                        cairo.Content.COLOR_ALPHA, None)
+                    draw_page(cairo.Context(page), item)
+                    surface.queue_page(page)
+
+        .. versionadded:: 1.30.0
+        """
+
+    def wait_pages(self) -> None:
+        """
+        :raises Error: if writing one of the queued pages failed
+
+        Waits until all pages added with :meth:`queue_page` are written to the
+        document.
+
+        .. versionadded:: 1.30.0
+        """
+
     def restrict_to_version(self, version: PDFVersion) -> None:
         """
         :param version: PDF version
@@ -4879,6 +5910,12 @@ class PSSurface(Surface):
 
         Note that the size of individual pages of the PostScript output can
         vary. See :meth:`.set_size`.
+
+        Output to a file object is buffered and written out by
+        :meth:`Surface.flush` and :meth:`Surface.finish`.
+
+        .. versionchanged:: 1.30.0
+            Output to file objects is buffered natively.
         """
 
     def dsc_begin_page_setup(self) -> None:
@@ -5073,6 +6110,29 @@ class PSSurface(Surface):
         .. versionadded:: 1.2
         """
 
+    def queue_page(self, page: RecordingSurface, max_pending: int = 2) -> None:
+        """
+        :param page: the contents of the page
+        :param max_pending: the maximum number of pages waiting to be written
+        :raises ValueError: if *max_pending* is less than 1
+        :raises Error: if writing one of the previously queued pages failed
+
+        Adds a copy of *page* to the document as the next page, which gets
+        written on a background thread. See :meth:`PDFSurface.queue_page`.
+
+        .. versionadded:: 1.30.0
+        """
+
+    def wait_pages(self) -> None:
+        """
+        :raises Error: if writing one of the queued pages failed
+
+        Waits until all pages added with :meth:`queue_page` are written to the
+        document.
+
+        .. versionadded:: 1.30.0
+        """
+
     @staticmethod
     def get_levels() -> list[PSLevel]:
         """
@@ -5103,6 +6163,12 @@ class SVGSurface(Surface):
             as a source, without generating a temporary file.
         :param width_in_points: width of the surface, in points (1 point == 1/72.0 inch)
         :param height_in_points: height of the surface, in points (1 point == 1/72.0 inch)
+
+        Output to a file object is buffered and written out by
+        :meth:`Surface.finish`.
+
+        .. versionchanged:: 1.30.0
+            Output to file objects is buffered natively.
         """
 
     def restrict_to_version(self, version: SVGVersion) -> None:
@@ -5362,6 +6428,16 @@ class RecordingSurface(Surface):
     necessary objects (paths, patterns, etc.), in order to achieve accurate
     replay.
 
+    cairo keeps the bounding box of every recorded command in a tree, which
+    is built on the first replay after the recording was modified. Replaying
+    into a target whose clip, in recording coordinates, is smaller than the
+    recording only visits the commands intersecting that clip, so showing a
+    viewport of a large scene costs time proportional to what is visible.
+    To benefit from this, keep the recording unchanged between replays, clip
+    the target context to the viewport before painting, and use a bounded
+    operator like :attr:`Operator.OVER`; unbounded operators replay the whole
+    recording.
+
     .. versionadded:: 1.11.0
     """
 
@@ -5406,6 +6482,56 @@ class RecordingSurface(Surface):
         .. versionadded:: 1.12.0
         """
 
+    def render_parallel(self, target: "ImageSurface", tile_size: int = 256,
+                        threads: int = 1) -> None:
+        """
+        :param target: the image surface to render into
+        :param tile_size: the width and height of the tiles in pixels
+        :param threads: the number of threads to use, including the calling
+            one, or 0 to use one per CPU
+        :raises ValueError: if *tile_size* is less than 1 or *threads* is
+            negative
+        :raises Error: if rendering failed
+
+        Replays the recorded operations into *target*, with the same result
+        as::
+
+            cr = cairo.Context(target)
+            cr.set_source_surface(recording_surface, 0.0, 0.0)
+            cr.paint()
+
+        The target is split into tiles of *tile_size* × *tile_size* pixels,
+        which get rendered without holding the GIL. This is meant for
+        rasterizing large scenes, for example a poster with a device scale
+        set via :meth:`Surface.set_device_scale`. Each tile replays the whole
+        recording clipped to its area, so a very small *tile_size* makes the
+        per-tile overhead dominate.
+
+        By default all tiles are rendered by the calling thread. Passing a
+        larger *threads* renders them concurrently on native threads, which
+        is only safe for recordings that draw with solid colors, gradients,
+        paths and text. cairo can't replay a recording surface from several
+        threads at once, so each additional thread replays its own copy of
+        the recorded operations, which costs memory proportional to the
+        recording size. The copy is shallow, everything the operations
+        reference is shared by all threads:
+
+        * image surfaces used as sources, which cairo may convert and attach
+          cached snapshots to while drawing with them
+        * recording surfaces used as sources, whose replay isn't thread
+          safe at all
+        * :class:`RasterSourcePattern` sources, whose callbacks get called
+          from all threads at once, each taking the GIL
+
+        Recordings which use any of these as sources should be rendered with
+        the default of one thread.
+
+        Neither the recording surface, the surfaces used as sources in it,
+        nor *target* may be modified by other threads until this returns.
+
+        .. versionadded:: 1.30.0
+        """
+
 
 class Region:
     """
@@ -5521,6 +6647,12 @@ class ScriptDevice(Device):
 
         Creates a output device for emitting the script, used when creating the
         individual surfaces.
+
+        Output to a file object is buffered and written out by
+        :meth:`Device.flush` and :meth:`Device.finish`.
+
+        .. versionchanged:: 1.30.0
+            Output to file objects is buffered natively.
         """
 
     def set_mode(self, mode: ScriptMode) -> None:
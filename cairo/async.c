@@ -0,0 +1,305 @@
+/* -*- mode: C; c-basic-offset: 2 -*-
+ *
+ * Pycairo - Python bindings for cairo
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "private.h"
+
+/* Worker pool for the *_async() methods. Jobs are queued together with an
+ * asyncio future; a native worker runs the blocking part of the job without
+ * the GIL, builds the result with the GIL and hands it to the event loop
+ * through loop.call_soon_threadsafe(). Workers are started on demand, up to
+ * one per CPU, and then wait for more jobs, so no executor thread is
+ * occupied while a job runs.
+ */
+
+static PyThread_type_lock async_mutex;
+static PyThread_type_lock async_wakeup;  /* held unless a worker gets woken */
+static PycairoAsyncJob *async_head;
+static PycairoAsyncJob *async_tail;
+static int async_queued;  /* jobs not yet picked up by a worker */
+static int async_workers;  /* started workers */
+static int async_idle;  /* workers waiting for a job */
+static int async_signaled;  /* async_wakeup was released for a worker */
+static int async_max_workers;
+
+/* Sets the result of the future unless it got cancelled in the meantime.
+ * Called by the event loop. */
+static PyObject *
+_async_resolve (PyObject *self, PyObject *args) {
+  PyObject *future, *value, *res;
+  int failed;
+
+  if (!PyArg_ParseTuple (args, "OOp", &future, &value, &failed))
+    return NULL;
+
+  res = PyObject_CallMethod (future, "cancelled", NULL);
+  if (res == NULL)
+    return NULL;
+  if (PyObject_IsTrue (res)) {
+    Py_DECREF (res);
+    Py_RETURN_NONE;
+  }
+  Py_DECREF (res);
+
+  return PyObject_CallMethod (future, failed ? "set_exception" : "set_result",
+                              "(O)", value);
+}
+
+static PyMethodDef async_resolve_def = {
+  "_async_resolve", (PyCFunction)_async_resolve, METH_VARARGS, NULL};
+
+static PyObject *async_resolve;
+
+/* Needs the GIL */
+static void
+_async_complete (PycairoAsyncJob *job) {
+  PyObject *value, *type, *traceback, *res;
+  int failed = 0;
+
+  value = job->complete (job);
+  if (value == NULL) {
+    failed = 1;
+    PyErr_Fetch (&type, &value, &traceback);
+    PyErr_NormalizeException (&type, &value, &traceback);
+    if (traceback != NULL)
+      PyException_SetTraceback (value, traceback);
+    Py_XDECREF (type);
+    Py_XDECREF (traceback);
+  }
+
+  res = PyObject_CallMethod (job->loop, "call_soon_threadsafe", "(OOOi)",
+                             async_resolve, job->future, value, failed);
+  if (res == NULL) {
+    /* The loop got closed, nobody is waiting anymore */
+    PyErr_WriteUnraisable (job->future);
+  }
+  Py_XDECREF (res);
+  Py_XDECREF (value);
+
+  job->destroy (job);
+}
+
+static void
+_async_worker (void *unused) {
+  PycairoAsyncJob *job;
+  PyGILState_STATE gstate;
+
+  for (;;) {
+    PyThread_acquire_lock (async_mutex, WAIT_LOCK);
+    while (async_head == NULL) {
+      async_idle++;
+      PyThread_release_lock (async_mutex);
+      PyThread_acquire_lock (async_wakeup, WAIT_LOCK);
+      PyThread_acquire_lock (async_mutex, WAIT_LOCK);
+      async_signaled = 0;
+      async_idle--;
+    }
+    job = async_head;
+    async_head = job->next;
+    async_queued--;
+    if (async_head == NULL)
+      async_tail = NULL;
+    /* Pass the wakeup on if more jobs are waiting */
+    if (async_head != NULL && async_idle > 0 && !async_signaled) {
+      async_signaled = 1;
+      PyThread_release_lock (async_wakeup);
+    }
+    PyThread_release_lock (async_mutex);
+
+    job->run (job);
+
+    gstate = PyGILState_Ensure ();
+    _async_complete (job);
+    PyGILState_Release (gstate);
+  }
+}
+
+static int
+_async_init_pool (void) {
+  async_mutex = PyThread_allocate_lock ();
+  async_wakeup = PyThread_allocate_lock ();
+  if (async_mutex == NULL || async_wakeup == NULL) {
+    PyErr_NoMemory ();
+    return -1;
+  }
+  PyThread_acquire_lock (async_wakeup, WAIT_LOCK);
+
+  async_head = NULL;
+  async_tail = NULL;
+  async_queued = 0;
+  async_workers = 0;
+  async_idle = 0;
+  async_signaled = 0;
+  return 0;
+}
+
+/* Called in the child process after os.fork(). The workers don't exist
+ * there and one of them might have held the locks, so start over with an
+ * empty pool. The old locks and queued jobs are leaked, the jobs belong to
+ * the event loop of the parent anyway. */
+static PyObject *
+_async_after_fork (PyObject *self, PyObject *ignored) {
+  if (_async_init_pool () < 0)
+    return NULL;
+  Py_RETURN_NONE;
+}
+
+static PyMethodDef async_after_fork_def = {
+  "_async_after_fork", (PyCFunction)_async_after_fork, METH_NOARGS, NULL};
+
+static int
+_async_register_at_fork (void) {
+  PyObject *os, *register_at_fork, *hook, *args, *kwargs, *res;
+
+  os = PyImport_ImportModule ("os");
+  if (os == NULL)
+    return -1;
+  /* Not available on Windows, which has no fork() */
+  if (!PyObject_HasAttrString (os, "register_at_fork")) {
+    Py_DECREF (os);
+    return 0;
+  }
+  register_at_fork = PyObject_GetAttrString (os, "register_at_fork");
+  Py_DECREF (os);
+  if (register_at_fork == NULL)
+    return -1;
+
+  hook = PyCFunction_New (&async_after_fork_def, NULL);
+  if (hook == NULL) {
+    Py_DECREF (register_at_fork);
+    return -1;
+  }
+  args = PyTuple_New (0);
+  kwargs = Py_BuildValue ("{s:O}", "after_in_child", hook);
+  Py_DECREF (hook);
+  if (args == NULL || kwargs == NULL) {
+    Py_XDECREF (args);
+    Py_XDECREF (kwargs);
+    Py_DECREF (register_at_fork);
+    return -1;
+  }
+
+  res = PyObject_Call (register_at_fork, args, kwargs);
+  Py_DECREF (args);
+  Py_DECREF (kwargs);
+  Py_DECREF (register_at_fork);
+  if (res == NULL)
+    return -1;
+  Py_DECREF (res);
+  return 0;
+}
+
+int
+init_async (void) {
+  if (_async_init_pool () < 0)
+    return -1;
+
+  async_resolve = PyCFunction_New (&async_resolve_def, NULL);
+  if (async_resolve == NULL)
+    return -1;
+
+  return _async_register_at_fork ();
+}
+
+/* Queues job and returns a new future of the running event loop, which
+ * gets resolved with the return value of job->complete() once the job is
+ * done. Needs the GIL. On error returns NULL with an exception set, the job
+ * isn't queued then and has to be destroyed by the caller. */
+PyObject *
+Pycairo_async_submit (PycairoAsyncJob *job) {
+  PyObject *asyncio, *loop, *future;
+
+  asyncio = PyImport_ImportModule ("asyncio");
+  if (asyncio == NULL)
+    return NULL;
+  loop = PyObject_CallMethod (asyncio, "get_running_loop", NULL);
+  Py_DECREF (asyncio);
+  if (loop == NULL)
+    return NULL;
+  future = PyObject_CallMethod (loop, "create_future", NULL);
+  if (future == NULL) {
+    Py_DECREF (loop);
+    return NULL;
+  }
+
+  if (async_max_workers == 0 &&
+      (async_max_workers = Pycairo_cpu_count ()) < 0) {
+    async_max_workers = 0;
+    Py_DECREF (future);
+    Py_DECREF (loop);
+    return NULL;
+  }
+
+  /* Setting up the pool again after fork() might have failed */
+  if (async_mutex == NULL || async_wakeup == NULL) {
+    Py_DECREF (future);
+    Py_DECREF (loop);
+    return PyErr_NoMemory ();
+  }
+
+  PyThread_acquire_lock (async_mutex, WAIT_LOCK);
+  if (async_queued >= async_idle && async_workers < async_max_workers) {
+    if (PyThread_start_new_thread (_async_worker, NULL) !=
+        PYTHREAD_INVALID_THREAD_ID) {
+      async_workers++;
+    } else if (async_workers == 0) {
+      PyThread_release_lock (async_mutex);
+      Py_DECREF (future);
+      Py_DECREF (loop);
+      PyErr_SetString (PyExc_RuntimeError, "can't start worker thread");
+      return NULL;
+    }
+  }
+
+  job->loop = loop;
+  job->future = future;
+  Py_INCREF (future);
+  job->next = NULL;
+  if (async_tail != NULL)
+    async_tail->next = job;
+  else
+    async_head = job;
+  async_tail = job;
+  async_queued++;
+  if (async_idle > 0 && !async_signaled) {
+    async_signaled = 1;
+    PyThread_release_lock (async_wakeup);
+  }
+  PyThread_release_lock (async_mutex);
+
+  return future;
+}
+
+/* Releases the references held by the pool, for job->destroy() */
+void
+Pycairo_async_job_clear (PycairoAsyncJob *job) {
+  Py_CLEAR (job->loop);
+  Py_CLEAR (job->future);
+}
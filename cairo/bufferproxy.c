@@ -33,12 +33,12 @@
 
 #include "private.h"
 
+/* Holds a simple (1-D, unsigned bytes) export of another object, so that
+ * a memoryview can be created from it independent of the shape the object
+ * exports by default. */
 typedef struct {
     PyObject_HEAD
-    PyObject *exporter;
-    void *buf;
-    Py_ssize_t len;
-    int readonly;
+    Py_buffer view;
 } Pycairo_BufferProxy;
 
 static PyTypeObject Pycairo_BufferProxyType = {
@@ -52,8 +52,8 @@ buffer_proxy_getbuffer(PyObject *exporter, Py_buffer *view, int flags)
 {
     Pycairo_BufferProxy *self = (Pycairo_BufferProxy *)exporter;
 
-    return PyBuffer_FillInfo (view, exporter, self->buf, self->len,
-                              self->readonly, flags);
+    return PyBuffer_FillInfo (view, exporter, self->view.buf, self->view.len,
+                              self->view.readonly, flags);
 }
 
 static PyBufferProcs Pycairo_BufferProxy_as_buffer = {
@@ -61,9 +61,11 @@ static PyBufferProcs Pycairo_BufferProxy_as_buffer = {
     (releasebufferproc)0,
 };
 
+/* Returns a 1-D memoryview of unsigned bytes covering the whole buffer of
+ * exporter. The export is held until the memoryview is released.
+ */
 PyObject *
-buffer_proxy_create_view(PyObject *exporter, void *buf, Py_ssize_t len,
-                         int readonly) {
+buffer_proxy_create_view(PyObject *exporter) {
     PyObject *memoryview;
     PyObject *obj;
     Pycairo_BufferProxy *self;
@@ -74,11 +76,10 @@ buffer_proxy_create_view(PyObject *exporter, void *buf, Py_ssize_t len,
         return NULL;
 
     self = (Pycairo_BufferProxy *)obj;
-    Py_INCREF(exporter);
-    self->exporter = exporter;
-    self->buf = buf;
-    self->len = len;
-    self->readonly = readonly;
+    if (PyObject_GetBuffer (exporter, &self->view, PyBUF_SIMPLE) < 0) {
+        PyObject_GC_Del (obj);
+        return NULL;
+    }
     PyObject_GC_Track(obj);
 
     memoryview = PyMemoryView_FromObject (obj);
@@ -92,7 +93,7 @@ buffer_proxy_traverse(PyObject* obj, visitproc visit, void *arg)
 {
     Pycairo_BufferProxy *self = (Pycairo_BufferProxy *)obj;
 
-    Py_VISIT(self->exporter);
+    Py_VISIT(self->view.obj);
     return 0;
 }
 
@@ -101,20 +102,15 @@ buffer_proxy_clear(PyObject *obj)
 {
     Pycairo_BufferProxy *self = (Pycairo_BufferProxy *)obj;
 
-    Py_CLEAR(self->exporter);
+    PyBuffer_Release (&self->view);
     return 0;
 }
 
 static void
 buffer_proxy_dealloc(PyObject* obj)
 {
-    Pycairo_BufferProxy *self = (Pycairo_BufferProxy *)obj;
-
     PyObject_GC_UnTrack(obj);
 
-    self->buf = NULL;
-    self->len = 0;
-    self->readonly = 0;
     buffer_proxy_clear(obj);
 
     Py_TYPE(obj)->tp_free(obj);
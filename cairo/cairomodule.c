@@ -132,10 +132,125 @@ pycairo_cairo_version_string (PyObject *self, PyObject *ignored) {
   return PyUnicode_FromString (cairo_version_string());
 }
 
+static PyObject *
+pycairo_context_stats (PyObject *self, PyObject *ignored) {
+  return context_stats_get_total ();
+}
+
+static PyObject *
+pycairo_reset_context_stats (PyObject *self, PyObject *ignored) {
+  context_stats_reset_total ();
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+pycairo_memory_stats (PyObject *self, PyObject *ignored) {
+  return surface_get_memory_stats ();
+}
+
+static PyObject *
+pycairo_output_stats (PyObject *self, PyObject *ignored) {
+  return output_stats_get_total ();
+}
+
+static PyObject *
+pycairo_reset_output_stats (PyObject *self, PyObject *ignored) {
+  output_stats_reset_total ();
+  Py_RETURN_NONE;
+}
+
+#ifdef PYCAIRO_HAS_SCRIPT_INTERPRETER
+static PyObject *
+pycairo_replay_script (PyObject *self, PyObject *args) {
+  PyObject *script;
+  PycairoSurface *target;
+
+  if (!PyArg_ParseTuple (args, "OO!:replay_script", &script,
+                         &PycairoSurface_Type, &target))
+    return NULL;
+
+  return script_replay (script, target);
+}
+#endif
+
+#ifdef CAIRO_HAS_PNG_FUNCTIONS
+static PyObject *
+pycairo_write_pngs (PyObject *self, PyObject *args, PyObject *kwds) {
+  static char *kwlist[] = {"items", "threads", NULL};
+  PyObject *items;
+  int threads = 0;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "O|i:write_pngs", kwlist,
+                                    &items, &threads))
+    return NULL;
+
+  return surface_write_pngs (items, threads);
+}
+#endif
+
+static PyObject *
+pycairo_set_image_memory_limit (PyObject *self, PyObject *args) {
+  PyObject *py_limit, *py_timeout = NULL;
+  Py_ssize_t limit = -1;
+  double timeout = 0.0;
+
+  if (!PyArg_ParseTuple (args, "O|O:set_image_memory_limit",
+                         &py_limit, &py_timeout))
+    return NULL;
+
+  if (py_limit != Py_None) {
+    limit = PyLong_AsSsize_t (py_limit);
+    if (limit == -1 && PyErr_Occurred ())
+      return NULL;
+    if (limit < 0) {
+      PyErr_SetString (PyExc_ValueError, "limit cannot be negative");
+      return NULL;
+    }
+  }
+
+  if (py_timeout == Py_None) {
+    timeout = -1.0;
+  } else if (py_timeout != NULL) {
+    timeout = PyFloat_AsDouble (py_timeout);
+    if (timeout == -1.0 && PyErr_Occurred ())
+      return NULL;
+    if (timeout < 0.0) {
+      PyErr_SetString (PyExc_ValueError, "timeout cannot be negative");
+      return NULL;
+    }
+  }
+
+  surface_set_image_memory_limit (limit, timeout);
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+pycairo_get_image_memory_limit (PyObject *self, PyObject *ignored) {
+  return surface_get_image_memory_limit ();
+}
+
 static PyMethodDef cairo_functions[] = {
   {"cairo_version",    (PyCFunction)pycairo_cairo_version, METH_NOARGS},
   {"cairo_version_string", (PyCFunction)pycairo_cairo_version_string,
    METH_NOARGS},
+  {"context_stats",    (PyCFunction)pycairo_context_stats, METH_NOARGS},
+  {"reset_context_stats", (PyCFunction)pycairo_reset_context_stats,
+   METH_NOARGS},
+  {"memory_stats",     (PyCFunction)pycairo_memory_stats, METH_NOARGS},
+  {"set_image_memory_limit", (PyCFunction)pycairo_set_image_memory_limit,
+   METH_VARARGS},
+  {"get_image_memory_limit", (PyCFunction)pycairo_get_image_memory_limit,
+   METH_NOARGS},
+  {"output_stats",     (PyCFunction)pycairo_output_stats, METH_NOARGS},
+  {"reset_output_stats", (PyCFunction)pycairo_reset_output_stats,
+   METH_NOARGS},
+#ifdef PYCAIRO_HAS_SCRIPT_INTERPRETER
+  {"replay_script",    (PyCFunction)pycairo_replay_script, METH_VARARGS},
+#endif
+#ifdef CAIRO_HAS_PNG_FUNCTIONS
+  {"write_pngs",       (PyCFunction)(void (*)(void))pycairo_write_pngs,
+   METH_VARARGS | METH_KEYWORDS},
+#endif
   {NULL, NULL, 0, NULL},
 };
 
@@ -208,6 +323,9 @@ static int exec_cairo(PyObject *m)
     return -1;
 #endif
 
+  if (PyType_Ready(&PycairoPickBuffer_Type) < 0)
+    return -1;
+
   if (PyType_Ready(&PycairoRegion_Type) < 0)
     return -1;
 
@@ -219,6 +337,8 @@ static int exec_cairo(PyObject *m)
     return -1;
   if (PyType_Ready(&PycairoMappedImageSurface_Type) < 0)
     return -1;
+  if (PyType_Ready(&PycairoSurfacePool_Type) < 0)
+    return -1;
 #endif
 #ifdef CAIRO_HAS_PDF_SURFACE
   if (PyType_Ready(&PycairoPDFSurface_Type) < 0)
@@ -261,6 +381,21 @@ static int exec_cairo(PyObject *m)
   if(init_buffer_proxy() < 0)
     return -1;
 
+  if(init_context_stats() < 0)
+    return -1;
+
+  if(init_memory_stats() < 0)
+    return -1;
+
+  if(init_convert() < 0)
+    return -1;
+
+  if(init_output_sink() < 0)
+    return -1;
+
+  if(init_async() < 0)
+    return -1;
+
   if(init_enums(m) < 0)
     return -1;
 
@@ -311,6 +446,9 @@ static int exec_cairo(PyObject *m)
                             (PyObject *)&PycairoRasterSourcePattern_Type) < 0)
       return -1;
 
+  if (PyModule_AddObjectRef(m, "PickBuffer", (PyObject *)&PycairoPickBuffer_Type) < 0)
+      return -1;
+
   if (PyModule_AddObjectRef(m, "RectangleInt",  (PyObject *)&PycairoRectangleInt_Type) < 0)
       return -1;
 
@@ -352,6 +490,9 @@ static int exec_cairo(PyObject *m)
   if (PyModule_AddObjectRef(m, "ImageSurface",
                             (PyObject *)&PycairoImageSurface_Type) < 0)
       return -1;
+  if (PyModule_AddObjectRef(m, "SurfacePool",
+                            (PyObject *)&PycairoSurfacePool_Type) < 0)
+      return -1;
 #endif
 
 #ifdef CAIRO_HAS_PDF_SURFACE
@@ -366,6 +507,9 @@ static int exec_cairo(PyObject *m)
     return -1;
 #endif
 
+  if (PyModule_AddIntConstant(m, "TRACEMALLOC_DOMAIN", PYCAIRO_TRACEMALLOC_DOMAIN) < 0)
+    return -1;
+
 #ifdef CAIRO_HAS_PS_SURFACE
   if (PyModule_AddObjectRef(m, "PSSurface", (PyObject *)&PycairoPSSurface_Type) < 0)
       return -1;
@@ -529,6 +673,13 @@ static int exec_cairo(PyObject *m)
   if (PyModule_AddIntConstant(m, "HAS_SCRIPT_SURFACE", 0) < 0)
     return -1;
 #endif
+#ifdef PYCAIRO_HAS_SCRIPT_INTERPRETER
+  if (PyModule_AddIntConstant(m, "HAS_SCRIPT_INTERPRETER", 1) < 0)
+    return -1;
+#else
+  if (PyModule_AddIntConstant(m, "HAS_SCRIPT_INTERPRETER", 0) < 0)
+    return -1;
+#endif
 #ifdef CAIRO_HAS_TEE_SURFACE
   if (PyModule_AddIntConstant(m, "HAS_TEE_SURFACE", 1) < 0)
     return -1;
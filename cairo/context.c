@@ -31,6 +31,8 @@
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
 
+#include <math.h>
+
 #include "private.h"
 
 PyObject *
@@ -55,6 +57,412 @@ PycairoContext_FromContext(cairo_t *ctx, PyTypeObject *type, PyObject *base) {
   return o;
 }
 
+/* Operation statistics, see Context.set_stats_enabled(). The counters of a
+ * context live in its cairo user data so the public PycairoContext struct
+ * doesn't change. They get updated without the GIL and without any lock, as
+ * a context is only used by one thread at a time. The process wide
+ * aggregate is folded together lazily: all enabled counters are kept in a
+ * list protected by context_stats_lock, which is only taken when stats get
+ * enabled or disabled and when the aggregate is read or reset.
+ */
+typedef enum {
+  CONTEXT_OP_PATH,
+  CONTEXT_OP_FILL,
+  CONTEXT_OP_STROKE,
+  CONTEXT_OP_PAINT,
+  CONTEXT_OP_MASK,
+  CONTEXT_OP_CLIP,
+  CONTEXT_OP_SHOW_TEXT,
+  CONTEXT_OP_SHOW_GLYPHS,
+  CONTEXT_OP_SHOW_PAGE,
+  CONTEXT_N_OPS
+} PycairoContextOp;
+
+static const char *context_op_names[CONTEXT_N_OPS] = {
+  "path",
+  "fill",
+  "stroke",
+  "paint",
+  "mask",
+  "clip",
+  "show_text",
+  "show_glyphs",
+  "show_page",
+};
+
+typedef struct {
+  uint64_t count[CONTEXT_N_OPS];
+  int64_t time_ns[CONTEXT_N_OPS];
+} PycairoContextCounters;
+
+typedef struct _PycairoContextStats {
+  PycairoContextCounters counters;
+  /* The part of the counters from before the aggregate got last reset */
+  PycairoContextCounters base;
+  struct _PycairoContextStats *prev, *next;
+} PycairoContextStats;
+
+static cairo_user_data_key_t context_stats_key;
+/* Counters of contexts which aren't in the list anymore */
+static PycairoContextCounters context_stats_total;
+static PycairoContextStats *context_stats_list = NULL;
+static PyThread_type_lock context_stats_lock = NULL;
+
+int
+init_context_stats (void) {
+  if (context_stats_lock != NULL)
+    return 0;
+
+  context_stats_lock = PyThread_allocate_lock ();
+  if (context_stats_lock == NULL) {
+    PyErr_NoMemory ();
+    return -1;
+  }
+  return 0;
+}
+
+static PycairoContextStats *
+_context_get_stats (cairo_t *ctx) {
+  return cairo_get_user_data (ctx, &context_stats_key);
+}
+
+/* Can be called without the GIL */
+static void
+_context_stats_add (PycairoContextStats *stats, PycairoContextOp op,
+                    int64_t time_ns) {
+  stats->counters.count[op]++;
+  stats->counters.time_ns[op] += time_ns;
+}
+
+/* Adds what stats counted since the last reset to total, needs
+ * context_stats_lock */
+static void
+_context_stats_fold (PycairoContextCounters *total,
+                     const PycairoContextStats *stats) {
+  int i;
+
+  for (i = 0; i < CONTEXT_N_OPS; i++) {
+    total->count[i] += stats->counters.count[i] - stats->base.count[i];
+    total->time_ns[i] += stats->counters.time_ns[i] - stats->base.time_ns[i];
+  }
+}
+
+static void
+_context_count_op (cairo_t *ctx, PycairoContextOp op) {
+  PycairoContextStats *stats = _context_get_stats (ctx);
+  if (stats != NULL)
+    _context_stats_add (stats, op, 0);
+}
+
+/* To be used inside a Py_BEGIN_ALLOW_THREADS section around a cairo call.
+ * The clock is only read if stats are enabled for the context.
+ * CONTEXT_OP_RESTART() leaves out the work done since CONTEXT_OP_BEGIN().
+ */
+#define CONTEXT_OP_BEGIN(o) \
+  PycairoContextStats *_op_stats = _context_get_stats ((o)->ctx); \
+  int64_t _op_start = (_op_stats != NULL) ? Pycairo_monotonic_ns () : 0
+
+#define CONTEXT_OP_RESTART() \
+  if (_op_stats != NULL) \
+    _op_start = Pycairo_monotonic_ns ()
+
+#define CONTEXT_OP_END(op) \
+  if (_op_stats != NULL) \
+    _context_stats_add (_op_stats, (op), Pycairo_monotonic_ns () - _op_start)
+
+static PyObject *
+_context_stats_as_dict (const PycairoContextCounters *stats) {
+  PyObject *dict, *value;
+  int i;
+
+  dict = PyDict_New ();
+  if (dict == NULL)
+    return NULL;
+
+  for (i = 0; i < CONTEXT_N_OPS; i++) {
+    value = Py_BuildValue ("(Kd)", (unsigned long long)stats->count[i],
+                           (double)stats->time_ns[i] / 1e9);
+    if (value == NULL) {
+      Py_DECREF (dict);
+      return NULL;
+    }
+    if (PyDict_SetItemString (dict, context_op_names[i], value) < 0) {
+      Py_DECREF (value);
+      Py_DECREF (dict);
+      return NULL;
+    }
+    Py_DECREF (value);
+  }
+
+  return dict;
+}
+
+/* Counters of contexts drawing on other threads right now can be slightly
+ * behind */
+PyObject *
+context_stats_get_total (void) {
+  PycairoContextCounters total;
+  PycairoContextStats *stats;
+
+  Py_BEGIN_ALLOW_THREADS;
+  PyThread_acquire_lock (context_stats_lock, WAIT_LOCK);
+  total = context_stats_total;
+  for (stats = context_stats_list; stats != NULL; stats = stats->next)
+    _context_stats_fold (&total, stats);
+  PyThread_release_lock (context_stats_lock);
+  Py_END_ALLOW_THREADS;
+
+  return _context_stats_as_dict (&total);
+}
+
+void
+context_stats_reset_total (void) {
+  PycairoContextStats *stats;
+
+  Py_BEGIN_ALLOW_THREADS;
+  PyThread_acquire_lock (context_stats_lock, WAIT_LOCK);
+  memset (&context_stats_total, 0, sizeof (context_stats_total));
+  for (stats = context_stats_list; stats != NULL; stats = stats->next)
+    stats->base = stats->counters;
+  PyThread_release_lock (context_stats_lock);
+  Py_END_ALLOW_THREADS;
+}
+
+/* Can be called without the GIL */
+static void
+_context_stats_destroy_func (void *user_data) {
+  PycairoContextStats *stats = user_data;
+
+  PyThread_acquire_lock (context_stats_lock, WAIT_LOCK);
+  _context_stats_fold (&context_stats_total, stats);
+  if (stats->prev != NULL)
+    stats->prev->next = stats->next;
+  else
+    context_stats_list = stats->next;
+  if (stats->next != NULL)
+    stats->next->prev = stats->prev;
+  PyThread_release_lock (context_stats_lock);
+
+  PyMem_RawFree (stats);
+}
+
+static PyObject *
+pycairo_set_stats_enabled (PycairoContext *o, PyObject *args) {
+  PycairoContextStats *stats;
+  PyObject *py_enabled;
+  cairo_status_t status;
+
+  if (!PyArg_ParseTuple (args, "O!:Context.set_stats_enabled",
+                         &PyBool_Type, &py_enabled))
+    return NULL;
+
+  if (py_enabled == Py_False) {
+    status = cairo_set_user_data (o->ctx, &context_stats_key, NULL, NULL);
+    RETURN_NULL_IF_CAIRO_ERROR (status);
+    Py_RETURN_NONE;
+  }
+
+  if (_context_get_stats (o->ctx) != NULL)
+    Py_RETURN_NONE;
+
+  stats = PyMem_RawCalloc (1, sizeof (PycairoContextStats));
+  if (stats == NULL)
+    return PyErr_NoMemory ();
+
+  /* Linked first, the destroy function unlinks it again */
+  PyThread_acquire_lock (context_stats_lock, WAIT_LOCK);
+  stats->next = context_stats_list;
+  if (context_stats_list != NULL)
+    context_stats_list->prev = stats;
+  context_stats_list = stats;
+  PyThread_release_lock (context_stats_lock);
+
+  status = cairo_set_user_data (o->ctx, &context_stats_key, stats,
+                                _context_stats_destroy_func);
+  if (status != CAIRO_STATUS_SUCCESS) {
+    _context_stats_destroy_func (stats);
+    Pycairo_Check_Status (status);
+    return NULL;
+  }
+
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+pycairo_get_stats_enabled (PycairoContext *o, PyObject *ignored) {
+  return PyBool_FromLong (_context_get_stats (o->ctx) != NULL);
+}
+
+static PyObject *
+pycairo_stats (PycairoContext *o, PyObject *ignored) {
+  PycairoContextStats *stats = _context_get_stats (o->ctx);
+
+  if (stats == NULL) {
+    PyErr_SetString (PyExc_RuntimeError,
+                     "statistics are not enabled for this context");
+    return NULL;
+  }
+
+  return _context_stats_as_dict (&stats->counters);
+}
+
+/* Picking, see Context.set_pick_buffer(). Like the statistics, the state of
+ * a context lives in its cairo user data. */
+typedef struct {
+  PyObject *pick; /* PickBuffer or NULL */
+  uint32_t id;
+} PycairoContextPick;
+
+static cairo_user_data_key_t context_pick_key;
+
+static void
+_context_pick_destroy_func (void *user_data) {
+  PycairoContextPick *state = user_data;
+  PyGILState_STATE gstate = PyGILState_Ensure ();
+  Py_XDECREF (state->pick);
+  PyGILState_Release (gstate);
+  PyMem_RawFree (state);
+}
+
+/* Returns the pick state of the context, creating it if needed. Returns
+ * NULL and sets an exception on error. */
+static PycairoContextPick *
+_context_ensure_pick (cairo_t *ctx) {
+  PycairoContextPick *state = cairo_get_user_data (ctx, &context_pick_key);
+  cairo_status_t status;
+
+  if (state != NULL)
+    return state;
+
+  state = PyMem_RawCalloc (1, sizeof (PycairoContextPick));
+  if (state == NULL) {
+    PyErr_NoMemory ();
+    return NULL;
+  }
+
+  status = cairo_set_user_data (ctx, &context_pick_key, state,
+                                _context_pick_destroy_func);
+  if (status != CAIRO_STATUS_SUCCESS) {
+    PyMem_RawFree (state);
+    Pycairo_Check_Status (status);
+    return NULL;
+  }
+
+  return state;
+}
+
+/* Mirrors the following fill or stroke into the pick buffer, to be called
+ * before it inside the Py_BEGIN_ALLOW_THREADS section. Returns whether
+ * anything was drawn. */
+static int
+_context_pick (cairo_t *ctx, int stroke) {
+  PycairoContextPick *state = cairo_get_user_data (ctx, &context_pick_key);
+
+  if (state == NULL || state->pick == NULL || state->id == 0)
+    return 0;
+  Pycairo_pick_buffer_render (state->pick, ctx, stroke, state->id);
+  return 1;
+}
+
+/* Tags an image source with a content based unique ID if the target embeds
+ * equal images only once, see Surface.set_deduplicate_images(). Tagging is
+ * best effort, failing only means the image isn't shared. */
+static void
+_context_tag_source (cairo_t *ctx, cairo_surface_t *source) {
+  const unsigned char *id;
+  unsigned long id_length;
+
+  if (source == NULL ||
+      cairo_surface_get_type (source) != CAIRO_SURFACE_TYPE_IMAGE ||
+      !Pycairo_surface_get_deduplicate_images (cairo_get_target (ctx)))
+    return;
+
+  /* Already tagged and unchanged since, see
+   * Pycairo_image_surface_tag_content() */
+  cairo_surface_get_mime_data (source, CAIRO_MIME_TYPE_UNIQUE_ID, &id,
+                               &id_length);
+  if (id != NULL)
+    return;
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (source);
+  Pycairo_image_surface_tag_content (source, 0);
+  PYCAIRO_PROBE_RETURN (source);
+  Py_END_ALLOW_THREADS;
+}
+
+static void
+_context_tag_source_pattern (cairo_t *ctx, cairo_pattern_t *pattern) {
+  cairo_surface_t *surface;
+
+  if (cairo_pattern_get_surface (pattern, &surface) == CAIRO_STATUS_SUCCESS)
+    _context_tag_source (ctx, surface);
+}
+
+static PyObject *
+pycairo_set_pick_buffer (PycairoContext *o, PyObject *args) {
+  PycairoContextPick *state;
+  PyObject *pick, *old;
+
+  if (!PyArg_ParseTuple (args, "O:Context.set_pick_buffer", &pick))
+    return NULL;
+
+  if (pick != Py_None && !PyObject_TypeCheck (pick, &PycairoPickBuffer_Type)) {
+    PyErr_SetString (PyExc_TypeError,
+                     "pick buffer must be a cairo.PickBuffer or None");
+    return NULL;
+  }
+
+  state = _context_ensure_pick (o->ctx);
+  if (state == NULL)
+    return NULL;
+
+  if (pick != Py_None)
+    Pycairo_pick_buffer_match_target (pick, cairo_get_target (o->ctx));
+
+  old = state->pick;
+  state->pick = pick != Py_None ? Py_NewRef (pick) : NULL;
+  Py_XDECREF (old);
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+pycairo_get_pick_buffer (PycairoContext *o, PyObject *ignored) {
+  PycairoContextPick *state = cairo_get_user_data (o->ctx, &context_pick_key);
+
+  if (state == NULL || state->pick == NULL)
+    Py_RETURN_NONE;
+  return Py_NewRef (state->pick);
+}
+
+static PyObject *
+pycairo_set_pick_id (PycairoContext *o, PyObject *args) {
+  PycairoContextPick *state;
+  unsigned long id;
+
+  if (!PyArg_ParseTuple (args, "k:Context.set_pick_id", &id))
+    return NULL;
+
+  if (id > 0xffffff) {
+    PyErr_SetString (PyExc_ValueError,
+                     "pick ID must be between 0 and 0xffffff");
+    return NULL;
+  }
+
+  state = _context_ensure_pick (o->ctx);
+  if (state == NULL)
+    return NULL;
+  state->id = (uint32_t)id;
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+pycairo_get_pick_id (PycairoContext *o, PyObject *ignored) {
+  PycairoContextPick *state = cairo_get_user_data (o->ctx, &context_pick_key);
+
+  return PyLong_FromUnsignedLong (state != NULL ? state->id : 0);
+}
+
 static void
 pycairo_dealloc(PycairoContext *o) {
   if (o->ctx) {
@@ -71,6 +479,8 @@ pycairo_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
   if (!PyArg_ParseTuple(args, "O!:Context.__new__",
 			&PycairoSurface_Type, &s))
     return NULL;
+  if (Pycairo_surface_wait_pages (s->surface) < 0)
+    return NULL;
   return PycairoContext_FromContext (cairo_create (s->surface), type, NULL);
 }
 
@@ -106,7 +516,9 @@ pycairo_tag_begin (PycairoContext *o, PyObject *args) {
         return NULL;
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
     cairo_tag_begin (o->ctx, tag_name, attributes);
+    PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
     Py_END_ALLOW_THREADS;
 
     PyMem_Free((void *)tag_name);
@@ -126,7 +538,9 @@ pycairo_tag_end (PycairoContext *o, PyObject *args) {
         return NULL;
 
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
       cairo_tag_end (o->ctx, tag_name);
+      PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
       Py_END_ALLOW_THREADS;
 
       PyMem_Free((void *)tag_name);
@@ -144,7 +558,11 @@ pycairo_append_path (PycairoContext *o, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_append_path (o->ctx, p->path);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_PATH);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -159,6 +577,7 @@ pycairo_arc (PycairoContext *o, PyObject *args) {
     return NULL;
 
   cairo_arc (o->ctx, xc, yc, radius, angle1, angle2);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
 }
@@ -172,14 +591,129 @@ pycairo_arc_negative (PycairoContext *o, PyObject *args) {
     return NULL;
 
   cairo_arc_negative (o->ctx, xc, yc, radius, angle1, angle2);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
+  RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
+  Py_RETURN_NONE;
+}
+
+/* Draws one sprite per source rectangle, with the GIL released. The loop
+ * does the same as set_source_surface(), rectangle() and fill() or
+ * paint_with_alpha() for each sprite, but reuses a single pattern. */
+static void
+_context_blit_many (cairo_t *ctx, cairo_surface_t *atlas, const double *src,
+                    const double *dst, const double *alphas, Py_ssize_t n) {
+  cairo_pattern_t *pattern;
+  cairo_matrix_t matrix;
+  Py_ssize_t i;
+
+  pattern = cairo_pattern_create_for_surface (atlas);
+  cairo_save (ctx);
+  cairo_new_path (ctx);
+
+  for (i = 0; i < n; i++) {
+    const double *rect = src + i * 4, *point = dst + i * 2;
+    double alpha = alphas != NULL ? alphas[i] : 1.0;
+
+    if (alpha <= 0.0 || rect[2] <= 0.0 || rect[3] <= 0.0)
+      continue;
+
+    cairo_matrix_init_translate (&matrix, rect[0] - point[0],
+                                 rect[1] - point[1]);
+    cairo_pattern_set_matrix (pattern, &matrix);
+    cairo_set_source (ctx, pattern);
+    cairo_rectangle (ctx, point[0], point[1], rect[2], rect[3]);
+
+    if (alpha >= 1.0) {
+      cairo_fill (ctx);
+    } else {
+      cairo_save (ctx);
+      cairo_clip (ctx);
+      cairo_paint_with_alpha (ctx, alpha);
+      cairo_restore (ctx);
+    }
+
+    if (cairo_status (ctx) != CAIRO_STATUS_SUCCESS)
+      break;
+  }
+
+  cairo_restore (ctx);
+  cairo_pattern_destroy (pattern);
+}
+
+static PyObject *
+pycairo_blit_many (PycairoContext *o, PyObject *args, PyObject *kwds) {
+  static char *kwlist[] = {"atlas", "src_rects", "dst_points", "alphas",
+                           NULL};
+  PycairoSurface *atlas;
+  PyObject *pysrc, *pydst, *pyalphas = Py_None;
+  Py_buffer src, dst, alphas;
+  Py_ssize_t n, n_dst, n_alphas;
+  const double *alpha_data = NULL;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "O!OO|O:Context.blit_many",
+                                    kwlist, &PycairoSurface_Type, &atlas,
+                                    &pysrc, &pydst, &pyalphas))
+    return NULL;
+
+  if (Pycairo_get_double_buffer (pysrc, "src_rects", 4, &src, &n) < 0)
+    return NULL;
+
+  if (Pycairo_get_double_buffer (pydst, "dst_points", 2, &dst, &n_dst) < 0) {
+    PyBuffer_Release (&src);
+    return NULL;
+  }
+  if (n_dst != n) {
+    PyErr_SetString (PyExc_ValueError,
+                     "src_rects and dst_points have a different length");
+    goto error_dst;
+  }
+
+  if (pyalphas != Py_None) {
+    if (Pycairo_get_double_buffer (pyalphas, "alphas", 1, &alphas,
+                                   &n_alphas) < 0)
+      goto error_dst;
+    if (n_alphas != n) {
+      PyErr_SetString (PyExc_ValueError,
+                       "src_rects and alphas have a different length");
+      PyBuffer_Release (&alphas);
+      goto error_dst;
+    }
+    alpha_data = alphas.buf;
+  }
+
+  _context_tag_source (o->ctx, atlas->surface);
+
+  Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
+  _context_blit_many (o->ctx, atlas->surface, src.buf, dst.buf, alpha_data,
+                      n);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_FILL);
+  Py_END_ALLOW_THREADS;
+
+  if (alpha_data != NULL)
+    PyBuffer_Release (&alphas);
+  PyBuffer_Release (&dst);
+  PyBuffer_Release (&src);
+
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
+
+error_dst:
+  PyBuffer_Release (&dst);
+  PyBuffer_Release (&src);
+  return NULL;
 }
 
 static PyObject *
 pycairo_clip (PycairoContext *o, PyObject *ignored) {
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_clip (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_CLIP);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -196,7 +730,11 @@ pycairo_clip_extents (PycairoContext *o, PyObject *ignored) {
 static PyObject *
 pycairo_clip_preserve (PycairoContext *o, PyObject *ignored) {
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_clip_preserve (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_CLIP);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -211,7 +749,9 @@ pycairo_in_clip (PycairoContext *o, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   result = cairo_in_clip (o->ctx, x, y);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
   Py_END_ALLOW_THREADS;
 
   return PyBool_FromLong(result);
@@ -220,7 +760,11 @@ pycairo_in_clip (PycairoContext *o, PyObject *args) {
 static PyObject *
 pycairo_close_path (PycairoContext *o, PyObject *ignored) {
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_close_path (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_PATH);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -265,8 +809,14 @@ pycairo_copy_clip_rectangle_list (PycairoContext *o, PyObject *ignored) {
 
 static PyObject *
 pycairo_copy_page (PycairoContext *o, PyObject *ignored) {
+  if (Pycairo_surface_wait_pages (cairo_get_target (o->ctx)) < 0)
+    return NULL;
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_copy_page (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_SHOW_PAGE);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -276,7 +826,9 @@ static PyObject *
 pycairo_copy_path (PycairoContext *o, PyObject *ignored) {
   cairo_path_t *cp;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cp = cairo_copy_path (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
   Py_END_ALLOW_THREADS;
   return PycairoPath_FromPath (cp);
 }
@@ -285,7 +837,9 @@ static PyObject *
 pycairo_copy_path_flat (PycairoContext *o, PyObject *ignored) {
   cairo_path_t *cp;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cp = cairo_copy_path_flat (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
   Py_END_ALLOW_THREADS;
   return PycairoPath_FromPath (cp);
 }
@@ -299,6 +853,7 @@ pycairo_curve_to (PycairoContext *o, PyObject *args) {
     return NULL;
 
   cairo_curve_to (o->ctx, x1, y1, x2, y2, x3, y3);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
 }
@@ -328,10 +883,126 @@ pycairo_device_to_user_distance (PycairoContext *o, PyObject *args) {
   return Py_BuildValue("(dd)", dx, dy);
 }
 
+typedef enum {
+  INSTANCE_MODE_FILL,
+  INSTANCE_MODE_STROKE,
+} PycairoInstanceMode;
+
+/* Draws the path once per transformation, with the GIL released. Each
+ * instance does the same as save(), transform(), append_path(), fill() or
+ * stroke() and restore(). */
+static void
+_context_draw_instances (cairo_t *ctx, cairo_path_t *path,
+                         const double *transforms, const double *colors,
+                         Py_ssize_t n, PycairoInstanceMode mode) {
+  cairo_matrix_t base, matrix;
+  Py_ssize_t i;
+
+  cairo_save (ctx);
+  cairo_get_matrix (ctx, &base);
+
+  for (i = 0; i < n; i++) {
+    const double *t = transforms + i * 6;
+
+    cairo_matrix_init (&matrix, t[0], t[1], t[2], t[3], t[4], t[5]);
+    cairo_set_matrix (ctx, &base);
+    cairo_transform (ctx, &matrix);
+    cairo_new_path (ctx);
+    cairo_append_path (ctx, path);
+
+    if (colors != NULL) {
+      const double *c = colors + i * 4;
+      cairo_set_source_rgba (ctx, c[0], c[1], c[2], c[3]);
+    }
+
+    if (mode == INSTANCE_MODE_FILL)
+      cairo_fill (ctx);
+    else
+      cairo_stroke (ctx);
+
+    if (cairo_status (ctx) != CAIRO_STATUS_SUCCESS)
+      break;
+  }
+
+  cairo_restore (ctx);
+}
+
+static PyObject *
+pycairo_draw_instances (PycairoContext *o, PyObject *args, PyObject *kwds) {
+  static char *kwlist[] = {"path", "transforms", "colors", "mode", NULL};
+  PycairoPath *path;
+  PyObject *pytransforms, *pycolors = Py_None;
+  Py_buffer transforms, colors;
+  Py_ssize_t n, n_colors;
+  const double *color_data = NULL;
+  const char *mode = "fill";
+  PycairoInstanceMode instance_mode;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds,
+                                    "O!O|Os:Context.draw_instances", kwlist,
+                                    &PycairoPath_Type, &path, &pytransforms,
+                                    &pycolors, &mode))
+    return NULL;
+
+  if (strcmp (mode, "fill") == 0) {
+    instance_mode = INSTANCE_MODE_FILL;
+  } else if (strcmp (mode, "stroke") == 0) {
+    instance_mode = INSTANCE_MODE_STROKE;
+  } else {
+    PyErr_Format (PyExc_ValueError,
+                  "mode must be 'fill' or 'stroke', not '%s'", mode);
+    return NULL;
+  }
+
+  if (Pycairo_get_double_buffer (pytransforms, "transforms", 6, &transforms,
+                                 &n) < 0)
+    return NULL;
+
+  if (pycolors != Py_None) {
+    if (Pycairo_get_double_buffer (pycolors, "colors", 4, &colors,
+                                   &n_colors) < 0) {
+      PyBuffer_Release (&transforms);
+      return NULL;
+    }
+    if (n_colors != n) {
+      PyErr_SetString (PyExc_ValueError,
+                       "transforms and colors have a different length");
+      PyBuffer_Release (&colors);
+      PyBuffer_Release (&transforms);
+      return NULL;
+    }
+    color_data = colors.buf;
+  }
+
+  Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
+  _context_draw_instances (o->ctx, path->path, transforms.buf, color_data, n,
+                           instance_mode);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (instance_mode == INSTANCE_MODE_FILL ?
+                  CONTEXT_OP_FILL : CONTEXT_OP_STROKE);
+  Py_END_ALLOW_THREADS;
+
+  if (color_data != NULL)
+    PyBuffer_Release (&colors);
+  PyBuffer_Release (&transforms);
+
+  RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
+  Py_RETURN_NONE;
+}
+
 static PyObject *
 pycairo_fill (PycairoContext *o, PyObject *ignored) {
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
+  /* Only the cairo call is timed */
+  if (_context_pick (o->ctx, 0))
+    CONTEXT_OP_RESTART ();
   cairo_fill (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_FILL);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -348,7 +1019,14 @@ pycairo_fill_extents (PycairoContext *o, PyObject *ignored) {
 static PyObject *
 pycairo_fill_preserve (PycairoContext *o, PyObject *ignored) {
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
+  /* Only the cairo call is timed */
+  if (_context_pick (o->ctx, 0))
+    CONTEXT_OP_RESTART ();
   cairo_fill_preserve (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_FILL);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -554,6 +1232,7 @@ pycairo_glyph_path (PycairoContext *o, PyObject *args) {
   if (glyphs == NULL)
     return NULL;
   cairo_glyph_path (o->ctx, glyphs, num_glyphs);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   PyMem_Free (glyphs);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -602,6 +1281,117 @@ pycairo_in_stroke (PycairoContext *o, PyObject *args) {
   return result;
 }
 
+typedef enum {
+  HIT_TEST_CLIP,
+  HIT_TEST_FILL,
+  HIT_TEST_STROKE,
+} PycairoHitTest;
+
+/* Tests each point like in_clip(), in_fill() or in_stroke(), without the
+ * GIL. Points outside of the fill or stroke extents, grown by a device
+ * pixel to be safe from rounding, can't hit and are rejected without asking
+ * cairo, which would look at the whole path for every point. */
+static void
+_context_hit_test_many (cairo_t *ctx, PycairoHitTest test,
+                        const double *points, Py_ssize_t n,
+                        unsigned char *result) {
+  double x1 = -INFINITY, y1 = -INFINITY, x2 = INFINITY, y2 = INFINITY;
+  double pad_x = 1.0, pad_y = 0.0, pad_x2 = 0.0, pad_y2 = 1.0, pad;
+  Py_ssize_t i;
+
+  if (test == HIT_TEST_FILL || test == HIT_TEST_STROKE) {
+    if (test == HIT_TEST_FILL)
+      cairo_fill_extents (ctx, &x1, &y1, &x2, &y2);
+    else
+      cairo_stroke_extents (ctx, &x1, &y1, &x2, &y2);
+    cairo_device_to_user_distance (ctx, &pad_x, &pad_y);
+    cairo_device_to_user_distance (ctx, &pad_x2, &pad_y2);
+    pad = fabs (pad_x) + fabs (pad_y) + fabs (pad_x2) + fabs (pad_y2);
+    x1 -= pad;
+    y1 -= pad;
+    x2 += pad;
+    y2 += pad;
+  }
+
+  for (i = 0; i < n; i++) {
+    double x = points[i * 2], y = points[i * 2 + 1];
+    cairo_bool_t hit;
+
+    /* also rejects NaN */
+    if (!(x >= x1 && x <= x2 && y >= y1 && y <= y2)) {
+      result[i] = 0;
+      continue;
+    }
+
+    switch (test) {
+    case HIT_TEST_CLIP:
+      hit = cairo_in_clip (ctx, x, y);
+      break;
+    case HIT_TEST_FILL:
+      hit = cairo_in_fill (ctx, x, y);
+      break;
+    default:
+      hit = cairo_in_stroke (ctx, x, y);
+      break;
+    }
+    result[i] = hit ? 1 : 0;
+  }
+}
+
+static PyObject *
+_context_hit_test_many_py (PycairoContext *o, PyObject *args,
+                           PycairoHitTest test, const char *format) {
+  PyObject *pypoints, *result;
+  Py_buffer points;
+  Py_ssize_t n;
+  unsigned char *data;
+
+  if (!PyArg_ParseTuple (args, format, &pypoints))
+    return NULL;
+
+  if (Pycairo_get_double_buffer (pypoints, "points", 2, &points, &n) < 0)
+    return NULL;
+
+  result = PyBytes_FromStringAndSize (NULL, n);
+  if (result == NULL) {
+    PyBuffer_Release (&points);
+    return NULL;
+  }
+  data = (unsigned char *)PyBytes_AS_STRING (result);
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
+  _context_hit_test_many (o->ctx, test, points.buf, n, data);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  Py_END_ALLOW_THREADS;
+
+  PyBuffer_Release (&points);
+
+  if (Pycairo_Check_Status (cairo_status (o->ctx))) {
+    Py_DECREF (result);
+    return NULL;
+  }
+  return result;
+}
+
+static PyObject *
+pycairo_in_clip_many (PycairoContext *o, PyObject *args) {
+  return _context_hit_test_many_py (o, args, HIT_TEST_CLIP,
+                                    "O:Context.in_clip_many");
+}
+
+static PyObject *
+pycairo_in_fill_many (PycairoContext *o, PyObject *args) {
+  return _context_hit_test_many_py (o, args, HIT_TEST_FILL,
+                                    "O:Context.in_fill_many");
+}
+
+static PyObject *
+pycairo_in_stroke_many (PycairoContext *o, PyObject *args) {
+  return _context_hit_test_many_py (o, args, HIT_TEST_STROKE,
+                                    "O:Context.in_stroke_many");
+}
+
 static PyObject *
 pycairo_line_to (PycairoContext *o, PyObject *args) {
   double x, y;
@@ -610,6 +1400,7 @@ pycairo_line_to (PycairoContext *o, PyObject *args) {
     return NULL;
 
   cairo_line_to (o->ctx, x, y);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
 }
@@ -621,8 +1412,14 @@ pycairo_mask (PycairoContext *o, PyObject *args) {
   if (!PyArg_ParseTuple(args, "O!:Context.mask", &PycairoPattern_Type, &p))
     return NULL;
 
+  _context_tag_source_pattern (o->ctx, p->pattern);
+
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_mask (o->ctx, p->pattern);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_MASK);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -637,8 +1434,14 @@ pycairo_mask_surface (PycairoContext *o, PyObject *args) {
 			 &PycairoSurface_Type, &s, &surface_x, &surface_y))
     return NULL;
 
+  _context_tag_source (o->ctx, s->surface);
+
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_mask_surface (o->ctx, s->surface, surface_x, surface_y);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_MASK);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -652,6 +1455,7 @@ pycairo_move_to (PycairoContext *o, PyObject *args) {
     return NULL;
 
   cairo_move_to (o->ctx, x, y);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
 }
@@ -659,6 +1463,7 @@ pycairo_move_to (PycairoContext *o, PyObject *args) {
 static PyObject *
 pycairo_new_path (PycairoContext *o, PyObject *ignored) {
   cairo_new_path (o->ctx);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
 }
@@ -666,6 +1471,7 @@ pycairo_new_path (PycairoContext *o, PyObject *ignored) {
 static PyObject *
 pycairo_new_sub_path (PycairoContext *o, PyObject *ignored) {
   cairo_new_sub_path (o->ctx);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
 }
@@ -673,7 +1479,11 @@ pycairo_new_sub_path (PycairoContext *o, PyObject *ignored) {
 static PyObject *
 pycairo_paint (PycairoContext *o, PyObject *ignored) {
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_paint (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_PAINT);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -687,7 +1497,11 @@ pycairo_paint_with_alpha (PycairoContext *o, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_paint_with_alpha (o->ctx, alpha);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_PAINT);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -701,6 +1515,150 @@ pycairo_path_extents (PycairoContext *o, PyObject *ignored) {
   return Py_BuildValue("(dddd)", x1, y1, x2, y2);
 }
 
+/* Polyline decimation, see Context.polyline(). Consecutive points falling
+ * into the same device pixel column are reduced to the first, last, lowest
+ * and highest one (M4 aggregation), which rasterizes to the same pixels as
+ * the full polyline. */
+typedef struct {
+  cairo_t *ctx;
+  int need_move;
+  Py_ssize_t n_emitted;
+} PycairoPolyline;
+
+typedef struct {
+  Py_ssize_t index;
+  double x;
+  double y;
+  double dev_y;
+} PycairoPolylinePoint;
+
+static void
+_polyline_emit (PycairoPolyline *line, const PycairoPolylinePoint *point) {
+  if (line->need_move) {
+    cairo_move_to (line->ctx, point->x, point->y);
+    line->need_move = 0;
+  } else {
+    cairo_line_to (line->ctx, point->x, point->y);
+  }
+  line->n_emitted++;
+}
+
+/* Emits the points of a column in their original order, each only once */
+static void
+_polyline_emit_column (PycairoPolyline *line, PycairoPolylinePoint *column) {
+  PycairoPolylinePoint *first = &column[0], *min = &column[1],
+    *max = &column[2], *last = &column[3], *tmp;
+
+  if (min->index > max->index) {
+    tmp = min;
+    min = max;
+    max = tmp;
+  }
+
+  _polyline_emit (line, first);
+  if (min->index != first->index)
+    _polyline_emit (line, min);
+  if (max->index != min->index && max->index != first->index)
+    _polyline_emit (line, max);
+  if (last->index != max->index && last->index != min->index &&
+      last->index != first->index)
+    _polyline_emit (line, last);
+}
+
+/* Called without the GIL */
+static Py_ssize_t
+_context_polyline (cairo_t *ctx, const double *points, Py_ssize_t n,
+                   int decimate) {
+  PycairoPolyline line = {ctx, 1, 0};
+  PycairoPolylinePoint point, column[4];
+  cairo_matrix_t matrix, device;
+  double sx, sy, ox, oy, dev_x, column_x = 0.0;
+  int have_column = 0;
+  Py_ssize_t i;
+
+  /* Columns are pixels of the surface drawn to, so include the device
+   * scale and offset of the current group or target. cairo_user_to_device()
+   * only applies the CTM. */
+  cairo_get_matrix (ctx, &matrix);
+  cairo_surface_get_device_scale (cairo_get_group_target (ctx), &sx, &sy);
+  cairo_surface_get_device_offset (cairo_get_group_target (ctx), &ox, &oy);
+  cairo_matrix_init (&device, sx, 0, 0, sy, ox, oy);
+  cairo_matrix_multiply (&matrix, &matrix, &device);
+
+  for (i = 0; i < n; i++) {
+    point.index = i;
+    point.x = points[i * 2];
+    point.y = points[i * 2 + 1];
+
+    /* Non-finite points split the line */
+    if (!isfinite (point.x) || !isfinite (point.y)) {
+      if (have_column)
+        _polyline_emit_column (&line, column);
+      have_column = 0;
+      line.need_move = 1;
+      continue;
+    }
+
+    if (!decimate) {
+      _polyline_emit (&line, &point);
+      continue;
+    }
+
+    dev_x = point.x;
+    point.dev_y = point.y;
+    cairo_matrix_transform_point (&matrix, &dev_x, &point.dev_y);
+    dev_x = floor (dev_x);
+
+    if (have_column && dev_x == column_x) {
+      if (point.dev_y < column[1].dev_y)
+        column[1] = point;
+      if (point.dev_y > column[2].dev_y)
+        column[2] = point;
+      column[3] = point;
+    } else {
+      if (have_column)
+        _polyline_emit_column (&line, column);
+      column[0] = column[1] = column[2] = column[3] = point;
+      column_x = dev_x;
+      have_column = 1;
+    }
+  }
+
+  if (have_column)
+    _polyline_emit_column (&line, column);
+
+  return line.n_emitted;
+}
+
+static PyObject *
+pycairo_polyline (PycairoContext *o, PyObject *args, PyObject *kwds) {
+  static char *kwlist[] = {"points", "decimate", NULL};
+  PyObject *pypoints;
+  Py_buffer points;
+  Py_ssize_t n, n_emitted;
+  int decimate = 1;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "O|p:Context.polyline",
+                                    kwlist, &pypoints, &decimate))
+    return NULL;
+
+  if (Pycairo_get_double_buffer (pypoints, "points", 2, &points, &n) < 0)
+    return NULL;
+
+  Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
+  n_emitted = _context_polyline (o->ctx, points.buf, n, decimate);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_PATH);
+  Py_END_ALLOW_THREADS;
+
+  PyBuffer_Release (&points);
+
+  RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
+  return PyLong_FromSsize_t (n_emitted);
+}
+
 static PyObject *
 pycairo_pop_group (PycairoContext *o, PyObject *ignored) {
   return PycairoPattern_FromPattern (cairo_pop_group (o->ctx), NULL);
@@ -744,6 +1702,7 @@ pycairo_rectangle (PycairoContext *o, PyObject *args) {
     return NULL;
 
   cairo_rectangle (o->ctx, x, y, width, height);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
 }
@@ -757,6 +1716,7 @@ pycairo_rel_curve_to (PycairoContext *o, PyObject *args) {
     return NULL;
 
   cairo_rel_curve_to (o->ctx, dx1, dy1, dx2, dy2, dx3, dy3);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
 }
@@ -769,6 +1729,7 @@ pycairo_rel_line_to (PycairoContext *o, PyObject *args) {
     return NULL;
 
   cairo_rel_line_to (o->ctx, dx, dy);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
 }
@@ -781,6 +1742,7 @@ pycairo_rel_move_to (PycairoContext *o, PyObject *args) {
     return NULL;
 
   cairo_rel_move_to (o->ctx, dx, dy);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
 }
@@ -1085,6 +2047,7 @@ pycairo_set_source (PycairoContext *o, PyObject *args) {
 			 &PycairoPattern_Type, &p))
     return NULL;
 
+  _context_tag_source_pattern (o->ctx, p->pattern);
   cairo_set_source (o->ctx, p->pattern);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -1126,6 +2089,7 @@ pycairo_set_source_surface (PycairoContext *o, PyObject *args) {
 			 &PycairoSurface_Type, &surface, &x, &y))
     return NULL;
 
+  _context_tag_source (o->ctx, surface->surface);
   cairo_set_source_surface (o->ctx, surface->surface, x, y);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -1161,7 +2125,11 @@ pycairo_show_glyphs (PycairoContext *o, PyObject *args) {
   if (glyphs == NULL)
     return NULL;
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_show_glyphs (o->ctx, glyphs, num_glyphs);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_SHOW_GLYPHS);
   Py_END_ALLOW_THREADS;
   PyMem_Free (glyphs);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
@@ -1170,8 +2138,14 @@ pycairo_show_glyphs (PycairoContext *o, PyObject *args) {
 
 static PyObject *
 pycairo_show_page (PycairoContext *o, PyObject *ignored) {
+  if (Pycairo_surface_wait_pages (cairo_get_target (o->ctx)) < 0)
+    return NULL;
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_show_page (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_SHOW_PAGE);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -1185,7 +2159,11 @@ pycairo_show_text (PycairoContext *o, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_show_text (o->ctx, utf8);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_SHOW_TEXT);
   Py_END_ALLOW_THREADS;
 
   PyMem_Free((void *)utf8);
@@ -1196,7 +2174,14 @@ pycairo_show_text (PycairoContext *o, PyObject *args) {
 static PyObject *
 pycairo_stroke (PycairoContext *o, PyObject *ignored) {
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
+  /* Only the cairo call is timed */
+  if (_context_pick (o->ctx, 1))
+    CONTEXT_OP_RESTART ();
   cairo_stroke (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_STROKE);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -1213,7 +2198,14 @@ pycairo_stroke_extents (PycairoContext *o, PyObject *ignored) {
 static PyObject *
 pycairo_stroke_preserve (PycairoContext *o, PyObject *ignored) {
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
+  /* Only the cairo call is timed */
+  if (_context_pick (o->ctx, 1))
+    CONTEXT_OP_RESTART ();
   cairo_stroke_preserve (o->ctx);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_STROKE);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -1247,6 +2239,7 @@ pycairo_text_path (PycairoContext *o, PyObject *args) {
     return NULL;
 
   cairo_text_path (o->ctx, utf8);
+  _context_count_op (o->ctx, CONTEXT_OP_PATH);
   PyMem_Free((void *)utf8);
   RETURN_NULL_IF_CAIRO_CONTEXT_ERROR(o->ctx);
   Py_RETURN_NONE;
@@ -1368,9 +2361,13 @@ pycairo_show_text_glyphs (PycairoContext *o, PyObject *args) {
   Py_CLEAR (clusters_seq);
 
   Py_BEGIN_ALLOW_THREADS;
+  CONTEXT_OP_BEGIN (o);
+  PYCAIRO_PROBE_ENTRY (cairo_get_target (o->ctx));
   cairo_show_text_glyphs (
     o->ctx, utf8, -1, glyphs, (int)glyphs_size, clusters,
     (int)clusters_size, cluster_flags);
+  PYCAIRO_PROBE_RETURN (cairo_get_target (o->ctx));
+  CONTEXT_OP_END (CONTEXT_OP_SHOW_TEXT);
   Py_END_ALLOW_THREADS;
 
   PyMem_Free ((void *)utf8);
@@ -1409,6 +2406,8 @@ static PyMethodDef pycairo_methods[] = {
   {"append_path",     (PyCFunction)pycairo_append_path,      METH_VARARGS},
   {"arc",             (PyCFunction)pycairo_arc,              METH_VARARGS},
   {"arc_negative",    (PyCFunction)pycairo_arc_negative,     METH_VARARGS},
+  {"blit_many",       (PyCFunction)(void (*)(void))pycairo_blit_many,
+   METH_VARARGS | METH_KEYWORDS},
   {"clip",            (PyCFunction)pycairo_clip,             METH_NOARGS},
   {"clip_extents",    (PyCFunction)pycairo_clip_extents,     METH_NOARGS},
   {"clip_preserve",   (PyCFunction)pycairo_clip_preserve,    METH_NOARGS},
@@ -1422,6 +2421,8 @@ static PyMethodDef pycairo_methods[] = {
   {"device_to_user",  (PyCFunction)pycairo_device_to_user,   METH_VARARGS},
   {"device_to_user_distance", (PyCFunction)pycairo_device_to_user_distance,
    METH_VARARGS},
+  {"draw_instances",  (PyCFunction)(void (*)(void))pycairo_draw_instances,
+   METH_VARARGS | METH_KEYWORDS},
   {"fill",            (PyCFunction)pycairo_fill,             METH_NOARGS},
   {"fill_extents",    (PyCFunction)pycairo_fill_extents,     METH_NOARGS},
   {"fill_preserve",   (PyCFunction)pycairo_fill_preserve,    METH_NOARGS},
@@ -1441,8 +2442,11 @@ static PyMethodDef pycairo_methods[] = {
   {"get_matrix",      (PyCFunction)pycairo_get_matrix,       METH_NOARGS},
   {"get_miter_limit", (PyCFunction)pycairo_get_miter_limit,  METH_NOARGS},
   {"get_operator",    (PyCFunction)pycairo_get_operator,     METH_NOARGS},
+  {"get_pick_buffer", (PyCFunction)pycairo_get_pick_buffer,  METH_NOARGS},
+  {"get_pick_id",     (PyCFunction)pycairo_get_pick_id,      METH_NOARGS},
   {"get_scaled_font", (PyCFunction)pycairo_get_scaled_font,  METH_NOARGS},
   {"get_source",      (PyCFunction)pycairo_get_source,       METH_NOARGS},
+  {"get_stats_enabled",(PyCFunction)pycairo_get_stats_enabled, METH_NOARGS},
   {"get_target",      (PyCFunction)pycairo_get_target,       METH_NOARGS},
   {"get_tolerance",   (PyCFunction)pycairo_get_tolerance,    METH_NOARGS},
   {"glyph_extents",   (PyCFunction)pycairo_glyph_extents,    METH_VARARGS},
@@ -1450,8 +2454,11 @@ static PyMethodDef pycairo_methods[] = {
   {"has_current_point",(PyCFunction)pycairo_has_current_point, METH_NOARGS},
   {"identity_matrix", (PyCFunction)pycairo_identity_matrix,  METH_NOARGS},
   {"in_clip",         (PyCFunction)pycairo_in_clip,          METH_VARARGS},
+  {"in_clip_many",    (PyCFunction)pycairo_in_clip_many,     METH_VARARGS},
   {"in_fill",         (PyCFunction)pycairo_in_fill,          METH_VARARGS},
+  {"in_fill_many",    (PyCFunction)pycairo_in_fill_many,     METH_VARARGS},
   {"in_stroke",       (PyCFunction)pycairo_in_stroke,        METH_VARARGS},
+  {"in_stroke_many",  (PyCFunction)pycairo_in_stroke_many,   METH_VARARGS},
   {"line_to",         (PyCFunction)pycairo_line_to,          METH_VARARGS},
   {"mask",            (PyCFunction)pycairo_mask,             METH_VARARGS},
   {"mask_surface",    (PyCFunction)pycairo_mask_surface,     METH_VARARGS},
@@ -1461,6 +2468,8 @@ static PyMethodDef pycairo_methods[] = {
   {"paint",           (PyCFunction)pycairo_paint,            METH_NOARGS},
   {"paint_with_alpha",(PyCFunction)pycairo_paint_with_alpha, METH_VARARGS},
   {"path_extents",    (PyCFunction)pycairo_path_extents,     METH_NOARGS},
+  {"polyline",        (PyCFunction)(void (*)(void))pycairo_polyline,
+   METH_VARARGS | METH_KEYWORDS},
   {"pop_group",       (PyCFunction)pycairo_pop_group,        METH_NOARGS},
   {"pop_group_to_source", (PyCFunction)pycairo_pop_group_to_source,
    METH_NOARGS},
@@ -1490,15 +2499,19 @@ static PyMethodDef pycairo_methods[] = {
   {"set_matrix",      (PyCFunction)pycairo_set_matrix,       METH_VARARGS},
   {"set_miter_limit", (PyCFunction)pycairo_set_miter_limit,  METH_VARARGS},
   {"set_operator",    (PyCFunction)pycairo_set_operator,     METH_VARARGS},
+  {"set_pick_buffer", (PyCFunction)pycairo_set_pick_buffer,  METH_VARARGS},
+  {"set_pick_id",     (PyCFunction)pycairo_set_pick_id,      METH_VARARGS},
   {"set_scaled_font", (PyCFunction)pycairo_set_scaled_font,  METH_VARARGS},
   {"set_source",      (PyCFunction)pycairo_set_source,       METH_VARARGS},
   {"set_source_rgb",  (PyCFunction)pycairo_set_source_rgb,   METH_VARARGS},
   {"set_source_rgba", (PyCFunction)pycairo_set_source_rgba,  METH_VARARGS},
   {"set_source_surface",(PyCFunction)pycairo_set_source_surface, METH_VARARGS},
+  {"set_stats_enabled",(PyCFunction)pycairo_set_stats_enabled, METH_VARARGS},
   {"set_tolerance",   (PyCFunction)pycairo_set_tolerance,    METH_VARARGS},
   {"show_glyphs",     (PyCFunction)pycairo_show_glyphs,      METH_VARARGS},
   {"show_page",       (PyCFunction)pycairo_show_page,        METH_NOARGS},
   {"show_text",       (PyCFunction)pycairo_show_text,        METH_VARARGS},
+  {"stats",           (PyCFunction)pycairo_stats,            METH_NOARGS},
   {"stroke",          (PyCFunction)pycairo_stroke,           METH_NOARGS},
   {"stroke_extents",  (PyCFunction)pycairo_stroke_extents,   METH_NOARGS},
   {"stroke_preserve", (PyCFunction)pycairo_stroke_preserve,  METH_NOARGS},
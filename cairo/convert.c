@@ -0,0 +1,880 @@
+/* -*- mode: C; c-basic-offset: 2 -*-
+ *
+ * Pycairo - Python bindings for cairo
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ */
+
+/* Pixel conversion between cairo image formats and the byte layouts used by
+ * other libraries.
+ *
+ * Every conversion goes through a row of premultiplied native endian ARGB32
+ * pixels. Conversions from and to the straight alpha RGBA/BGRA/ARGB layouts
+ * have vectorized kernels, selected at runtime (SSE2 and AVX2 on x86, NEON
+ * on aarch64). The results are identical to the scalar code, which matches
+ * the rounding cairo uses when reading and writing PNG files.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <string.h>
+
+#include "private.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PYCAIRO_HAVE_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#if defined(PYCAIRO_HAVE_SSE2) && defined(__GNUC__) && \
+    (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ >= 5)
+#define PYCAIRO_HAVE_AVX2 1
+#include <immintrin.h>
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#define PYCAIRO_HAVE_NEON 1
+#include <arm_neon.h>
+#endif
+
+typedef void (*unpremultiply_func_t) (
+  const uint32_t *src, uint8_t *dst, int n, PycairoPixelLayoutType layout);
+typedef void (*premultiply_func_t) (
+  const uint8_t *src, uint32_t *dst, int n, PycairoPixelLayoutType layout);
+
+/* unpremultiply_table[a][c] == (c * 255 + a / 2) / a */
+static uint8_t unpremultiply_table[256][256];
+static unpremultiply_func_t unpremultiply_impl;
+static premultiply_func_t premultiply_impl;
+static const char *convert_impl_name = "generic";
+
+/* Byte offsets of red, green, blue and alpha for the 4 byte layouts */
+static void
+_layout_offsets (PycairoPixelLayoutType layout, int offsets[4]) {
+  switch (layout) {
+  case PYCAIRO_LAYOUT_BGRA:
+    offsets[0] = 2; offsets[1] = 1; offsets[2] = 0; offsets[3] = 3;
+    break;
+  case PYCAIRO_LAYOUT_ARGB:
+    offsets[0] = 1; offsets[1] = 2; offsets[2] = 3; offsets[3] = 0;
+    break;
+  case PYCAIRO_LAYOUT_BGR:
+    offsets[0] = 2; offsets[1] = 1; offsets[2] = 0; offsets[3] = -1;
+    break;
+  case PYCAIRO_LAYOUT_RGB:
+    offsets[0] = 0; offsets[1] = 1; offsets[2] = 2; offsets[3] = -1;
+    break;
+  case PYCAIRO_LAYOUT_RGBA:
+  case PYCAIRO_LAYOUT_L:
+  case PYCAIRO_LAYOUT_FORMAT:
+  default:
+    offsets[0] = 0; offsets[1] = 1; offsets[2] = 2; offsets[3] = 3;
+    break;
+  }
+}
+
+static inline uint8_t
+_multiply_alpha (uint32_t alpha, uint32_t color) {
+  uint32_t temp = alpha * color + 0x80;
+  return (uint8_t)((temp + (temp >> 8)) >> 8);
+}
+
+static inline uint8_t
+_luma (uint32_t r, uint32_t g, uint32_t b) {
+  /* ITU-R 601-2, the same weights PIL uses for "L" */
+  return (uint8_t)((r * 19595 + g * 38470 + b * 7471 + 0x8000) >> 16);
+}
+
+/* Scalar kernels --------------------------------------------------------- */
+
+static void
+unpremultiply_generic (const uint32_t *src, uint8_t *dst, int n,
+                       PycairoPixelLayoutType layout) {
+  int offsets[4], i, bpp;
+  uint32_t pixel, alpha;
+  const uint8_t *table;
+  uint8_t r, g, b;
+
+  _layout_offsets (layout, offsets);
+  bpp = Pycairo_pixel_layout_bytes_per_pixel (layout);
+
+  for (i = 0; i < n; i++, dst += bpp) {
+    pixel = src[i];
+    alpha = pixel >> 24;
+    table = unpremultiply_table[alpha];
+    r = table[(pixel >> 16) & 0xff];
+    g = table[(pixel >> 8) & 0xff];
+    b = table[pixel & 0xff];
+    if (layout == PYCAIRO_LAYOUT_L) {
+      dst[0] = _luma (r, g, b);
+      continue;
+    }
+    dst[offsets[0]] = r;
+    dst[offsets[1]] = g;
+    dst[offsets[2]] = b;
+    if (offsets[3] >= 0)
+      dst[offsets[3]] = (uint8_t)alpha;
+  }
+}
+
+static void
+premultiply_generic (const uint8_t *src, uint32_t *dst, int n,
+                     PycairoPixelLayoutType layout) {
+  int offsets[4], i, bpp;
+  uint32_t r, g, b, alpha;
+
+  _layout_offsets (layout, offsets);
+  bpp = Pycairo_pixel_layout_bytes_per_pixel (layout);
+
+  for (i = 0; i < n; i++, src += bpp) {
+    if (layout == PYCAIRO_LAYOUT_L) {
+      r = g = b = src[0];
+    } else {
+      r = src[offsets[0]];
+      g = src[offsets[1]];
+      b = src[offsets[2]];
+    }
+    alpha = offsets[3] >= 0 && layout != PYCAIRO_LAYOUT_L ?
+      src[offsets[3]] : 0xff;
+    if (alpha != 0xff) {
+      r = _multiply_alpha (alpha, r);
+      g = _multiply_alpha (alpha, g);
+      b = _multiply_alpha (alpha, b);
+    }
+    dst[i] = (alpha << 24) | (r << 16) | (g << 8) | b;
+  }
+}
+
+/* SSE2 ------------------------------------------------------------------- */
+
+/* The vectorized kernels only handle the 4 byte layouts and treat pixels as
+ * little endian 32 bit words: native ARGB32 is BGRA in memory, RGBA swaps
+ * the red and blue bytes and ARGB reverses all bytes. Both swizzles are
+ * their own inverse, so the same code converts in both directions.
+ */
+
+#ifdef PYCAIRO_HAVE_SSE2
+
+static inline __m128i
+_swizzle_sse2 (__m128i v, PycairoPixelLayoutType layout) {
+  const __m128i mask_ag = _mm_set1_epi32 ((int)0xff00ff00);
+  const __m128i mask_lo = _mm_set1_epi32 (0xff);
+  const __m128i mask_hi = _mm_set1_epi32 (0xff0000);
+
+  switch (layout) {
+  case PYCAIRO_LAYOUT_RGBA:
+    return _mm_or_si128 (
+      _mm_and_si128 (v, mask_ag),
+      _mm_or_si128 (_mm_and_si128 (_mm_srli_epi32 (v, 16), mask_lo),
+                    _mm_and_si128 (_mm_slli_epi32 (v, 16), mask_hi)));
+  case PYCAIRO_LAYOUT_ARGB:
+    v = _mm_or_si128 (_mm_srli_epi16 (v, 8), _mm_slli_epi16 (v, 8));
+    return _mm_or_si128 (_mm_srli_epi32 (v, 16), _mm_slli_epi32 (v, 16));
+  case PYCAIRO_LAYOUT_BGRA:
+  case PYCAIRO_LAYOUT_RGB:
+  case PYCAIRO_LAYOUT_BGR:
+  case PYCAIRO_LAYOUT_L:
+  case PYCAIRO_LAYOUT_FORMAT:
+  default:
+    return v;
+  }
+}
+
+static void
+unpremultiply_sse2 (const uint32_t *src, uint8_t *dst, int n,
+                    PycairoPixelLayoutType layout) {
+  const __m128i alpha_mask = _mm_set1_epi32 ((int)0xff000000);
+  const __m128i zero = _mm_setzero_si128 ();
+  __m128i v, alpha;
+  int i = 0, opaque, transparent;
+
+  if (Pycairo_pixel_layout_bytes_per_pixel (layout) != 4) {
+    unpremultiply_generic (src, dst, n, layout);
+    return;
+  }
+
+  /* Blocks which are completely opaque or transparent only need swizzling,
+   * everything else goes through the lookup table */
+  for (; i + 4 <= n; i += 4) {
+    v = _mm_loadu_si128 ((const __m128i *)(const void *)(src + i));
+    alpha = _mm_and_si128 (v, alpha_mask);
+    opaque = _mm_movemask_epi8 (_mm_cmpeq_epi32 (alpha, alpha_mask));
+    transparent = _mm_movemask_epi8 (_mm_cmpeq_epi32 (alpha, zero));
+    if (opaque == 0xffff) {
+      _mm_storeu_si128 ((__m128i *)(void *)(dst + i * 4),
+                        _swizzle_sse2 (v, layout));
+    } else if (transparent == 0xffff) {
+      _mm_storeu_si128 ((__m128i *)(void *)(dst + i * 4), zero);
+    } else {
+      unpremultiply_generic (src + i, dst + i * 4, 4, layout);
+    }
+  }
+  unpremultiply_generic (src + i, dst + i * 4, n - i, layout);
+}
+
+static void
+premultiply_sse2 (const uint8_t *src, uint32_t *dst, int n,
+                  PycairoPixelLayoutType layout) {
+  const __m128i alpha_mask = _mm_set1_epi32 ((int)0xff000000);
+  const __m128i alpha_lanes = _mm_set_epi16 (-1, 0, 0, 0, -1, 0, 0, 0);
+  const __m128i bias = _mm_set1_epi16 (0x80);
+  const __m128i zero = _mm_setzero_si128 ();
+  __m128i v, lo, hi, alo, ahi;
+  int i = 0;
+
+  if (Pycairo_pixel_layout_bytes_per_pixel (layout) != 4) {
+    premultiply_generic (src, dst, n, layout);
+    return;
+  }
+
+  for (; i + 4 <= n; i += 4) {
+    v = _mm_loadu_si128 ((const __m128i *)(const void *)(src + i * 4));
+    v = _swizzle_sse2 (v, layout);
+    if (_mm_movemask_epi8 (_mm_cmpeq_epi32 (
+          _mm_and_si128 (v, alpha_mask), alpha_mask)) != 0xffff) {
+      lo = _mm_unpacklo_epi8 (v, zero);
+      hi = _mm_unpackhi_epi8 (v, zero);
+      alo = _mm_shufflehi_epi16 (
+        _mm_shufflelo_epi16 (lo, _MM_SHUFFLE (3, 3, 3, 3)),
+        _MM_SHUFFLE (3, 3, 3, 3));
+      ahi = _mm_shufflehi_epi16 (
+        _mm_shufflelo_epi16 (hi, _MM_SHUFFLE (3, 3, 3, 3)),
+        _MM_SHUFFLE (3, 3, 3, 3));
+      /* keep the alpha lanes, multiply the color ones */
+      alo = _mm_adds_epu16 (_mm_mullo_epi16 (lo, alo), bias);
+      ahi = _mm_adds_epu16 (_mm_mullo_epi16 (hi, ahi), bias);
+      alo = _mm_srli_epi16 (_mm_add_epi16 (alo, _mm_srli_epi16 (alo, 8)), 8);
+      ahi = _mm_srli_epi16 (_mm_add_epi16 (ahi, _mm_srli_epi16 (ahi, 8)), 8);
+      lo = _mm_or_si128 (_mm_and_si128 (alpha_lanes, lo),
+                         _mm_andnot_si128 (alpha_lanes, alo));
+      hi = _mm_or_si128 (_mm_and_si128 (alpha_lanes, hi),
+                         _mm_andnot_si128 (alpha_lanes, ahi));
+      v = _mm_packus_epi16 (lo, hi);
+    }
+    _mm_storeu_si128 ((__m128i *)(void *)(dst + i), v);
+  }
+  premultiply_generic (src + i * 4, dst + i, n - i, layout);
+}
+
+#endif /* PYCAIRO_HAVE_SSE2 */
+
+/* AVX2 ------------------------------------------------------------------- */
+
+#ifdef PYCAIRO_HAVE_AVX2
+
+#define PYCAIRO_TARGET_AVX2 __attribute__((target("avx2")))
+
+PYCAIRO_TARGET_AVX2 static inline __m256i
+_swizzle_avx2 (__m256i v, PycairoPixelLayoutType layout) {
+  const __m256i rgba = _mm256_setr_epi8 (
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  const __m256i argb = _mm256_setr_epi8 (
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+    3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+  switch (layout) {
+  case PYCAIRO_LAYOUT_RGBA:
+    return _mm256_shuffle_epi8 (v, rgba);
+  case PYCAIRO_LAYOUT_ARGB:
+    return _mm256_shuffle_epi8 (v, argb);
+  case PYCAIRO_LAYOUT_BGRA:
+  case PYCAIRO_LAYOUT_RGB:
+  case PYCAIRO_LAYOUT_BGR:
+  case PYCAIRO_LAYOUT_L:
+  case PYCAIRO_LAYOUT_FORMAT:
+  default:
+    return v;
+  }
+}
+
+PYCAIRO_TARGET_AVX2 static void
+unpremultiply_avx2 (const uint32_t *src, uint8_t *dst, int n,
+                    PycairoPixelLayoutType layout) {
+  const __m256i alpha_mask = _mm256_set1_epi32 ((int)0xff000000);
+  const __m256i zero = _mm256_setzero_si256 ();
+  __m256i v, alpha;
+  int i = 0;
+
+  if (Pycairo_pixel_layout_bytes_per_pixel (layout) != 4) {
+    unpremultiply_generic (src, dst, n, layout);
+    return;
+  }
+
+  for (; i + 8 <= n; i += 8) {
+    v = _mm256_loadu_si256 ((const __m256i *)(const void *)(src + i));
+    alpha = _mm256_and_si256 (v, alpha_mask);
+    if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (alpha, alpha_mask)) == -1) {
+      _mm256_storeu_si256 ((__m256i *)(void *)(dst + i * 4),
+                           _swizzle_avx2 (v, layout));
+    } else if (_mm256_testz_si256 (alpha, alpha)) {
+      _mm256_storeu_si256 ((__m256i *)(void *)(dst + i * 4), zero);
+    } else {
+      unpremultiply_generic (src + i, dst + i * 4, 8, layout);
+    }
+  }
+  unpremultiply_generic (src + i, dst + i * 4, n - i, layout);
+}
+
+PYCAIRO_TARGET_AVX2 static void
+premultiply_avx2 (const uint8_t *src, uint32_t *dst, int n,
+                  PycairoPixelLayoutType layout) {
+  const __m256i alpha_mask = _mm256_set1_epi32 ((int)0xff000000);
+  const __m256i broadcast = _mm256_setr_epi8 (
+    6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15,
+    6, 7, 6, 7, 6, 7, 6, 7, 14, 15, 14, 15, 14, 15, 14, 15);
+  const __m256i alpha_lanes = _mm256_set_epi16 (
+    -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0, -1, 0, 0, 0);
+  const __m256i bias = _mm256_set1_epi16 (0x80);
+  const __m256i zero = _mm256_setzero_si256 ();
+  __m256i v, lo, hi, alo, ahi;
+  int i = 0;
+
+  if (Pycairo_pixel_layout_bytes_per_pixel (layout) != 4) {
+    premultiply_generic (src, dst, n, layout);
+    return;
+  }
+
+  for (; i + 8 <= n; i += 8) {
+    v = _mm256_loadu_si256 ((const __m256i *)(const void *)(src + i * 4));
+    v = _swizzle_avx2 (v, layout);
+    if (_mm256_movemask_epi8 (_mm256_cmpeq_epi32 (
+          _mm256_and_si256 (v, alpha_mask), alpha_mask)) != -1) {
+      lo = _mm256_unpacklo_epi8 (v, zero);
+      hi = _mm256_unpackhi_epi8 (v, zero);
+      alo = _mm256_shuffle_epi8 (lo, broadcast);
+      ahi = _mm256_shuffle_epi8 (hi, broadcast);
+      alo = _mm256_adds_epu16 (_mm256_mullo_epi16 (lo, alo), bias);
+      ahi = _mm256_adds_epu16 (_mm256_mullo_epi16 (hi, ahi), bias);
+      alo = _mm256_srli_epi16 (
+        _mm256_add_epi16 (alo, _mm256_srli_epi16 (alo, 8)), 8);
+      ahi = _mm256_srli_epi16 (
+        _mm256_add_epi16 (ahi, _mm256_srli_epi16 (ahi, 8)), 8);
+      lo = _mm256_blendv_epi8 (alo, lo, alpha_lanes);
+      hi = _mm256_blendv_epi8 (ahi, hi, alpha_lanes);
+      v = _mm256_packus_epi16 (lo, hi);
+    }
+    _mm256_storeu_si256 ((__m256i *)(void *)(dst + i), v);
+  }
+  premultiply_generic (src + i * 4, dst + i, n - i, layout);
+}
+
+#endif /* PYCAIRO_HAVE_AVX2 */
+
+/* NEON ------------------------------------------------------------------- */
+
+#ifdef PYCAIRO_HAVE_NEON
+
+static inline uint8x16_t
+_swizzle_neon (uint8x16_t v, PycairoPixelLayoutType layout) {
+  static const uint8_t rgba[16] = {
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15};
+
+  switch (layout) {
+  case PYCAIRO_LAYOUT_RGBA:
+    return vqtbl1q_u8 (v, vld1q_u8 (rgba));
+  case PYCAIRO_LAYOUT_ARGB:
+    return vrev32q_u8 (v);
+  case PYCAIRO_LAYOUT_BGRA:
+  case PYCAIRO_LAYOUT_RGB:
+  case PYCAIRO_LAYOUT_BGR:
+  case PYCAIRO_LAYOUT_L:
+  case PYCAIRO_LAYOUT_FORMAT:
+  default:
+    return v;
+  }
+}
+
+static void
+unpremultiply_neon (const uint32_t *src, uint8_t *dst, int n,
+                    PycairoPixelLayoutType layout) {
+  uint32x4_t v, alpha;
+  int i = 0;
+
+  if (Pycairo_pixel_layout_bytes_per_pixel (layout) != 4) {
+    unpremultiply_generic (src, dst, n, layout);
+    return;
+  }
+
+  for (; i + 4 <= n; i += 4) {
+    v = vld1q_u32 (src + i);
+    alpha = vshrq_n_u32 (v, 24);
+    if (vminvq_u32 (alpha) == 0xff) {
+      vst1q_u8 (dst + i * 4,
+                _swizzle_neon (vreinterpretq_u8_u32 (v), layout));
+    } else if (vmaxvq_u32 (alpha) == 0) {
+      vst1q_u8 (dst + i * 4, vdupq_n_u8 (0));
+    } else {
+      unpremultiply_generic (src + i, dst + i * 4, 4, layout);
+    }
+  }
+  unpremultiply_generic (src + i, dst + i * 4, n - i, layout);
+}
+
+static void
+premultiply_neon (const uint8_t *src, uint32_t *dst, int n,
+                  PycairoPixelLayoutType layout) {
+  static const uint8_t broadcast[16] = {
+    3, 3, 3, 3, 7, 7, 7, 7, 11, 11, 11, 11, 15, 15, 15, 15};
+  static const uint8_t alpha_lanes[16] = {
+    0, 0, 0, 0xff, 0, 0, 0, 0xff, 0, 0, 0, 0xff, 0, 0, 0, 0xff};
+  const uint8x16_t broadcast_idx = vld1q_u8 (broadcast);
+  const uint8x16_t alpha_mask = vld1q_u8 (alpha_lanes);
+  const uint16x8_t bias = vdupq_n_u16 (0x80);
+  uint8x16_t v, alpha;
+  uint16x8_t lo, hi;
+  int i = 0;
+
+  if (Pycairo_pixel_layout_bytes_per_pixel (layout) != 4) {
+    premultiply_generic (src, dst, n, layout);
+    return;
+  }
+
+  for (; i + 4 <= n; i += 4) {
+    v = _swizzle_neon (vld1q_u8 (src + i * 4), layout);
+    alpha = vqtbl1q_u8 (v, broadcast_idx);
+    if (vminvq_u8 (alpha) != 0xff) {
+      lo = vaddq_u16 (vmull_u8 (vget_low_u8 (v), vget_low_u8 (alpha)), bias);
+      hi = vaddq_u16 (vmull_high_u8 (v, alpha), bias);
+      lo = vsraq_n_u16 (lo, lo, 8);
+      hi = vsraq_n_u16 (hi, hi, 8);
+      v = vbslq_u8 (alpha_mask, v,
+                    vcombine_u8 (vshrn_n_u16 (lo, 8), vshrn_n_u16 (hi, 8)));
+    }
+    vst1q_u32 (dst + i, vreinterpretq_u32_u8 (v));
+  }
+  premultiply_generic (src + i * 4, dst + i, n - i, layout);
+}
+
+#endif /* PYCAIRO_HAVE_NEON */
+
+/* Cairo formats ---------------------------------------------------------- */
+
+static inline uint8_t
+_float_to_byte (float value) {
+  if (!(value > 0.f))
+    return 0;
+  if (value >= 1.f)
+    return 255;
+  return (uint8_t)(value * 255.f + 0.5f);
+}
+
+/* Reads a row of pixels in a cairo format into premultiplied ARGB32.
+ * row has to be 4 byte aligned. */
+static void
+_read_row (cairo_format_t format, const unsigned char *row, uint32_t *dst,
+           int n) {
+  const uint16_t *row16 = (const uint16_t *)(const void *)row;
+  const uint32_t *row32 = (const uint32_t *)(const void *)row;
+  const float *rowf = (const float *)(const void *)row;
+  uint32_t r, g, b;
+  int i;
+
+  switch (format) {
+  case CAIRO_FORMAT_ARGB32:
+    memcpy (dst, row, (size_t)n * 4);
+    break;
+  case CAIRO_FORMAT_RGB24:
+    for (i = 0; i < n; i++)
+      dst[i] = row32[i] | 0xff000000;
+    break;
+  case CAIRO_FORMAT_A8:
+    for (i = 0; i < n; i++)
+      dst[i] = (uint32_t)row[i] << 24;
+    break;
+  case CAIRO_FORMAT_RGB16_565:
+    for (i = 0; i < n; i++) {
+      r = (row16[i] >> 11) & 0x1f;
+      g = (row16[i] >> 5) & 0x3f;
+      b = row16[i] & 0x1f;
+      dst[i] = 0xff000000 | (((r << 3) | (r >> 2)) << 16) |
+        (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+    }
+    break;
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 17, 2)
+  case CAIRO_FORMAT_RGB96F:
+    for (i = 0; i < n; i++, rowf += 3)
+      dst[i] = 0xff000000 | ((uint32_t)_float_to_byte (rowf[0]) << 16) |
+        ((uint32_t)_float_to_byte (rowf[1]) << 8) | _float_to_byte (rowf[2]);
+    break;
+  case CAIRO_FORMAT_RGBA128F:
+    for (i = 0; i < n; i++, rowf += 4)
+      dst[i] = ((uint32_t)_float_to_byte (rowf[3]) << 24) |
+        ((uint32_t)_float_to_byte (rowf[0]) << 16) |
+        ((uint32_t)_float_to_byte (rowf[1]) << 8) | _float_to_byte (rowf[2]);
+    break;
+#endif
+  case CAIRO_FORMAT_INVALID:
+  case CAIRO_FORMAT_A1:
+  case CAIRO_FORMAT_RGB30:
+  default:
+    memset (dst, 0, (size_t)n * 4);
+    break;
+  }
+}
+
+/* Writes a row of premultiplied ARGB32 pixels in a cairo format.
+ * row has to be 4 byte aligned. */
+static void
+_write_row (cairo_format_t format, const uint32_t *src, unsigned char *row,
+            int n) {
+  uint16_t *row16 = (uint16_t *)(void *)row;
+  uint32_t *row32 = (uint32_t *)(void *)row;
+  float *rowf = (float *)(void *)row;
+  int i;
+
+  switch (format) {
+  case CAIRO_FORMAT_ARGB32:
+    memcpy (row, src, (size_t)n * 4);
+    break;
+  case CAIRO_FORMAT_RGB24:
+    for (i = 0; i < n; i++)
+      row32[i] = src[i] | 0xff000000;
+    break;
+  case CAIRO_FORMAT_A8:
+    for (i = 0; i < n; i++)
+      row[i] = (uint8_t)(src[i] >> 24);
+    break;
+  case CAIRO_FORMAT_RGB16_565:
+    for (i = 0; i < n; i++)
+      row16[i] = (uint16_t)(((src[i] >> 8) & 0xf800) |
+                            ((src[i] >> 5) & 0x07e0) |
+                            ((src[i] >> 3) & 0x001f));
+    break;
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 17, 2)
+  case CAIRO_FORMAT_RGB96F:
+    for (i = 0; i < n; i++, rowf += 3) {
+      rowf[0] = (float)((src[i] >> 16) & 0xff) / 255.f;
+      rowf[1] = (float)((src[i] >> 8) & 0xff) / 255.f;
+      rowf[2] = (float)(src[i] & 0xff) / 255.f;
+    }
+    break;
+  case CAIRO_FORMAT_RGBA128F:
+    for (i = 0; i < n; i++, rowf += 4) {
+      rowf[0] = (float)((src[i] >> 16) & 0xff) / 255.f;
+      rowf[1] = (float)((src[i] >> 8) & 0xff) / 255.f;
+      rowf[2] = (float)(src[i] & 0xff) / 255.f;
+      rowf[3] = (float)(src[i] >> 24) / 255.f;
+    }
+    break;
+#endif
+  case CAIRO_FORMAT_INVALID:
+  case CAIRO_FORMAT_A1:
+  case CAIRO_FORMAT_RGB30:
+  default:
+    break;
+  }
+}
+
+static int
+_format_is_supported (cairo_format_t format) {
+  switch (format) {
+  case CAIRO_FORMAT_ARGB32:
+  case CAIRO_FORMAT_RGB24:
+  case CAIRO_FORMAT_A8:
+  case CAIRO_FORMAT_RGB16_565:
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 17, 2)
+  case CAIRO_FORMAT_RGB96F:
+  case CAIRO_FORMAT_RGBA128F:
+#endif
+    return 1;
+  case CAIRO_FORMAT_INVALID:
+  case CAIRO_FORMAT_A1:
+  case CAIRO_FORMAT_RGB30:
+  default:
+    return 0;
+  }
+}
+
+/* Layouts ---------------------------------------------------------------- */
+
+int
+Pycairo_pixel_layout_converter (PyObject *obj, PycairoPixelLayout *layout) {
+  static const struct {
+    const char *name;
+    PycairoPixelLayoutType type;
+  } names[] = {
+    {"RGBA", PYCAIRO_LAYOUT_RGBA},
+    {"BGRA", PYCAIRO_LAYOUT_BGRA},
+    {"ARGB", PYCAIRO_LAYOUT_ARGB},
+    {"RGB", PYCAIRO_LAYOUT_RGB},
+    {"BGR", PYCAIRO_LAYOUT_BGR},
+    {"L", PYCAIRO_LAYOUT_L},
+  };
+  const char *name;
+  long format;
+  size_t i;
+
+  if (PyUnicode_Check (obj)) {
+    name = PyUnicode_AsUTF8 (obj);
+    if (name == NULL)
+      return 0;
+    for (i = 0; i < sizeof (names) / sizeof (names[0]); i++) {
+      if (strcmp (name, names[i].name) == 0) {
+        layout->type = names[i].type;
+        layout->format = CAIRO_FORMAT_INVALID;
+        return 1;
+      }
+    }
+    PyErr_Format (PyExc_ValueError, "unknown pixel layout '%s'", name);
+    return 0;
+  }
+
+  if (PyLong_Check (obj)) {
+    format = PyLong_AsLong (obj);
+    if (format == -1 && PyErr_Occurred ())
+      return 0;
+    if (format < INT_MIN || format > INT_MAX ||
+        !_format_is_supported ((cairo_format_t)format)) {
+      PyErr_SetString (PyExc_ValueError,
+                       "format not supported for pixel conversion");
+      return 0;
+    }
+    layout->type = PYCAIRO_LAYOUT_FORMAT;
+    layout->format = (cairo_format_t)format;
+    return 1;
+  }
+
+  PyErr_SetString (PyExc_TypeError,
+                   "layout must be a str or a cairo.Format");
+  return 0;
+}
+
+int
+Pycairo_pixel_layout_bytes_per_pixel (PycairoPixelLayoutType type) {
+  switch (type) {
+  case PYCAIRO_LAYOUT_RGBA:
+  case PYCAIRO_LAYOUT_BGRA:
+  case PYCAIRO_LAYOUT_ARGB:
+    return 4;
+  case PYCAIRO_LAYOUT_RGB:
+  case PYCAIRO_LAYOUT_BGR:
+    return 3;
+  case PYCAIRO_LAYOUT_L:
+    return 1;
+  case PYCAIRO_LAYOUT_FORMAT:
+  default:
+    return 0;
+  }
+}
+
+/* Returns the number of bytes used by a row of width pixels, or -1 */
+Py_ssize_t
+Pycairo_pixel_layout_row_bytes (PycairoPixelLayout *layout, int width) {
+  int bpp;
+
+  if (layout->type != PYCAIRO_LAYOUT_FORMAT)
+    return (Py_ssize_t)width *
+      Pycairo_pixel_layout_bytes_per_pixel (layout->type);
+
+  switch (layout->format) {
+  case CAIRO_FORMAT_A8:
+    bpp = 1;
+    break;
+  case CAIRO_FORMAT_RGB16_565:
+    bpp = 2;
+    break;
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 17, 2)
+  case CAIRO_FORMAT_RGB96F:
+    bpp = 12;
+    break;
+  case CAIRO_FORMAT_RGBA128F:
+    bpp = 16;
+    break;
+#endif
+  case CAIRO_FORMAT_ARGB32:
+  case CAIRO_FORMAT_RGB24:
+    bpp = 4;
+    break;
+  case CAIRO_FORMAT_INVALID:
+  case CAIRO_FORMAT_A1:
+  case CAIRO_FORMAT_RGB30:
+  default:
+    return -1;
+  }
+  return (Py_ssize_t)width * bpp;
+}
+
+/* The row stride used if none is given: tightly packed rows for the byte
+ * layouts, the cairo stride for the cairo formats. */
+Py_ssize_t
+Pycairo_pixel_layout_default_stride (PycairoPixelLayout *layout, int width) {
+  if (layout->type == PYCAIRO_LAYOUT_FORMAT)
+    return cairo_format_stride_for_width (layout->format, width);
+  return Pycairo_pixel_layout_row_bytes (layout, width);
+}
+
+/* The cairo format an image created from pixels in layout uses */
+cairo_format_t
+Pycairo_pixel_layout_image_format (PycairoPixelLayout *layout) {
+  switch (layout->type) {
+  case PYCAIRO_LAYOUT_RGBA:
+  case PYCAIRO_LAYOUT_BGRA:
+  case PYCAIRO_LAYOUT_ARGB:
+    return CAIRO_FORMAT_ARGB32;
+  case PYCAIRO_LAYOUT_RGB:
+  case PYCAIRO_LAYOUT_BGR:
+  case PYCAIRO_LAYOUT_L:
+    return CAIRO_FORMAT_RGB24;
+  case PYCAIRO_LAYOUT_FORMAT:
+  default:
+    return layout->format;
+  }
+}
+
+/* Conversion ------------------------------------------------------------- */
+
+static inline int
+_is_aligned (const void *ptr) {
+  return ((uintptr_t)ptr & 3) == 0;
+}
+
+/* Converts width x height pixels from src to dst. Can be called without the
+ * GIL held. Returns -1 if the scratch memory couldn't be allocated.
+ */
+int
+Pycairo_convert_pixels (PycairoPixelLayout *src_layout,
+                        const unsigned char *src, Py_ssize_t src_stride,
+                        PycairoPixelLayout *dst_layout,
+                        unsigned char *dst, Py_ssize_t dst_stride,
+                        int width, int height) {
+  Py_ssize_t src_row_bytes, dst_row_bytes;
+  uint32_t *scratch;
+  const uint32_t *argb;
+  unsigned char *row;
+  int y, src_format, dst_format;
+
+  if (width <= 0 || height <= 0)
+    return 0;
+
+  src_format = src_layout->type == PYCAIRO_LAYOUT_FORMAT;
+  dst_format = dst_layout->type == PYCAIRO_LAYOUT_FORMAT;
+  src_row_bytes = Pycairo_pixel_layout_row_bytes (src_layout, width);
+  dst_row_bytes = Pycairo_pixel_layout_row_bytes (dst_layout, width);
+
+  if (src_layout->type == dst_layout->type &&
+      src_layout->format == dst_layout->format) {
+    for (y = 0; y < height; y++)
+      memcpy (dst + y * dst_stride, src + y * src_stride,
+              (size_t)dst_row_bytes);
+    return 0;
+  }
+
+  /* one ARGB32 row and one row of the largest cairo format for copying
+   * unaligned rows */
+  scratch = PyMem_RawMalloc ((size_t)width * (4 + 16));
+  if (scratch == NULL)
+    return -1;
+  row = (unsigned char *)(scratch + width);
+
+  for (y = 0; y < height; y++) {
+    const unsigned char *src_row = src + y * src_stride;
+    unsigned char *dst_row = dst + y * dst_stride;
+
+    if (!src_format && dst_layout->format == CAIRO_FORMAT_ARGB32 &&
+        _is_aligned (dst_row)) {
+      premultiply_impl (src_row, (uint32_t *)(void *)dst_row, width,
+                        src_layout->type);
+      continue;
+    }
+
+    if (!src_format) {
+      premultiply_impl (src_row, scratch, width, src_layout->type);
+      argb = scratch;
+    } else if (src_layout->format == CAIRO_FORMAT_ARGB32 &&
+               _is_aligned (src_row)) {
+      argb = (const uint32_t *)(const void *)src_row;
+    } else {
+      if (!_is_aligned (src_row)) {
+        memcpy (row, src_row, (size_t)src_row_bytes);
+        src_row = row;
+      }
+      _read_row (src_layout->format, src_row, scratch, width);
+      argb = scratch;
+    }
+
+    if (!dst_format) {
+      unpremultiply_impl (argb, dst_row, width, dst_layout->type);
+    } else if (_is_aligned (dst_row)) {
+      _write_row (dst_layout->format, argb, dst_row, width);
+    } else {
+      _write_row (dst_layout->format, argb, row, width);
+      memcpy (dst_row, row, (size_t)dst_row_bytes);
+    }
+  }
+
+  PyMem_RawFree (scratch);
+  return 0;
+}
+
+/* Returns the name of the kernels in use, "generic", "sse2", "avx2" or
+ * "neon" */
+const char *
+Pycairo_convert_get_impl (void) {
+  return convert_impl_name;
+}
+
+int
+init_convert (void) {
+  unsigned int a, c;
+
+  for (c = 0; c < 256; c++)
+    unpremultiply_table[0][c] = 0;
+  for (a = 1; a < 256; a++) {
+    for (c = 0; c < 256; c++) {
+      unsigned int value = (c * 255 + a / 2) / a;
+      unpremultiply_table[a][c] = (uint8_t)(value > 255 ? 255 : value);
+    }
+  }
+
+  unpremultiply_impl = unpremultiply_generic;
+  premultiply_impl = premultiply_generic;
+  convert_impl_name = "generic";
+
+#ifdef PYCAIRO_HAVE_SSE2
+  unpremultiply_impl = unpremultiply_sse2;
+  premultiply_impl = premultiply_sse2;
+  convert_impl_name = "sse2";
+#endif
+
+#ifdef PYCAIRO_HAVE_AVX2
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx2")) {
+    unpremultiply_impl = unpremultiply_avx2;
+    premultiply_impl = premultiply_avx2;
+    convert_impl_name = "avx2";
+  }
+#endif
+
+#ifdef PYCAIRO_HAVE_NEON
+  unpremultiply_impl = unpremultiply_neon;
+  premultiply_impl = premultiply_neon;
+  convert_impl_name = "neon";
+#endif
+
+  return 0;
+}
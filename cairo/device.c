@@ -28,9 +28,22 @@
 
 #define PY_SSIZE_T_CLEAN
 #include <Python.h>
+#include <math.h>
 
 #include "private.h"
 
+static const cairo_user_data_key_t device_output_sink_key;
+
+/* Writes out the output buffered for a stream device. Doesn't need the GIL,
+ * returns -1 if writing failed. */
+static int
+_device_flush_output (cairo_device_t *device) {
+    PycairoOutputSink *sink = cairo_device_get_user_data (
+        device, &device_output_sink_key);
+
+    return sink != NULL ? Pycairo_output_sink_flush (sink) : 0;
+}
+
 static void
 device_dealloc(PycairoDevice *obj) {
     if (obj->device) {
@@ -42,15 +55,35 @@ device_dealloc(PycairoDevice *obj) {
 
 static PyObject *
 device_finish (PycairoDevice *obj, PyObject *ignored) {
+    int output_err;
+
     cairo_device_finish (obj->device);
+    Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
+    output_err = _device_flush_output (obj->device);
+    PYCAIRO_PROBE_RETURN (NULL);
+    Py_END_ALLOW_THREADS;
+
     RETURN_NULL_IF_CAIRO_DEVICE_ERROR(obj->device);
+    if (output_err < 0)
+        RETURN_NULL_IF_CAIRO_ERROR (CAIRO_STATUS_WRITE_ERROR);
     Py_RETURN_NONE;
 }
 
 static PyObject *
 device_flush (PycairoDevice *obj, PyObject *ignored) {
+    int output_err;
+
     cairo_device_flush (obj->device);
+    Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
+    output_err = _device_flush_output (obj->device);
+    PYCAIRO_PROBE_RETURN (NULL);
+    Py_END_ALLOW_THREADS;
+
     RETURN_NULL_IF_CAIRO_DEVICE_ERROR(obj->device);
+    if (output_err < 0)
+        RETURN_NULL_IF_CAIRO_ERROR (CAIRO_STATUS_WRITE_ERROR);
     Py_RETURN_NONE;
 }
 
@@ -59,7 +92,9 @@ device_acquire (PycairoDevice *obj, PyObject *ignored) {
     cairo_status_t status;
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     status = cairo_device_acquire (obj->device);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
 
     RETURN_NULL_IF_CAIRO_ERROR (status);
@@ -80,9 +115,17 @@ device_ctx_enter (PyObject *obj, PyObject *ignored) {
 
 static PyObject *
 device_ctx_exit (PycairoDevice *obj, PyObject *args) {
+    int output_err;
+
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     cairo_device_finish (obj->device);
+    output_err = _device_flush_output (obj->device);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
+
+    if (output_err < 0)
+        RETURN_NULL_IF_CAIRO_ERROR (CAIRO_STATUS_WRITE_ERROR);
     Py_RETURN_NONE;
 }
 
@@ -168,55 +211,24 @@ PyTypeObject PycairoDevice_Type = {
 #ifdef CAIRO_HAS_SCRIPT_SURFACE
 #include <cairo-script.h>
 
-static const cairo_user_data_key_t device_base_object_key;
-
-static void
-_decref_destroy_func(void *user_data) {
-  PyGILState_STATE gstate = PyGILState_Ensure();
-  Py_DECREF(user_data);
-  PyGILState_Release(gstate);
-}
-
+/* Creates the wrapper for a device writing to a stream through sink, which
+ * gets freed with the device */
 static PyObject *
-_device_create_with_object(cairo_device_t *device, PyObject *base) {
-    PyObject *pydevice;
+_device_create_with_sink (cairo_device_t *device, PycairoOutputSink *sink) {
     cairo_status_t status;
 
-    pydevice = PycairoDevice_FromDevice(device);
-    if (pydevice == NULL)
+    status = cairo_device_status (device);
+    if (status == CAIRO_STATUS_SUCCESS)
+        status = cairo_device_set_user_data (
+            device, &device_output_sink_key, sink, Pycairo_output_sink_destroy);
+    if (status != CAIRO_STATUS_SUCCESS) {
+        cairo_device_destroy (device);
+        Pycairo_output_sink_destroy (sink);
+        Pycairo_Check_Status (status);
         return NULL;
-
-    if (base != NULL) {
-        status = cairo_device_set_user_data(
-            device, &device_base_object_key, base, _decref_destroy_func);
-        if (status != CAIRO_STATUS_SUCCESS)
-            Py_DECREF(pydevice);
-        RETURN_NULL_IF_CAIRO_ERROR(status);
-        Py_INCREF(base);
     }
 
-    return pydevice;
-}
-
-static cairo_status_t
-_write_func (void *closure, const unsigned char *data, unsigned int length) {
-    PyGILState_STATE gstate = PyGILState_Ensure();
-    PyObject *res = PyObject_CallMethod (
-        (PyObject *)closure, "write", "(y#)",
-        data, (Py_ssize_t)length);
-
-    if (res == NULL) {
-        PyErr_Clear();
-        /* an exception has occurred, it will be picked up later by
-         * Pycairo_Check_Status()
-         */
-        PyGILState_Release(gstate);
-        return CAIRO_STATUS_WRITE_ERROR;
-    }
-
-    Py_DECREF(res);
-    PyGILState_Release(gstate);
-    return CAIRO_STATUS_SUCCESS;
+    return PycairoDevice_FromDevice (device);
 }
 
 static PyObject *
@@ -224,6 +236,7 @@ script_device_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
     char *name = NULL;
     PyObject *file;
     cairo_device_t *device;
+    PycairoOutputSink *sink;
 
   if (!PyArg_ParseTuple (args, "O:ScriptDevice.__new__", &file))
     return NULL;
@@ -234,17 +247,25 @@ script_device_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
       return NULL;
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     device = cairo_script_create (name);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
     PyMem_Free (name);
     return PycairoDevice_FromDevice (device);
   } else {
     if (PyArg_ParseTuple (args, "O&:ScriptDevice.__new__",
                           Pycairo_writer_converter, &file)) {
+        sink = Pycairo_output_sink_new (file);
+        if (sink == NULL)
+            return NULL;
         Py_BEGIN_ALLOW_THREADS;
-        device = cairo_script_create_for_stream (_write_func, file);
+        PYCAIRO_PROBE_ENTRY (NULL);
+        device = cairo_script_create_for_stream (
+            Pycairo_output_sink_write, sink);
+        PYCAIRO_PROBE_RETURN (NULL);
         Py_END_ALLOW_THREADS;
-        return _device_create_with_object (device, file);
+        return _device_create_with_sink (device, sink);
     } else {
         PyErr_Clear ();
         PyErr_SetString (PyExc_TypeError,
@@ -272,7 +293,9 @@ script_device_set_mode (PycairoDevice *obj, PyObject *args) {
     mode = (cairo_script_mode_t)mode_arg;
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     cairo_script_set_mode (obj->device, mode);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
 
     RETURN_NULL_IF_CAIRO_DEVICE_ERROR (obj->device);
@@ -287,7 +310,9 @@ script_device_write_comment (PycairoDevice *obj, PyObject *args) {
         return NULL;
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     cairo_script_write_comment (obj->device, comment, -1);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
 
     RETURN_NULL_IF_CAIRO_DEVICE_ERROR(obj->device);
@@ -305,7 +330,9 @@ script_device_from_recording_surface (PycairoDevice *obj, PyObject *args) {
         return NULL;
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     status = cairo_script_from_recording_surface (obj->device, ((PycairoRecordingSurface*)pysurface)->surface);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
 
     RETURN_NULL_IF_CAIRO_ERROR(status);
@@ -401,3 +428,108 @@ PycairoDevice_FromDevice (cairo_device_t *device) {
     }
     return obj;
 }
+
+#ifdef PYCAIRO_HAS_SCRIPT_INTERPRETER
+#include <cairo-script-interpreter.h>
+
+typedef struct {
+    cairo_surface_t *target;
+    int have_target;  /* the first surface of the script got created */
+} PycairoScriptReplay;
+
+/* The first surface the script creates is drawn onto the replay target,
+ * later ones get a scratch surface similar to it */
+static cairo_surface_t *
+_script_replay_surface_create (void *closure, cairo_content_t content,
+                               double width, double height, long uid) {
+    PycairoScriptReplay *replay = closure;
+
+    if (!replay->have_target) {
+        replay->have_target = 1;
+        return cairo_surface_reference (replay->target);
+    }
+    return cairo_surface_create_similar (
+        replay->target, content, (int)ceil (width), (int)ceil (height));
+}
+
+/* Runs a cairo-script read from path, or from data if path is NULL.
+ * Doesn't need the GIL. */
+static cairo_status_t
+_script_replay_run (cairo_surface_t *target, const char *path,
+                    const char *data, int length) {
+    cairo_script_interpreter_hooks_t hooks = { 0 };
+    PycairoScriptReplay replay = { target, 0 };
+    cairo_script_interpreter_t *csi;
+    cairo_status_t status, finish_status;
+
+    hooks.closure = &replay;
+    hooks.surface_create = _script_replay_surface_create;
+
+    csi = cairo_script_interpreter_create ();
+    cairo_script_interpreter_install_hooks (csi, &hooks);
+    if (path != NULL)
+        status = cairo_script_interpreter_run (csi, path);
+    else
+        status = cairo_script_interpreter_feed_string (csi, data, length);
+    finish_status = cairo_script_interpreter_finish (csi);
+    cairo_script_interpreter_destroy (csi);
+
+    return status != CAIRO_STATUS_SUCCESS ? status : finish_status;
+}
+
+/* Replays script onto target. script is a path, an object supporting the
+ * buffer protocol holding the script, or a file object to read it from. */
+PyObject *
+script_replay (PyObject *script, PycairoSurface *target) {
+    cairo_status_t status;
+    Py_buffer view;
+    PyObject *data;
+    char *path;
+
+    if (!PyObject_CheckBuffer (script) && Pycairo_is_fspath (script)) {
+        if (!Pycairo_fspath_converter (script, &path))
+            return NULL;
+
+        Py_BEGIN_ALLOW_THREADS;
+        PYCAIRO_PROBE_ENTRY (target->surface);
+        status = _script_replay_run (target->surface, path, NULL, 0);
+        PYCAIRO_PROBE_RETURN (target->surface);
+        Py_END_ALLOW_THREADS;
+        PyMem_Free (path);
+    } else {
+        if (PyObject_CheckBuffer (script)) {
+            data = script;
+            Py_INCREF (data);
+        } else {
+            data = PyObject_CallMethod (script, "read", NULL);
+            if (data == NULL)
+                return NULL;
+        }
+
+        if (PyObject_GetBuffer (data, &view, PyBUF_SIMPLE) < 0) {
+            Py_DECREF (data);
+            return NULL;
+        }
+        if (view.len > INT_MAX) {
+            PyBuffer_Release (&view);
+            Py_DECREF (data);
+            PyErr_SetString (PyExc_OverflowError, "script is too large");
+            return NULL;
+        }
+
+        Py_BEGIN_ALLOW_THREADS;
+        PYCAIRO_PROBE_ENTRY (target->surface);
+        status = _script_replay_run (target->surface, NULL, view.buf,
+                                     (int)view.len);
+        PYCAIRO_PROBE_RETURN (target->surface);
+        Py_END_ALLOW_THREADS;
+        PyBuffer_Release (&view);
+        Py_DECREF (data);
+    }
+
+    if (status == CAIRO_STATUS_SUCCESS)
+        status = cairo_surface_status (target->surface);
+    RETURN_NULL_IF_CAIRO_ERROR (status);
+    Py_RETURN_NONE;
+}
+#endif /* PYCAIRO_HAS_SCRIPT_INTERPRETER */
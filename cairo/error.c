@@ -50,16 +50,17 @@ status_to_string(cairo_status_t status)
         return cairo_status_to_string(status);
 }
 
-/* Sets an exception based on a cairo_status_t */
+/* Sets an exception based on a cairo_status_t and a message */
 static void
-set_error (PyObject *error_type, cairo_status_t status)
+set_error_with_message (PyObject *error_type, cairo_status_t status,
+                        const char *message)
 {
     PyObject *args, *v, *int_enum;
 
     int_enum = CREATE_INT_ENUM(Status, status);
     if (int_enum == NULL)
         return;
-    args = Py_BuildValue("(sO)", status_to_string(status), int_enum);
+    args = Py_BuildValue("(sO)", message, int_enum);
     Py_DECREF (int_enum);
     v = PyObject_Call(error_type, args, NULL);
     Py_DECREF(args);
@@ -69,6 +70,27 @@ set_error (PyObject *error_type, cairo_status_t status)
     }
 }
 
+/* Sets an exception based on a cairo_status_t */
+static void
+set_error (PyObject *error_type, cairo_status_t status)
+{
+    set_error_with_message (error_type, status, status_to_string (status));
+}
+
+/* Raises cairo.MemoryError for allocations refused by pycairo itself */
+void
+Pycairo_Set_Memory_Error (const char *message)
+{
+    PyObject *suberror;
+
+    suberror = error_get_type_combined (
+        (PyObject *)&PycairoError_Type, PyExc_MemoryError, "cairo.MemoryError");
+    if (suberror == NULL)
+        return;
+    set_error_with_message (suberror, CAIRO_STATUS_NO_MEMORY, message);
+    Py_DECREF (suberror);
+}
+
 int
 Pycairo_Check_Status (cairo_status_t status) {
     PyObject *suberror;
@@ -332,7 +332,9 @@ scaled_font_text_extents (PycairoScaledFont *o, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_scaled_font_text_extents (o->scaled_font, utf8, &extents);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   PyMem_Free ((void *)utf8);
@@ -351,7 +353,9 @@ scaled_font_get_ctm (PycairoScaledFont *o, PyObject *ignored) {
   cairo_matrix_t matrix;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_scaled_font_get_ctm (o->scaled_font, &matrix);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   return PycairoMatrix_FromMatrix (&matrix);
@@ -362,7 +366,9 @@ scaled_font_get_font_matrix (PycairoScaledFont *o, PyObject *ignored) {
   cairo_matrix_t matrix;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_scaled_font_get_font_matrix (o->scaled_font, &matrix);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   return PycairoMatrix_FromMatrix (&matrix);
@@ -373,7 +379,9 @@ scaled_font_get_font_options (PycairoScaledFont *o, PyObject *ignored) {
   cairo_font_options_t *options = cairo_font_options_create();
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_scaled_font_get_font_options (o->scaled_font, options);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   return PycairoFontOptions_FromFontOptions (options);
@@ -405,6 +413,7 @@ scaled_font_text_to_glyphs (PycairoScaledFont *o, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   status = cairo_scaled_font_text_to_glyphs (
     o->scaled_font,
     x, y,
@@ -413,6 +422,7 @@ scaled_font_text_to_glyphs (PycairoScaledFont *o, PyObject *args) {
     (with_clusters) ? &clusters : NULL,
     (with_clusters) ? &num_clusters : NULL,
     (with_clusters) ? &cluster_flags : NULL);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   PyMem_Free ((void *)utf8);
@@ -497,9 +507,11 @@ scaled_font_glyph_extents (PycairoScaledFont *o, PyObject *args) {
   if (glyphs == NULL)
     return NULL;
 
-  Py_BEGIN_ALLOW_THREADS
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_scaled_font_glyph_extents (
     o->scaled_font, glyphs, num_glyphs, &extents);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   PyMem_Free (glyphs);
@@ -654,7 +666,9 @@ font_options_set_variations (PycairoFontOptions *o, PyObject *args) {
     }
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     cairo_font_options_set_variations (o->font_options, variations);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
 
     if (variations != NULL)
@@ -669,7 +683,9 @@ font_options_get_variations (PycairoFontOptions *o, PyObject *ignored) {
     const char *variations;
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     variations = cairo_font_options_get_variations (o->font_options);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
 
     if (variations == NULL)
@@ -837,7 +853,9 @@ font_options_copy (PycairoFontOptions *o, PyObject *ignored) {
   cairo_font_options_t *new;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   new = cairo_font_options_copy (o->font_options);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   return PycairoFontOptions_FromFontOptions (new);
@@ -848,7 +866,9 @@ font_options_hash (PycairoFontOptions *o, PyObject *ignored) {
   unsigned long hash;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   hash = cairo_font_options_hash (o->font_options);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   return PyLong_FromUnsignedLong (hash);
@@ -864,7 +884,9 @@ font_options_equal (PycairoFontOptions *o, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   result = cairo_font_options_equal (o->font_options, other->font_options);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   return PyBool_FromLong(result);
@@ -879,7 +901,9 @@ font_options_merge (PycairoFontOptions *o, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_font_options_merge (o->font_options, other->font_options);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   Py_RETURN_NONE;
@@ -935,8 +959,10 @@ font_options_tp_richcompare (PyObject *a, PyObject *b, int op) {
   other = (PycairoFontOptions *)b;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   is_equal = cairo_font_options_equal (((PycairoFontOptions *)a)->font_options,
                                        other->font_options);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   if (is_equal == (op == Py_EQ))
@@ -33,6 +33,12 @@
 
 #include "private.h"
 
+#if defined(MS_WINDOWS)
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
 /* Returns 1 if the object has the correct file type for a filesystem path.
  * Parsing it with Pycairo_fspath_converter() might still fail.
  */
@@ -176,3 +182,98 @@ Pycairo_richcompare (void* a, void *b, int op)
     Py_INCREF (res);
     return res;
 }
+
+/* Returns a monotonic timestamp in nanoseconds. Doesn't need the GIL, so it
+ * can be used to time code running in Py_BEGIN_ALLOW_THREADS sections.
+ */
+int64_t
+Pycairo_monotonic_ns (void) {
+#if defined(MS_WINDOWS)
+    static LARGE_INTEGER frequency;
+    LARGE_INTEGER counter;
+
+    if (frequency.QuadPart == 0)
+        QueryPerformanceFrequency (&frequency);
+    QueryPerformanceCounter (&counter);
+    return (int64_t)((double)counter.QuadPart * 1e9 /
+                     (double)frequency.QuadPart);
+#else
+    struct timespec ts;
+
+    clock_gettime (CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + (int64_t)ts.tv_nsec;
+#endif
+}
+
+/* Returns the number of CPUs as reported by os.cpu_count(), at least 1.
+ * Returns -1 and sets an exception on error.
+ */
+int
+Pycairo_cpu_count (void) {
+    PyObject *os, *res;
+    long count = 1;
+
+    os = PyImport_ImportModule ("os");
+    if (os == NULL)
+        return -1;
+    res = PyObject_CallMethod (os, "cpu_count", NULL);
+    Py_DECREF (os);
+    if (res == NULL)
+        return -1;
+    if (res != Py_None)
+        count = PyLong_AsLong (res);
+    Py_DECREF (res);
+    if (count == -1 && PyErr_Occurred ())
+        return -1;
+
+    return (int)Py_MAX (Py_MIN (count, INT_MAX), 1);
+}
+
+/* Gets a view of a C contiguous buffer of native doubles, as used for
+ * passing many coordinates at once. The number of items has to be a
+ * multiple of @group and the number of groups is stored in @n_groups.
+ * Returns -1 and sets an exception on error, otherwise the view has to be
+ * released with PyBuffer_Release().
+ */
+int
+Pycairo_get_double_buffer (PyObject *obj, const char *name, Py_ssize_t group,
+                           Py_buffer *view, Py_ssize_t *n_groups) {
+    const char *format;
+    Py_ssize_t n_items;
+
+    if (PyObject_GetBuffer (obj, view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0) {
+        PyErr_Format (PyExc_TypeError,
+                      "%s must be a contiguous buffer of doubles, not %.100s",
+                      name, Py_TYPE (obj)->tp_name);
+        return -1;
+    }
+
+    format = view->format != NULL ? view->format : "B";
+    if (*format == '@' || *format == '=' ||
+#if PY_LITTLE_ENDIAN
+        *format == '<'
+#else
+        *format == '>'
+#endif
+        )
+        format++;
+    if (strcmp (format, "d") != 0 || view->itemsize != sizeof (double)) {
+        PyErr_Format (PyExc_TypeError,
+                      "%s must be a buffer of doubles, not of format '%s'",
+                      name, view->format != NULL ? view->format : "B");
+        PyBuffer_Release (view);
+        return -1;
+    }
+
+    n_items = view->len / (Py_ssize_t)sizeof (double);
+    if (n_items % group != 0) {
+        PyErr_Format (PyExc_ValueError,
+                      "the length of %s must be a multiple of %zd", name,
+                      group);
+        PyBuffer_Release (view);
+        return -1;
+    }
+
+    *n_groups = n_items / group;
+    return 0;
+}
@@ -0,0 +1,296 @@
+/* -*- mode: C; c-basic-offset: 2 -*-
+ *
+ * Pycairo - Python bindings for cairo
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "private.h"
+
+#ifdef CAIRO_HAS_RECORDING_SURFACE
+
+/* Page queue for multi-page document surfaces (PDF, PS). Pages are recorded
+ * by Python and replayed into the document on a native thread, followed by a
+ * show_page(), so drawing the next page overlaps with emitting the previous
+ * one. The worker thread is started when the first page gets queued and
+ * exits once the queue runs empty; while running it holds a reference to the
+ * document surface, so pages queued before the surface gets dropped are still
+ * written out.
+ */
+
+typedef struct _PycairoPageNode {
+  cairo_surface_t *page;
+  struct _PycairoPageNode *next;
+} PycairoPageNode;
+
+struct _PycairoPageQueue {
+  cairo_surface_t *target;  /* owns the queue through its user data */
+  PyThread_type_lock mutex;
+  PyThread_type_lock producer;  /* serializes push and wait */
+  PyThread_type_lock producer_wakeup;  /* held unless a producer gets woken */
+  PycairoPageNode *head;
+  PycairoPageNode *tail;
+  int pending;  /* queued pages, plus the one being emitted */
+  int running;
+  int producer_waiting;
+  cairo_status_t status;  /* first error of the worker */
+};
+
+static const cairo_user_data_key_t page_queue_key;
+
+static void
+_page_queue_free (PycairoPageQueue *queue) {
+  if (queue->mutex != NULL)
+    PyThread_free_lock (queue->mutex);
+  if (queue->producer != NULL)
+    PyThread_free_lock (queue->producer);
+  if (queue->producer_wakeup != NULL) {
+    PyThread_release_lock (queue->producer_wakeup);
+    PyThread_free_lock (queue->producer_wakeup);
+  }
+  PyMem_RawFree (queue);
+}
+
+static void
+_page_queue_destroy_func (void *user_data) {
+  /* The worker holds a reference to the target while pages are queued, so
+   * the queue is empty here */
+  _page_queue_free ((PycairoPageQueue *)user_data);
+}
+
+/* Returns a new recording surface with a copy of the recorded commands of
+ * page, so Python can keep using it. Doesn't need the GIL. */
+cairo_surface_t *
+Pycairo_recording_surface_copy (cairo_surface_t *page,
+                                cairo_status_t *status) {
+  cairo_rectangle_t extents;
+  cairo_surface_t *copy;
+  cairo_t *cr;
+
+  if (cairo_recording_surface_get_extents (page, &extents))
+    copy = cairo_recording_surface_create (
+      cairo_surface_get_content (page), &extents);
+  else
+    copy = cairo_recording_surface_create (
+      cairo_surface_get_content (page), NULL);
+
+  cr = cairo_create (copy);
+  cairo_set_source_surface (cr, page, 0, 0);
+  cairo_paint (cr);
+  *status = cairo_status (cr);
+  cairo_destroy (cr);
+
+  if (*status != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy (copy);
+    return NULL;
+  }
+  return copy;
+}
+
+static cairo_status_t
+_page_queue_emit (cairo_surface_t *target, cairo_surface_t *page) {
+  cairo_status_t status;
+  cairo_t *cr;
+
+  PYCAIRO_PROBE_ENTRY (target);
+  cr = cairo_create (target);
+  cairo_set_source_surface (cr, page, 0, 0);
+  cairo_paint (cr);
+  cairo_show_page (cr);
+  status = cairo_status (cr);
+  cairo_destroy (cr);
+  PYCAIRO_PROBE_RETURN (target);
+
+  return status;
+}
+
+/* Needs the mutex */
+static void
+_page_queue_wake_producer (PycairoPageQueue *queue) {
+  if (queue->producer_waiting) {
+    queue->producer_waiting = 0;
+    PyThread_release_lock (queue->producer_wakeup);
+  }
+}
+
+/* Needs the mutex and the producer lock, waits until at most limit pages are
+ * pending */
+static void
+_page_queue_wait_for (PycairoPageQueue *queue, int limit) {
+  while (queue->pending > limit) {
+    queue->producer_waiting = 1;
+    PyThread_release_lock (queue->mutex);
+    PyThread_acquire_lock (queue->producer_wakeup, WAIT_LOCK);
+    PyThread_acquire_lock (queue->mutex, WAIT_LOCK);
+  }
+}
+
+static void
+_page_queue_worker (void *user_data) {
+  PycairoPageQueue *queue = user_data;
+  cairo_surface_t *target = queue->target;
+  PycairoPageNode *node;
+  cairo_status_t status;
+
+  PyThread_acquire_lock (queue->mutex, WAIT_LOCK);
+  while ((node = queue->head) != NULL) {
+    queue->head = node->next;
+    if (queue->head == NULL)
+      queue->tail = NULL;
+    PyThread_release_lock (queue->mutex);
+
+    status = _page_queue_emit (target, node->page);
+    cairo_surface_destroy (node->page);
+    PyMem_RawFree (node);
+
+    PyThread_acquire_lock (queue->mutex, WAIT_LOCK);
+    if (queue->status == CAIRO_STATUS_SUCCESS)
+      queue->status = status;
+    queue->pending--;
+    _page_queue_wake_producer (queue);
+  }
+  queue->running = 0;
+  PyThread_release_lock (queue->mutex);
+
+  /* Might finish the document and free the queue */
+  cairo_surface_destroy (target);
+}
+
+/* Returns the page queue of target, creating it if create is set. Needs the
+ * GIL, returns NULL with an exception set if creating failed. */
+PycairoPageQueue *
+Pycairo_page_queue_get (cairo_surface_t *target, int create) {
+  PycairoPageQueue *queue;
+  cairo_status_t status;
+
+  queue = cairo_surface_get_user_data (target, &page_queue_key);
+  if (queue != NULL || !create)
+    return queue;
+
+  queue = PyMem_RawCalloc (1, sizeof (PycairoPageQueue));
+  if (queue == NULL) {
+    PyErr_NoMemory ();
+    return NULL;
+  }
+  queue->target = target;
+  queue->mutex = PyThread_allocate_lock ();
+  queue->producer = PyThread_allocate_lock ();
+  queue->producer_wakeup = PyThread_allocate_lock ();
+  if (queue->producer_wakeup != NULL)
+    PyThread_acquire_lock (queue->producer_wakeup, WAIT_LOCK);
+  if (queue->mutex == NULL || queue->producer == NULL ||
+      queue->producer_wakeup == NULL) {
+    _page_queue_free (queue);
+    PyErr_NoMemory ();
+    return NULL;
+  }
+
+  status = cairo_surface_set_user_data (
+    target, &page_queue_key, queue, _page_queue_destroy_func);
+  if (status != CAIRO_STATUS_SUCCESS) {
+    _page_queue_free (queue);
+    Pycairo_Check_Status (status);
+    return NULL;
+  }
+
+  return queue;
+}
+
+/* Queues a copy of the recording surface page to be emitted as the next
+ * page, after waiting until less than max_pending pages are pending.
+ * Doesn't need the GIL. */
+cairo_status_t
+Pycairo_page_queue_push (PycairoPageQueue *queue, cairo_surface_t *page,
+                         int max_pending) {
+  PycairoPageNode *node;
+  cairo_status_t status;
+
+  node = PyMem_RawMalloc (sizeof (PycairoPageNode));
+  if (node == NULL)
+    return CAIRO_STATUS_NO_MEMORY;
+  node->next = NULL;
+  node->page = Pycairo_recording_surface_copy (page, &status);
+  if (node->page == NULL) {
+    PyMem_RawFree (node);
+    return status;
+  }
+
+  PyThread_acquire_lock (queue->producer, WAIT_LOCK);
+  PyThread_acquire_lock (queue->mutex, WAIT_LOCK);
+  _page_queue_wait_for (queue, max_pending - 1);
+
+  status = queue->status;
+  if (status == CAIRO_STATUS_SUCCESS) {
+    if (queue->tail != NULL)
+      queue->tail->next = node;
+    else
+      queue->head = node;
+    queue->tail = node;
+    queue->pending++;
+
+    if (!queue->running) {
+      cairo_surface_reference (queue->target);
+      queue->running = 1;
+      if (PyThread_start_new_thread (_page_queue_worker, queue) ==
+          PYTHREAD_INVALID_THREAD_ID) {
+        cairo_surface_destroy (queue->target);
+        queue->running = 0;
+        queue->head = queue->tail = NULL;
+        queue->pending--;
+        status = CAIRO_STATUS_NO_MEMORY;
+      }
+    }
+  }
+
+  PyThread_release_lock (queue->mutex);
+  PyThread_release_lock (queue->producer);
+
+  if (status != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy (node->page);
+    PyMem_RawFree (node);
+  }
+  return status;
+}
+
+/* Waits until all queued pages are emitted and returns the first error of
+ * the worker since the last call. Doesn't need the GIL. */
+cairo_status_t
+Pycairo_page_queue_wait (PycairoPageQueue *queue) {
+  cairo_status_t status;
+
+  PyThread_acquire_lock (queue->producer, WAIT_LOCK);
+  PyThread_acquire_lock (queue->mutex, WAIT_LOCK);
+  _page_queue_wait_for (queue, 0);
+  status = queue->status;
+  queue->status = CAIRO_STATUS_SUCCESS;
+  PyThread_release_lock (queue->mutex);
+  PyThread_release_lock (queue->producer);
+
+  return status;
+}
+
+#endif /* CAIRO_HAS_RECORDING_SURFACE */
@@ -0,0 +1,164 @@
+/* -*- mode: C; c-basic-offset: 2 -*-
+ *
+ * Pycairo - Python bindings for cairo
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "private.h"
+
+/* Runs independent work items on native threads. The items are handed out
+ * one at a time, so uneven items still balance across the threads; the
+ * calling thread takes part as well and returns once all items are done.
+ * Each thread gets a worker number, so callers can prepare per-thread state
+ * up front: the calling thread is worker 0, the others count up from 1.
+ */
+
+typedef struct {
+  PycairoParallelFunc func;
+  void *data;
+  int end;
+  int stop_on_error;
+  PyThread_type_lock mutex;
+  PyThread_type_lock done;  /* held until the last worker exits */
+  int next;  /* next item to hand out */
+  int next_worker;  /* number of the next started worker */
+  int workers;  /* running worker threads */
+  int waiting;  /* the caller waits for the workers */
+  cairo_status_t status;  /* first error */
+} PycairoParallelJob;
+
+/* Runs items until none are left, or until an error occurred if
+ * stop_on_error is set */
+static void
+_parallel_job_run (PycairoParallelJob *job, int worker) {
+  cairo_status_t status;
+  int index;
+
+  for (;;) {
+    PyThread_acquire_lock (job->mutex, WAIT_LOCK);
+    index = job->next;
+    if (index >= job->end ||
+        (job->stop_on_error && job->status != CAIRO_STATUS_SUCCESS)) {
+      PyThread_release_lock (job->mutex);
+      return;
+    }
+    job->next++;
+    PyThread_release_lock (job->mutex);
+
+    status = job->func (job->data, worker, index);
+    if (status != CAIRO_STATUS_SUCCESS) {
+      PyThread_acquire_lock (job->mutex, WAIT_LOCK);
+      if (job->status == CAIRO_STATUS_SUCCESS)
+        job->status = status;
+      PyThread_release_lock (job->mutex);
+    }
+  }
+}
+
+static void
+_parallel_worker (void *user_data) {
+  PycairoParallelJob *job = user_data;
+  PyThread_type_lock done = job->done;
+  int worker, wake;
+
+  PyThread_acquire_lock (job->mutex, WAIT_LOCK);
+  worker = job->next_worker++;
+  PyThread_release_lock (job->mutex);
+
+  _parallel_job_run (job, worker);
+
+  PyThread_acquire_lock (job->mutex, WAIT_LOCK);
+  job->workers--;
+  wake = job->workers == 0 && job->waiting;
+  PyThread_release_lock (job->mutex);
+
+  /* The job lives on the stack of the caller, which returns once woken */
+  if (wake)
+    PyThread_release_lock (done);
+}
+
+/* Calls func (data, worker, index) for each index in [start, end) using up
+ * to threads threads, including the calling one. worker is the number of
+ * the calling thread, in [0, threads). Returns the first error
+ * returned by func. Doesn't need the GIL. Starting fewer threads than
+ * requested isn't an error, the remaining items just get run by the
+ * threads that are running. */
+cairo_status_t
+Pycairo_parallel_for (int start, int end, int threads, int stop_on_error,
+                      PycairoParallelFunc func, void *data) {
+  PycairoParallelJob job = {0};
+  int i;
+
+  if (start >= end)
+    return CAIRO_STATUS_SUCCESS;
+
+  job.func = func;
+  job.data = data;
+  job.end = end;
+  job.next = start;
+  job.next_worker = 1;
+  job.stop_on_error = stop_on_error;
+  job.mutex = PyThread_allocate_lock ();
+  job.done = PyThread_allocate_lock ();
+  if (job.mutex == NULL || job.done == NULL) {
+    job.status = CAIRO_STATUS_NO_MEMORY;
+    goto out;
+  }
+  PyThread_acquire_lock (job.done, WAIT_LOCK);
+
+  threads = Py_MIN (threads, end - start);
+  for (i = 1; i < threads; i++) {
+    PyThread_acquire_lock (job.mutex, WAIT_LOCK);
+    job.workers++;
+    PyThread_release_lock (job.mutex);
+    if (PyThread_start_new_thread (_parallel_worker, &job) ==
+        PYTHREAD_INVALID_THREAD_ID) {
+      PyThread_acquire_lock (job.mutex, WAIT_LOCK);
+      job.workers--;
+      PyThread_release_lock (job.mutex);
+      break;
+    }
+  }
+
+  _parallel_job_run (&job, 0);
+
+  PyThread_acquire_lock (job.mutex, WAIT_LOCK);
+  job.waiting = job.workers > 0;
+  PyThread_release_lock (job.mutex);
+  if (job.waiting)
+    PyThread_acquire_lock (job.done, WAIT_LOCK);
+
+  PyThread_release_lock (job.done);
+out:
+  if (job.mutex != NULL)
+    PyThread_free_lock (job.mutex);
+  if (job.done != NULL)
+    PyThread_free_lock (job.done);
+
+  return job.status;
+}
@@ -144,7 +144,9 @@ pattern_get_filter (PycairoPattern *o, PyObject *ignored) {
   cairo_filter_t filter;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   filter = cairo_pattern_get_filter (o->pattern);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_INT_ENUM (Filter, filter);
@@ -161,7 +163,9 @@ pattern_set_filter (PycairoPattern *o, PyObject *args) {
   filter = (cairo_filter_t)filter_arg;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_pattern_set_filter (o->pattern, filter);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   Py_RETURN_NONE;
@@ -173,7 +177,9 @@ pattern_get_dither (PycairoPattern *o, PyObject *ignored) {
   cairo_dither_t dither;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   dither = cairo_pattern_get_dither (o->pattern);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_INT_ENUM (Dither, dither);
@@ -190,7 +196,9 @@ pattern_set_dither (PycairoPattern *o, PyObject *args) {
   dither = (cairo_dither_t)dither_arg;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_pattern_set_dither (o->pattern, dither);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   Py_RETURN_NONE;
@@ -695,7 +703,9 @@ mesh_pattern_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
 static PyObject *
 mesh_pattern_begin_patch (PycairoMeshPattern *obj, PyObject *ignored) {
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_mesh_pattern_begin_patch (obj->pattern);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_PATTERN_ERROR (obj->pattern);
@@ -706,7 +716,9 @@ mesh_pattern_begin_patch (PycairoMeshPattern *obj, PyObject *ignored) {
 static PyObject *
 mesh_pattern_end_patch (PycairoMeshPattern *obj, PyObject *ignored) {
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_mesh_pattern_end_patch (obj->pattern);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_PATTERN_ERROR (obj->pattern);
@@ -723,7 +735,9 @@ mesh_pattern_curve_to (PycairoMeshPattern *obj, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_mesh_pattern_curve_to (obj->pattern, x1, y1, x2, y2, x3, y3);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_PATTERN_ERROR (obj->pattern);
@@ -742,8 +756,10 @@ mesh_pattern_get_control_point (PycairoMeshPattern *obj, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   status = cairo_mesh_pattern_get_control_point (
     obj->pattern, patch_num, point_num, &x, &y);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_ERROR (status);
@@ -762,8 +778,10 @@ mesh_pattern_get_corner_color_rgba (PycairoMeshPattern *obj, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   status = cairo_mesh_pattern_get_corner_color_rgba (
     obj->pattern, patch_num, corner_num, &red, &green, &blue, &alpha);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_ERROR (status);
@@ -777,7 +795,9 @@ mesh_pattern_get_patch_count (PycairoMeshPattern *obj, PyObject *ignored) {
   cairo_status_t status;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   status = cairo_mesh_pattern_get_patch_count (obj->pattern, &count);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_ERROR (status);
@@ -794,7 +814,9 @@ mesh_pattern_get_path (PycairoMeshPattern *obj, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   path = cairo_mesh_pattern_get_path (obj->pattern, patch_num);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   return PycairoPath_FromPath (path);
@@ -808,7 +830,9 @@ mesh_pattern_line_to (PycairoMeshPattern *obj, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_mesh_pattern_line_to (obj->pattern, x, y);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_PATTERN_ERROR (obj->pattern);
@@ -824,7 +848,9 @@ mesh_pattern_move_to (PycairoMeshPattern *obj, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_mesh_pattern_move_to (obj->pattern, x, y);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_PATTERN_ERROR (obj->pattern);
@@ -842,7 +868,9 @@ mesh_pattern_set_control_point (PycairoMeshPattern *obj, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_mesh_pattern_set_control_point (obj->pattern, point_num, x, y);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_PATTERN_ERROR (obj->pattern);
@@ -860,8 +888,10 @@ mesh_pattern_set_corner_color_rgb (PycairoMeshPattern *obj, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_mesh_pattern_set_corner_color_rgb (
     obj->pattern, corner_num, red, green, blue);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_PATTERN_ERROR (obj->pattern);
@@ -879,8 +909,10 @@ mesh_pattern_set_corner_color_rgba (PycairoMeshPattern *obj, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_mesh_pattern_set_corner_color_rgba (
     obj->pattern, corner_num, red, green, blue, alpha);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_PATTERN_ERROR (obj->pattern);
@@ -1178,8 +1210,10 @@ raster_source_pattern_set_acquire (PycairoRasterSourcePattern *obj,
   cairo_raster_source_pattern_set_callback_data (pattern, pattern);
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_raster_source_pattern_set_acquire (
     pattern, acquire_func, release_func);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   Py_RETURN_NONE;
@@ -0,0 +1,283 @@
+/* -*- mode: C; c-basic-offset: 2 -*-
+ *
+ * Pycairo - Python bindings for cairo
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include "private.h"
+
+/* A pick buffer is an RGB24 image surface where every pixel holds the ID of
+ * the feature drawn last at that position, see Context.set_pick_buffer().
+ * Contexts mirror their fills and strokes into it with antialiasing off, so
+ * the colors are exact IDs. The buffer can be shared by contexts used from
+ * different threads and gets drawn to without the GIL, so drawing is
+ * serialized with a lock.
+ */
+
+typedef struct {
+  PyObject_HEAD
+  cairo_surface_t *surface;
+  cairo_t *ctx;
+  PyThread_type_lock lock;
+} PycairoPickBuffer;
+
+#define PICK_ID_MASK 0xffffff
+
+static PyObject *
+pick_buffer_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
+  static char *kwlist[] = {"width", "height", NULL};
+  PycairoPickBuffer *self;
+  cairo_surface_t *surface;
+  cairo_t *ctx;
+  int width, height;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "ii:PickBuffer.__new__",
+                                    kwlist, &width, &height))
+    return NULL;
+
+  surface = cairo_image_surface_create (CAIRO_FORMAT_RGB24, width, height);
+  if (Pycairo_Check_Status (cairo_surface_status (surface))) {
+    cairo_surface_destroy (surface);
+    return NULL;
+  }
+
+  ctx = cairo_create (surface);
+  cairo_set_antialias (ctx, CAIRO_ANTIALIAS_NONE);
+  cairo_set_operator (ctx, CAIRO_OPERATOR_SOURCE);
+
+  self = (PycairoPickBuffer *)type->tp_alloc (type, 0);
+  if (self == NULL) {
+    cairo_destroy (ctx);
+    cairo_surface_destroy (surface);
+    return NULL;
+  }
+  self->surface = surface;
+  self->ctx = ctx;
+
+  self->lock = PyThread_allocate_lock ();
+  if (self->lock == NULL) {
+    Py_DECREF (self);
+    return PyErr_NoMemory ();
+  }
+
+  return (PyObject *)self;
+}
+
+static void
+pick_buffer_dealloc (PycairoPickBuffer *self) {
+  if (self->ctx != NULL)
+    cairo_destroy (self->ctx);
+  if (self->surface != NULL)
+    cairo_surface_destroy (self->surface);
+  if (self->lock != NULL)
+    PyThread_free_lock (self->lock);
+  Py_TYPE (self)->tp_free (self);
+}
+
+/* Copies the stroke parameters of src to dst */
+static void
+_pick_copy_stroke_style (cairo_t *src, cairo_t *dst) {
+  int n_dashes;
+
+  cairo_set_line_width (dst, cairo_get_line_width (src));
+  cairo_set_line_cap (dst, cairo_get_line_cap (src));
+  cairo_set_line_join (dst, cairo_get_line_join (src));
+  cairo_set_miter_limit (dst, cairo_get_miter_limit (src));
+
+  n_dashes = cairo_get_dash_count (src);
+  if (n_dashes > 0) {
+    double *dashes = PyMem_RawMalloc ((size_t)n_dashes * sizeof (double));
+    double offset;
+
+    if (dashes != NULL) {
+      cairo_get_dash (src, dashes, &offset);
+      cairo_set_dash (dst, dashes, n_dashes, offset);
+      PyMem_RawFree (dashes);
+    }
+  }
+}
+
+/* Draws the current path of src with the given ID into the pick buffer,
+ * like the following fill() or stroke() on src would. Rectangular clips of
+ * src are applied as well. Doesn't need the GIL. */
+void
+Pycairo_pick_buffer_render (PyObject *obj, cairo_t *src, int stroke,
+                            uint32_t id) {
+  PycairoPickBuffer *pick = (PycairoPickBuffer *)obj;
+  cairo_t *ctx = pick->ctx;
+  cairo_rectangle_list_t *clip;
+  cairo_matrix_t matrix;
+  cairo_path_t *path;
+  int i;
+
+  clip = cairo_copy_clip_rectangle_list (src);
+  if (clip->status == CAIRO_STATUS_SUCCESS && clip->num_rectangles == 0) {
+    /* everything is clipped */
+    cairo_rectangle_list_destroy (clip);
+    return;
+  }
+  path = cairo_copy_path (src);
+  cairo_get_matrix (src, &matrix);
+
+  PyThread_acquire_lock (pick->lock, WAIT_LOCK);
+  cairo_save (ctx);
+  cairo_set_matrix (ctx, &matrix);
+
+  if (clip->status == CAIRO_STATUS_SUCCESS) {
+    for (i = 0; i < clip->num_rectangles; i++) {
+      cairo_rectangle_t *r = &clip->rectangles[i];
+      cairo_rectangle (ctx, r->x, r->y, r->width, r->height);
+    }
+    cairo_clip (ctx);
+  }
+
+  cairo_append_path (ctx, path);
+  cairo_set_tolerance (ctx, cairo_get_tolerance (src));
+  cairo_set_source_rgb (ctx, ((id >> 16) & 0xff) / 255.0,
+                        ((id >> 8) & 0xff) / 255.0, (id & 0xff) / 255.0);
+
+  if (stroke) {
+    _pick_copy_stroke_style (src, ctx);
+    cairo_stroke (ctx);
+  } else {
+    cairo_set_fill_rule (ctx, cairo_get_fill_rule (src));
+    cairo_fill (ctx);
+  }
+
+  cairo_restore (ctx);
+  PyThread_release_lock (pick->lock);
+
+  cairo_path_destroy (path);
+  cairo_rectangle_list_destroy (clip);
+}
+
+/* Makes the pick buffer use the same device transformation as target, so
+ * the pixels of both line up */
+void
+Pycairo_pick_buffer_match_target (PyObject *obj, cairo_surface_t *target) {
+  PycairoPickBuffer *pick = (PycairoPickBuffer *)obj;
+  double x, y;
+
+  cairo_surface_get_device_scale (target, &x, &y);
+  cairo_surface_set_device_scale (pick->surface, x, y);
+  cairo_surface_get_device_offset (target, &x, &y);
+  cairo_surface_set_device_offset (pick->surface, x, y);
+}
+
+static PyObject *
+pick_buffer_clear (PycairoPickBuffer *self, PyObject *ignored) {
+  Py_BEGIN_ALLOW_THREADS;
+  PyThread_acquire_lock (self->lock, WAIT_LOCK);
+  PYCAIRO_PROBE_ENTRY (self->surface);
+  cairo_save (self->ctx);
+  cairo_set_operator (self->ctx, CAIRO_OPERATOR_CLEAR);
+  cairo_paint (self->ctx);
+  cairo_restore (self->ctx);
+  PYCAIRO_PROBE_RETURN (self->surface);
+  PyThread_release_lock (self->lock);
+  Py_END_ALLOW_THREADS;
+
+  RETURN_NULL_IF_CAIRO_CONTEXT_ERROR (self->ctx);
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+pick_buffer_get_surface (PycairoPickBuffer *self, PyObject *ignored) {
+  return PycairoSurface_FromSurface (
+    cairo_surface_reference (self->surface), NULL);
+}
+
+static PyObject *
+pick_buffer_lookup (PycairoPickBuffer *self, PyObject *args) {
+  int x, y, width, height, stride;
+  unsigned char *data;
+  uint32_t pixel = 0;
+
+  if (!PyArg_ParseTuple (args, "ii:PickBuffer.lookup", &x, &y))
+    return NULL;
+
+  PyThread_acquire_lock (self->lock, WAIT_LOCK);
+  cairo_surface_flush (self->surface);
+  data = cairo_image_surface_get_data (self->surface);
+  width = cairo_image_surface_get_width (self->surface);
+  height = cairo_image_surface_get_height (self->surface);
+  stride = cairo_image_surface_get_stride (self->surface);
+  if (data != NULL && x >= 0 && y >= 0 && x < width && y < height)
+    pixel = *(uint32_t *)(data + (size_t)y * (size_t)stride + (size_t)x * 4);
+  PyThread_release_lock (self->lock);
+
+  return PyLong_FromUnsignedLong (pixel & PICK_ID_MASK);
+}
+
+static PyMethodDef pick_buffer_methods[] = {
+  {"clear",       (PyCFunction)pick_buffer_clear,       METH_NOARGS},
+  {"get_surface", (PyCFunction)pick_buffer_get_surface, METH_NOARGS},
+  {"lookup",      (PyCFunction)pick_buffer_lookup,      METH_VARARGS},
+  {NULL, NULL, 0, NULL},
+};
+
+PyTypeObject PycairoPickBuffer_Type = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "cairo.PickBuffer",                   /* tp_name */
+  sizeof(PycairoPickBuffer),            /* tp_basicsize */
+  0,                                    /* tp_itemsize */
+  (destructor)pick_buffer_dealloc,      /* tp_dealloc */
+  0,                                    /* tp_print */
+  0,                                    /* tp_getattr */
+  0,                                    /* tp_setattr */
+  0,                                    /* tp_compare */
+  0,                                    /* tp_repr */
+  0,                                    /* tp_as_number */
+  0,                                    /* tp_as_sequence */
+  0,                                    /* tp_as_mapping */
+  (hashfunc)PyObject_HashNotImplemented,/* tp_hash */
+  0,                                    /* tp_call */
+  0,                                    /* tp_str */
+  0,                                    /* tp_getattro */
+  0,                                    /* tp_setattro */
+  0,                                    /* tp_as_buffer */
+  Py_TPFLAGS_DEFAULT,                   /* tp_flags */
+  0,                                    /* tp_doc */
+  0,                                    /* tp_traverse */
+  0,                                    /* tp_clear */
+  0,                                    /* tp_richcompare */
+  0,                                    /* tp_weaklistoffset */
+  0,                                    /* tp_iter */
+  0,                                    /* tp_iternext */
+  pick_buffer_methods,                  /* tp_methods */
+  0,                                    /* tp_members */
+  0,                                    /* tp_getset */
+  0,                                    /* tp_base */
+  0,                                    /* tp_dict */
+  0,                                    /* tp_descr_get */
+  0,                                    /* tp_descr_set */
+  0,                                    /* tp_dictoffset */
+  0,                                    /* tp_init */
+  0,                                    /* tp_alloc */
+  (newfunc)pick_buffer_new,             /* tp_new */
+};
@@ -53,6 +53,57 @@ int Pycairo_fspath_none_converter (PyObject *obj, char** result);
 int Pycairo_writer_converter (PyObject *obj, PyObject** file);
 int Pycairo_reader_converter (PyObject *obj, PyObject** file);
 int Pycairo_is_fspath (PyObject *obj);
+int64_t Pycairo_monotonic_ns (void);
+int Pycairo_cpu_count (void);
+
+typedef cairo_status_t (*PycairoParallelFunc) (void *data, int worker,
+                                              int index);
+cairo_status_t Pycairo_parallel_for (int start, int end, int threads,
+                                     int stop_on_error,
+                                     PycairoParallelFunc func, void *data);
+int Pycairo_get_double_buffer (PyObject *obj, const char *name,
+                               Py_ssize_t group, Py_buffer *view,
+                               Py_ssize_t *n_groups);
+
+cairo_status_t Pycairo_image_surface_tag_content (cairo_surface_t *image,
+                                                  int force);
+int Pycairo_surface_get_deduplicate_images (cairo_surface_t *surface);
+int Pycairo_surface_wait_pages (cairo_surface_t *surface);
+
+#ifdef PYCAIRO_HAS_SCRIPT_INTERPRETER
+PyObject *script_replay (PyObject *script, PycairoSurface *target);
+#endif
+
+#ifdef CAIRO_HAS_PNG_FUNCTIONS
+PyObject *surface_write_pngs (PyObject *items, int threads);
+#endif
+
+typedef struct _PycairoOutputSink PycairoOutputSink;
+int init_output_sink (void);
+PycairoOutputSink *Pycairo_output_sink_new (PyObject *file);
+cairo_status_t Pycairo_output_sink_write (void *closure,
+                                          const unsigned char *data,
+                                          unsigned int length);
+int Pycairo_output_sink_flush (PycairoOutputSink *sink);
+void Pycairo_output_sink_destroy (void *sink);
+PyObject *output_stats_get_total (void);
+void output_stats_reset_total (void);
+
+typedef struct _PycairoAsyncJob PycairoAsyncJob;
+struct _PycairoAsyncJob {
+  /* Does the blocking work, without the GIL */
+  void (*run) (PycairoAsyncJob *job);
+  /* With the GIL, returns the result or NULL with an exception set */
+  PyObject *(*complete) (PycairoAsyncJob *job);
+  /* With the GIL, calls Pycairo_async_job_clear() and frees the job */
+  void (*destroy) (PycairoAsyncJob *job);
+  PyObject *loop;
+  PyObject *future;
+  PycairoAsyncJob *next;
+};
+int init_async (void);
+PyObject *Pycairo_async_submit (PycairoAsyncJob *job);
+void Pycairo_async_job_clear (PycairoAsyncJob *job);
 
 cairo_glyph_t * _PycairoGlyphs_AsGlyphs (PyObject *py_object, int *num_glyphs);
 int _PyGlyph_AsGlyph (PyObject *pyobj, cairo_glyph_t *glyph);
@@ -64,6 +115,15 @@ PyObject* Pycairo_richcompare (void* a, void *b, int op);
 extern PyTypeObject PycairoContext_Type;
 PyObject *PycairoContext_FromContext (cairo_t *ctx, PyTypeObject *type,
 				      PyObject *base);
+int init_context_stats (void);
+PyObject *context_stats_get_total (void);
+void context_stats_reset_total (void);
+
+extern PyTypeObject PycairoPickBuffer_Type;
+void Pycairo_pick_buffer_render (PyObject *obj, cairo_t *src, int stroke,
+                                 uint32_t id);
+void Pycairo_pick_buffer_match_target (PyObject *obj,
+                                       cairo_surface_t *target);
 
 extern PyTypeObject PycairoFontFace_Type;
 extern PyTypeObject PycairoToyFontFace_Type;
@@ -113,6 +173,7 @@ PyObject *PycairoScaledFont_FromScaledFont (cairo_scaled_font_t *scaled_font);
 extern PyTypeObject PycairoSurface_Type;
 extern PyTypeObject PycairoImageSurface_Type;
 extern PyTypeObject PycairoMappedImageSurface_Type;
+extern PyTypeObject PycairoSurfacePool_Type;
 
 extern PyTypeObject PycairoGlyph_Type;
 typedef PyTupleObject PycairGlyph;
@@ -146,6 +207,22 @@ extern PyTypeObject PycairoPSSurface_Type;
 
 #ifdef CAIRO_HAS_RECORDING_SURFACE
 extern PyTypeObject PycairoRecordingSurface_Type;
+
+typedef struct _PycairoPageQueue PycairoPageQueue;
+PycairoPageQueue *Pycairo_page_queue_get (cairo_surface_t *target,
+                                          int create);
+cairo_status_t Pycairo_page_queue_push (PycairoPageQueue *queue,
+                                        cairo_surface_t *page,
+                                        int max_pending);
+cairo_status_t Pycairo_page_queue_wait (PycairoPageQueue *queue);
+cairo_surface_t *Pycairo_recording_surface_copy (cairo_surface_t *page,
+                                                 cairo_status_t *status);
+
+#ifdef CAIRO_HAS_IMAGE_SURFACE
+cairo_status_t Pycairo_render_tiles (cairo_surface_t *recording,
+                                     cairo_surface_t *target,
+                                     int tile_size, int threads);
+#endif
 #endif
 
 #ifdef CAIRO_HAS_SVG_SURFACE
@@ -173,7 +250,16 @@ extern PyTypeObject PycairoTeeSurface_Type;
 PyObject *PycairoSurface_FromSurface (cairo_surface_t *surface,
                                       PyObject *base);
 
+/* tracemalloc domain used for the pixel memory of image surfaces */
+#define PYCAIRO_TRACEMALLOC_DOMAIN 0x63616972u
+
+int init_memory_stats (void);
+PyObject *surface_get_memory_stats (void);
+void surface_set_image_memory_limit (Py_ssize_t limit, double timeout);
+PyObject *surface_get_image_memory_limit (void);
+
 int Pycairo_Check_Status (cairo_status_t status);
+void Pycairo_Set_Memory_Error (const char *message);
 
 /* error checking macros */
 #define RETURN_NULL_IF_CAIRO_ERROR(status)    \
@@ -252,8 +338,40 @@ PyObject *error_get_type(void);
 
 int init_buffer_proxy(void);
 
-PyObject *buffer_proxy_create_view(PyObject *exporter, void *buf,
-                                   Py_ssize_t len, int readonly);
+PyObject *buffer_proxy_create_view(PyObject *exporter);
+
+/* convert.c */
+
+typedef enum {
+  PYCAIRO_LAYOUT_RGBA,
+  PYCAIRO_LAYOUT_BGRA,
+  PYCAIRO_LAYOUT_ARGB,
+  PYCAIRO_LAYOUT_RGB,
+  PYCAIRO_LAYOUT_BGR,
+  PYCAIRO_LAYOUT_L,
+  /* pixels in the cairo format given by PycairoPixelLayout.format */
+  PYCAIRO_LAYOUT_FORMAT,
+} PycairoPixelLayoutType;
+
+typedef struct {
+  PycairoPixelLayoutType type;
+  cairo_format_t format;
+} PycairoPixelLayout;
+
+int init_convert (void);
+int Pycairo_pixel_layout_converter (PyObject *obj, PycairoPixelLayout *layout);
+int Pycairo_pixel_layout_bytes_per_pixel (PycairoPixelLayoutType type);
+Py_ssize_t Pycairo_pixel_layout_row_bytes (PycairoPixelLayout *layout,
+                                           int width);
+Py_ssize_t Pycairo_pixel_layout_default_stride (PycairoPixelLayout *layout,
+                                                int width);
+cairo_format_t Pycairo_pixel_layout_image_format (PycairoPixelLayout *layout);
+int Pycairo_convert_pixels (PycairoPixelLayout *src_layout,
+                            const unsigned char *src, Py_ssize_t src_stride,
+                            PycairoPixelLayout *dst_layout,
+                            unsigned char *dst, Py_ssize_t dst_stride,
+                            int width, int height);
+const char *Pycairo_convert_get_impl (void);
 
 /* int enums */
 
@@ -341,4 +459,27 @@ DECL_ENUM(Dither)
 
 #define PYCAIRO_Py_hash_t_FromVoidPtr(p) ((Py_hash_t)(Py_ssize_t)(p))
 
+/* Static probes placed around the cairo calls made without holding the GIL,
+ * enabled with the 'usdt' build option. Both probes pass the name of the C
+ * function making the call and the type of the surface involved, or -1. */
+#ifdef PYCAIRO_ENABLE_USDT
+#include <sys/sdt.h>
+
+static inline int
+_pycairo_probe_surface_type (cairo_surface_t *surface) {
+  return (surface != NULL) ? (int)cairo_surface_get_type (surface) : -1;
+}
+
+#define PYCAIRO_PROBE_ENTRY(surface) \
+  DTRACE_PROBE2 (pycairo, call__entry, __func__, \
+                 _pycairo_probe_surface_type (surface))
+
+#define PYCAIRO_PROBE_RETURN(surface) \
+  DTRACE_PROBE2 (pycairo, call__return, __func__, \
+                 _pycairo_probe_surface_type (surface))
+#else
+#define PYCAIRO_PROBE_ENTRY(surface) do { } while (0)
+#define PYCAIRO_PROBE_RETURN(surface) do { } while (0)
+#endif
+
 #endif /* _PYCAIRO_PRIVATE_H_ */
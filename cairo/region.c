@@ -264,7 +264,9 @@ static PyObject *
 region_copy (PycairoRegion *o, PyObject *ignored) {
   cairo_region_t *res;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   res = cairo_region_copy (o->region);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_REGION_ERROR(res);
   return PycairoRegion_FromRegion(res);
@@ -275,7 +277,9 @@ static PyObject *
 region_get_extents (PycairoRegion *o, PyObject *ignored) {
   cairo_rectangle_int_t rect;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_region_get_extents(o->region, &rect);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   return PycairoRectangleInt_FromRectangleInt(&rect);
@@ -286,7 +290,9 @@ static PyObject *
 region_num_rectangles (PycairoRegion *o, PyObject *ignored) {
   int res;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   res = cairo_region_num_rectangles(o->region);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
   return PyLong_FromLong(res);
 }
@@ -308,7 +314,9 @@ region_get_rectangle (PycairoRegion *o, PyObject *args) {
     return NULL;
   }
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_region_get_rectangle(o->region, i, &rect);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
   return PycairoRectangleInt_FromRectangleInt(&rect);
 }
@@ -319,7 +327,9 @@ region_is_empty (PycairoRegion *o, PyObject *ignored) {
   cairo_bool_t res;
   PyObject *b;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   res = cairo_region_is_empty(o->region);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
   b = res ? Py_True : Py_False;
   Py_INCREF(b);
@@ -335,7 +345,9 @@ region_contains_point (PycairoRegion *o, PyObject *args) {
   if (!PyArg_ParseTuple (args, "ii:Region.contains_point", &x, &y))
     return NULL;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   res = cairo_region_contains_point(o->region, x, y);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
   b = res ? Py_True : Py_False;
   Py_INCREF(b);
@@ -351,7 +363,9 @@ region_contains_rectangle (PycairoRegion *o, PyObject *args) {
                          &PycairoRectangleInt_Type, &rect_int))
     return NULL;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   res = cairo_region_contains_rectangle(o->region, &(rect_int->rectangle_int));
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   RETURN_INT_ENUM(RegionOverlap, res);
@@ -367,7 +381,9 @@ region_equal (PycairoRegion *o, PyObject *args) {
                          &PycairoRegion_Type, &region_obj))
     return NULL;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   res = cairo_region_equal (o->region, region_obj->region);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
   b = res ? Py_True : Py_False;
   Py_INCREF(b);
@@ -404,7 +420,9 @@ region_translate (PycairoRegion *o, PyObject *args) {
   if (!PyArg_ParseTuple (args, "ii:Region.translate", &x, &y))
     return NULL;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_region_translate (o->region, x, y);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
   Py_RETURN_NONE;
 }
@@ -419,13 +437,17 @@ region_intersect (PycairoRegion *o, PyObject *args) {
 
   if (PyObject_TypeCheck(other, &PycairoRegion_Type)) {
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       res = cairo_region_intersect(o->region,
               ((PycairoRegion *)other)->region);
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
   } else if (PyObject_TypeCheck(other, &PycairoRectangleInt_Type)) {
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       res = cairo_region_intersect_rectangle(o->region,
           &(((PycairoRectangleInt *)other)->rectangle_int));
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
   } else {
     PyErr_SetString(PyExc_TypeError,
@@ -446,13 +468,17 @@ region_subtract (PycairoRegion *o, PyObject *args) {
 
   if (PyObject_TypeCheck(other, &PycairoRegion_Type)) {
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       res = cairo_region_subtract(o->region,
               ((PycairoRegion *)other)->region);
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
   } else if (PyObject_TypeCheck(other, &PycairoRectangleInt_Type)) {
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       res = cairo_region_subtract_rectangle(o->region,
           &(((PycairoRectangleInt *)other)->rectangle_int));
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
   } else {
     PyErr_SetString(PyExc_TypeError,
@@ -472,13 +498,17 @@ region_union (PycairoRegion *o, PyObject *args) {
 
   if (PyObject_TypeCheck(other, &PycairoRegion_Type)) {
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       res = cairo_region_union(o->region,
               ((PycairoRegion *)other)->region);
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
   } else if (PyObject_TypeCheck(other, &PycairoRectangleInt_Type)) {
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       res = cairo_region_union_rectangle(o->region,
           &(((PycairoRectangleInt *)other)->rectangle_int));
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
   } else {
     PyErr_SetString(PyExc_TypeError,
@@ -498,13 +528,17 @@ region_xor (PycairoRegion *o, PyObject *args) {
 
   if (PyObject_TypeCheck(other, &PycairoRegion_Type)) {
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       res = cairo_region_xor(o->region,
               ((PycairoRegion *)other)->region);
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
   } else if (PyObject_TypeCheck(other, &PycairoRectangleInt_Type)) {
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       res = cairo_region_xor_rectangle(o->region,
           &(((PycairoRectangleInt *)other)->rectangle_int));
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
   } else {
     PyErr_SetString(PyExc_TypeError,
@@ -0,0 +1,360 @@
+/* -*- mode: C; c-basic-offset: 2 -*-
+ *
+ * Pycairo - Python bindings for cairo
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#ifndef MS_WINDOWS
+#include <errno.h>
+#include <unistd.h>
+#define PYCAIRO_SINK_HAS_FD
+#endif
+
+#include "private.h"
+
+/* Output sink for the cairo stream functions (PDF, PS, SVG, script and PNG
+ * output to file objects). cairo emits many small fragments, calling
+ * file.write() with the GIL for each of them serializes export on the GIL.
+ * The sink collects fragments in a buffer and writes them out in large
+ * chunks: with write(2) on a duplicate of the file descriptor for files
+ * returned by open(), without the GIL, or with one write() call per chunk
+ * for all other file objects, like io.BytesIO.
+ */
+
+#define OUTPUT_SINK_BUFFER_SIZE (256 * 1024)
+
+struct _PycairoOutputSink {
+  PyObject *file;
+  int fd;      /* duplicate of the file descriptor, or -1 */
+  int resync;  /* file is buffered and its position has to be updated */
+  int moved;  /* written to fd since the last resync */
+  int error;
+  unsigned char *buffer;
+  size_t used;
+  /* counters not yet added to the totals */
+  uint64_t fragments;
+  uint64_t bytes;
+  uint64_t python_writes;
+  uint64_t direct_writes;
+};
+
+typedef struct {
+  uint64_t fragments;
+  uint64_t bytes;
+  uint64_t python_writes;
+  uint64_t direct_writes;
+} PycairoOutputStats;
+
+static PycairoOutputStats output_stats_total;
+static PyThread_type_lock output_stats_lock = NULL;
+
+int
+init_output_sink (void) {
+  if (output_stats_lock != NULL)
+    return 0;
+
+  output_stats_lock = PyThread_allocate_lock ();
+  if (output_stats_lock == NULL) {
+    PyErr_NoMemory ();
+    return -1;
+  }
+  return 0;
+}
+
+/* Returns the file descriptor if file is a binary file object returned by
+ * open(), which can be written to directly after flushing its buffer.
+ * Returns -1 otherwise, or -2 with an exception set. */
+static int
+_output_sink_get_fd (PyObject *file, int *buffered) {
+#ifdef PYCAIRO_SINK_HAS_FD
+  static const char *types[] = {"FileIO", "BufferedWriter", "BufferedRandom"};
+  PyObject *io, *type, *res;
+  int i, match = -1, fd;
+  long value;
+
+  io = PyImport_ImportModule ("io");
+  if (io == NULL)
+    return -2;
+  for (i = 0; i < 3 && match < 0; i++) {
+    type = PyObject_GetAttrString (io, types[i]);
+    if (type == NULL) {
+      Py_DECREF (io);
+      return -2;
+    }
+    if ((PyObject *)Py_TYPE (file) == type)
+      match = i;
+    Py_DECREF (type);
+  }
+  Py_DECREF (io);
+  if (match < 0)
+    return -1;
+
+  res = PyObject_CallMethod (file, "fileno", NULL);
+  if (res == NULL) {
+    PyErr_Clear ();
+    return -1;
+  }
+  value = PyLong_AsLong (res);
+  Py_DECREF (res);
+  if (value < 0 || value > INT_MAX) {
+    PyErr_Clear ();
+    return -1;
+  }
+  fd = (int)value;
+
+  res = PyObject_CallMethod (file, "flush", NULL);
+  if (res == NULL)
+    return -2;
+  Py_DECREF (res);
+
+  *buffered = match != 0;
+  return fd;
+#else
+  return -1;
+#endif
+}
+
+PycairoOutputSink *
+Pycairo_output_sink_new (PyObject *file) {
+  PycairoOutputSink *sink;
+  int fd, buffered = 0;
+
+  fd = _output_sink_get_fd (file, &buffered);
+  if (fd == -2)
+    return NULL;
+
+  sink = PyMem_RawCalloc (1, sizeof (PycairoOutputSink));
+  if (sink == NULL) {
+    PyErr_NoMemory ();
+    return NULL;
+  }
+  sink->fd = -1;
+
+#ifdef PYCAIRO_SINK_HAS_FD
+  /* Our own descriptor stays valid even if the file gets closed before
+   * cairo is done writing */
+  if (fd >= 0) {
+    sink->fd = dup (fd);
+    sink->resync = sink->fd >= 0 && buffered;
+  }
+#endif
+
+  sink->buffer = PyMem_RawMalloc (OUTPUT_SINK_BUFFER_SIZE);
+  if (sink->buffer == NULL) {
+    Pycairo_output_sink_destroy (sink);
+    PyErr_NoMemory ();
+    return NULL;
+  }
+
+  sink->file = Py_NewRef (file);
+  return sink;
+}
+
+/* Writes data to the target. Doesn't need the GIL. */
+static int
+_output_sink_write_out (PycairoOutputSink *sink, const unsigned char *data,
+                        size_t length) {
+  PyGILState_STATE gstate;
+  PyObject *res;
+
+  if (length == 0)
+    return 0;
+
+#ifdef PYCAIRO_SINK_HAS_FD
+  if (sink->fd >= 0) {
+    while (length > 0) {
+      ssize_t written = write (sink->fd, data, length);
+      if (written < 0) {
+        if (errno == EINTR)
+          continue;
+        sink->error = 1;
+        return -1;
+      }
+      data += written;
+      length -= (size_t)written;
+      sink->direct_writes++;
+      sink->moved = 1;
+    }
+    return 0;
+  }
+#endif
+
+  gstate = PyGILState_Ensure ();
+  res = PyObject_CallMethod (sink->file, "write", "(y#)",
+                             data, (Py_ssize_t)length);
+  sink->python_writes++;
+  if (res == NULL) {
+    /* an exception has occurred, it will be picked up later by
+     * Pycairo_Check_Status()
+     */
+    PyErr_Clear ();
+    sink->error = 1;
+  } else {
+    Py_DECREF (res);
+  }
+  PyGILState_Release (gstate);
+
+  return sink->error ? -1 : 0;
+}
+
+static void
+_output_sink_add_totals (PycairoOutputSink *sink) {
+  PyThread_acquire_lock (output_stats_lock, WAIT_LOCK);
+  output_stats_total.fragments += sink->fragments;
+  output_stats_total.bytes += sink->bytes;
+  output_stats_total.python_writes += sink->python_writes;
+  output_stats_total.direct_writes += sink->direct_writes;
+  PyThread_release_lock (output_stats_lock);
+
+  sink->fragments = 0;
+  sink->bytes = 0;
+  sink->python_writes = 0;
+  sink->direct_writes = 0;
+}
+
+/* Writes out the buffered data. Doesn't need the GIL, returns -1 if this or
+ * an earlier write failed. */
+static int
+_output_sink_flush_buffer (PycairoOutputSink *sink) {
+  if (!sink->error && sink->used > 0) {
+    _output_sink_write_out (sink, sink->buffer, sink->used);
+    sink->used = 0;
+  }
+  _output_sink_add_totals (sink);
+  return sink->error ? -1 : 0;
+}
+
+/* Makes the buffered file pick up the position changed by our writes, so
+ * Python code using the file after finish() or flush() continues at the
+ * end of the output. Takes the GIL. */
+static void
+_output_sink_resync (PycairoOutputSink *sink) {
+  PyGILState_STATE gstate;
+  PyObject *res;
+
+  if (!sink->resync || !sink->moved)
+    return;
+  sink->moved = 0;
+
+  gstate = PyGILState_Ensure ();
+  res = PyObject_CallMethod (sink->file, "seek", "(ii)", 0, SEEK_CUR);
+  if (res == NULL)
+    PyErr_Clear ();
+  Py_XDECREF (res);
+  PyGILState_Release (gstate);
+}
+
+/* Writes out the buffered data and updates the position of the file. Can
+ * be called without the GIL, returns -1 if this or an earlier write
+ * failed. */
+int
+Pycairo_output_sink_flush (PycairoOutputSink *sink) {
+  int res = _output_sink_flush_buffer (sink);
+
+  _output_sink_resync (sink);
+  return res;
+}
+
+/* A cairo_write_func_t, the closure is the sink */
+cairo_status_t
+Pycairo_output_sink_write (void *closure, const unsigned char *data,
+                           unsigned int length) {
+  PycairoOutputSink *sink = closure;
+
+  if (sink->error)
+    return CAIRO_STATUS_WRITE_ERROR;
+
+  sink->fragments++;
+  sink->bytes += length;
+
+  if (sink->used + length > OUTPUT_SINK_BUFFER_SIZE) {
+    if (_output_sink_flush_buffer (sink) < 0)
+      return CAIRO_STATUS_WRITE_ERROR;
+    if (length >= OUTPUT_SINK_BUFFER_SIZE) {
+      if (_output_sink_write_out (sink, data, length) < 0)
+        return CAIRO_STATUS_WRITE_ERROR;
+      return CAIRO_STATUS_SUCCESS;
+    }
+  }
+
+  memcpy (sink->buffer + sink->used, data, length);
+  sink->used += length;
+  return CAIRO_STATUS_SUCCESS;
+}
+
+/* Flushes and frees the sink, can be used as a cairo_destroy_func_t */
+void
+Pycairo_output_sink_destroy (void *user_data) {
+  PycairoOutputSink *sink = user_data;
+  PyGILState_STATE gstate;
+
+  if (sink->buffer != NULL)
+    Pycairo_output_sink_flush (sink);
+
+#ifdef PYCAIRO_SINK_HAS_FD
+  if (sink->fd >= 0)
+    close (sink->fd);
+#endif
+
+  gstate = PyGILState_Ensure ();
+  Py_XDECREF (sink->file);
+  PyGILState_Release (gstate);
+
+  PyMem_RawFree (sink->buffer);
+  PyMem_RawFree (sink);
+}
+
+PyObject *
+output_stats_get_total (void) {
+  PycairoOutputStats total;
+
+  Py_BEGIN_ALLOW_THREADS;
+  PyThread_acquire_lock (output_stats_lock, WAIT_LOCK);
+  total = output_stats_total;
+  PyThread_release_lock (output_stats_lock);
+  Py_END_ALLOW_THREADS;
+
+  return Py_BuildValue (
+    "{s:K,s:K,s:K,s:K,s:K}",
+    "fragments", (unsigned long long)total.fragments,
+    "bytes", (unsigned long long)total.bytes,
+    "python_writes", (unsigned long long)total.python_writes,
+    "direct_writes", (unsigned long long)total.direct_writes,
+    "python_writes_saved", (unsigned long long)(
+      total.fragments > total.python_writes ?
+      total.fragments - total.python_writes : 0));
+}
+
+void
+output_stats_reset_total (void) {
+  Py_BEGIN_ALLOW_THREADS;
+  PyThread_acquire_lock (output_stats_lock, WAIT_LOCK);
+  memset (&output_stats_total, 0, sizeof (output_stats_total));
+  PyThread_release_lock (output_stats_lock);
+  Py_END_ALLOW_THREADS;
+}
@@ -34,6 +34,453 @@
 
 #include "private.h"
 
+#include <errno.h>
+#include <math.h>
+
+#ifdef PYCAIRO_HAS_MMAP
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const cairo_user_data_key_t surface_is_mapped_image;
+static const cairo_user_data_key_t surface_buffer_view_key;
+static const cairo_user_data_key_t surface_is_finished_key;
+static const cairo_user_data_key_t surface_is_finishing_key;
+static const cairo_user_data_key_t surface_is_foreign_key;
+static const cairo_user_data_key_t surface_export_count_key;
+static const cairo_user_data_key_t surface_mmap_key;
+static const cairo_user_data_key_t surface_shared_memory_key;
+static const cairo_user_data_key_t surface_pool_key;
+static const cairo_user_data_key_t surface_pixels_key;
+static const cairo_user_data_key_t surface_output_sink_key;
+
+/* Memory accounting ------------------------------------------------------ */
+
+/* Every cairo surface wrapped by pycairo gets a record attached as user data
+ * which keeps the live totals reported by cairo.memory_stats() up to date.
+ * Pixel memory allocated by cairo for image surfaces is also reported to
+ * tracemalloc, using PYCAIRO_TRACEMALLOC_DOMAIN. The records can get
+ * destroyed without the GIL held, so the totals are protected by a lock.
+ */
+
+#define SURFACE_ACCOUNT_N_TYPES 32
+
+typedef struct {
+  cairo_surface_type_t type;
+  void *data;
+  size_t pixel_bytes;
+  int traced;  /* reported to tracemalloc by the record */
+} PycairoSurfaceAccount;
+
+static const cairo_user_data_key_t surface_account_key;
+static PyThread_type_lock surface_account_lock = NULL;
+static Py_ssize_t surface_account_live[SURFACE_ACCOUNT_N_TYPES];
+static size_t surface_account_pixel_bytes;
+static size_t surface_account_peak_pixel_bytes;
+
+/* Pixel memory kept by SurfacePool objects for reuse, see
+ * _surface_pool_idle_changed() */
+static size_t surface_pool_idle_bytes;
+
+static const char *
+_surface_type_name (int type) {
+  switch (type) {
+  case CAIRO_SURFACE_TYPE_IMAGE: return "image";
+  case CAIRO_SURFACE_TYPE_PDF: return "pdf";
+  case CAIRO_SURFACE_TYPE_PS: return "ps";
+  case CAIRO_SURFACE_TYPE_XLIB: return "xlib";
+  case CAIRO_SURFACE_TYPE_XCB: return "xcb";
+  case CAIRO_SURFACE_TYPE_GLITZ: return "glitz";
+  case CAIRO_SURFACE_TYPE_QUARTZ: return "quartz";
+  case CAIRO_SURFACE_TYPE_WIN32: return "win32";
+  case CAIRO_SURFACE_TYPE_BEOS: return "beos";
+  case CAIRO_SURFACE_TYPE_DIRECTFB: return "directfb";
+  case CAIRO_SURFACE_TYPE_SVG: return "svg";
+  case CAIRO_SURFACE_TYPE_OS2: return "os2";
+  case CAIRO_SURFACE_TYPE_WIN32_PRINTING: return "win32_printing";
+  case CAIRO_SURFACE_TYPE_QUARTZ_IMAGE: return "quartz_image";
+  case CAIRO_SURFACE_TYPE_SCRIPT: return "script";
+  case CAIRO_SURFACE_TYPE_QT: return "qt";
+  case CAIRO_SURFACE_TYPE_RECORDING: return "recording";
+  case CAIRO_SURFACE_TYPE_VG: return "vg";
+  case CAIRO_SURFACE_TYPE_GL: return "gl";
+  case CAIRO_SURFACE_TYPE_DRM: return "drm";
+  case CAIRO_SURFACE_TYPE_TEE: return "tee";
+  case CAIRO_SURFACE_TYPE_XML: return "xml";
+  case CAIRO_SURFACE_TYPE_SKIA: return "skia";
+  case CAIRO_SURFACE_TYPE_SUBSURFACE: return "subsurface";
+  case CAIRO_SURFACE_TYPE_COGL: return "cogl";
+  default: return "unknown";
+  }
+}
+
+/* Optional limit for the pixel memory of image surfaces, see
+ * cairo.set_image_memory_limit(). Allocations reserve their size up front,
+ * so concurrent ones can't overshoot the limit together. Also protected by
+ * surface_account_lock.
+ */
+static Py_ssize_t image_memory_limit = -1;
+static double image_memory_timeout = 0.0;
+static size_t image_memory_reserved;
+
+/* A thread waiting in _image_memory_reserve(), queued oldest first. The
+ * wakeup lock is held until the waiter gets woken because its size might
+ * fit now, so each released surface only wakes the waiters it can help. */
+typedef struct _PycairoMemoryWaiter {
+  size_t size;
+  PyThread_type_lock wakeup;
+  int woken;
+  struct _PycairoMemoryWaiter *next;
+} PycairoMemoryWaiter;
+
+static PycairoMemoryWaiter *image_memory_waiters = NULL;
+
+static size_t _surface_pools_trim (size_t needed);
+
+int
+init_memory_stats (void) {
+  if (surface_account_lock != NULL)
+    return 0;
+
+  surface_account_lock = PyThread_allocate_lock ();
+  if (surface_account_lock == NULL) {
+    PyErr_NoMemory ();
+    return -1;
+  }
+
+  return 0;
+}
+
+/* Wakes the waiters whose reservation fits into the memory which is
+ * available now. Needs surface_account_lock. */
+static void
+_image_memory_wake_waiters (void) {
+  PycairoMemoryWaiter *waiter;
+  size_t in_use, available = 0;
+
+  if (image_memory_waiters == NULL)
+    return;
+
+  in_use = surface_account_pixel_bytes + image_memory_reserved +
+    surface_pool_idle_bytes;
+  if (image_memory_limit < 0)
+    available = (size_t)-1;
+  else if (in_use < (size_t)image_memory_limit)
+    available = (size_t)image_memory_limit - in_use;
+
+  for (waiter = image_memory_waiters; waiter != NULL; waiter = waiter->next) {
+    if (waiter->woken || waiter->size > available)
+      continue;
+    available -= waiter->size;
+    waiter->woken = 1;
+    PyThread_release_lock (waiter->wakeup);
+  }
+}
+
+/* Needs surface_account_lock */
+static void
+_image_memory_add_waiter (PycairoMemoryWaiter *waiter) {
+  PycairoMemoryWaiter **link = &image_memory_waiters;
+
+  while (*link != NULL)
+    link = &(*link)->next;
+  waiter->woken = 0;
+  waiter->next = NULL;
+  *link = waiter;
+}
+
+/* Needs surface_account_lock */
+static void
+_image_memory_remove_waiter (PycairoMemoryWaiter *waiter) {
+  PycairoMemoryWaiter **link = &image_memory_waiters;
+
+  while (*link != waiter)
+    link = &(*link)->next;
+  *link = waiter->next;
+}
+
+static int
+_surface_account_index (cairo_surface_type_t type) {
+  int index = (int)type;
+  if (index < 0 || index >= SURFACE_ACCOUNT_N_TYPES)
+    return SURFACE_ACCOUNT_N_TYPES - 1;
+  return index;
+}
+
+/* Stops accounting the pixel memory of the surface. Can be called without
+ * the GIL.
+ */
+static void
+_surface_account_release_pixels (PycairoSurfaceAccount *account) {
+  if (account->pixel_bytes == 0)
+    return;
+
+  if (account->traced)
+    PyTraceMalloc_Untrack (PYCAIRO_TRACEMALLOC_DOMAIN,
+                           (uintptr_t)account->data);
+
+  PyThread_acquire_lock (surface_account_lock, WAIT_LOCK);
+  surface_account_pixel_bytes -= account->pixel_bytes;
+  _image_memory_wake_waiters ();
+  PyThread_release_lock (surface_account_lock);
+
+  account->pixel_bytes = 0;
+  account->data = NULL;
+}
+
+static void
+_surface_account_destroy_func (void *user_data) {
+  PycairoSurfaceAccount *account = user_data;
+
+  _surface_account_release_pixels (account);
+
+  PyThread_acquire_lock (surface_account_lock, WAIT_LOCK);
+  surface_account_live[_surface_account_index (account->type)]--;
+  PyThread_release_lock (surface_account_lock);
+
+  PyMem_RawFree (account);
+}
+
+/* Accounts the surface, including its pixel memory if owns_pixels is set */
+static void
+_surface_account_add_full (cairo_surface_t *surface, int owns_pixels) {
+  PycairoSurfaceAccount *account;
+
+  if (cairo_surface_get_user_data (surface, &surface_account_key) != NULL)
+    return;
+
+  account = PyMem_RawCalloc (1, sizeof (PycairoSurfaceAccount));
+  if (account == NULL)
+    return;
+
+  account->type = cairo_surface_get_type (surface);
+
+  if (owns_pixels && account->type == CAIRO_SURFACE_TYPE_IMAGE) {
+    account->data = cairo_image_surface_get_data (surface);
+    if (account->data != NULL)
+      account->pixel_bytes = (size_t)cairo_image_surface_get_stride (surface) *
+        (size_t)cairo_image_surface_get_height (surface);
+    /* Pool buffers stay traced by the pool while idle */
+    account->traced = cairo_surface_get_user_data (
+      surface, &surface_pool_key) == NULL;
+  }
+
+  if (cairo_surface_set_user_data (surface, &surface_account_key, account,
+                                   _surface_account_destroy_func) !=
+      CAIRO_STATUS_SUCCESS) {
+    PyMem_RawFree (account);
+    return;
+  }
+
+  if (account->pixel_bytes != 0 && account->traced)
+    PyTraceMalloc_Track (PYCAIRO_TRACEMALLOC_DOMAIN,
+                         (uintptr_t)account->data, account->pixel_bytes);
+
+  PyThread_acquire_lock (surface_account_lock, WAIT_LOCK);
+  surface_account_live[_surface_account_index (account->type)]++;
+  surface_account_pixel_bytes += account->pixel_bytes;
+  if (surface_account_pixel_bytes > surface_account_peak_pixel_bytes)
+    surface_account_peak_pixel_bytes = surface_account_pixel_bytes;
+  PyThread_release_lock (surface_account_lock);
+}
+
+/* To be called after the surface was finished, which frees the pixels */
+static void
+_surface_account_finish (cairo_surface_t *surface) {
+  PycairoSurfaceAccount *account;
+
+  account = cairo_surface_get_user_data (surface, &surface_account_key);
+  if (account != NULL)
+    _surface_account_release_pixels (account);
+}
+
+static size_t
+_image_memory_size (cairo_format_t format, int width, int height) {
+  int stride = cairo_format_stride_for_width (format, width);
+
+  if (stride <= 0 || height <= 0)
+    return 0;
+  return (size_t)stride * (size_t)height;
+}
+
+/* Reserves @size bytes of the image memory limit before allocating a
+ * surface, waiting for other surfaces to be released if configured to do so.
+ * On success the reserved amount is stored in @reserved, which has to be
+ * passed to _image_memory_unreserve() after the new surface was accounted
+ * for. Otherwise raises cairo.MemoryError and returns -1.
+ */
+static int
+_image_memory_reserve (size_t size, size_t *reserved) {
+  PycairoMemoryWaiter waiter = {size, NULL, 0, NULL};
+  PyLockStatus lock_status;
+  int64_t deadline = -1, now;
+  PY_TIMEOUT_T wait_us;
+  size_t in_use = 0, limit = 0;
+  double timeout = 0.0;
+  char message[256];
+  int ret = -1;
+
+  *reserved = 0;
+  if (size == 0)
+    return 0;
+
+  for (;;) {
+    PyThread_acquire_lock (surface_account_lock, WAIT_LOCK);
+    if (image_memory_limit < 0) {
+      PyThread_release_lock (surface_account_lock);
+      ret = 0;
+      goto done;
+    }
+    limit = (size_t)image_memory_limit;
+    timeout = image_memory_timeout;
+    in_use = surface_account_pixel_bytes + image_memory_reserved +
+      surface_pool_idle_bytes;
+    if (size <= limit && in_use <= limit - size) {
+      image_memory_reserved += size;
+      PyThread_release_lock (surface_account_lock);
+      *reserved = size;
+      ret = 0;
+      goto done;
+    }
+    PyThread_release_lock (surface_account_lock);
+
+    /* Memory kept for reuse goes first */
+    if (size <= limit &&
+        _surface_pools_trim (in_use - Py_MIN (in_use, limit - size)) > 0)
+      continue;
+
+    /* Waiting is pointless if the surface can never fit */
+    if (size > limit || timeout == 0.0)
+      break;
+
+    now = Pycairo_monotonic_ns ();
+    wait_us = -1;
+    if (timeout > 0.0) {
+      if (deadline < 0)
+        deadline = now + (int64_t)(timeout * 1e9);
+      else if (now >= deadline)
+        break;
+      wait_us = (PY_TIMEOUT_T)Py_MIN ((deadline - now + 999) / 1000,
+                                      (int64_t)PY_TIMEOUT_MAX);
+    }
+
+    if (waiter.wakeup == NULL) {
+      waiter.wakeup = PyThread_allocate_lock ();
+      if (waiter.wakeup == NULL) {
+        PyErr_NoMemory ();
+        return -1;
+      }
+      PyThread_acquire_lock (waiter.wakeup, WAIT_LOCK);
+    }
+
+    /* Memory released between the check above and queueing up isn't
+     * missed, the wakeup stays released until we take it */
+    PyThread_acquire_lock (surface_account_lock, WAIT_LOCK);
+    _image_memory_add_waiter (&waiter);
+    _image_memory_wake_waiters ();
+    PyThread_release_lock (surface_account_lock);
+
+    Py_BEGIN_ALLOW_THREADS;
+    lock_status = PyThread_acquire_lock_timed (waiter.wakeup, wait_us, 1);
+    Py_END_ALLOW_THREADS;
+
+    PyThread_acquire_lock (surface_account_lock, WAIT_LOCK);
+    _image_memory_remove_waiter (&waiter);
+    PyThread_release_lock (surface_account_lock);
+    /* Woken after giving up waiting, take the wakeup back */
+    if (lock_status != PY_LOCK_ACQUIRED && waiter.woken)
+      PyThread_acquire_lock (waiter.wakeup, WAIT_LOCK);
+
+    if (PyErr_CheckSignals () < 0)
+      goto done;
+  }
+
+  PyOS_snprintf (message, sizeof (message),
+                 "image surface of %zu bytes exceeds the image memory limit "
+                 "of %zu bytes (%zu bytes in use)", size, limit, in_use);
+  Pycairo_Set_Memory_Error (message);
+
+done:
+  if (waiter.wakeup != NULL) {
+    PyThread_release_lock (waiter.wakeup);
+    PyThread_free_lock (waiter.wakeup);
+  }
+  return ret;
+}
+
+static void
+_image_memory_unreserve (size_t reserved) {
+  if (reserved == 0)
+    return;
+
+  PyThread_acquire_lock (surface_account_lock, WAIT_LOCK);
+  image_memory_reserved -= reserved;
+  _image_memory_wake_waiters ();
+  PyThread_release_lock (surface_account_lock);
+}
+
+void
+surface_set_image_memory_limit (Py_ssize_t limit, double timeout) {
+  PyThread_acquire_lock (surface_account_lock, WAIT_LOCK);
+  image_memory_limit = limit;
+  image_memory_timeout = timeout;
+  _image_memory_wake_waiters ();
+  PyThread_release_lock (surface_account_lock);
+}
+
+PyObject *
+surface_get_image_memory_limit (void) {
+  Py_ssize_t limit;
+
+  PyThread_acquire_lock (surface_account_lock, WAIT_LOCK);
+  limit = image_memory_limit;
+  PyThread_release_lock (surface_account_lock);
+
+  if (limit < 0)
+    Py_RETURN_NONE;
+  return PyLong_FromSsize_t (limit);
+}
+
+PyObject *
+surface_get_memory_stats (void) {
+  Py_ssize_t live[SURFACE_ACCOUNT_N_TYPES];
+  size_t pixel_bytes, peak_pixel_bytes, pool_idle_bytes;
+  PyObject *surfaces, *value;
+  int i;
+
+  PyThread_acquire_lock (surface_account_lock, WAIT_LOCK);
+  memcpy (live, surface_account_live, sizeof (live));
+  pixel_bytes = surface_account_pixel_bytes;
+  peak_pixel_bytes = surface_account_peak_pixel_bytes;
+  pool_idle_bytes = surface_pool_idle_bytes;
+  PyThread_release_lock (surface_account_lock);
+
+  surfaces = PyDict_New ();
+  if (surfaces == NULL)
+    return NULL;
+
+  for (i = 0; i < SURFACE_ACCOUNT_N_TYPES; i++) {
+    if (live[i] == 0)
+      continue;
+    value = PyLong_FromSsize_t (live[i]);
+    if (value == NULL ||
+        PyDict_SetItemString (surfaces, _surface_type_name (i), value) < 0) {
+      Py_XDECREF (value);
+      Py_DECREF (surfaces);
+      return NULL;
+    }
+    Py_DECREF (value);
+  }
+
+  return Py_BuildValue ("{s:N,s:n,s:n,s:n}",
+                        "surfaces", surfaces,
+                        "pixel_bytes", (Py_ssize_t)pixel_bytes,
+                        "peak_pixel_bytes", (Py_ssize_t)peak_pixel_bytes,
+                        "pool_idle_bytes", (Py_ssize_t)pool_idle_bytes);
+}
+
 
 /* Class Surface ---------------------------------------------------------- */
 
@@ -107,6 +554,13 @@ PycairoSurface_FromSurface (cairo_surface_t *surface, PyObject *base) {
     type = &PycairoSurface_Type;
     break;
   }
+  /* The first wrapper of a surface created by pycairo holds the only
+   * reference, see _surface_is_finished() */
+  if (cairo_surface_get_user_data (surface, &surface_account_key) == NULL &&
+      cairo_surface_get_reference_count (surface) > 1)
+    cairo_surface_set_user_data (
+      surface, &surface_is_foreign_key, (void *)1, NULL);
+
   o = type->tp_alloc (type, 0);
   if (o == NULL) {
     cairo_surface_destroy (surface);
@@ -114,41 +568,116 @@ PycairoSurface_FromSurface (cairo_surface_t *surface, PyObject *base) {
     ((PycairoSurface *)o)->surface = surface;
     Py_XINCREF(base);
     ((PycairoSurface *)o)->base = base;
+    /* Only a live surface, see _image_surface_from_allocation() */
+    _surface_account_add_full (surface, 0);
   }
   return o;
 }
 
-/* for use with
- * cairo_surface_write_to_png_stream()
- * cairo_pdf/ps/svg_surface_create_for_stream()
- */
-static cairo_status_t
-_write_func (void *closure, const unsigned char *data, unsigned int length) {
-  PyGILState_STATE gstate = PyGILState_Ensure();
-  PyObject *res = PyObject_CallMethod ((PyObject *)closure, "write", "(y#)",
-				       data, (Py_ssize_t)length);
-  if (res == NULL) {
-    PyErr_Clear();
-    /* an exception has occurred, it will be picked up later by
-     * Pycairo_Check_Status()
-     */
-    PyGILState_Release(gstate);
-    return CAIRO_STATUS_WRITE_ERROR;
+/* Wraps a new image surface whose pixels got allocated by or for pycairo,
+ * which are accounted until the surface is finished. Images we didn't
+ * allocate, like the ones passed to create_for_data(), file mappings or
+ * surfaces returned by C libraries, only count as live surfaces. */
+static PyObject *
+_image_surface_from_allocation (cairo_surface_t *surface) {
+  _surface_account_add_full (surface, 1);
+  return PycairoSurface_FromSurface (surface, NULL);
+}
+
+/* Creates the wrapper for a surface writing to a stream through sink, which
+ * gets freed with the surface */
+static PyObject *
+_surface_create_with_sink (cairo_surface_t *surface, PycairoOutputSink *sink) {
+  cairo_status_t status;
+
+  status = cairo_surface_status (surface);
+  if (status == CAIRO_STATUS_SUCCESS)
+    status = cairo_surface_set_user_data (
+      surface, &surface_output_sink_key, sink, Pycairo_output_sink_destroy);
+  if (status != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy (surface);
+    Pycairo_output_sink_destroy (sink);
+    Pycairo_Check_Status (status);
+    return NULL;
   }
-  Py_DECREF(res);
-  PyGILState_Release(gstate);
-  return CAIRO_STATUS_SUCCESS;
+
+  return PycairoSurface_FromSurface (surface, NULL);
 }
 
-static const cairo_user_data_key_t surface_base_object_key;
-static const cairo_user_data_key_t surface_is_mapped_image;
-static const cairo_user_data_key_t surface_buffer_view_key;
+/* Writes out the output buffered for a stream surface. Doesn't need the GIL,
+ * returns -1 if writing failed. */
+static int
+_surface_flush_output (cairo_surface_t *surface) {
+  PycairoOutputSink *sink = cairo_surface_get_user_data (
+    surface, &surface_output_sink_key);
+
+  return sink != NULL ? Pycairo_output_sink_flush (sink) : 0;
+}
+
+#ifdef CAIRO_HAS_RECORDING_SURFACE
+/* Waits until the pages queued with queue_page() are emitted, which has to
+ * happen before anything else touches a document surface. Returns -1 with
+ * an exception set if emitting one of them failed. */
+int
+Pycairo_surface_wait_pages (cairo_surface_t *surface) {
+  PycairoPageQueue *queue = Pycairo_page_queue_get (surface, 0);
+  cairo_status_t status;
+
+  if (queue == NULL)
+    return 0;
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (surface);
+  status = Pycairo_page_queue_wait (queue);
+  PYCAIRO_PROBE_RETURN (surface);
+  Py_END_ALLOW_THREADS;
+
+  return Pycairo_Check_Status (status) ? -1 : 0;
+}
+
+/* Like Pycairo_surface_wait_pages() but doesn't need the GIL, returns the
+ * status */
+static cairo_status_t
+_surface_wait_pages_unlocked (cairo_surface_t *surface) {
+  PycairoPageQueue *queue = Pycairo_page_queue_get (surface, 0);
+
+  return queue != NULL ? Pycairo_page_queue_wait (queue)
+                       : CAIRO_STATUS_SUCCESS;
+}
+
+/* Waits for the queued pages before the wrapper goes away, so they get
+ * written while Python is still around to run the stream callbacks instead
+ * of by the worker at some later point, possibly during shutdown. Errors
+ * get dropped like the ones of finishing the surface on destroy. */
+static void
+_surface_drain_pages (cairo_surface_t *surface) {
+  PycairoPageQueue *queue = Pycairo_page_queue_get (surface, 0);
+
+  if (queue == NULL)
+    return;
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (surface);
+  Pycairo_page_queue_wait (queue);
+  PYCAIRO_PROBE_RETURN (surface);
+  Py_END_ALLOW_THREADS;
+}
+#else
+int
+Pycairo_surface_wait_pages (cairo_surface_t *surface) {
+  return 0;
+}
+
+#define _surface_wait_pages_unlocked(surface) CAIRO_STATUS_SUCCESS
+#define _surface_drain_pages(surface)
+#endif
 
 static void
 surface_dealloc (PycairoSurface *o) {
   if (o->surface) {
     if (cairo_surface_get_user_data (
         o->surface, &surface_is_mapped_image) == NULL) {
+      _surface_drain_pages (o->surface);
       cairo_surface_destroy(o->surface);
     }
     o->surface = NULL;
@@ -158,37 +687,6 @@ surface_dealloc (PycairoSurface *o) {
   Py_TYPE(o)->tp_free(o);
 }
 
-static void
-_decref_destroy_func(void *user_data) {
-  PyGILState_STATE gstate = PyGILState_Ensure();
-  Py_DECREF(user_data);
-  PyGILState_Release(gstate);
-}
-
-/* Like PycairoSurface_FromSurface, but keeps the base object alive as long
- * as cairo_surface_t exists and not as long as the wrapper exists.
- */
-static PyObject *
-_surface_create_with_object(cairo_surface_t *surface, PyObject *base) {
-  PyObject *pysurface;
-  cairo_status_t status;
-
-  pysurface = PycairoSurface_FromSurface(surface, NULL);
-  if (pysurface == NULL)
-    return NULL;
-
-  if (base != NULL) {
-    status = cairo_surface_set_user_data(
-      surface, &surface_base_object_key, base, _decref_destroy_func);
-    if (status != CAIRO_STATUS_SUCCESS)
-      Py_DECREF(pysurface);
-    RETURN_NULL_IF_CAIRO_ERROR(status);
-    Py_INCREF(base);
-  }
-
-  return pysurface;
-}
-
 static PyObject *
 surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
   PyErr_SetString(PyExc_TypeError,
@@ -198,8 +696,12 @@ surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
 
 static PyObject *
 surface_copy_page (PycairoSurface *o, PyObject *ignored) {
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   cairo_surface_copy_page (o->surface);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
   Py_RETURN_NONE;
@@ -216,104 +718,408 @@ surface_create_similar (PycairoSurface *o, PyObject *args) {
 
   content = (cairo_content_t)content_arg;
 
-  return PycairoSurface_FromSurface (
-	     cairo_surface_create_similar (o->surface, content, width, height),
-	     NULL);
+  return _image_surface_from_allocation (
+	     cairo_surface_create_similar (o->surface, content, width, height));
 }
 
-static PyObject *
-surface_finish (PycairoSurface *o, PyObject *ignored) {
-  cairo_surface_finish (o->surface);
-  Py_CLEAR(o->base);
+/* Surfaces finished through pycairo get marked, so that we can tell if the
+ * pixel data is still valid without asking cairo. Surfaces which were
+ * already referenced elsewhere when pycairo first saw them (get_target(),
+ * C libraries passing in their surfaces) can get finished behind our back,
+ * for those we still ask cairo.
+ * https://gitlab.freedesktop.org/cairo/cairo/-/issues/406
+ */
+static void
+_surface_mark_finished (cairo_surface_t *surface) {
+  cairo_surface_set_user_data (
+    surface, &surface_is_finished_key, (void *)1, NULL);
+}
 
-  /* After an image surface is finished it won't access the buffer and
-  we can release it */
-  cairo_surface_set_user_data(
-    o->surface, &surface_buffer_view_key, NULL, NULL);
+/* A surface passed to finish_async() counts as finished right away, the
+ * worker thread can free the pixels at any point after the submit. */
+static void
+_surface_set_finishing (cairo_surface_t *surface, int finishing) {
+  cairo_surface_set_user_data (
+    surface, &surface_is_finishing_key, finishing ? (void *)1 : NULL, NULL);
+}
 
-  RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
-  Py_RETURN_NONE;
+static int
+_surface_is_finishing (cairo_surface_t *surface) {
+  return cairo_surface_get_user_data (
+    surface, &surface_is_finishing_key) != NULL;
 }
 
-static PyObject *
-surface_flush (PycairoSurface *o, PyObject *ignored) {
-  Py_BEGIN_ALLOW_THREADS;
-  cairo_surface_flush (o->surface);
-  Py_END_ALLOW_THREADS;
-  RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
-  Py_RETURN_NONE;
+static int
+_surface_is_finished (cairo_surface_t *surface) {
+  cairo_t *ctx;
+  cairo_status_t status;
+
+  if (cairo_surface_get_user_data (surface, &surface_is_finished_key) != NULL ||
+      _surface_is_finishing (surface))
+    return 1;
+  if (cairo_surface_get_user_data (surface, &surface_is_foreign_key) == NULL)
+    return 0;
+
+  /* cairo has no API for this, but refuses to draw to finished surfaces */
+  ctx = cairo_create (surface);
+  status = cairo_status (ctx);
+  cairo_destroy (ctx);
+  return status == CAIRO_STATUS_SURFACE_FINISHED;
 }
 
-static PyObject *
-surface_get_content (PycairoSurface *o, PyObject *ignored) {
-  RETURN_INT_ENUM (Content, cairo_surface_get_content (o->surface));
+/* Number of buffer exports of the pixel data which are still alive */
+static Py_ssize_t
+_surface_get_export_count (cairo_surface_t *surface) {
+  return (Py_ssize_t)(intptr_t)cairo_surface_get_user_data (
+    surface, &surface_export_count_key);
 }
 
-static PyObject *
-surface_get_device_offset (PycairoSurface *o, PyObject *ignored) {
-  double x_offset, y_offset;
-  cairo_surface_get_device_offset (o->surface, &x_offset, &y_offset);
-  return Py_BuildValue("(dd)", x_offset, y_offset);
+static cairo_status_t
+_surface_set_export_count (cairo_surface_t *surface, Py_ssize_t count) {
+  return cairo_surface_set_user_data (
+    surface, &surface_export_count_key, (void *)(intptr_t)count, NULL);
 }
 
-static PyObject *
-surface_get_device_scale (PycairoSurface *o, PyObject *ignored) {
-  double x_scale, y_scale;
-  cairo_surface_get_device_scale (o->surface, &x_scale, &y_scale);
-  return Py_BuildValue("(dd)", x_scale, y_scale);
+static int
+_surface_check_not_exported (cairo_surface_t *surface) {
+  if (_surface_is_finishing (surface)) {
+    PyErr_SetString (PyExc_RuntimeError,
+      "the surface is already being finished");
+    return -1;
+  }
+  if (_surface_get_export_count (surface) != 0) {
+    PyErr_SetString (PyExc_BufferError,
+      "cannot finish the surface while its buffer is exported");
+    return -1;
+  }
+  return 0;
 }
 
-static PyObject *
-surface_get_fallback_resolution (PycairoSurface *o, PyObject *ignored) {
-  double x_ppi, y_ppi;
-  cairo_surface_get_fallback_resolution (o->surface, &x_ppi, &y_ppi);
-  return Py_BuildValue("(dd)", x_ppi, y_ppi);
+/* Frees pixel memory owned by pycairo once the surface is finished */
+static void
+_surface_release_pixels (cairo_surface_t *surface) {
+  cairo_surface_set_user_data (surface, &surface_pool_key, NULL, NULL);
+  cairo_surface_set_user_data (surface, &surface_pixels_key, NULL, NULL);
 }
 
-static PyObject *
-surface_get_font_options (PycairoSurface *o, PyObject *ignored) {
-  cairo_font_options_t *options = cairo_font_options_create();
+/* File mappings ---------------------------------------------------------- */
 
-  cairo_surface_get_font_options (o->surface, options);
-  /* there is no reference fn */
-  return PycairoFontOptions_FromFontOptions (options);
+#ifdef PYCAIRO_HAS_MMAP
+
+/* The file mapping backing a surface created by create_for_mmap() */
+typedef struct {
+  void *data;
+  size_t size;
+  int sync;
+} PycairoSurfaceMapping;
+
+static void
+_surface_mapping_destroy_func (void *user_data) {
+  PycairoSurfaceMapping *mapping = user_data;
+
+  if (mapping->sync)
+    msync (mapping->data, mapping->size, MS_SYNC);
+  munmap (mapping->data, mapping->size);
+  PyMem_RawFree (mapping);
 }
 
-static PyObject *
-surface_get_device (PycairoSurface *o, PyObject *ignored) {
-  cairo_device_t *device = cairo_surface_get_device (o->surface);
-  if (device == NULL)
-    Py_RETURN_NONE;
-  return PycairoDevice_FromDevice (cairo_device_reference (device));
+/* Writes the pixels of a surface created with sync=True back to its file.
+ * Can be called without the GIL, returns an errno value or 0. */
+static int
+_surface_mapping_sync (cairo_surface_t *surface) {
+  PycairoSurfaceMapping *mapping = cairo_surface_get_user_data (
+    surface, &surface_mmap_key);
+
+  if (mapping == NULL || !mapping->sync)
+    return 0;
+  if (msync (mapping->data, mapping->size, MS_SYNC) < 0)
+    return errno;
+  return 0;
 }
 
-static PyObject *
-surface_mark_dirty (PycairoSurface *o, PyObject *ignored) {
-  cairo_surface_mark_dirty (o->surface);
-  RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
-  Py_RETURN_NONE;
+/* Syncs and unmaps the file of a finished surface. Can be called without
+ * the GIL, returns an errno value or 0. */
+static int
+_surface_mapping_release (cairo_surface_t *surface) {
+  PycairoSurfaceMapping *mapping = cairo_surface_get_user_data (
+    surface, &surface_mmap_key);
+  int err;
+
+  if (mapping == NULL)
+    return 0;
+  err = _surface_mapping_sync (surface);
+  mapping->sync = 0;
+  cairo_surface_set_user_data (surface, &surface_mmap_key, NULL, NULL);
+  return err;
 }
 
-static PyObject *
-surface_mark_dirty_rectangle (PycairoSurface *o, PyObject *args) {
-  int x, y, width, height;
+#else
 
-  if (!PyArg_ParseTuple(args, "iiii:Surface.mark_dirty_rectangle",
-			&x, &y, &width, &height))
-    return NULL;
+static int
+_surface_mapping_sync (cairo_surface_t *surface) {
+  return 0;
+}
 
-  cairo_surface_mark_dirty_rectangle (o->surface, x, y, width, height);
-  RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
-  Py_RETURN_NONE;
+static int
+_surface_mapping_release (cairo_surface_t *surface) {
+  return 0;
 }
 
+#endif /* PYCAIRO_HAS_MMAP */
+
 static PyObject *
-surface_set_device_offset (PycairoSurface *o, PyObject *args) {
+_surface_mapping_error (int err) {
+  errno = err;
+  return PyErr_SetFromErrno (PyExc_OSError);
+}
+
+/* Drops what pycairo keeps alive for a surface which got finished */
+static void
+_surface_finish_release (PycairoSurface *o) {
+  _surface_mark_finished (o->surface);
+  _surface_account_finish (o->surface);
+  Py_CLEAR(o->base);
+
+  /* After an image surface is finished it won't access the buffer and
+  we can release it */
+  cairo_surface_set_user_data(
+    o->surface, &surface_buffer_view_key, NULL, NULL);
+  _surface_release_pixels (o->surface);
+}
+
+static PyObject *
+surface_finish (PycairoSurface *o, PyObject *ignored) {
+  int err, output_err;
+
+  if (_surface_check_not_exported (o->surface) < 0)
+    return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
+
+  cairo_surface_finish (o->surface);
+  _surface_finish_release (o);
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
+  err = _surface_mapping_release (o->surface);
+  output_err = _surface_flush_output (o->surface);
+  PYCAIRO_PROBE_RETURN (o->surface);
+  Py_END_ALLOW_THREADS;
+
+  RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
+  if (err != 0)
+    return _surface_mapping_error (err);
+  if (output_err < 0)
+    RETURN_NULL_IF_CAIRO_ERROR (CAIRO_STATUS_WRITE_ERROR);
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+surface_flush (PycairoSurface *o, PyObject *ignored) {
+  int err, output_err;
+
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
+  cairo_surface_flush (o->surface);
+  err = _surface_mapping_sync (o->surface);
+  output_err = _surface_flush_output (o->surface);
+  PYCAIRO_PROBE_RETURN (o->surface);
+  Py_END_ALLOW_THREADS;
+  RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
+  if (err != 0)
+    return _surface_mapping_error (err);
+  if (output_err < 0)
+    RETURN_NULL_IF_CAIRO_ERROR (CAIRO_STATUS_WRITE_ERROR);
+  Py_RETURN_NONE;
+}
+
+/* Awaitable variants ----------------------------------------------------- */
+
+/* A *_async() call, see Pycairo_async_submit() */
+typedef struct {
+  PycairoAsyncJob base;
+  PycairoSurface *surface;  /* keeps the surface and its buffer alive */
+  char *name;
+  PycairoOutputSink *sink;
+  PyObject *file;
+  cairo_surface_t *result;
+  cairo_status_t status;
+  int err;
+  int output_err;
+} PycairoSurfaceJob;
+
+static void
+_surface_job_destroy (PycairoAsyncJob *base) {
+  PycairoSurfaceJob *job = (PycairoSurfaceJob *)base;
+
+  Pycairo_async_job_clear (base);
+  if (job->sink != NULL)
+    Pycairo_output_sink_destroy (job->sink);
+  if (job->result != NULL)
+    cairo_surface_destroy (job->result);
+  PyMem_Free (job->name);
+  Py_XDECREF (job->file);
+  Py_XDECREF (job->surface);
+  PyMem_Free (job);
+}
+
+static PycairoSurfaceJob *
+_surface_job_new (PycairoSurface *surface,
+                  void (*run) (PycairoAsyncJob *job),
+                  PyObject *(*complete) (PycairoAsyncJob *job)) {
+  PycairoSurfaceJob *job = PyMem_Calloc (1, sizeof (PycairoSurfaceJob));
+
+  if (job == NULL) {
+    PyErr_NoMemory ();
+    return NULL;
+  }
+  job->base.run = run;
+  job->base.complete = complete;
+  job->base.destroy = _surface_job_destroy;
+  job->surface = surface;
+  Py_XINCREF (surface);
+  return job;
+}
+
+/* Returns a future for the job, or NULL with an exception set in which
+ * case the job got destroyed */
+static PyObject *
+_surface_job_submit (PycairoSurfaceJob *job) {
+  PyObject *future = Pycairo_async_submit (&job->base);
+
+  if (future == NULL)
+    _surface_job_destroy (&job->base);
+  return future;
+}
+
+static void
+_surface_finish_run (PycairoAsyncJob *base) {
+  PycairoSurfaceJob *job = (PycairoSurfaceJob *)base;
+  cairo_surface_t *surface = job->surface->surface;
+
+  PYCAIRO_PROBE_ENTRY (surface);
+  job->status = _surface_wait_pages_unlocked (surface);
+  if (job->status == CAIRO_STATUS_SUCCESS) {
+    cairo_surface_finish (surface);
+    job->err = _surface_mapping_release (surface);
+    job->output_err = _surface_flush_output (surface);
+  }
+  PYCAIRO_PROBE_RETURN (surface);
+}
+
+static PyObject *
+_surface_finish_complete (PycairoAsyncJob *base) {
+  PycairoSurfaceJob *job = (PycairoSurfaceJob *)base;
+  PycairoSurface *o = job->surface;
+
+  _surface_set_finishing (o->surface, 0);
+  RETURN_NULL_IF_CAIRO_ERROR (job->status);
+  _surface_finish_release (o);
+
+  RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
+  if (job->err != 0)
+    return _surface_mapping_error (job->err);
+  if (job->output_err < 0)
+    RETURN_NULL_IF_CAIRO_ERROR (CAIRO_STATUS_WRITE_ERROR);
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+surface_finish_async (PycairoSurface *o, PyObject *ignored) {
+  PycairoSurfaceJob *job;
+  PyObject *future;
+
+  if (_surface_check_not_exported (o->surface) < 0)
+    return NULL;
+
+  job = _surface_job_new (o, _surface_finish_run, _surface_finish_complete);
+  if (job == NULL)
+    return NULL;
+
+  /* No new exports of the pixels from here on, see
+   * _surface_is_finished() */
+  _surface_set_finishing (o->surface, 1);
+  future = _surface_job_submit (job);
+  if (future == NULL)
+    _surface_set_finishing (o->surface, 0);
+  return future;
+}
+
+static PyObject *
+surface_get_content (PycairoSurface *o, PyObject *ignored) {
+  RETURN_INT_ENUM (Content, cairo_surface_get_content (o->surface));
+}
+
+static PyObject *
+surface_get_device_offset (PycairoSurface *o, PyObject *ignored) {
+  double x_offset, y_offset;
+  cairo_surface_get_device_offset (o->surface, &x_offset, &y_offset);
+  return Py_BuildValue("(dd)", x_offset, y_offset);
+}
+
+static PyObject *
+surface_get_device_scale (PycairoSurface *o, PyObject *ignored) {
+  double x_scale, y_scale;
+  cairo_surface_get_device_scale (o->surface, &x_scale, &y_scale);
+  return Py_BuildValue("(dd)", x_scale, y_scale);
+}
+
+static PyObject *
+surface_get_fallback_resolution (PycairoSurface *o, PyObject *ignored) {
+  double x_ppi, y_ppi;
+  cairo_surface_get_fallback_resolution (o->surface, &x_ppi, &y_ppi);
+  return Py_BuildValue("(dd)", x_ppi, y_ppi);
+}
+
+static PyObject *
+surface_get_font_options (PycairoSurface *o, PyObject *ignored) {
+  cairo_font_options_t *options = cairo_font_options_create();
+
+  cairo_surface_get_font_options (o->surface, options);
+  /* there is no reference fn */
+  return PycairoFontOptions_FromFontOptions (options);
+}
+
+static PyObject *
+surface_get_device (PycairoSurface *o, PyObject *ignored) {
+  cairo_device_t *device = cairo_surface_get_device (o->surface);
+  if (device == NULL)
+    Py_RETURN_NONE;
+  return PycairoDevice_FromDevice (cairo_device_reference (device));
+}
+
+static PyObject *
+surface_mark_dirty (PycairoSurface *o, PyObject *ignored) {
+  cairo_surface_mark_dirty (o->surface);
+  RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+surface_mark_dirty_rectangle (PycairoSurface *o, PyObject *args) {
+  int x, y, width, height;
+
+  if (!PyArg_ParseTuple(args, "iiii:Surface.mark_dirty_rectangle",
+			&x, &y, &width, &height))
+    return NULL;
+
+  cairo_surface_mark_dirty_rectangle (o->surface, x, y, width, height);
+  RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+surface_set_device_offset (PycairoSurface *o, PyObject *args) {
   double x_offset, y_offset;
 
   if (!PyArg_ParseTuple (args, "dd:Surface.set_device_offset",
 			 &x_offset, &y_offset))
     return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
 
   cairo_surface_set_device_offset (o->surface, x_offset, y_offset);
   Py_RETURN_NONE;
@@ -327,6 +1133,8 @@ surface_set_device_scale (PycairoSurface *o, PyObject *args) {
   if (!PyArg_ParseTuple (args, "dd:Surface.set_device_scale",
 			 &x_scale, &y_scale))
     return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
 
   /* cairo asserts the following without reporting an error back.
    * Since we don't want things to crash in Python replicate the logic here.
@@ -346,6 +1154,8 @@ surface_set_fallback_resolution (PycairoSurface *o, PyObject *args) {
   if (!PyArg_ParseTuple(args, "dd:Surface.set_fallback_resolution",
 			&x_ppi, &y_ppi))
     return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
   cairo_surface_set_fallback_resolution (o->surface, x_ppi, y_ppi);
   Py_RETURN_NONE;
 }
@@ -360,7 +1170,9 @@ surface_create_for_rectangle (PycairoSurface *o, PyObject *args) {
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   new = cairo_surface_create_for_rectangle(o->surface, x, y, width, height);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
   return PycairoSurface_FromSurface(new, NULL);
@@ -368,8 +1180,12 @@ surface_create_for_rectangle (PycairoSurface *o, PyObject *args) {
 
 static PyObject *
 surface_show_page (PycairoSurface *o, PyObject *ignored) {
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   cairo_surface_show_page (o->surface);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
   Py_RETURN_NONE;
@@ -380,6 +1196,8 @@ surface_create_similar_image (PycairoSurface *o, PyObject *args) {
   cairo_format_t format;
   int width, height, format_arg;
   cairo_surface_t *new;
+  PyObject *result;
+  size_t reserved;
 
   if (!PyArg_ParseTuple (args, "iii:Surface.create_similar_image",
                          &format_arg, &width, &height))
@@ -387,16 +1205,25 @@ surface_create_similar_image (PycairoSurface *o, PyObject *args) {
 
   format = (cairo_format_t)format_arg;
 
+  if (_image_memory_reserve (_image_memory_size (format, width, height),
+                             &reserved) < 0)
+    return NULL;
+
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   new = cairo_surface_create_similar_image (o->surface, format, width, height);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
-  return PycairoSurface_FromSurface (new, NULL);
+  result = _image_surface_from_allocation (new);
+  _image_memory_unreserve (reserved);
+  return result;
 }
 
 #ifdef CAIRO_HAS_PNG_FUNCTIONS
 static PyObject *
 surface_write_to_png (PycairoSurface *o, PyObject *args) {
+  PycairoOutputSink *sink;
   cairo_status_t status;
   char *name = NULL;
   PyObject *file;
@@ -409,16 +1236,27 @@ surface_write_to_png (PycairoSurface *o, PyObject *args) {
                            Pycairo_fspath_converter, &name))
       return NULL;
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (o->surface);
     status = cairo_surface_write_to_png (o->surface, name);
+    PYCAIRO_PROBE_RETURN (o->surface);
     Py_END_ALLOW_THREADS;
     PyMem_Free (name);
   } else {
     if (PyArg_ParseTuple (args, "O&:Surface.write_to_png",
                           Pycairo_writer_converter, &file)) {
+      sink = Pycairo_output_sink_new (file);
+      if (sink == NULL)
+        return NULL;
       Py_BEGIN_ALLOW_THREADS;
-      status = cairo_surface_write_to_png_stream (o->surface, _write_func,
-                                                  file);
+      PYCAIRO_PROBE_ENTRY (o->surface);
+      status = cairo_surface_write_to_png_stream (
+        o->surface, Pycairo_output_sink_write, sink);
+      if (status == CAIRO_STATUS_SUCCESS &&
+          Pycairo_output_sink_flush (sink) < 0)
+        status = CAIRO_STATUS_WRITE_ERROR;
+      PYCAIRO_PROBE_RETURN (o->surface);
       Py_END_ALLOW_THREADS;
+      Pycairo_output_sink_destroy (sink);
     } else {
       PyErr_Clear ();
       PyErr_SetString (PyExc_TypeError,
@@ -432,6 +1270,189 @@ surface_write_to_png (PycairoSurface *o, PyObject *args) {
   RETURN_NULL_IF_CAIRO_ERROR (status);
   Py_RETURN_NONE;
 }
+
+static PyObject *
+_surface_job_complete_none (PycairoAsyncJob *base) {
+  PycairoSurfaceJob *job = (PycairoSurfaceJob *)base;
+
+  RETURN_NULL_IF_CAIRO_ERROR (job->status);
+  Py_RETURN_NONE;
+}
+
+static void
+_surface_write_to_png_run (PycairoAsyncJob *base) {
+  PycairoSurfaceJob *job = (PycairoSurfaceJob *)base;
+  cairo_surface_t *surface = job->surface->surface;
+
+  PYCAIRO_PROBE_ENTRY (surface);
+  if (job->name != NULL) {
+    job->status = cairo_surface_write_to_png (surface, job->name);
+  } else {
+    job->status = cairo_surface_write_to_png_stream (
+      surface, Pycairo_output_sink_write, job->sink);
+    if (job->status == CAIRO_STATUS_SUCCESS &&
+        Pycairo_output_sink_flush (job->sink) < 0)
+      job->status = CAIRO_STATUS_WRITE_ERROR;
+  }
+  PYCAIRO_PROBE_RETURN (surface);
+}
+
+static PyObject *
+surface_write_to_png_async (PycairoSurface *o, PyObject *args) {
+  PycairoSurfaceJob *job;
+  PyObject *file;
+
+  if (!PyArg_ParseTuple (args, "O:Surface.write_to_png_async", &file))
+    return NULL;
+
+  job = _surface_job_new (o, _surface_write_to_png_run,
+                          _surface_job_complete_none);
+  if (job == NULL)
+    return NULL;
+
+  if (Pycairo_is_fspath (file)) {
+    if (!PyArg_ParseTuple (args, "O&:Surface.write_to_png_async",
+                           Pycairo_fspath_converter, &job->name))
+      goto error;
+  } else if (PyArg_ParseTuple (args, "O&:Surface.write_to_png_async",
+                               Pycairo_writer_converter, &file)) {
+    job->sink = Pycairo_output_sink_new (file);
+    if (job->sink == NULL)
+      goto error;
+  } else {
+    PyErr_Clear ();
+    PyErr_SetString (PyExc_TypeError,
+                     "Surface.write_to_png_async takes one argument which "
+                     "must be a filename, file object, or a file-like object "
+                     "which has a \"write\" method (like BytesIO) taking bytes");
+    goto error;
+  }
+
+  return _surface_job_submit (job);
+
+ error:
+  _surface_job_destroy (&job->base);
+  return NULL;
+}
+
+/* An item of write_pngs() */
+typedef struct {
+  cairo_surface_t *surface;
+  char *name;
+  PycairoOutputSink *sink;
+  cairo_status_t status;
+} PycairoPngItem;
+
+static cairo_status_t
+_write_pngs_item (void *data, int worker, int index) {
+  PycairoPngItem *item = (PycairoPngItem *)data + index;
+
+  if (item->name != NULL) {
+    item->status = cairo_surface_write_to_png (item->surface, item->name);
+  } else {
+    item->status = cairo_surface_write_to_png_stream (
+      item->surface, Pycairo_output_sink_write, item->sink);
+    if (item->status == CAIRO_STATUS_SUCCESS &&
+        Pycairo_output_sink_flush (item->sink) < 0)
+      item->status = CAIRO_STATUS_WRITE_ERROR;
+  }
+  return item->status;
+}
+
+/* Implements cairo.write_pngs(): writes each (surface, file) pair of the
+ * sequence items using up to threads threads, and returns a list with the
+ * Status of each item */
+PyObject *
+surface_write_pngs (PyObject *items_arg, int threads) {
+  PyObject *seq, *entry, *file, *status_obj, *result = NULL;
+  PycairoSurface *surface;
+  PycairoPngItem *items;
+  Py_ssize_t i, n;
+
+  if (threads < 0) {
+    PyErr_SetString (PyExc_ValueError, "threads must not be negative");
+    return NULL;
+  }
+  if (threads == 0 && (threads = Pycairo_cpu_count ()) < 0)
+    return NULL;
+
+  seq = PySequence_Fast (items_arg, "write_pngs() argument must be a sequence");
+  if (seq == NULL)
+    return NULL;
+  n = PySequence_Fast_GET_SIZE (seq);
+  if (n > INT_MAX) {
+    Py_DECREF (seq);
+    PyErr_SetString (PyExc_OverflowError, "too many items");
+    return NULL;
+  }
+
+  items = PyMem_Calloc ((size_t)Py_MAX (n, 1), sizeof (PycairoPngItem));
+  if (items == NULL) {
+    Py_DECREF (seq);
+    return PyErr_NoMemory ();
+  }
+
+  for (i = 0; i < n; i++) {
+    entry = PySequence_Fast_GET_ITEM (seq, i);
+    if (!PyTuple_Check (entry) || PyTuple_GET_SIZE (entry) != 2) {
+      PyErr_SetString (PyExc_TypeError,
+                       "write_pngs() items must be (surface, file) tuples");
+      goto out;
+    }
+    if (!PyArg_ParseTuple (entry, "O!O:write_pngs", &PycairoSurface_Type,
+                           &surface, &file))
+      goto out;
+    items[i].surface = cairo_surface_reference (surface->surface);
+    /* Reported for items which didn't get run */
+    items[i].status = CAIRO_STATUS_NO_MEMORY;
+
+    if (Pycairo_is_fspath (file)) {
+      if (!Pycairo_fspath_converter (file, &items[i].name))
+        goto out;
+    } else if (Pycairo_writer_converter (file, &file)) {
+      items[i].sink = Pycairo_output_sink_new (file);
+      if (items[i].sink == NULL)
+        goto out;
+    } else {
+      PyErr_Clear ();
+      PyErr_SetString (PyExc_TypeError,
+                       "write_pngs() files must be filenames, file objects, "
+                       "or file-like objects which have a \"write\" method "
+                       "(like BytesIO) taking bytes");
+      goto out;
+    }
+  }
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
+  Pycairo_parallel_for (0, (int)n, threads, 0, _write_pngs_item, items);
+  PYCAIRO_PROBE_RETURN (NULL);
+  Py_END_ALLOW_THREADS;
+
+  result = PyList_New (n);
+  if (result == NULL)
+    goto out;
+  for (i = 0; i < n; i++) {
+    status_obj = CREATE_INT_ENUM (Status, items[i].status);
+    if (status_obj == NULL) {
+      Py_CLEAR (result);
+      goto out;
+    }
+    PyList_SET_ITEM (result, i, status_obj);
+  }
+
+ out:
+  for (i = 0; i < n; i++) {
+    if (items[i].sink != NULL)
+      Pycairo_output_sink_destroy (items[i].sink);
+    if (items[i].surface != NULL)
+      cairo_surface_destroy (items[i].surface);
+    PyMem_Free (items[i].name);
+  }
+  PyMem_Free (items);
+  Py_DECREF (seq);
+  return result;
+}
 #endif  /* CAIRO_HAS_PNG_FUNCTIONS */
 
 static void
@@ -540,6 +1561,109 @@ surface_set_mime_data (PycairoSurface *o, PyObject *args) {
   Py_RETURN_NONE;
 }
 
+#ifdef PYCAIRO_HAS_MMAP
+typedef struct {
+  void *data;
+  size_t size;
+} PycairoMimeMapping;
+
+static void
+_mime_mapping_destroy_func (void *user_data) {
+  PycairoMimeMapping *mapping = user_data;
+
+  munmap (mapping->data, mapping->size);
+  PyMem_RawFree (mapping);
+}
+
+/* Maps a whole file read-only. Returns 0, an errno value, or -1 if the file
+ * is empty. The file descriptor isn't kept open. */
+static int
+_map_mime_file (const char *path, PycairoMimeMapping *mapping) {
+  struct stat st;
+  int fd, flags = O_RDONLY, err;
+
+#ifdef O_CLOEXEC
+  flags |= O_CLOEXEC;
+#endif
+
+  fd = open (path, flags);
+  if (fd < 0)
+    return errno;
+
+  if (fstat (fd, &st) < 0) {
+    err = errno;
+    close (fd);
+    return err;
+  }
+  if (st.st_size <= 0) {
+    close (fd);
+    return -1;
+  }
+
+  mapping->size = (size_t)st.st_size;
+  mapping->data = mmap (NULL, mapping->size, PROT_READ, MAP_PRIVATE, fd, 0);
+  err = mapping->data == MAP_FAILED ? errno : 0;
+  close (fd);
+#ifdef MADV_SEQUENTIAL
+  /* cairo reads the data once, front to back, when writing the document */
+  if (err == 0)
+    madvise (mapping->data, mapping->size, MADV_SEQUENTIAL);
+#endif
+  return err;
+}
+
+static PyObject *
+surface_set_mime_data_from_file (PycairoSurface *o, PyObject *args) {
+  PycairoMimeMapping *mapping;
+  const char *mime_type;
+  char *path;
+  int err;
+  cairo_status_t status;
+
+  if (!PyArg_ParseTuple (args, "sO&:Surface.set_mime_data_from_file",
+                         &mime_type, Pycairo_fspath_converter, &path))
+    return NULL;
+
+  mapping = PyMem_RawMalloc (sizeof (PycairoMimeMapping));
+  if (mapping == NULL) {
+    PyMem_Free (path);
+    return PyErr_NoMemory ();
+  }
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
+  err = _map_mime_file (path, mapping);
+  PYCAIRO_PROBE_RETURN (NULL);
+  Py_END_ALLOW_THREADS;
+
+  if (err != 0) {
+    PyMem_RawFree (mapping);
+    if (err < 0)
+      PyErr_SetString (PyExc_ValueError, "file is empty");
+    else {
+      errno = err;
+      PyErr_SetFromErrnoWithFilename (PyExc_OSError, path);
+    }
+    PyMem_Free (path);
+    return NULL;
+  }
+  PyMem_Free (path);
+
+  /* cairo keeps the mapping until the mime data gets replaced or the last
+   * snapshot using it is gone */
+  status = cairo_surface_set_mime_data (
+    o->surface, mime_type, mapping->data, (unsigned long)mapping->size,
+    _mime_mapping_destroy_func, mapping);
+  if (status != CAIRO_STATUS_SUCCESS) {
+    _mime_mapping_destroy_func (mapping);
+    Pycairo_Check_Status (status);
+    return NULL;
+  }
+
+  Py_RETURN_NONE;
+}
+#endif /* PYCAIRO_HAS_MMAP */
+
 static PyObject *
 surface_get_mime_data (PycairoSurface *o, PyObject *args) {
   PyObject *user_data, *obj, *mime_intern;
@@ -580,12 +1704,181 @@ surface_supports_mime_type (PycairoSurface *self, PyObject *args) {
     cairo_surface_supports_mime_type(self->surface, mime_type));
 }
 
-static PyObject *
-surface_has_show_text_glyphs (PycairoSurface *o, PyObject *ignored) {
+/* Content based unique IDs ------------------------------------------------ */
+
+#define CONTENT_ID_PREFIX "pycairo-content:"
+#define CONTENT_HASH_P1 UINT64_C(0x9E3779B185EBCA87)
+#define CONTENT_HASH_P2 UINT64_C(0xC2B2AE3D27D4EB4F)
+#define CONTENT_HASH_P3 UINT64_C(0x165667B19E3779F9)
+
+static const cairo_user_data_key_t surface_deduplicate_images_key;
+
+static inline uint64_t
+_content_hash_rotl (uint64_t x, int r) {
+  return (x << r) | (x >> (64 - r));
+}
+
+static inline uint64_t
+_content_hash_round (uint64_t acc, uint64_t input) {
+  acc += input * CONTENT_HASH_P2;
+  return _content_hash_rotl (acc, 31) * CONTENT_HASH_P1;
+}
+
+/* Number of bytes per row holding pixels, without the padding up to the
+ * stride */
+static int
+_image_surface_row_size (cairo_format_t format, int width, int stride) {
+  switch (format) {
+    case CAIRO_FORMAT_ARGB32:
+    case CAIRO_FORMAT_RGB24:
+    case CAIRO_FORMAT_RGB30:
+      return width * 4;
+    case CAIRO_FORMAT_RGB16_565:
+      return width * 2;
+    case CAIRO_FORMAT_A8:
+      return width;
+    case CAIRO_FORMAT_A1:
+      return (width + 7) / 8;
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 17, 2)
+    case CAIRO_FORMAT_RGB96F:
+      return width * 12;
+    case CAIRO_FORMAT_RGBA128F:
+      return width * 16;
+#endif
+    default:
+      return stride;
+  }
+}
+
+/* 64 bit non-cryptographic hash of the pixel rows, four independent lanes
+ * of 64 bit multiply-rotate rounds */
+static uint64_t
+_image_surface_content_hash (const unsigned char *data, int stride,
+                             int row_size, int height) {
+  uint64_t acc[4] = {
+    CONTENT_HASH_P1 + CONTENT_HASH_P2, CONTENT_HASH_P2, 0, -CONTENT_HASH_P1};
+  uint64_t words[4], h;
+  const unsigned char *row;
+  int x, y;
+
+  for (y = 0; y < height; y++) {
+    row = data + (ptrdiff_t)y * stride;
+    for (x = 0; x + 32 <= row_size; x += 32) {
+      memcpy (words, row + x, 32);
+      acc[0] = _content_hash_round (acc[0], words[0]);
+      acc[1] = _content_hash_round (acc[1], words[1]);
+      acc[2] = _content_hash_round (acc[2], words[2]);
+      acc[3] = _content_hash_round (acc[3], words[3]);
+    }
+    for (; x + 8 <= row_size; x += 8) {
+      memcpy (words, row + x, 8);
+      acc[2] = _content_hash_round (acc[2], words[0]);
+    }
+    for (; x < row_size; x++)
+      acc[3] = _content_hash_round (acc[3], row[x]);
+  }
+
+  h = _content_hash_rotl (acc[0], 1) + _content_hash_rotl (acc[1], 7) +
+      _content_hash_rotl (acc[2], 12) + _content_hash_rotl (acc[3], 18);
+  h ^= h >> 33;
+  h *= CONTENT_HASH_P2;
+  h ^= h >> 29;
+  h *= CONTENT_HASH_P3;
+  h ^= h >> 32;
+  return h;
+}
+
+/* Sets CAIRO_MIME_TYPE_UNIQUE_ID of an image surface to a hash of its
+ * pixels, so PDF, PS and SVG output embeds images with equal contents only
+ * once. Existing unique IDs are replaced only if force is set, other
+ * surface types are ignored. Doesn't need the GIL. */
+cairo_status_t
+Pycairo_image_surface_tag_content (cairo_surface_t *image, int force) {
+  const unsigned char *current, *data;
+  unsigned long current_length;
+  cairo_format_t format;
+  int width, height, stride;
+  uint64_t hash;
+  char *id;
+  size_t length;
+  cairo_status_t status;
+
+  if (cairo_surface_get_type (image) != CAIRO_SURFACE_TYPE_IMAGE ||
+      cairo_surface_status (image) != CAIRO_STATUS_SUCCESS)
+    return CAIRO_STATUS_SUCCESS;
+
+  /* cairo drops the mime data of a surface when it gets drawn on or marked
+   * dirty, so an ID which is still there matches the pixels: ours doesn't
+   * need hashing again and the ones set by the user are kept */
+  cairo_surface_get_mime_data (image, CAIRO_MIME_TYPE_UNIQUE_ID,
+                               &current, &current_length);
+  if (current != NULL && !force)
+    return CAIRO_STATUS_SUCCESS;
+
+  cairo_surface_flush (image);
+  data = cairo_image_surface_get_data (image);
+  if (data == NULL)
+    return CAIRO_STATUS_SUCCESS;
+  format = cairo_image_surface_get_format (image);
+  width = cairo_image_surface_get_width (image);
+  height = cairo_image_surface_get_height (image);
+  stride = cairo_image_surface_get_stride (image);
+  hash = _image_surface_content_hash (
+    data, stride, _image_surface_row_size (format, width, stride), height);
+
+  id = malloc (64);
+  if (id == NULL)
+    return CAIRO_STATUS_NO_MEMORY;
+  PyOS_snprintf (id, 64, CONTENT_ID_PREFIX "%016llx-%dx%d-%d",
+                 (unsigned long long)hash, width, height, (int)format);
+  length = strlen (id);
+  if (current != NULL && current_length == length &&
+      memcmp (current, id, length) == 0) {
+    free (id);
+    return CAIRO_STATUS_SUCCESS;
+  }
+
+  status = cairo_surface_set_mime_data (
+    image, CAIRO_MIME_TYPE_UNIQUE_ID, (unsigned char *)id, length, free, id);
+  if (status != CAIRO_STATUS_SUCCESS)
+    free (id);
+  return status;
+}
+
+int
+Pycairo_surface_get_deduplicate_images (cairo_surface_t *surface) {
+  return cairo_surface_get_user_data (
+    surface, &surface_deduplicate_images_key) != NULL;
+}
+
+static PyObject *
+surface_set_deduplicate_images (PycairoSurface *o, PyObject *args) {
+  int enabled;
+  cairo_status_t status;
+
+  if (!PyArg_ParseTuple (args, "p:Surface.set_deduplicate_images", &enabled))
+    return NULL;
+
+  status = cairo_surface_set_user_data (
+    o->surface, &surface_deduplicate_images_key,
+    enabled ? (void *)1 : NULL, NULL);
+  RETURN_NULL_IF_CAIRO_ERROR (status);
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+surface_get_deduplicate_images (PycairoSurface *o, PyObject *ignored) {
+  return PyBool_FromLong (Pycairo_surface_get_deduplicate_images (o->surface));
+}
+
+static PyObject *
+surface_has_show_text_glyphs (PycairoSurface *o, PyObject *ignored) {
   cairo_bool_t result;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   result = cairo_surface_has_show_text_glyphs (o->surface);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR (o->surface);
@@ -594,11 +1887,32 @@ surface_has_show_text_glyphs (PycairoSurface *o, PyObject *ignored) {
 
 #ifdef CAIRO_HAS_IMAGE_SURFACE
 
+/* Returns the expected size of the image cairo allocates for mapping extents
+ * of surface, or 0 if it isn't known up front */
+static size_t
+_surface_map_size (cairo_surface_t *surface, cairo_rectangle_int_t *extents) {
+#ifdef CAIRO_HAS_RECORDING_SURFACE
+  cairo_rectangle_t rect;
+#endif
+
+  if (extents != NULL)
+    return _image_memory_size (CAIRO_FORMAT_ARGB32, extents->width,
+                               extents->height);
+#ifdef CAIRO_HAS_RECORDING_SURFACE
+  if (cairo_surface_get_type (surface) == CAIRO_SURFACE_TYPE_RECORDING &&
+      cairo_recording_surface_get_extents (surface, &rect))
+    return _image_memory_size (CAIRO_FORMAT_ARGB32, (int)ceil (rect.width),
+                               (int)ceil (rect.height));
+#endif
+  return 0;
+}
+
 static PyObject *
 surface_map_to_image (PycairoSurface *self, PyObject *args) {
   PyObject *pyextents, *pymapped;
   cairo_rectangle_int_t *extents;
   cairo_surface_t *mapped_surface;
+  size_t size = 0, reserved, extra;
 
   if (!PyArg_ParseTuple(args, "O:Surface.map_to_image", &pyextents))
     return NULL;
@@ -615,15 +1929,52 @@ surface_map_to_image (PycairoSurface *self, PyObject *args) {
     }
   }
 
+  /* Mapping an image surface gives a view of the same memory, for other
+   * surfaces a new image gets allocated. */
+  if (cairo_surface_get_type (self->surface) != CAIRO_SURFACE_TYPE_IMAGE)
+    size = _surface_map_size (self->surface, extents);
+  if (_image_memory_reserve (size, &reserved) < 0)
+    return NULL;
+
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (self->surface);
   mapped_surface = cairo_surface_map_to_image (self->surface, extents);
+  PYCAIRO_PROBE_RETURN (self->surface);
   Py_END_ALLOW_THREADS;
 
   if (Pycairo_Check_Status (cairo_surface_status (mapped_surface))) {
+    _image_memory_unreserve (reserved);
     cairo_surface_destroy (mapped_surface);
     return NULL;
   }
 
+  /* The expected size can be off or unknown, so check the real one before
+   * accounting the image */
+  if (cairo_surface_get_type (self->surface) != CAIRO_SURFACE_TYPE_IMAGE) {
+    size = (size_t)cairo_image_surface_get_stride (mapped_surface) *
+      (size_t)cairo_image_surface_get_height (mapped_surface);
+    if (size > reserved) {
+      if (_image_memory_reserve (size - reserved, &extra) < 0) {
+        _image_memory_unreserve (reserved);
+        Py_BEGIN_ALLOW_THREADS;
+        PYCAIRO_PROBE_ENTRY (self->surface);
+        cairo_surface_unmap_image (self->surface, mapped_surface);
+        PYCAIRO_PROBE_RETURN (self->surface);
+        Py_END_ALLOW_THREADS;
+        return NULL;
+      }
+      reserved += extra;
+    }
+  }
+
+  /* Images mapped from other surface types own their pixels, which stay
+   * accounted until cairo destroys the image on unmap. Views into an image
+   * surface only count as a live surface. */
+  _surface_account_add_full (
+    mapped_surface,
+    cairo_surface_get_type (self->surface) != CAIRO_SURFACE_TYPE_IMAGE);
+  _image_memory_unreserve (reserved);
+
   /* So we can skip the destroy() call in the base tp_dealloc */
   cairo_surface_set_user_data (
     mapped_surface, &surface_is_mapped_image, (void*)1, NULL);
@@ -633,7 +1984,9 @@ surface_map_to_image (PycairoSurface *self, PyObject *args) {
 
   if (pymapped == NULL) {
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (self->surface);
     cairo_surface_unmap_image (self->surface, mapped_surface);
+    PYCAIRO_PROBE_RETURN (self->surface);
     Py_END_ALLOW_THREADS;
     return NULL;
   }
@@ -668,8 +2021,13 @@ surface_unmap_image (PycairoSurface *self, PyObject *args) {
     return NULL;
   }
 
+  if (_surface_check_not_exported (pymapped->surface) < 0)
+    return NULL;
+
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (self->surface);
   cairo_surface_unmap_image (self->surface, pymapped->surface);
+  PYCAIRO_PROBE_RETURN (self->surface);
   Py_END_ALLOW_THREADS;
 
   /* Replace the mapped image surface with a fake one and finish it so
@@ -677,6 +2035,7 @@ surface_unmap_image (PycairoSurface *self, PyObject *args) {
    */
   fake_surface = cairo_image_surface_create (CAIRO_FORMAT_ARGB32, 0, 0);
   cairo_surface_finish (fake_surface);
+  _surface_mark_finished (fake_surface);
   pymapped->surface = fake_surface;
   /* We no longer need the base surface */
   Py_CLEAR(pymapped->base);
@@ -694,9 +2053,27 @@ surface_ctx_enter (PyObject *obj, PyObject *ignored) {
 
 static PyObject *
 surface_ctx_exit (PycairoSurface *obj, PyObject *args) {
+  int err, output_err;
+
+  if (_surface_check_not_exported (obj->surface) < 0)
+    return NULL;
+  if (Pycairo_surface_wait_pages (obj->surface) < 0)
+    return NULL;
+
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (obj->surface);
   cairo_surface_finish (obj->surface);
+  PYCAIRO_PROBE_RETURN (obj->surface);
+  _surface_account_finish (obj->surface);
+  err = _surface_mapping_release (obj->surface);
+  output_err = _surface_flush_output (obj->surface);
   Py_END_ALLOW_THREADS;
+  _surface_mark_finished (obj->surface);
+  _surface_release_pixels (obj->surface);
+  if (err != 0)
+    return _surface_mapping_error (err);
+  if (output_err < 0)
+    RETURN_NULL_IF_CAIRO_ERROR (CAIRO_STATUS_WRITE_ERROR);
   Py_RETURN_NONE;
 }
 
@@ -715,6 +2092,7 @@ static PyMethodDef surface_methods[] = {
   {"create_similar_image", (PyCFunction)surface_create_similar_image,
    METH_VARARGS},
   {"finish",         (PyCFunction)surface_finish,             METH_NOARGS},
+  {"finish_async",   (PyCFunction)surface_finish_async,       METH_NOARGS},
   {"flush",          (PyCFunction)surface_flush,              METH_NOARGS},
   {"get_content",    (PyCFunction)surface_get_content,        METH_NOARGS},
   {"get_device_offset",(PyCFunction)surface_get_device_offset,METH_NOARGS},
@@ -723,18 +2101,28 @@ static PyMethodDef surface_methods[] = {
    METH_NOARGS},
   {"get_font_options",(PyCFunction)surface_get_font_options,  METH_NOARGS},
   {"get_device",     (PyCFunction)surface_get_device,         METH_NOARGS},
+  {"get_deduplicate_images", (PyCFunction)surface_get_deduplicate_images,
+   METH_NOARGS},
   {"mark_dirty",     (PyCFunction)surface_mark_dirty,         METH_NOARGS},
   {"mark_dirty_rectangle", (PyCFunction)surface_mark_dirty_rectangle,
    METH_VARARGS},
   {"set_device_offset",(PyCFunction)surface_set_device_offset,METH_VARARGS},
   {"set_device_scale", (PyCFunction)surface_set_device_scale, METH_VARARGS},
+  {"set_deduplicate_images", (PyCFunction)surface_set_deduplicate_images,
+   METH_VARARGS},
   {"set_fallback_resolution",(PyCFunction)surface_set_fallback_resolution,
    METH_VARARGS},
   {"show_page",      (PyCFunction)surface_show_page,          METH_NOARGS},
 #ifdef CAIRO_HAS_PNG_FUNCTIONS
   {"write_to_png",   (PyCFunction)surface_write_to_png,       METH_VARARGS},
+  {"write_to_png_async", (PyCFunction)surface_write_to_png_async,
+   METH_VARARGS},
 #endif
   {"set_mime_data",  (PyCFunction)surface_set_mime_data,      METH_VARARGS},
+#ifdef PYCAIRO_HAS_MMAP
+  {"set_mime_data_from_file", (PyCFunction)surface_set_mime_data_from_file,
+   METH_VARARGS},
+#endif
   {"get_mime_data",  (PyCFunction)surface_get_mime_data,      METH_VARARGS},
   {"supports_mime_type", (PyCFunction)surface_supports_mime_type,
    METH_VARARGS},
@@ -763,100 +2151,733 @@ surface_richcompare (PyObject *self, PyObject *other, int op)
   }
 }
 
-static Py_hash_t
-surface_hash (PyObject *self)
-{
-  return PYCAIRO_Py_hash_t_FromVoidPtr (((PycairoSurface *)self)->surface);
+static Py_hash_t
+surface_hash (PyObject *self)
+{
+  return PYCAIRO_Py_hash_t_FromVoidPtr (((PycairoSurface *)self)->surface);
+}
+
+PyTypeObject PycairoSurface_Type = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "cairo.Surface",                    /* tp_name */
+  sizeof(PycairoSurface),             /* tp_basicsize */
+  0,                                  /* tp_itemsize */
+  (destructor)surface_dealloc,        /* tp_dealloc */
+  0,                                  /* tp_print */
+  0,                                  /* tp_getattr */
+  0,                                  /* tp_setattr */
+  0,                                  /* tp_compare */
+  0,                                  /* tp_repr */
+  0,                                  /* tp_as_number */
+  0,                                  /* tp_as_sequence */
+  0,                                  /* tp_as_mapping */
+  surface_hash,                       /* tp_hash */
+  0,                                  /* tp_call */
+  0,                                  /* tp_str */
+  0,                                  /* tp_getattro */
+  0,                                  /* tp_setattro */
+  0,                                  /* tp_as_buffer */
+  Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,/* tp_flags */
+  0,                                  /* tp_doc */
+  0,                                  /* tp_traverse */
+  0,                                  /* tp_clear */
+  surface_richcompare,                /* tp_richcompare */
+  0,                                  /* tp_weaklistoffset */
+  0,                                  /* tp_iter */
+  0,                                  /* tp_iternext */
+  surface_methods,                    /* tp_methods */
+  0,                                  /* tp_members */
+  0,                                  /* tp_getset */
+  0,                                  /* tp_base */
+  0,                                  /* tp_dict */
+  0,                                  /* tp_descr_get */
+  0,                                  /* tp_descr_set */
+  0,                                  /* tp_dictoffset */
+  0,                                  /* tp_init */
+  0,                                  /* tp_alloc */
+  (newfunc)surface_new,               /* tp_new */
+  0,                                  /* tp_free */
+  0,                                  /* tp_is_gc */
+  0,                                  /* tp_bases */
+};
+
+
+/* Class ImageSurface(Surface) -------------------------------------------- */
+#ifdef CAIRO_HAS_IMAGE_SURFACE
+
+/* Pixel memory for image surfaces created with a non-default allocator,
+ * freed when the surface is finished or destroyed. */
+
+typedef enum {
+  IMAGE_ALLOCATOR_DEFAULT,
+  IMAGE_ALLOCATOR_ALIGNED64,
+  IMAGE_ALLOCATOR_HUGEPAGE,
+} PycairoImageAllocator;
+
+#define IMAGE_ALLOCATOR_ALIGNMENT 64
+#define IMAGE_ALLOCATOR_HUGE_PAGE_SIZE ((size_t)2 * 1024 * 1024)
+
+typedef struct {
+  void *base;
+  size_t map_size; /* 0 for heap memory */
+} PycairoPixelMemory;
+
+static void
+_pixel_memory_destroy_func (void *user_data) {
+  PycairoPixelMemory *mem = user_data;
+
+#ifdef PYCAIRO_HAS_MMAP
+  if (mem->map_size != 0)
+    munmap (mem->base, mem->map_size);
+  else
+#endif
+    PyMem_RawFree (mem->base);
+  PyMem_RawFree (mem);
+}
+
+/* Allocates @size bytes of zeroed, 64 byte aligned memory. Huge pages are
+ * only a hint, if none are available normal pages are used. Returns NULL on
+ * failure. */
+static unsigned char *
+_pixel_memory_alloc (PycairoImageAllocator allocator, size_t size,
+                     PycairoPixelMemory *mem) {
+  uintptr_t addr;
+
+#if defined(PYCAIRO_HAS_MMAP) && defined(MAP_ANONYMOUS)
+  if (allocator == IMAGE_ALLOCATOR_HUGEPAGE && size > 0) {
+    size_t map_size = (size + IMAGE_ALLOCATOR_HUGE_PAGE_SIZE - 1) &
+      ~(IMAGE_ALLOCATOR_HUGE_PAGE_SIZE - 1);
+    void *data = MAP_FAILED;
+
+#ifdef MAP_HUGETLB
+    /* Only succeeds if the administrator has reserved huge pages */
+    data = mmap (NULL, map_size, PROT_READ | PROT_WRITE,
+                 MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+#endif
+    if (data == MAP_FAILED) {
+      data = mmap (NULL, map_size, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (data == MAP_FAILED)
+        return NULL;
+#ifdef MADV_HUGEPAGE
+      /* Ask for transparent huge pages */
+      madvise (data, map_size, MADV_HUGEPAGE);
+#endif
+    }
+    mem->base = data;
+    mem->map_size = map_size;
+    return data;
+  }
+#endif
+
+  mem->base = PyMem_RawCalloc (size + IMAGE_ALLOCATOR_ALIGNMENT - 1, 1);
+  mem->map_size = 0;
+  if (mem->base == NULL)
+    return NULL;
+  addr = ((uintptr_t)mem->base + IMAGE_ALLOCATOR_ALIGNMENT - 1) &
+    ~(uintptr_t)(IMAGE_ALLOCATOR_ALIGNMENT - 1);
+  return (unsigned char *)addr;
+}
+
+static int
+_image_allocator_converter (PyObject *obj, PycairoImageAllocator *allocator) {
+  const char *name;
+
+  if (!PyUnicode_Check (obj)) {
+    PyErr_Format (PyExc_TypeError, "allocator must be str, not %.100s",
+                  Py_TYPE (obj)->tp_name);
+    return 0;
+  }
+  name = PyUnicode_AsUTF8 (obj);
+  if (name == NULL)
+    return 0;
+
+  if (strcmp (name, "default") == 0) {
+    *allocator = IMAGE_ALLOCATOR_DEFAULT;
+  } else if (strcmp (name, "aligned64") == 0) {
+    *allocator = IMAGE_ALLOCATOR_ALIGNED64;
+  } else if (strcmp (name, "hugepage") == 0) {
+    *allocator = IMAGE_ALLOCATOR_HUGEPAGE;
+  } else {
+    PyErr_Format (PyExc_ValueError,
+                  "allocator must be 'default', 'aligned64' or 'hugepage', "
+                  "not '%s'", name);
+    return 0;
+  }
+  return 1;
+}
+
+/* Creates an image surface on memory allocated by us instead of cairo. Rows
+ * start at 64 byte boundaries. Returns NULL and sets an exception if
+ * allocating fails. */
+static cairo_surface_t *
+_image_surface_create_with_allocator (PycairoImageAllocator allocator,
+                                      cairo_format_t format,
+                                      int width, int height) {
+  PycairoPixelMemory *mem;
+  cairo_surface_t *surface;
+  cairo_status_t status;
+  unsigned char *data;
+  int stride;
+
+  stride = cairo_format_stride_for_width (format, width);
+  if (stride < 0 || height < 0 ||
+      stride > INT_MAX - (IMAGE_ALLOCATOR_ALIGNMENT - 1)) {
+    /* Let cairo report the error */
+    return cairo_image_surface_create (format, width, height);
+  }
+  stride = (stride + IMAGE_ALLOCATOR_ALIGNMENT - 1) &
+    ~(IMAGE_ALLOCATOR_ALIGNMENT - 1);
+
+  mem = PyMem_RawMalloc (sizeof (PycairoPixelMemory));
+  if (mem == NULL) {
+    PyErr_NoMemory ();
+    return NULL;
+  }
+
+  data = _pixel_memory_alloc (allocator, (size_t)stride * (size_t)height,
+                              mem);
+  if (data == NULL) {
+    PyMem_RawFree (mem);
+    PyErr_NoMemory ();
+    return NULL;
+  }
+
+  surface = cairo_image_surface_create_for_data (
+    data, format, width, height, stride);
+  if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+    _pixel_memory_destroy_func (mem);
+    return surface;
+  }
+
+  status = cairo_surface_set_user_data (surface, &surface_pixels_key, mem,
+                                        _pixel_memory_destroy_func);
+  if (status != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy (surface);
+    _pixel_memory_destroy_func (mem);
+    Pycairo_Check_Status (status);
+    return NULL;
+  }
+
+  return surface;
+}
+
+static PyObject *
+image_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
+  static char *kwlist[] = {"format", "width", "height", "allocator", NULL};
+  PycairoImageAllocator allocator = IMAGE_ALLOCATOR_DEFAULT;
+  cairo_surface_t *surface;
+  cairo_format_t format;
+  int width, height, format_arg;
+  PyObject *result;
+  size_t reserved, size;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "iii|O&:ImageSurface.__new__",
+                                    kwlist, &format_arg, &width, &height,
+                                    _image_allocator_converter, &allocator))
+    return NULL;
+
+  format = (cairo_format_t)format_arg;
+
+  size = _image_memory_size (format, width, height);
+  if (allocator != IMAGE_ALLOCATOR_DEFAULT && size != 0)
+    size += (size_t)(IMAGE_ALLOCATOR_ALIGNMENT - 1) * (size_t)height;
+  if (_image_memory_reserve (size, &reserved) < 0)
+    return NULL;
+
+  if (allocator == IMAGE_ALLOCATOR_DEFAULT)
+    surface = cairo_image_surface_create (format, width, height);
+  else
+    surface = _image_surface_create_with_allocator (
+      allocator, format, width, height);
+
+  if (surface == NULL) {
+    _image_memory_unreserve (reserved);
+    return NULL;
+  }
+
+  result = _image_surface_from_allocation (surface);
+  _image_memory_unreserve (reserved);
+  return result;
+}
+
+static void
+_release_buffer_destroy_func (void *user_data) {
+  Py_buffer *view = (Py_buffer *)user_data;
+  PyGILState_STATE gstate = PyGILState_Ensure();
+  PyBuffer_Release (view);
+  PyMem_Free (view);
+  PyGILState_Release(gstate);
+}
+
+/* Creates an image surface using the writable buffer of obj, which is kept
+ * exported until the surface is finished. Returns NULL and sets an exception
+ * on error. */
+static cairo_surface_t *
+_image_surface_create_for_buffer (PyObject *obj, cairo_format_t format,
+                                  int width, int height, int stride) {
+  cairo_surface_t *surface;
+  cairo_status_t status;
+  int res;
+
+  if (width < 0) {
+    PyErr_SetString(PyExc_ValueError, "width cannot be negative");
+    return NULL;
+  }
+  if (height < 0) {
+    PyErr_SetString(PyExc_ValueError, "height cannot be negative");
+    return NULL;
+  }
+  /* if stride is missing, calculate it from width */
+  if (stride < 0) {
+    stride = cairo_format_stride_for_width (format, width);
+    if (stride == -1){
+      PyErr_SetString(PyExc_ValueError,
+		      "format is invalid or the width too large");
+      return NULL;
+    }
+  }
+
+  Py_buffer *view = PyMem_Malloc (sizeof (Py_buffer));
+  if (view == NULL) {
+    PyErr_NoMemory ();
+    return NULL;
+  }
+
+  res = PyObject_GetBuffer (obj, view, PyBUF_WRITABLE);
+  if (res == -1) {
+    PyMem_Free (view);
+    return NULL;
+  }
+
+  if (height * stride > view->len) {
+    PyBuffer_Release (view);
+    PyMem_Free (view);
+    PyErr_SetString(PyExc_TypeError, "buffer is not long enough");
+    return NULL;
+  }
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
+  surface = cairo_image_surface_create_for_data (view->buf, format, width,
+                                                 height, stride);
+  PYCAIRO_PROBE_RETURN (NULL);
+  Py_END_ALLOW_THREADS;
+
+  status = cairo_surface_set_user_data(
+    surface, &surface_buffer_view_key, view,
+    (cairo_destroy_func_t)_release_buffer_destroy_func);
+  if (Pycairo_Check_Status (status)) {
+    cairo_surface_destroy (surface);
+    PyBuffer_Release (view);
+    PyMem_Free (view);
+    return NULL;
+  }
+
+  return surface;
+}
+
+/* METH_CLASS */
+static PyObject *
+image_surface_create_for_data (PyTypeObject *type, PyObject *args) {
+  cairo_surface_t *surface;
+  int width, height, stride = -1, format_arg;
+  PyObject *obj;
+
+  if (!PyArg_ParseTuple (args, "Oiii|i:ImageSurface.create_for_data",
+                         &obj, &format_arg, &width, &height, &stride))
+    return NULL;
+
+  surface = _image_surface_create_for_buffer (
+    obj, (cairo_format_t)format_arg, width, height, stride);
+  if (surface == NULL)
+    return NULL;
+
+  return PycairoSurface_FromSurface(surface, NULL);
+}
+
+/* Shared memory ---------------------------------------------------------- */
+
+/* Surfaces created by create_shared() and open_shared() use the buffer of a
+ * multiprocessing.shared_memory.SharedMemory instance, which is attached to
+ * the surface so it stays open as long as the surface exists.
+ */
+
+static void
+_release_object_destroy_func (void *user_data) {
+  PyGILState_STATE gstate = PyGILState_Ensure();
+  Py_DECREF ((PyObject *)user_data);
+  PyGILState_Release(gstate);
+}
+
+static PyObject *
+_shared_memory_new (PyObject *name, int create, Py_ssize_t size) {
+  PyObject *module, *cls, *shm, *args, *kwargs;
+
+  module = PyImport_ImportModule ("multiprocessing.shared_memory");
+  if (module == NULL)
+    return NULL;
+
+  args = Py_BuildValue ("(O)", name);
+  if (args == NULL) {
+    Py_DECREF (module);
+    return NULL;
+  }
+
+  if (create) {
+    kwargs = Py_BuildValue ("{s:O,s:n}", "create", Py_True, "size", size);
+  } else {
+#if PY_VERSION_HEX >= 0x030D0000
+    /* The process creating the segment is responsible for unlinking it */
+    kwargs = Py_BuildValue ("{s:O}", "track", Py_False);
+#else
+    kwargs = PyDict_New ();
+#endif
+  }
+  if (kwargs == NULL) {
+    Py_DECREF (args);
+    Py_DECREF (module);
+    return NULL;
+  }
+
+  cls = PyObject_GetAttrString (module, "SharedMemory");
+  Py_DECREF (module);
+  shm = cls != NULL ? PyObject_Call (cls, args, kwargs) : NULL;
+  Py_XDECREF (cls);
+  Py_DECREF (kwargs);
+  Py_DECREF (args);
+  return shm;
+}
+
+/* Creates an image surface using the buffer of shm. Returns NULL and sets an
+ * exception on error. */
+static PyObject *
+_image_surface_from_shared_memory (PyObject *shm, cairo_format_t format,
+                                   int width, int height, int stride) {
+  cairo_surface_t *surface;
+  cairo_status_t status;
+  PyObject *buf;
+
+  buf = PyObject_GetAttrString (shm, "buf");
+  if (buf == NULL)
+    return NULL;
+
+  surface = _image_surface_create_for_buffer (buf, format, width, height,
+                                              stride);
+  Py_DECREF (buf);
+  if (surface == NULL)
+    return NULL;
+
+  Py_INCREF (shm);
+  status = cairo_surface_set_user_data (
+    surface, &surface_shared_memory_key, shm, _release_object_destroy_func);
+  if (Pycairo_Check_Status (status)) {
+    cairo_surface_destroy (surface);
+    Py_DECREF (shm);
+    return NULL;
+  }
+
+  return PycairoSurface_FromSurface (surface, NULL);
+}
+
+/* Calls shm.close() and optionally shm.unlink(), keeping the current
+ * exception */
+static void
+_shared_memory_discard (PyObject *shm, int unlink) {
+  PyObject *type, *value, *traceback, *res;
+
+  PyErr_Fetch (&type, &value, &traceback);
+  res = PyObject_CallMethod (shm, "close", NULL);
+  Py_XDECREF (res);
+  if (unlink) {
+    res = PyObject_CallMethod (shm, "unlink", NULL);
+    Py_XDECREF (res);
+  }
+  PyErr_Clear ();
+  PyErr_Restore (type, value, traceback);
+}
+
+/* METH_CLASS */
+static PyObject *
+image_surface_create_shared (PyTypeObject *type, PyObject *args,
+                             PyObject *kwds) {
+  static char *kwlist[] = {"format", "width", "height", "name", NULL};
+  PyObject *name = Py_None, *shm, *result;
+  cairo_format_t format;
+  int format_arg, width, height, stride;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds,
+                                    "iii|O:ImageSurface.create_shared",
+                                    kwlist, &format_arg, &width, &height,
+                                    &name))
+    return NULL;
+
+  format = (cairo_format_t)format_arg;
+
+  if (width < 0 || height < 0) {
+    PyErr_SetString (PyExc_ValueError, "width and height cannot be negative");
+    return NULL;
+  }
+  stride = cairo_format_stride_for_width (format, width);
+  if (stride == -1) {
+    PyErr_SetString (PyExc_ValueError,
+                     "format is invalid or the width too large");
+    return NULL;
+  }
+
+  /* shared memory segments can't be empty */
+  shm = _shared_memory_new (
+    name, 1, Py_MAX ((Py_ssize_t)stride * height, 1));
+  if (shm == NULL)
+    return NULL;
+
+  result = _image_surface_from_shared_memory (shm, format, width, height,
+                                              stride);
+  if (result == NULL)
+    _shared_memory_discard (shm, 1);
+  Py_DECREF (shm);
+  return result;
+}
+
+/* METH_CLASS */
+static PyObject *
+image_surface_open_shared (PyTypeObject *type, PyObject *args) {
+  PyObject *name, *shm, *result;
+  int format_arg, width, height, stride = -1;
+
+  if (!PyArg_ParseTuple (args, "Uiii|i:ImageSurface.open_shared",
+                         &name, &format_arg, &width, &height, &stride))
+    return NULL;
+
+  shm = _shared_memory_new (name, 0, 0);
+  if (shm == NULL)
+    return NULL;
+
+#if PY_VERSION_HEX < 0x030D0000 && !defined(MS_WINDOWS)
+  {
+    /* Opening registers the segment with the resource tracker, which would
+     * unlink it once this process exits. Only the creator should do that. */
+    PyObject *tracker, *shm_name, *res = NULL;
+
+    tracker = PyImport_ImportModule ("multiprocessing.resource_tracker");
+    shm_name = PyObject_GetAttrString (shm, "_name");
+    if (tracker != NULL && shm_name != NULL)
+      res = PyObject_CallMethod (tracker, "unregister", "Os", shm_name,
+                                 "shared_memory");
+    Py_XDECREF (shm_name);
+    Py_XDECREF (tracker);
+    if (res == NULL) {
+      _shared_memory_discard (shm, 0);
+      Py_DECREF (shm);
+      return NULL;
+    }
+    Py_DECREF (res);
+  }
+#endif
+
+  result = _image_surface_from_shared_memory (
+    shm, (cairo_format_t)format_arg, width, height, stride);
+  if (result == NULL)
+    _shared_memory_discard (shm, 0);
+  Py_DECREF (shm);
+  return result;
 }
 
-PyTypeObject PycairoSurface_Type = {
-  PyVarObject_HEAD_INIT(NULL, 0)
-  "cairo.Surface",                    /* tp_name */
-  sizeof(PycairoSurface),             /* tp_basicsize */
-  0,                                  /* tp_itemsize */
-  (destructor)surface_dealloc,        /* tp_dealloc */
-  0,                                  /* tp_print */
-  0,                                  /* tp_getattr */
-  0,                                  /* tp_setattr */
-  0,                                  /* tp_compare */
-  0,                                  /* tp_repr */
-  0,                                  /* tp_as_number */
-  0,                                  /* tp_as_sequence */
-  0,                                  /* tp_as_mapping */
-  surface_hash,                       /* tp_hash */
-  0,                                  /* tp_call */
-  0,                                  /* tp_str */
-  0,                                  /* tp_getattro */
-  0,                                  /* tp_setattro */
-  0,                                  /* tp_as_buffer */
-  Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,/* tp_flags */
-  0,                                  /* tp_doc */
-  0,                                  /* tp_traverse */
-  0,                                  /* tp_clear */
-  surface_richcompare,                /* tp_richcompare */
-  0,                                  /* tp_weaklistoffset */
-  0,                                  /* tp_iter */
-  0,                                  /* tp_iternext */
-  surface_methods,                    /* tp_methods */
-  0,                                  /* tp_members */
-  0,                                  /* tp_getset */
-  0,                                  /* tp_base */
-  0,                                  /* tp_dict */
-  0,                                  /* tp_descr_get */
-  0,                                  /* tp_descr_set */
-  0,                                  /* tp_dictoffset */
-  0,                                  /* tp_init */
-  0,                                  /* tp_alloc */
-  (newfunc)surface_new,               /* tp_new */
-  0,                                  /* tp_free */
-  0,                                  /* tp_is_gc */
-  0,                                  /* tp_bases */
-};
+static PyObject *
+image_surface_get_shared_memory (PycairoImageSurface *o, PyObject *ignored) {
+  PyObject *shm = cairo_surface_get_user_data (
+    o->surface, &surface_shared_memory_key);
+
+  if (shm == NULL)
+    Py_RETURN_NONE;
+  Py_INCREF (shm);
+  return shm;
+}
 
 
-/* Class ImageSurface(Surface) -------------------------------------------- */
-#ifdef CAIRO_HAS_IMAGE_SURFACE
+/* Checks that view holds height rows of row_bytes, stride bytes apart */
+static int
+_pixels_buffer_check (Py_buffer *view, Py_ssize_t stride,
+                      Py_ssize_t row_bytes, int height) {
+  if (stride < row_bytes) {
+    PyErr_SetString (PyExc_ValueError, "stride is too small for the width");
+    return -1;
+  }
+  if (height > 0 && (height - 1) * stride + row_bytes > view->len) {
+    PyErr_SetString (PyExc_TypeError, "buffer is not long enough");
+    return -1;
+  }
+  return 0;
+}
 
+/* METH_CLASS */
 static PyObject *
-image_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
-  cairo_format_t format;
-  int width, height, format_arg;
+image_surface_create_from_pixels (PyTypeObject *type, PyObject *args) {
+  PycairoPixelLayout layout, image_layout;
+  cairo_surface_t *surface;
+  Py_ssize_t stride = -1;
+  int width, height, ret = 0;
+  size_t reserved;
+  PyObject *obj, *result;
+  Py_buffer view;
+
+  if (!PyArg_ParseTuple (args, "OO&ii|n:ImageSurface.create_from_pixels",
+                         &obj, Pycairo_pixel_layout_converter, &layout,
+                         &width, &height, &stride))
+    return NULL;
 
-  if (!PyArg_ParseTuple (args, "iii:ImageSurface.__new__",
-                         &format_arg, &width, &height))
+  if (width < 0) {
+    PyErr_SetString(PyExc_ValueError, "width cannot be negative");
     return NULL;
+  }
+  if (height < 0) {
+    PyErr_SetString(PyExc_ValueError, "height cannot be negative");
+    return NULL;
+  }
+  if (stride < 0)
+    stride = Pycairo_pixel_layout_default_stride (&layout, width);
 
-  format = (cairo_format_t)format_arg;
+  if (PyObject_GetBuffer (obj, &view, PyBUF_SIMPLE) == -1)
+    return NULL;
 
-  return PycairoSurface_FromSurface (
-	     cairo_image_surface_create (format, width, height),
-	     NULL);
+  if (_pixels_buffer_check (
+        &view, stride, Pycairo_pixel_layout_row_bytes (&layout, width),
+        height) < 0) {
+    PyBuffer_Release (&view);
+    return NULL;
+  }
+
+  image_layout.type = PYCAIRO_LAYOUT_FORMAT;
+  image_layout.format = Pycairo_pixel_layout_image_format (&layout);
+
+  if (_image_memory_reserve (
+        _image_memory_size (image_layout.format, width, height),
+        &reserved) < 0) {
+    PyBuffer_Release (&view);
+    return NULL;
+  }
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
+  surface = cairo_image_surface_create (image_layout.format, width, height);
+  if (cairo_surface_status (surface) == CAIRO_STATUS_SUCCESS) {
+    cairo_surface_flush (surface);
+    ret = Pycairo_convert_pixels (
+      &layout, view.buf, stride, &image_layout,
+      cairo_image_surface_get_data (surface),
+      cairo_image_surface_get_stride (surface), width, height);
+    cairo_surface_mark_dirty (surface);
+  }
+  PYCAIRO_PROBE_RETURN (NULL);
+  Py_END_ALLOW_THREADS;
+
+  PyBuffer_Release (&view);
+
+  if (ret < 0) {
+    cairo_surface_destroy (surface);
+    _image_memory_unreserve (reserved);
+    return PyErr_NoMemory ();
+  }
+
+  result = _image_surface_from_allocation (surface);
+  _image_memory_unreserve (reserved);
+  return result;
 }
 
-static void
-_release_buffer_destroy_func (void *user_data) {
-  Py_buffer *view = (Py_buffer *)user_data;
-  PyGILState_STATE gstate = PyGILState_Ensure();
-  PyBuffer_Release (view);
-  PyMem_Free (view);
-  PyGILState_Release(gstate);
+#ifdef PYCAIRO_HAS_MMAP
+typedef enum {
+  MAP_MODE_READ_WRITE,
+  MAP_MODE_CREATE,
+  MAP_MODE_COPY_ON_WRITE,
+} PycairoMapMode;
+
+/* Maps size bytes of the file at path. Called without the GIL, returns 0 on
+ * success, an errno value, or -1 if the file is too small. */
+static int
+_map_file (const char *path, PycairoMapMode mode, size_t size,
+           void **data, size_t *map_size) {
+  struct stat st;
+  int fd, flags, err;
+
+  flags = mode == MAP_MODE_COPY_ON_WRITE ? O_RDONLY : O_RDWR;
+  if (mode == MAP_MODE_CREATE)
+    flags |= O_CREAT | O_TRUNC;
+#ifdef O_CLOEXEC
+  flags |= O_CLOEXEC;
+#endif
+
+  fd = open (path, flags, 0666);
+  if (fd < 0)
+    return errno;
+
+  if (mode == MAP_MODE_CREATE) {
+    if (ftruncate (fd, (off_t)size) < 0) {
+      err = errno;
+      close (fd);
+      return err;
+    }
+  } else {
+    if (fstat (fd, &st) < 0) {
+      err = errno;
+      close (fd);
+      return err;
+    }
+    if ((size_t)st.st_size < size) {
+      close (fd);
+      return -1;
+    }
+  }
+
+  /* mmap() doesn't allow empty mappings, nothing will access the page */
+  *map_size = size > 0 ? size : 1;
+  *data = mmap (NULL, *map_size, PROT_READ | PROT_WRITE,
+                mode == MAP_MODE_COPY_ON_WRITE ? MAP_PRIVATE : MAP_SHARED,
+                fd, 0);
+  err = *data == MAP_FAILED ? errno : 0;
+  close (fd);
+  return err;
 }
 
 /* METH_CLASS */
 static PyObject *
-image_surface_create_for_data (PyTypeObject *type, PyObject *args) {
+image_surface_create_for_mmap (PyTypeObject *type, PyObject *args,
+                               PyObject *kwds) {
+  static char *kwlist[] = {"path", "format", "width", "height", "stride",
+                           "mode", "sync", NULL};
+  PycairoSurfaceMapping *mapping;
   cairo_surface_t *surface;
   cairo_format_t format;
   cairo_status_t status;
-  int width, height, stride = -1, res, format_arg;
-  PyObject *obj;
-
-  if (!PyArg_ParseTuple (args, "Oiii|i:ImageSurface.create_for_data",
-                         &obj, &format_arg, &width, &height, &stride))
+  PycairoMapMode map_mode;
+  int width, height, stride = -1, format_arg, sync = 0, err;
+  const char *mode = "r+";
+  PyObject *pypath;
+  char *path;
+  void *data;
+  size_t map_size;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds,
+                                    "Oiii|isp:ImageSurface.create_for_mmap",
+                                    kwlist, &pypath, &format_arg, &width,
+                                    &height, &stride, &mode, &sync))
     return NULL;
 
   format = (cairo_format_t)format_arg;
 
+  if (strcmp (mode, "r+") == 0) {
+    map_mode = MAP_MODE_READ_WRITE;
+  } else if (strcmp (mode, "w+") == 0) {
+    map_mode = MAP_MODE_CREATE;
+  } else if (strcmp (mode, "c") == 0) {
+    map_mode = MAP_MODE_COPY_ON_WRITE;
+    /* private mappings are never written back */
+    sync = 0;
+  } else {
+    PyErr_Format (PyExc_ValueError,
+                  "mode must be 'r+', 'w+' or 'c', not '%s'", mode);
+    return NULL;
+  }
+
   if (width < 0) {
     PyErr_SetString(PyExc_ValueError, "width cannot be negative");
     return NULL;
@@ -865,7 +2886,6 @@ image_surface_create_for_data (PyTypeObject *type, PyObject *args) {
     PyErr_SetString(PyExc_ValueError, "height cannot be negative");
     return NULL;
   }
-  /* if stride is missing, calculate it from width */
   if (stride < 0) {
     stride = cairo_format_stride_for_width (format, width);
     if (stride == -1){
@@ -875,43 +2895,64 @@ image_surface_create_for_data (PyTypeObject *type, PyObject *args) {
     }
   }
 
-  Py_buffer *view = PyMem_Malloc (sizeof (Py_buffer));
-  if (view == NULL) {
-    PyErr_NoMemory ();
+  if (height > 0 && (size_t)stride > SIZE_MAX / (size_t)height) {
+    PyErr_SetString (PyExc_ValueError, "image is too large");
     return NULL;
   }
 
-  res = PyObject_GetBuffer (obj, view, PyBUF_WRITABLE);
-  if (res == -1) {
-    PyMem_Free (view);
+  mapping = PyMem_RawMalloc (sizeof (PycairoSurfaceMapping));
+  if (mapping == NULL)
+    return PyErr_NoMemory ();
+
+  if (!Pycairo_fspath_converter (pypath, &path)) {
+    PyMem_RawFree (mapping);
     return NULL;
   }
 
-  if (height * stride > view->len) {
-    PyBuffer_Release (view);
-    PyMem_Free (view);
-    PyErr_SetString(PyExc_TypeError, "buffer is not long enough");
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
+  err = _map_file (path, map_mode, (size_t)stride * (size_t)height,
+                   &data, &map_size);
+  PYCAIRO_PROBE_RETURN (NULL);
+  Py_END_ALLOW_THREADS;
+
+  if (err != 0) {
+    PyMem_RawFree (mapping);
+    if (err < 0)
+      PyErr_SetString (PyExc_ValueError, "file is too small for the image");
+    else {
+      errno = err;
+      PyErr_SetFromErrnoWithFilename (PyExc_OSError, path);
+    }
+    PyMem_Free (path);
     return NULL;
   }
+  PyMem_Free (path);
 
-  Py_BEGIN_ALLOW_THREADS;
-  surface = cairo_image_surface_create_for_data (view->buf, format, width,
+  mapping->data = data;
+  mapping->size = map_size;
+  mapping->sync = sync;
+
+  surface = cairo_image_surface_create_for_data (data, format, width,
                                                  height, stride);
-  Py_END_ALLOW_THREADS;
+  if (cairo_surface_status (surface) != CAIRO_STATUS_SUCCESS) {
+    munmap (data, map_size);
+    PyMem_RawFree (mapping);
+    return PycairoSurface_FromSurface (surface, NULL);
+  }
 
-  status = cairo_surface_set_user_data(
-    surface, &surface_buffer_view_key, view,
-    (cairo_destroy_func_t)_release_buffer_destroy_func);
+  status = cairo_surface_set_user_data (
+    surface, &surface_mmap_key, mapping, _surface_mapping_destroy_func);
   if (Pycairo_Check_Status (status)) {
     cairo_surface_destroy (surface);
-    PyBuffer_Release (view);
-    PyMem_Free (view);
+    munmap (data, map_size);
+    PyMem_RawFree (mapping);
     return NULL;
   }
 
-  return PycairoSurface_FromSurface(surface, NULL);
+  return PycairoSurface_FromSurface (surface, NULL);
 }
-
+#endif /* PYCAIRO_HAS_MMAP */
 
 #ifdef CAIRO_HAS_PNG_FUNCTIONS
 static cairo_status_t
@@ -960,18 +3001,22 @@ image_surface_create_from_png (PyTypeObject *type, PyObject *args) {
       return NULL;
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     image_surface = cairo_image_surface_create_from_png (name);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
     PyMem_Free(name);
-    return PycairoSurface_FromSurface (image_surface, NULL);
+    return _image_surface_from_allocation (image_surface);
   } else {
     if (PyArg_ParseTuple (args, "O&:ImageSurface.create_from_png",
                           Pycairo_reader_converter, &file)) {
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       image_surface = cairo_image_surface_create_from_png_stream (
         _read_func, file);
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
-      return PycairoSurface_FromSurface (image_surface, NULL);
+      return _image_surface_from_allocation (image_surface);
     } else {
       PyErr_SetString(PyExc_TypeError,
                       "ImageSurface.create_from_png argument must be a "
@@ -981,6 +3026,65 @@ image_surface_create_from_png (PyTypeObject *type, PyObject *args) {
     }
   }
 }
+
+static void
+_image_surface_create_from_png_run (PycairoAsyncJob *base) {
+  PycairoSurfaceJob *job = (PycairoSurfaceJob *)base;
+
+  PYCAIRO_PROBE_ENTRY (NULL);
+  if (job->name != NULL)
+    job->result = cairo_image_surface_create_from_png (job->name);
+  else
+    job->result = cairo_image_surface_create_from_png_stream (
+      _read_func, job->file);
+  PYCAIRO_PROBE_RETURN (NULL);
+}
+
+static PyObject *
+_image_surface_create_from_png_complete (PycairoAsyncJob *base) {
+  PycairoSurfaceJob *job = (PycairoSurfaceJob *)base;
+  cairo_surface_t *image_surface = job->result;
+
+  job->result = NULL;
+  return _image_surface_from_allocation (image_surface);
+}
+
+/* METH_CLASS */
+static PyObject *
+image_surface_create_from_png_async (PyTypeObject *type, PyObject *args) {
+  PycairoSurfaceJob *job;
+  PyObject *file;
+
+  if (!PyArg_ParseTuple (args, "O:ImageSurface.create_from_png_async", &file))
+    return NULL;
+
+  job = _surface_job_new (NULL, _image_surface_create_from_png_run,
+                          _image_surface_create_from_png_complete);
+  if (job == NULL)
+    return NULL;
+
+  if (Pycairo_is_fspath (file)) {
+    if (!PyArg_ParseTuple (args, "O&:ImageSurface.create_from_png_async",
+                           Pycairo_fspath_converter, &job->name))
+      goto error;
+  } else if (PyArg_ParseTuple (args, "O&:ImageSurface.create_from_png_async",
+                               Pycairo_reader_converter, &file)) {
+    job->file = file;
+    Py_INCREF (file);
+  } else {
+    PyErr_SetString (PyExc_TypeError,
+                     "ImageSurface.create_from_png_async argument must be a "
+                     "filename (str), file object, or an object that has a "
+                     "\"read\" method (like BytesIO) returning bytes.");
+    goto error;
+  }
+
+  return _surface_job_submit (job);
+
+ error:
+  _surface_job_destroy (&job->base);
+  return NULL;
+}
 #endif /* CAIRO_HAS_PNG_FUNCTIONS */
 
 /* METH_STATIC */
@@ -1016,45 +3120,266 @@ create_empty_memoryview(void)
     return view;
 }
 
+static PyObject *
+image_surface_convert_to (PycairoImageSurface *o, PyObject *args) {
+  PycairoPixelLayout layout, image_layout;
+  cairo_surface_t *surface = o->surface;
+  unsigned char *data;
+  Py_ssize_t stride = -1;
+  int width, height, ret = 0;
+  PyObject *obj;
+  Py_buffer view;
+
+  if (!PyArg_ParseTuple (args, "OO&|n:ImageSurface.convert_to",
+                         &obj, Pycairo_pixel_layout_converter, &layout,
+                         &stride))
+    return NULL;
+
+  if (_surface_is_finished (surface)) {
+    Pycairo_Check_Status (CAIRO_STATUS_SURFACE_FINISHED);
+    return NULL;
+  }
+
+  image_layout.type = PYCAIRO_LAYOUT_FORMAT;
+  image_layout.format = cairo_image_surface_get_format (surface);
+  if (Pycairo_pixel_layout_row_bytes (&image_layout, 0) < 0) {
+    PyErr_SetString (PyExc_ValueError,
+                     "format of the surface not supported for pixel conversion");
+    return NULL;
+  }
+
+  width = cairo_image_surface_get_width (surface);
+  height = cairo_image_surface_get_height (surface);
+  if (stride < 0)
+    stride = Pycairo_pixel_layout_default_stride (&layout, width);
+
+  if (PyObject_GetBuffer (obj, &view, PyBUF_WRITABLE) == -1)
+    return NULL;
+
+  if (_pixels_buffer_check (
+        &view, stride, Pycairo_pixel_layout_row_bytes (&layout, width),
+        height) < 0) {
+    PyBuffer_Release (&view);
+    return NULL;
+  }
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (surface);
+  cairo_surface_flush (surface);
+  data = cairo_image_surface_get_data (surface);
+  if (data != NULL)
+    ret = Pycairo_convert_pixels (
+      &image_layout, data, cairo_image_surface_get_stride (surface),
+      &layout, view.buf, stride, width, height);
+  PYCAIRO_PROBE_RETURN (surface);
+  Py_END_ALLOW_THREADS;
+
+  PyBuffer_Release (&view);
+
+  if (ret < 0)
+    return PyErr_NoMemory ();
+
+  RETURN_NULL_IF_CAIRO_SURFACE_ERROR (surface);
+  Py_RETURN_NONE;
+}
+
 static PyObject *
 image_surface_get_data (PycairoImageSurface *o, PyObject *ignored) {
-  cairo_surface_t *surface;
-  int height, stride;
-  unsigned char * buffer;
+  cairo_surface_t *surface = o->surface;
+
+  if (_surface_is_finished (surface)) {
+    if (PyErr_WarnEx (
+        PyExc_DeprecationWarning,
+        "Calling get_data() on a finished surface is deprecated and will raise in the future",
+        1) < 0)
+      return NULL;
+    return create_empty_memoryview();
+  }
+
+  if (cairo_image_surface_get_data (surface) == NULL) {
+    // It's documented to return NULL after finish, but that's not always the case:
+    // https://gitlab.freedesktop.org/cairo/cairo/-/issues/406
+    // and it returns NULL if the size is 0 and it's backed by pixman:
+    // https://gitlab.freedesktop.org/cairo/cairo/-/issues/880
+    // Let's paper over this by returning an empty memoryview.
+    return create_empty_memoryview();
+  }
+
+  return buffer_proxy_create_view ((PyObject *)o);
+}
+
+/* Buffer protocol: the pixel data is exported as rows x columns x channels
+ * with the row stride cairo uses. Formats where a pixel isn't made of
+ * channels of the same type export one native integer per pixel, A1 exports
+ * the raw bytes of each row.
+ */
+typedef struct {
+  Py_ssize_t shape[3];
+  Py_ssize_t strides[3];
+} PycairoImageExport;
+
+static int
+image_surface_getbuffer (PycairoImageSurface *o, Py_buffer *view, int flags) {
+  cairo_surface_t *surface = o->surface;
+  PycairoImageExport *export;
+  unsigned char *data;
+  const char *format;
+  Py_ssize_t width, height, stride, channels, itemsize;
+  int ndim = 3;
+  cairo_status_t status;
+
+  view->obj = NULL;
+
+  if (_surface_is_finished (surface)) {
+    PyErr_SetString (PyExc_BufferError, "the surface is finished");
+    return -1;
+  }
+
+  data = cairo_image_surface_get_data (surface);
+  width = cairo_image_surface_get_width (surface);
+  height = cairo_image_surface_get_height (surface);
+  stride = cairo_image_surface_get_stride (surface);
+  if (data == NULL)
+    width = height = stride = 0;
+
+  switch (cairo_image_surface_get_format (surface)) {
+  case CAIRO_FORMAT_ARGB32:
+  case CAIRO_FORMAT_RGB24:
+    format = "B";
+    itemsize = 1;
+    channels = 4;
+    break;
+  case CAIRO_FORMAT_A8:
+    format = "B";
+    itemsize = 1;
+    channels = 1;
+    break;
+  case CAIRO_FORMAT_RGB16_565:
+    format = "H";
+    itemsize = 2;
+    channels = 1;
+    break;
+  case CAIRO_FORMAT_RGB30:
+    format = "I";
+    itemsize = 4;
+    channels = 1;
+    break;
+#if CAIRO_VERSION >= CAIRO_VERSION_ENCODE(1, 17, 2)
+  case CAIRO_FORMAT_RGB96F:
+    format = "f";
+    itemsize = 4;
+    channels = 3;
+    break;
+  case CAIRO_FORMAT_RGBA128F:
+    format = "f";
+    itemsize = 4;
+    channels = 4;
+    break;
+#endif
+  case CAIRO_FORMAT_A1:
+    format = "B";
+    itemsize = 1;
+    channels = 1;
+    width = stride;
+    ndim = 2;
+    break;
+  default:
+    /* CAIRO_FORMAT_INVALID or unknown formats: raw bytes */
+    format = "B";
+    itemsize = 1;
+    channels = 1;
+    width = stride;
+    ndim = 2;
+    break;
+  }
+
+  /* Only arrays with at most one dimension longer than one are both C and
+   * Fortran contiguous */
+  if ((flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS &&
+      (height > 1) + (width > 1) + (channels > 1) > 1) {
+    PyErr_SetString (PyExc_BufferError,
+      "image data is not Fortran contiguous");
+    return -1;
+  }
 
-  surface = o->surface;
+  /* Without a shape the consumer gets all rows including the padding */
+  if ((flags & PyBUF_ND) == PyBUF_ND &&
+      ((flags & PyBUF_STRIDES) != PyBUF_STRIDES ||
+       (flags & PyBUF_C_CONTIGUOUS) == PyBUF_C_CONTIGUOUS ||
+       (flags & PyBUF_F_CONTIGUOUS) == PyBUF_F_CONTIGUOUS ||
+       (flags & PyBUF_ANY_CONTIGUOUS) == PyBUF_ANY_CONTIGUOUS) &&
+      width * channels * itemsize != stride && height > 1) {
+    PyErr_SetString (PyExc_BufferError,
+      "image rows are padded, the data is not contiguous");
+    return -1;
+  }
 
-  // We need to figure out if the surface is finished or not to see
-  // if the buffer is still valid.
-  // https://gitlab.freedesktop.org/cairo/cairo/-/issues/406
-  // https://github.com/gtk-rs/cairo/issues/323
-  cairo_t *ctx = cairo_create (surface);
-  cairo_status_t status = cairo_status (ctx);
-  cairo_destroy (ctx);
+  export = PyMem_Malloc (sizeof (PycairoImageExport));
+  if (export == NULL) {
+    PyErr_NoMemory ();
+    return -1;
+  }
+
+  export->shape[0] = height;
+  export->shape[1] = width;
+  export->shape[2] = channels;
+  export->strides[0] = stride;
+  export->strides[1] = channels * itemsize;
+  export->strides[2] = itemsize;
+  if (ndim == 2)
+    export->strides[1] = itemsize;
+
+  status = _surface_set_export_count (
+    surface, _surface_get_export_count (surface) + 1);
   if (Pycairo_Check_Status (status)) {
-    PyErr_Clear ();
-    PyErr_WarnEx (
-      PyExc_DeprecationWarning,
-      "Calling get_data() on a finished surface is deprecated and will raise in the future",
-      1
-    );
+    PyMem_Free (export);
+    return -1;
   }
 
-  buffer = cairo_image_surface_get_data (surface);
-  if (buffer == NULL) {
-    // It's documented to return NULL after finish, but that's not always the case:
-    // https://gitlab.freedesktop.org/cairo/cairo/-/issues/406
-    // and it returns NULL if the size is 0 and it's backed by pixman:
-    // https://gitlab.freedesktop.org/cairo/cairo/-/issues/880
-    // Let's paper over this by returning an empty memoryview.
-    return create_empty_memoryview();
+  view->buf = data;
+  view->len = height * stride;
+  view->readonly = 0;
+  view->itemsize = itemsize;
+  view->format = (flags & PyBUF_FORMAT) ? (char *)format : NULL;
+  view->internal = export;
+  view->suboffsets = NULL;
+  if (!(flags & PyBUF_ND)) {
+    /* A plain sequence of bytes covering all rows */
+    view->ndim = 1;
+    view->shape = NULL;
+    view->strides = NULL;
+    if (view->format != NULL)
+      view->format = "B";
+    view->itemsize = 1;
+  } else {
+    view->ndim = ndim;
+    view->shape = export->shape;
+    view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ?
+      export->strides : NULL;
+    /* len is the product of the shape, the row padding isn't included */
+    view->len = height * width * channels * itemsize;
   }
-  height = cairo_image_surface_get_height (surface);
-  stride = cairo_image_surface_get_stride (surface);
 
-  return buffer_proxy_create_view((PyObject *)o, buffer, height * stride, 0);
+  Py_INCREF (o);
+  view->obj = (PyObject *)o;
+  return 0;
 }
 
+static void
+image_surface_releasebuffer (PycairoImageSurface *o, Py_buffer *view) {
+  Py_ssize_t count = _surface_get_export_count (o->surface);
+
+  if (count > 0)
+    _surface_set_export_count (o->surface, count - 1);
+  PyMem_Free (view->internal);
+  view->internal = NULL;
+}
+
+static PyBufferProcs image_surface_as_buffer = {
+  (getbufferproc)image_surface_getbuffer,
+  (releasebufferproc)image_surface_releasebuffer,
+};
+
 static PyObject *
 image_surface_get_format (PycairoImageSurface *o, PyObject *ignored) {
   RETURN_INT_ENUM (Format, cairo_image_surface_get_format (o->surface));
@@ -1075,21 +3400,56 @@ image_surface_get_width (PycairoImageSurface *o, PyObject *ignored) {
   return PyLong_FromLong (cairo_image_surface_get_width (o->surface));
 }
 
+static PyObject *
+image_surface_set_unique_id_from_content (PycairoImageSurface *o,
+                                          PyObject *ignored) {
+  cairo_status_t status;
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
+  status = Pycairo_image_surface_tag_content (o->surface, 1);
+  PYCAIRO_PROBE_RETURN (o->surface);
+  Py_END_ALLOW_THREADS;
+
+  RETURN_NULL_IF_CAIRO_ERROR (status);
+  Py_RETURN_NONE;
+}
+
 static PyMethodDef image_surface_methods[] = {
+  {"convert_to",    (PyCFunction)image_surface_convert_to,      METH_VARARGS},
   {"create_for_data",(PyCFunction)image_surface_create_for_data,
    METH_VARARGS | METH_CLASS},
+#ifdef PYCAIRO_HAS_MMAP
+  {"create_for_mmap",
+   (PyCFunction)(void (*)(void))image_surface_create_for_mmap,
+   METH_VARARGS | METH_KEYWORDS | METH_CLASS},
+#endif
+  {"create_from_pixels", (PyCFunction)image_surface_create_from_pixels,
+   METH_VARARGS | METH_CLASS},
 #ifdef CAIRO_HAS_PNG_FUNCTIONS
   {"create_from_png", (PyCFunction)image_surface_create_from_png,
    METH_VARARGS | METH_CLASS},
+  {"create_from_png_async",
+   (PyCFunction)image_surface_create_from_png_async,
+   METH_VARARGS | METH_CLASS},
 #endif
+  {"create_shared",
+   (PyCFunction)(void (*)(void))image_surface_create_shared,
+   METH_VARARGS | METH_KEYWORDS | METH_CLASS},
   {"format_stride_for_width",
    (PyCFunction)image_surface_format_stride_for_width,
    METH_VARARGS | METH_STATIC},
   {"get_data",      (PyCFunction)image_surface_get_data,        METH_NOARGS},
   {"get_format",    (PyCFunction)image_surface_get_format,      METH_NOARGS},
   {"get_height",    (PyCFunction)image_surface_get_height,      METH_NOARGS},
+  {"get_shared_memory", (PyCFunction)image_surface_get_shared_memory,
+   METH_NOARGS},
   {"get_stride",    (PyCFunction)image_surface_get_stride,      METH_NOARGS},
   {"get_width",     (PyCFunction)image_surface_get_width,       METH_NOARGS},
+  {"open_shared",   (PyCFunction)image_surface_open_shared,
+   METH_VARARGS | METH_CLASS},
+  {"set_unique_id_from_content",
+   (PyCFunction)image_surface_set_unique_id_from_content, METH_NOARGS},
   {NULL, NULL, 0, NULL},
 };
 
@@ -1113,7 +3473,7 @@ PyTypeObject PycairoImageSurface_Type = {
   0,                                  /* tp_str */
   0,                                  /* tp_getattro */
   0,                                  /* tp_setattro */
-  0,                                  /* tp_as_buffer */
+  &image_surface_as_buffer,           /* tp_as_buffer */
   Py_TPFLAGS_DEFAULT,                 /* tp_flags */
   0,                                  /* tp_doc */
   0,                                  /* tp_traverse */
@@ -1189,6 +3549,7 @@ mapped_image_surface_ctx_exit (PycairoImageSurface *self, PyObject *args) {
 static PyMethodDef mapped_image_surface_methods[] = {
   {"__exit__",     (PyCFunction)mapped_image_surface_ctx_exit,   METH_VARARGS},
   {"finish",       (PyCFunction)mapped_image_surface_finish,     METH_NOARGS},
+  {"finish_async", (PyCFunction)mapped_image_surface_finish,     METH_NOARGS},
   {NULL, NULL, 0, NULL},
 };
 
@@ -1238,9 +3599,488 @@ PyTypeObject PycairoMappedImageSurface_Type = {
 };
 
 
+/* Class SurfacePool ------------------------------------------------------ */
+
+/* A pool keeps the pixel memory of image surfaces created by it once they
+ * are finished or destroyed, and uses it for the next surface of the same
+ * format and size. Surfaces are created with
+ * cairo_image_surface_create_for_data() on pool memory, so no cairo state
+ * (mime data, device offset, snapshots) is carried over between users.
+ *
+ * Surfaces can be destroyed from any thread, the pool state is protected
+ * by a lock. Idle buffers count towards the image memory limit and are
+ * reported to tracemalloc and cairo.memory_stats(); all pools are kept in a
+ * list protected by the GIL, so that _image_memory_reserve() can free idle
+ * buffers before it gives up.
+ */
+
+typedef struct {
+  cairo_format_t format;
+  int width;
+  int height;
+  int stride;
+  unsigned char *data;
+} PycairoPoolBuffer;
+
+typedef struct _PycairoSurfacePool {
+  PyObject_HEAD
+  PyThread_type_lock lock;
+  PycairoPoolBuffer *buffers; /* idle buffers, oldest first */
+  Py_ssize_t n_buffers;
+  Py_ssize_t max_size;
+  Py_ssize_t hits;
+  Py_ssize_t misses;
+  Py_ssize_t discarded;
+  struct _PycairoSurfacePool *prev, *next;
+} PycairoSurfacePool;
+
+static PycairoSurfacePool *surface_pools = NULL;
+
+/* Attached to every surface using pool memory */
+typedef struct {
+  PycairoSurfacePool *pool;
+  PycairoPoolBuffer buffer;
+} PycairoPoolLease;
+
+static size_t
+_surface_pool_buffer_size (PycairoPoolBuffer *buffer) {
+  return (size_t)buffer->stride * (size_t)buffer->height;
+}
+
+/* Updates the global total of idle pool memory, called with the pool lock
+ * held */
+static void
+_surface_pool_idle_changed (size_t added, size_t removed) {
+  PyThread_acquire_lock (surface_account_lock, WAIT_LOCK);
+  surface_pool_idle_bytes += added;
+  surface_pool_idle_bytes -= removed;
+  if (removed > added)
+    _image_memory_wake_waiters ();
+  PyThread_release_lock (surface_account_lock);
+}
+
+/* Frees the memory of a buffer, can be called without the GIL */
+static void
+_surface_pool_buffer_free (PycairoPoolBuffer *buffer) {
+  PyTraceMalloc_Untrack (PYCAIRO_TRACEMALLOC_DOMAIN, (uintptr_t)buffer->data);
+  PyMem_RawFree (buffer->data);
+}
+
+/* Returns a buffer to the pool, dropping the oldest idle one if the pool is
+ * full. Can be called without the GIL. */
+static void
+_surface_pool_put (PycairoSurfacePool *pool, PycairoPoolBuffer *buffer) {
+  PycairoPoolBuffer dropped;
+  int drop = 0;
+
+  PyThread_acquire_lock (pool->lock, WAIT_LOCK);
+  if (pool->max_size == 0) {
+    dropped = *buffer;
+    drop = 1;
+    pool->discarded++;
+  } else {
+    if (pool->n_buffers == pool->max_size) {
+      dropped = pool->buffers[0];
+      drop = 1;
+      memmove (pool->buffers, pool->buffers + 1,
+               (size_t)(pool->n_buffers - 1) * sizeof (PycairoPoolBuffer));
+      pool->n_buffers--;
+      pool->discarded++;
+    }
+    pool->buffers[pool->n_buffers++] = *buffer;
+    _surface_pool_idle_changed (
+      _surface_pool_buffer_size (buffer),
+      drop ? _surface_pool_buffer_size (&dropped) : 0);
+  }
+  PyThread_release_lock (pool->lock);
+
+  if (drop)
+    _surface_pool_buffer_free (&dropped);
+}
+
+/* Frees idle buffers of all pools, oldest first, until at least needed
+ * bytes are freed or none are left. Returns the number of bytes freed.
+ * Needs the GIL. */
+static size_t
+_surface_pools_trim (size_t needed) {
+  PycairoSurfacePool *pool;
+  PycairoPoolBuffer buffer;
+  size_t freed = 0, size;
+
+  for (pool = surface_pools; pool != NULL && freed < needed;
+       pool = pool->next) {
+    for (;;) {
+      PyThread_acquire_lock (pool->lock, WAIT_LOCK);
+      if (pool->n_buffers == 0 || freed >= needed) {
+        PyThread_release_lock (pool->lock);
+        break;
+      }
+      buffer = pool->buffers[0];
+      memmove (pool->buffers, pool->buffers + 1,
+               (size_t)(pool->n_buffers - 1) * sizeof (PycairoPoolBuffer));
+      pool->n_buffers--;
+      pool->discarded++;
+      size = _surface_pool_buffer_size (&buffer);
+      _surface_pool_idle_changed (0, size);
+      PyThread_release_lock (pool->lock);
+
+      _surface_pool_buffer_free (&buffer);
+      freed += size;
+    }
+  }
+
+  return freed;
+}
+
+static void
+_surface_pool_lease_destroy_func (void *user_data) {
+  PycairoPoolLease *lease = user_data;
+  PyGILState_STATE gstate;
+
+  _surface_pool_put (lease->pool, &lease->buffer);
+
+  gstate = PyGILState_Ensure ();
+  Py_DECREF (lease->pool);
+  PyGILState_Release (gstate);
+  PyMem_RawFree (lease);
+}
+
+static PyObject *
+surface_pool_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
+  static char *kwlist[] = {"max_size", NULL};
+  PycairoSurfacePool *self;
+  Py_ssize_t max_size = 16;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "|n:SurfacePool.__new__",
+                                    kwlist, &max_size))
+    return NULL;
+
+  if (max_size < 0) {
+    PyErr_SetString (PyExc_ValueError, "max_size cannot be negative");
+    return NULL;
+  }
+
+  self = (PycairoSurfacePool *)type->tp_alloc (type, 0);
+  if (self == NULL)
+    return NULL;
+
+  self->max_size = max_size;
+  self->lock = PyThread_allocate_lock ();
+  self->buffers = PyMem_Calloc (
+    (size_t)Py_MAX (max_size, 1), sizeof (PycairoPoolBuffer));
+  if (self->lock == NULL || self->buffers == NULL) {
+    Py_DECREF (self);
+    return PyErr_NoMemory ();
+  }
+
+  self->next = surface_pools;
+  if (surface_pools != NULL)
+    surface_pools->prev = self;
+  surface_pools = self;
+
+  return (PyObject *)self;
+}
+
+static void
+_surface_pool_clear (PycairoSurfacePool *self) {
+  size_t removed = 0;
+  Py_ssize_t i;
+
+  PyThread_acquire_lock (self->lock, WAIT_LOCK);
+  for (i = 0; i < self->n_buffers; i++) {
+    removed += _surface_pool_buffer_size (&self->buffers[i]);
+    _surface_pool_buffer_free (&self->buffers[i]);
+  }
+  self->n_buffers = 0;
+  _surface_pool_idle_changed (0, removed);
+  PyThread_release_lock (self->lock);
+}
+
+static void
+surface_pool_dealloc (PycairoSurfacePool *self) {
+  if (self->prev != NULL)
+    self->prev->next = self->next;
+  else if (surface_pools == self)
+    surface_pools = self->next;
+  if (self->next != NULL)
+    self->next->prev = self->prev;
+
+  /* Surfaces leased from the pool keep it alive, so all buffers are idle */
+  if (self->lock != NULL) {
+    _surface_pool_clear (self);
+    PyThread_free_lock (self->lock);
+  }
+  PyMem_Free (self->buffers);
+  Py_TYPE (self)->tp_free (self);
+}
+
+static PyObject *
+surface_pool_acquire (PycairoSurfacePool *self, PyObject *args) {
+  PycairoPoolBuffer buffer;
+  PycairoPoolLease *lease;
+  cairo_surface_t *surface;
+  cairo_status_t status;
+  int format_arg, width, height, found = 0;
+  size_t size, reserved;
+  Py_ssize_t i;
+  PyObject *result;
+
+  if (!PyArg_ParseTuple (args, "iii:SurfacePool.acquire",
+                         &format_arg, &width, &height))
+    return NULL;
+
+  buffer.format = (cairo_format_t)format_arg;
+  buffer.width = width;
+  buffer.height = height;
+
+  if (width < 0 || height < 0) {
+    PyErr_SetString (PyExc_ValueError, "width and height cannot be negative");
+    return NULL;
+  }
+  buffer.stride = cairo_format_stride_for_width (buffer.format, width);
+  if (buffer.stride == -1) {
+    PyErr_SetString (PyExc_ValueError,
+                     "format is invalid or the width too large");
+    return NULL;
+  }
+  size = (size_t)buffer.stride * (size_t)height;
+
+  lease = PyMem_RawMalloc (sizeof (PycairoPoolLease));
+  if (lease == NULL)
+    return PyErr_NoMemory ();
+
+  /* A reused buffer stops being idle before reserving its size, so it
+   * isn't counted twice */
+  PyThread_acquire_lock (self->lock, WAIT_LOCK);
+  for (i = self->n_buffers - 1; i >= 0; i--) {
+    PycairoPoolBuffer *idle = &self->buffers[i];
+    if (idle->format == buffer.format && idle->width == width &&
+        idle->height == height) {
+      buffer = *idle;
+      memmove (idle, idle + 1,
+               (size_t)(self->n_buffers - i - 1) * sizeof (PycairoPoolBuffer));
+      self->n_buffers--;
+      _surface_pool_idle_changed (0, size);
+      found = 1;
+      break;
+    }
+  }
+  PyThread_release_lock (self->lock);
+
+  if (_image_memory_reserve (size, &reserved) < 0) {
+    if (found) {
+      /* Memory is tight, don't keep it around */
+      PyThread_acquire_lock (self->lock, WAIT_LOCK);
+      self->discarded++;
+      PyThread_release_lock (self->lock);
+      _surface_pool_buffer_free (&buffer);
+    }
+    PyMem_RawFree (lease);
+    return NULL;
+  }
+
+  PyThread_acquire_lock (self->lock, WAIT_LOCK);
+  if (found)
+    self->hits++;
+  else
+    self->misses++;
+  PyThread_release_lock (self->lock);
+
+  if (found) {
+    Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
+    memset (buffer.data, 0, size);
+    PYCAIRO_PROBE_RETURN (NULL);
+    Py_END_ALLOW_THREADS;
+  } else {
+    /* calloc() can hand out pages which are known to be zero */
+    buffer.data = PyMem_RawCalloc (size > 0 ? size : 1, 1);
+    if (buffer.data == NULL) {
+      _image_memory_unreserve (reserved);
+      PyMem_RawFree (lease);
+      return PyErr_NoMemory ();
+    }
+    PyTraceMalloc_Track (PYCAIRO_TRACEMALLOC_DOMAIN, (uintptr_t)buffer.data,
+                         size);
+  }
+
+  surface = cairo_image_surface_create_for_data (
+    buffer.data, buffer.format, width, height, buffer.stride);
+
+  Py_INCREF (self);
+  lease->pool = self;
+  lease->buffer = buffer;
+  status = cairo_surface_set_user_data (surface, &surface_pool_key, lease,
+                                        _surface_pool_lease_destroy_func);
+  if (status != CAIRO_STATUS_SUCCESS) {
+    cairo_surface_destroy (surface);
+    _surface_pool_put (self, &buffer);
+    Py_DECREF (self);
+    PyMem_RawFree (lease);
+    _image_memory_unreserve (reserved);
+    Pycairo_Check_Status (status);
+    return NULL;
+  }
+
+  result = _image_surface_from_allocation (surface);
+  _image_memory_unreserve (reserved);
+  return result;
+}
+
+static PyObject *
+surface_pool_release (PycairoSurfacePool *self, PyObject *args) {
+  PycairoSurface *surface;
+  PycairoPoolLease *lease;
+
+  if (!PyArg_ParseTuple (args, "O!:SurfacePool.release",
+                         &PycairoImageSurface_Type, &surface))
+    return NULL;
+
+  lease = cairo_surface_get_user_data (surface->surface, &surface_pool_key);
+  if (lease == NULL || lease->pool != self) {
+    PyErr_SetString (PyExc_ValueError,
+                     "surface was not acquired from this pool");
+    return NULL;
+  }
+
+  return surface_finish (surface, NULL);
+}
+
+static PyObject *
+surface_pool_clear (PycairoSurfacePool *self, PyObject *ignored) {
+  _surface_pool_clear (self);
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+surface_pool_stats (PycairoSurfacePool *self, PyObject *ignored) {
+  Py_ssize_t hits, misses, discarded, idle, i;
+  size_t idle_bytes = 0;
+
+  PyThread_acquire_lock (self->lock, WAIT_LOCK);
+  hits = self->hits;
+  misses = self->misses;
+  discarded = self->discarded;
+  idle = self->n_buffers;
+  for (i = 0; i < self->n_buffers; i++)
+    idle_bytes += (size_t)self->buffers[i].stride *
+      (size_t)self->buffers[i].height;
+  PyThread_release_lock (self->lock);
+
+  return Py_BuildValue ("{s:n,s:n,s:n,s:n,s:n}",
+                        "hits", hits,
+                        "misses", misses,
+                        "discarded", discarded,
+                        "idle", idle,
+                        "idle_bytes", (Py_ssize_t)idle_bytes);
+}
+
+static PyMethodDef surface_pool_methods[] = {
+  {"acquire",  (PyCFunction)surface_pool_acquire,  METH_VARARGS},
+  {"clear",    (PyCFunction)surface_pool_clear,    METH_NOARGS},
+  {"release",  (PyCFunction)surface_pool_release,  METH_VARARGS},
+  {"stats",    (PyCFunction)surface_pool_stats,    METH_NOARGS},
+  {NULL, NULL, 0, NULL},
+};
+
+PyTypeObject PycairoSurfacePool_Type = {
+  PyVarObject_HEAD_INIT(NULL, 0)
+  "cairo.SurfacePool",                /* tp_name */
+  sizeof(PycairoSurfacePool),         /* tp_basicsize */
+  0,                                  /* tp_itemsize */
+  (destructor)surface_pool_dealloc,   /* tp_dealloc */
+  0,                                  /* tp_print */
+  0,                                  /* tp_getattr */
+  0,                                  /* tp_setattr */
+  0,                                  /* tp_compare */
+  0,                                  /* tp_repr */
+  0,                                  /* tp_as_number */
+  0,                                  /* tp_as_sequence */
+  0,                                  /* tp_as_mapping */
+  PyObject_HashNotImplemented,        /* tp_hash */
+  0,                                  /* tp_call */
+  0,                                  /* tp_str */
+  0,                                  /* tp_getattro */
+  0,                                  /* tp_setattro */
+  0,                                  /* tp_as_buffer */
+  Py_TPFLAGS_DEFAULT,                 /* tp_flags */
+  0,                                  /* tp_doc */
+  0,                                  /* tp_traverse */
+  0,                                  /* tp_clear */
+  0,                                  /* tp_richcompare */
+  0,                                  /* tp_weaklistoffset */
+  0,                                  /* tp_iter */
+  0,                                  /* tp_iternext */
+  surface_pool_methods,               /* tp_methods */
+  0,                                  /* tp_members */
+  0,                                  /* tp_getset */
+  0,                                  /* tp_base */
+  0,                                  /* tp_dict */
+  0,                                  /* tp_descr_get */
+  0,                                  /* tp_descr_set */
+  0,                                  /* tp_dictoffset */
+  0,                                  /* tp_init */
+  0,                                  /* tp_alloc */
+  (newfunc)surface_pool_new,          /* tp_new */
+  0,                                  /* tp_free */
+  0,                                  /* tp_is_gc */
+  0,                                  /* tp_bases */
+};
+
+
 #endif /* CAIRO_HAS_IMAGE_SURFACE */
 
 
+/* Page queue of PDFSurface and PSSurface --------------------------------- */
+#if defined(CAIRO_HAS_RECORDING_SURFACE) && \
+    (defined(CAIRO_HAS_PDF_SURFACE) || defined(CAIRO_HAS_PS_SURFACE))
+#define PYCAIRO_HAS_PAGE_QUEUE
+
+static PyObject *
+document_surface_queue_page (PycairoSurface *o, PyObject *args,
+                             PyObject *kwds) {
+  static char *kwlist[] = {"page", "max_pending", NULL};
+  PycairoSurface *page;
+  int max_pending = 2;
+  PycairoPageQueue *queue;
+  cairo_status_t status;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "O!|i:queue_page", kwlist,
+                                    &PycairoRecordingSurface_Type, &page,
+                                    &max_pending))
+    return NULL;
+
+  if (max_pending < 1) {
+    PyErr_SetString (PyExc_ValueError, "max_pending must be at least 1");
+    return NULL;
+  }
+  if (_surface_is_finished (o->surface))
+    RETURN_NULL_IF_CAIRO_ERROR (CAIRO_STATUS_SURFACE_FINISHED);
+
+  queue = Pycairo_page_queue_get (o->surface, 1);
+  if (queue == NULL)
+    return NULL;
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
+  status = Pycairo_page_queue_push (queue, page->surface, max_pending);
+  PYCAIRO_PROBE_RETURN (o->surface);
+  Py_END_ALLOW_THREADS;
+
+  RETURN_NULL_IF_CAIRO_ERROR (status);
+  Py_RETURN_NONE;
+}
+
+static PyObject *
+document_surface_wait_pages (PycairoSurface *o, PyObject *ignored) {
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
+  Py_RETURN_NONE;
+}
+
+#endif /* PYCAIRO_HAS_PAGE_QUEUE */
+
+
 /* Class PDFSurface(Surface) ---------------------------------------------- */
 #ifdef CAIRO_HAS_PDF_SURFACE
 #include <cairo-pdf.h>
@@ -1249,6 +4089,7 @@ static PyObject *
 pdf_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
   double width_in_points, height_in_points;
   PyObject *file;
+  PycairoOutputSink *sink;
   cairo_surface_t *sfc;
   char *name;
 
@@ -1263,7 +4104,9 @@ pdf_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
       return NULL;
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     sfc = cairo_pdf_surface_create (name, width_in_points, height_in_points);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
     PyMem_Free(name);
     return PycairoSurface_FromSurface (sfc, NULL);
@@ -1271,11 +4114,16 @@ pdf_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
     if (PyArg_ParseTuple (args, "O&dd:PDFSurface.__new__",
                           Pycairo_writer_converter, &file,
                           &width_in_points, &height_in_points)) {
+      sink = Pycairo_output_sink_new (file);
+      if (sink == NULL)
+        return NULL;
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       sfc = cairo_pdf_surface_create_for_stream (
-        _write_func, file, width_in_points, height_in_points);
+        Pycairo_output_sink_write, sink, width_in_points, height_in_points);
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
-      return _surface_create_with_object (sfc, file);
+      return _surface_create_with_sink (sfc, sink);
     } else {
       PyErr_Clear ();
       PyErr_SetString(PyExc_TypeError,
@@ -1295,6 +4143,8 @@ pdf_surface_set_size (PycairoPDFSurface *o, PyObject *args) {
   if (!PyArg_ParseTuple(args, "dd:PDFSurface.set_size", &width_in_points,
 			&height_in_points))
     return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
   cairo_pdf_surface_set_size (o->surface, width_in_points,
 			      height_in_points);
   Py_RETURN_NONE;
@@ -1309,9 +4159,13 @@ pdf_surface_set_custom_metadata (PycairoPDFSurface *o, PyObject *args) {
   if (!PyArg_ParseTuple (args, "sz:PDFSurface.set_custom_metadata",
                          &name, &value))
     return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   cairo_pdf_surface_set_custom_metadata (o->surface, name, value);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR (o->surface);
@@ -1326,7 +4180,9 @@ pdf_get_versions (PyObject *self, PyObject *ignored) {
   int i, num_versions;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_pdf_get_versions (&versions, &num_versions);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   list = PyList_New (num_versions);
@@ -1364,7 +4220,9 @@ pdf_version_to_string (PyObject *self,  PyObject *args) {
   */
   if (version >= 0) {
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     version_string = cairo_pdf_version_to_string (version);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
   } else {
     version_string = NULL;
@@ -1386,11 +4244,15 @@ pdf_surface_restrict_to_version (PycairoPDFSurface *o, PyObject *args) {
   if (!PyArg_ParseTuple (args, "i:PDFSurface.restrict_to_version",
                          &version_arg))
     return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
 
   version = (cairo_pdf_version_t)version_arg;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   cairo_pdf_surface_restrict_to_version (o->surface, version);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR (o->surface);
@@ -1401,12 +4263,17 @@ static PyObject *
 pdf_surface_set_page_label (PycairoPDFSurface *o, PyObject *args) {
   const char *utf8;
 
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
+
   if (!PyArg_ParseTuple (args, "es:PDFSurface.set_page_label",
                          "utf-8", &utf8))
     return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   cairo_pdf_surface_set_page_label (o->surface, utf8);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
   PyMem_Free((void *)utf8);
@@ -1421,6 +4288,9 @@ pdf_surface_set_metadata (PycairoPDFSurface *o, PyObject *args) {
   cairo_pdf_metadata_t metadata;
   int metadata_arg;
 
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
+
   if (!PyArg_ParseTuple (args, "ies:PDFSurface.set_metadata",
                          &metadata_arg, "utf-8", &utf8))
     return NULL;
@@ -1428,7 +4298,9 @@ pdf_surface_set_metadata (PycairoPDFSurface *o, PyObject *args) {
   metadata = (cairo_pdf_metadata_t)metadata_arg;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   cairo_pdf_surface_set_metadata (o->surface, metadata, utf8);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
   PyMem_Free((void *)utf8);
@@ -1444,9 +4316,13 @@ pdf_surface_set_thumbnail_size (PycairoPDFSurface *o, PyObject *args) {
   if (!PyArg_ParseTuple (args, "ii:PDFSurface.set_thumbnail_size",
                          &width, &height))
     return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   cairo_pdf_surface_set_thumbnail_size (o->surface, width, height);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR (o->surface);
@@ -1462,6 +4338,9 @@ pdf_surface_add_outline (PycairoPDFSurface *o, PyObject *args) {
   cairo_pdf_outline_flags_t flags;
   int flags_arg;
 
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
+
   if (!PyArg_ParseTuple (args, "iesesi:PDFSurface.add_outline",
                          &parent_id, "utf-8", &utf8, "utf-8", &link_attribs, &flags_arg))
     return NULL;
@@ -1469,7 +4348,9 @@ pdf_surface_add_outline (PycairoPDFSurface *o, PyObject *args) {
   flags = (cairo_pdf_outline_flags_t)flags_arg;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   added_id = cairo_pdf_surface_add_outline (o->surface, parent_id, utf8, link_attribs, flags);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
   PyMem_Free((void *)utf8);
@@ -1494,6 +4375,11 @@ static PyMethodDef pdf_surface_methods[] = {
    METH_VARARGS | METH_STATIC},
   {"restrict_to_version", (PyCFunction)pdf_surface_restrict_to_version,
    METH_VARARGS},
+#ifdef PYCAIRO_HAS_PAGE_QUEUE
+  {"queue_page", (PyCFunction)(void (*)(void))document_surface_queue_page,
+   METH_VARARGS | METH_KEYWORDS},
+  {"wait_pages", (PyCFunction)document_surface_wait_pages, METH_NOARGS},
+#endif
   {NULL, NULL, 0, NULL},
 };
 
@@ -1641,6 +4527,7 @@ static PyObject *
 ps_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
   double width_in_points, height_in_points;
   PyObject *file;
+  PycairoOutputSink *sink;
   cairo_surface_t *sfc;
   char *name;
 
@@ -1655,7 +4542,9 @@ ps_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
       return NULL;
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     sfc = cairo_ps_surface_create (name, width_in_points, height_in_points);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
     PyMem_Free(name);
     return PycairoSurface_FromSurface (sfc, NULL);
@@ -1663,11 +4552,16 @@ ps_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
     if (PyArg_ParseTuple (args, "O&dd:PSSurface.__new__",
                           Pycairo_writer_converter, &file,
                           &width_in_points, &height_in_points)) {
+      sink = Pycairo_output_sink_new (file);
+      if (sink == NULL)
+        return NULL;
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       sfc = cairo_ps_surface_create_for_stream (
-        _write_func, file, width_in_points, height_in_points);
+        Pycairo_output_sink_write, sink, width_in_points, height_in_points);
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
-      return _surface_create_with_object (sfc, file);
+      return _surface_create_with_sink (sfc, sink);
     } else {
       PyErr_Clear ();
       PyErr_SetString(PyExc_TypeError,
@@ -1682,6 +4576,8 @@ ps_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
 
 static PyObject *
 ps_surface_dsc_begin_page_setup (PycairoPSSurface *o, PyObject *ignored) {
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
   cairo_ps_surface_dsc_begin_page_setup (o->surface);
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
   Py_RETURN_NONE;
@@ -1689,6 +4585,8 @@ ps_surface_dsc_begin_page_setup (PycairoPSSurface *o, PyObject *ignored) {
 
 static PyObject *
 ps_surface_dsc_begin_setup (PycairoPSSurface *o, PyObject *ignored) {
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
   cairo_ps_surface_dsc_begin_setup (o->surface);
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
   Py_RETURN_NONE;
@@ -1699,6 +4597,8 @@ ps_surface_dsc_comment (PycairoPSSurface *o, PyObject *args) {
   const char *comment;
   if (!PyArg_ParseTuple(args, "s:PSSurface.dsc_comment", &comment))
     return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
   cairo_ps_surface_dsc_comment (o->surface, comment);
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
   Py_RETURN_NONE;
@@ -1706,7 +4606,11 @@ ps_surface_dsc_comment (PycairoPSSurface *o, PyObject *args) {
 
 static PyObject *
 ps_surface_get_eps (PycairoPSSurface *o, PyObject *ignored) {
-  PyObject *eps = cairo_ps_surface_get_eps (o->surface) ? Py_True : Py_False;
+  PyObject *eps;
+
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
+  eps = cairo_ps_surface_get_eps (o->surface) ? Py_True : Py_False;
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
   Py_INCREF(eps);
   return eps;
@@ -1740,6 +4644,8 @@ ps_surface_restrict_to_level (PycairoPSSurface *o, PyObject *args) {
 
   if (!PyArg_ParseTuple (args, "i:PSSurface.restrict_to_level", &level_arg))
     return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
 
   level = (cairo_ps_level_t)level_arg;
 
@@ -1754,6 +4660,8 @@ ps_surface_set_eps (PycairoPSSurface *o, PyObject *args) {
   if (!PyArg_ParseTuple(args, "O!:PSSurface.set_eps",
 			&PyBool_Type, &py_eps))
     return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
   cairo_ps_surface_set_eps (o->surface, (py_eps == Py_True));
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR(o->surface);
   Py_RETURN_NONE;
@@ -1766,6 +4674,8 @@ ps_surface_set_size (PycairoPSSurface *o, PyObject *args) {
   if (!PyArg_ParseTuple(args, "dd:PSSurface.set_size",
 			&width_in_points, &height_in_points))
     return NULL;
+  if (Pycairo_surface_wait_pages (o->surface) < 0)
+    return NULL;
   cairo_ps_surface_set_size (o->surface, width_in_points, height_in_points);
   Py_RETURN_NONE;
 }
@@ -1777,7 +4687,9 @@ ps_get_levels (PyObject *self, PyObject *ignored) {
   int i, num_levels;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_ps_get_levels (&levels, &num_levels);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   list = PyList_New (num_levels);
@@ -1811,6 +4723,11 @@ static PyMethodDef ps_surface_methods[] = {
   {"set_eps", (PyCFunction)ps_surface_set_eps,                METH_VARARGS },
   {"set_size", (PyCFunction)ps_surface_set_size,              METH_VARARGS },
   {"get_levels", (PyCFunction)ps_get_levels, METH_NOARGS | METH_STATIC},
+#ifdef PYCAIRO_HAS_PAGE_QUEUE
+  {"queue_page", (PyCFunction)(void (*)(void))document_surface_queue_page,
+   METH_VARARGS | METH_KEYWORDS},
+  {"wait_pages", (PyCFunction)document_surface_wait_pages, METH_NOARGS},
+#endif
   {NULL, NULL, 0, NULL},
 };
 
@@ -1891,7 +4808,9 @@ recording_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
   }
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   sfc = cairo_recording_surface_create (content, extents_ptr);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
   return PycairoSurface_FromSurface (sfc, NULL);
 }
@@ -1912,7 +4831,9 @@ recording_surface_get_extents (PycairoRecordingSurface *o, PyObject *ignored) {
   PyObject *rect, *args;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   result = cairo_recording_surface_get_extents (o->surface, &extents);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
   if (!result) {
@@ -1928,9 +4849,54 @@ recording_surface_get_extents (PycairoRecordingSurface *o, PyObject *ignored) {
   return rect;
 }
 
+#ifdef CAIRO_HAS_IMAGE_SURFACE
+static PyObject *
+recording_surface_render_parallel (PycairoRecordingSurface *o, PyObject *args,
+                                   PyObject *kwds) {
+  static char *kwlist[] = {"target", "tile_size", "threads", NULL};
+  PycairoSurface *target;
+  int tile_size = 256, threads = 1;
+  cairo_status_t status;
+
+  if (!PyArg_ParseTupleAndKeywords (args, kwds, "O!|ii:render_parallel",
+                                    kwlist, &PycairoImageSurface_Type,
+                                    &target, &tile_size, &threads))
+    return NULL;
+
+  if (tile_size < 1) {
+    PyErr_SetString (PyExc_ValueError, "tile_size must be at least 1");
+    return NULL;
+  }
+  if (threads < 0) {
+    PyErr_SetString (PyExc_ValueError, "threads must not be negative");
+    return NULL;
+  }
+  if (threads == 0 && (threads = Pycairo_cpu_count ()) < 0)
+    return NULL;
+  if (_surface_is_finished (o->surface) ||
+      _surface_is_finished (target->surface))
+    RETURN_NULL_IF_CAIRO_ERROR (CAIRO_STATUS_SURFACE_FINISHED);
+
+  Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (target->surface);
+  status = Pycairo_render_tiles (o->surface, target->surface, tile_size,
+                                 threads);
+  PYCAIRO_PROBE_RETURN (target->surface);
+  Py_END_ALLOW_THREADS;
+
+  RETURN_NULL_IF_CAIRO_ERROR (status);
+  Py_RETURN_NONE;
+}
+#endif /* CAIRO_HAS_IMAGE_SURFACE */
+
 static PyMethodDef recording_surface_methods[] = {
   {"ink_extents", (PyCFunction)recording_surface_ink_extents, METH_NOARGS },
   {"get_extents", (PyCFunction)recording_surface_get_extents, METH_NOARGS },
+#ifdef CAIRO_HAS_IMAGE_SURFACE
+  {"render_parallel",
+   (PyCFunction)(void (*)(void))recording_surface_render_parallel,
+   METH_VARARGS | METH_KEYWORDS},
+#endif
   {NULL, NULL, 0, NULL},
 };
 
@@ -1988,6 +4954,7 @@ static PyObject *
 svg_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
   double width_in_points, height_in_points;
   PyObject *file;
+  PycairoOutputSink *sink;
   cairo_surface_t *sfc;
   char *name;
 
@@ -2002,7 +4969,9 @@ svg_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
       return NULL;
 
     Py_BEGIN_ALLOW_THREADS;
+    PYCAIRO_PROBE_ENTRY (NULL);
     sfc = cairo_svg_surface_create (name, width_in_points, height_in_points);
+    PYCAIRO_PROBE_RETURN (NULL);
     Py_END_ALLOW_THREADS;
     PyMem_Free(name);
     return PycairoSurface_FromSurface (sfc, NULL);
@@ -2010,11 +4979,16 @@ svg_surface_new (PyTypeObject *type, PyObject *args, PyObject *kwds) {
     if (PyArg_ParseTuple (args, "O&dd:SVGSurface.__new__",
                           Pycairo_writer_converter, &file,
                           &width_in_points, &height_in_points)) {
+      sink = Pycairo_output_sink_new (file);
+      if (sink == NULL)
+        return NULL;
       Py_BEGIN_ALLOW_THREADS;
+      PYCAIRO_PROBE_ENTRY (NULL);
       sfc = cairo_svg_surface_create_for_stream (
-        _write_func, file, width_in_points, height_in_points);
+        Pycairo_output_sink_write, sink, width_in_points, height_in_points);
+      PYCAIRO_PROBE_RETURN (NULL);
       Py_END_ALLOW_THREADS;
-      return _surface_create_with_object (sfc, file);
+      return _surface_create_with_sink (sfc, sink);
     } else {
       PyErr_Clear ();
       PyErr_SetString(PyExc_TypeError,
@@ -2034,7 +5008,9 @@ svg_get_versions (PyObject *self, PyObject *ignored) {
   int i, num_versions;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   cairo_svg_get_versions (&versions, &num_versions);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   list = PyList_New (num_versions);
@@ -2065,7 +5041,9 @@ svg_version_to_string (PyObject *self,  PyObject *args) {
   version = (cairo_svg_version_t)version_arg;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (NULL);
   version_string = cairo_svg_version_to_string (version);
+  PYCAIRO_PROBE_RETURN (NULL);
   Py_END_ALLOW_THREADS;
 
   if (version_string == NULL) {
@@ -2092,7 +5070,9 @@ svg_surface_set_document_unit (PycairoSVGSurface *o, PyObject *args) {
   unit = (cairo_svg_unit_t)unit_arg;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   cairo_svg_surface_set_document_unit (o->surface, unit);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR (o->surface);
@@ -2111,7 +5091,9 @@ svg_surface_restrict_to_version (PycairoSVGSurface *o, PyObject *args) {
   version = (cairo_svg_version_t)version_arg;
 
   Py_BEGIN_ALLOW_THREADS;
+  PYCAIRO_PROBE_ENTRY (o->surface);
   cairo_svg_surface_restrict_to_version (o->surface, version);
+  PYCAIRO_PROBE_RETURN (o->surface);
   Py_END_ALLOW_THREADS;
 
   RETURN_NULL_IF_CAIRO_SURFACE_ERROR (o->surface);
@@ -0,0 +1,164 @@
+/* -*- mode: C; c-basic-offset: 2 -*-
+ *
+ * Pycairo - Python bindings for cairo
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it either under the terms of the GNU Lesser General Public
+ * License version 2.1 as published by the Free Software Foundation
+ * (the "LGPL") or, at your option, under the terms of the Mozilla
+ * Public License Version 1.1 (the "MPL"). If you do not alter this
+ * notice, a recipient may use your version of this file under either
+ * the MPL or the LGPL.
+ *
+ * You should have received a copy of the LGPL along with this library
+ * in the file COPYING-LGPL-2.1; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA 02111-1307 USA
+ * You should have received a copy of the MPL along with this library
+ * in the file COPYING-MPL-1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License
+ * Version 1.1 (the "License"); you may not use this file except in
+ * compliance with the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY
+ * OF ANY KIND, either express or implied. See the LGPL or the MPL for
+ * the specific language governing rights and limitations.
+ */
+
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <math.h>
+
+#include "private.h"
+
+#if defined(CAIRO_HAS_RECORDING_SURFACE) && defined(CAIRO_HAS_IMAGE_SURFACE)
+
+/* Tiled replay of a recording surface into an image surface. The image is
+ * split into square tiles which get rendered by Pycairo_parallel_for(); each
+ * tile is a sub-surface of the image, so the threads write to disjoint
+ * pixels and never need the GIL.
+ *
+ * cairo isn't safe to replay one recording surface from several threads at
+ * once: painting it attaches a proxy snapshot to it and builds its index of
+ * the recorded commands lazily. So every thread replays its own copy, which
+ * gets made on the calling thread before any worker starts. The copies are
+ * shallow: surfaces and raster sources used by the commands are still
+ * shared, which is why RecordingSurface.render_parallel() uses one thread
+ * unless asked for more.
+ */
+
+typedef struct {
+  cairo_surface_t **recordings;  /* one per worker */
+  cairo_surface_t *target;
+  int width, height;  /* of the target, in pixels */
+  int tile_size;
+  int columns;
+  double x_scale, y_scale, x_offset, y_offset;  /* of the target */
+} PycairoTileJob;
+
+/* Returns the coordinate to pass to cairo_surface_create_for_rectangle()
+ * for the pixel position pixel. cairo applies the device transform and
+ * rounds the sub-surface extents inwards, so nudge the value until it maps
+ * back to the exact pixel. */
+static double
+_tile_position (int pixel, double scale, double offset) {
+  double value = (pixel - offset) / scale;
+
+  while (value * scale + offset > pixel)
+    value = nextafter (value, -INFINITY);
+  return value;
+}
+
+static double
+_tile_extent (double position, int end, double scale, double offset) {
+  double start = position * scale + offset;
+  double value = (end - start) / scale;
+
+  while (start + value * scale < end)
+    value = nextafter (value, INFINITY);
+  return value;
+}
+
+static cairo_status_t
+_tile_render (void *data, int worker, int index) {
+  PycairoTileJob *job = data;
+  cairo_surface_t *tile;
+  cairo_status_t status;
+  double x, y, width, height;
+  int left, top, right, bottom;
+  cairo_t *cr;
+
+  left = (index % job->columns) * job->tile_size;
+  top = (index / job->columns) * job->tile_size;
+  right = Py_MIN (left + job->tile_size, job->width);
+  bottom = Py_MIN (top + job->tile_size, job->height);
+
+  x = _tile_position (left, job->x_scale, job->x_offset);
+  y = _tile_position (top, job->y_scale, job->y_offset);
+  width = _tile_extent (x, right, job->x_scale, job->x_offset);
+  height = _tile_extent (y, bottom, job->y_scale, job->y_offset);
+
+  tile = cairo_surface_create_for_rectangle (job->target, x, y, width,
+                                             height);
+  cr = cairo_create (tile);
+  /* Places the origin of the recording at the origin of the target */
+  cairo_set_source_surface (cr, job->recordings[worker], -x, -y);
+  cairo_paint (cr);
+  status = cairo_status (cr);
+  cairo_destroy (cr);
+  cairo_surface_destroy (tile);
+
+  return status;
+}
+
+/* Replays recording into the image surface target, with the origin of the
+ * recording at the origin of the target's user space, using up to threads
+ * threads including the calling one. Doesn't need the GIL. */
+cairo_status_t
+Pycairo_render_tiles (cairo_surface_t *recording, cairo_surface_t *target,
+                      int tile_size, int threads) {
+  PycairoTileJob job;
+  cairo_status_t status = CAIRO_STATUS_SUCCESS;
+  int tiles, copies, i;
+
+  job.target = target;
+  job.width = cairo_image_surface_get_width (target);
+  job.height = cairo_image_surface_get_height (target);
+  job.tile_size = tile_size;
+  if (job.width == 0 || job.height == 0)
+    return CAIRO_STATUS_SUCCESS;
+  job.columns = (job.width - 1) / tile_size + 1;
+  tiles = job.columns * ((job.height - 1) / tile_size + 1);
+  cairo_surface_get_device_scale (target, &job.x_scale, &job.y_scale);
+  cairo_surface_get_device_offset (target, &job.x_offset, &job.y_offset);
+
+  threads = Py_MIN (threads, tiles);
+  job.recordings = PyMem_RawCalloc ((size_t)threads,
+                                    sizeof (cairo_surface_t *));
+  if (job.recordings == NULL)
+    return CAIRO_STATUS_NO_MEMORY;
+
+  /* The calling thread replays the original */
+  job.recordings[0] = cairo_surface_reference (recording);
+  for (copies = 1; copies < threads; copies++) {
+    job.recordings[copies] = Pycairo_recording_surface_copy (recording,
+                                                             &status);
+    if (job.recordings[copies] == NULL)
+      break;
+    /* The copy refers to a snapshot of the recording, which cairo would
+     * hand out again for the next copy unless it gets detached */
+    cairo_surface_flush (recording);
+  }
+
+  if (status == CAIRO_STATUS_SUCCESS)
+    status = Pycairo_parallel_for (0, tiles, threads, 1, _tile_render, &job);
+
+  for (i = 0; i < copies; i++)
+    cairo_surface_destroy (job.recordings[i]);
+  PyMem_RawFree (job.recordings);
+
+  return status;
+}
+
+#endif /* CAIRO_HAS_RECORDING_SURFACE && CAIRO_HAS_IMAGE_SURFACE */
@@ -0,0 +1,570 @@
+#!/usr/bin/env python3
+"""Captures the drawing of an application into a binary trace and replays it
+to benchmark pycairo and cairo versions without the application.
+
+Capture, in the application::
+
+    from trace_replay import TracingContext
+
+    ctx = TracingContext(cairo.Context(surface), "workload.pctrace")
+    draw(ctx)          # used like a cairo.Context
+    ctx.close_trace()
+
+Replay, with any pycairo and cairo version::
+
+    python3 trace_replay.py workload.pctrace --repeat 5 --target image
+
+The replay reports, per operation class, the wall time of the calls through
+the Python API, the time spent in cairo as measured by
+Context.set_stats_enabled() and the difference, which is the binding
+overhead. Classes which cairo doesn't time, like state changes and most path
+construction calls, are shown without the last two. If cairo-script support
+is available the trace is also converted to a cairo-script once and replayed
+with cairo.replay_script(), which runs entirely in C and gives the pure
+cairo cost of the whole workload.
+
+What gets captured: every Context method call with its arguments. Images
+and patterns are stored by value when they are used, objects returned by
+Context methods (groups, copied paths, the target) are referenced by handle.
+Changes made to such objects outside the context, font faces other than
+ToyFontFace and scaled fonts can't be captured and raise TypeError.
+"""
+
+import argparse
+import hashlib
+import io
+import math
+import struct
+import sys
+import time
+from typing import Any, BinaryIO, Optional, Union
+
+import cairo
+
+MAGIC = b"PCTRACE1"
+
+# Classes of the Context methods which Context.stats() times, using its
+# categories. The other path construction calls are only counted there, so
+# they get a class of their own which is shown without a cairo time, like
+# all the methods not listed here.
+CATEGORIES = {
+    "append_path": "path", "close_path": "path", "polyline": "path",
+    "arc": "path_build", "arc_negative": "path_build",
+    "curve_to": "path_build", "glyph_path": "path_build",
+    "line_to": "path_build", "move_to": "path_build",
+    "new_path": "path_build", "new_sub_path": "path_build",
+    "rectangle": "path_build", "rel_curve_to": "path_build",
+    "rel_line_to": "path_build", "rel_move_to": "path_build",
+    "text_path": "path_build",
+    "blit_many": "fill", "draw_instances[fill]": "fill", "fill": "fill",
+    "fill_preserve": "fill",
+    "draw_instances[stroke]": "stroke", "stroke": "stroke",
+    "stroke_preserve": "stroke",
+    "paint": "paint", "paint_with_alpha": "paint",
+    "mask": "mask", "mask_surface": "mask",
+    "clip": "clip", "clip_preserve": "clip",
+    "show_text": "show_text", "show_text_glyphs": "show_text",
+    "show_glyphs": "show_glyphs",
+    "copy_page": "show_page", "show_page": "show_page",
+}
+
+
+def timing_key(name: str, args: tuple, kwargs: dict[str, Any]) -> str:
+    """Returns the name to record the timing of a call under. cairo times
+    draw_instances() as fill or stroke, depending on its mode."""
+
+    if name == "draw_instances":
+        mode = kwargs.get("mode", args[3] if len(args) > 3 else "fill")
+        return f"draw_instances[{mode}]"
+    return name
+
+
+# Types returned by Context methods which can be passed back later
+_HANDLE_TYPES = (cairo.Pattern, cairo.Surface, cairo.Path, cairo.FontFace,
+                 cairo.ScaledFont, cairo.FontOptions)
+
+_PATH_REPLAY = {
+    cairo.PathDataType.MOVE_TO: "move_to",
+    cairo.PathDataType.LINE_TO: "line_to",
+    cairo.PathDataType.CURVE_TO: "curve_to",
+    cairo.PathDataType.CLOSE_PATH: "close_path",
+}
+
+
+def _pack_str(value: str) -> bytes:
+    data = value.encode("utf-8")
+    return struct.pack("<I", len(data)) + data
+
+
+class TracingContext:
+    """Forwards all calls to a :class:`cairo.Context` and records them."""
+
+    def __init__(self, context: cairo.Context,
+                 fobj: Union[str, BinaryIO]) -> None:
+        self.context = context
+        if isinstance(fobj, str):
+            self._file: BinaryIO = open(fobj, "wb")
+            self._close_file = True
+        else:
+            self._file = fobj
+            self._close_file = False
+        self._names: dict[str, int] = {}
+        self._images: dict[tuple, int] = {}
+        self._patterns: dict[bytes, int] = {}
+        self._results: dict[int, tuple[int, Any]] = {}
+        self._next_handle = 1
+
+        target = context.get_target()
+        if isinstance(target, cairo.ImageSurface):
+            header = (int(target.get_format()), target.get_width(),
+                      target.get_height())
+        else:
+            x1, y1, x2, y2 = context.clip_extents()
+            header = (int(cairo.Format.ARGB32), math.ceil(x2 - x1),
+                      math.ceil(y2 - y1))
+        self._file.write(MAGIC + struct.pack("<iii", *header))
+
+    def __getattr__(self, name: str) -> Any:
+        attr = getattr(self.context, name)
+        if not callable(attr):
+            return attr
+
+        def traced(*args: Any, **kwargs: Any) -> Any:
+            if name == "append_path" and args and \
+                    id(args[0]) not in self._results:
+                return self._append_foreign_path(args[0])
+            record = self._encode_call(name, args, kwargs)
+            result = attr(*args, **kwargs)
+            handle = 0
+            if isinstance(result, _HANDLE_TYPES):
+                handle = self._new_handle()
+                self._results[id(result)] = (handle, result)
+            self._file.write(record + struct.pack("<I", handle))
+            return result
+
+        return traced
+
+    def close_trace(self) -> None:
+        """Ends the trace. The context can still be used, untraced."""
+
+        self._file.write(b"E")
+        self._file.flush()
+        if self._close_file:
+            self._file.close()
+        self._results.clear()
+
+    def _new_handle(self) -> int:
+        handle = self._next_handle
+        self._next_handle += 1
+        return handle
+
+    def _append_foreign_path(self, path: cairo.Path) -> None:
+        # A Path can't be recreated in Python, so record the equivalent
+        # path construction calls instead
+        for kind, points in path:
+            getattr(self, _PATH_REPLAY[kind])(*points)
+
+    def _name_id(self, name: str) -> int:
+        if name not in self._names:
+            self._names[name] = len(self._names)
+            self._file.write(b"".join([
+                b"N", struct.pack("<H", self._names[name]), _pack_str(name)]))
+        return self._names[name]
+
+    def _encode_call(self, name: str, args: tuple,
+                     kwargs: dict[str, Any]) -> bytes:
+        out = [b"C", struct.pack("<HB", self._name_id(name), len(args))]
+        for value in args:
+            self._encode(value, out)
+        out.append(struct.pack("<B", len(kwargs)))
+        for key, value in kwargs.items():
+            out.append(_pack_str(key))
+            self._encode(value, out)
+        return b"".join(out)
+
+    def _encode(self, value: Any, out: list[bytes]) -> None:
+        if value is None:
+            out.append(b"n")
+        elif value is True or value is False:
+            out.append(b"t" if value else b"f")
+        elif isinstance(value, int):
+            out.append(b"i" + struct.pack("<q", value))
+        elif isinstance(value, float):
+            out.append(b"d" + struct.pack("<d", value))
+        elif isinstance(value, str):
+            out.append(b"s" + _pack_str(value))
+        elif id(value) in self._results:
+            out.append(b"h" + struct.pack("<I", self._results[id(value)][0]))
+        elif isinstance(value, cairo.Matrix):
+            out.append(b"m" + struct.pack("<6d", *value))
+        elif isinstance(value, (list, tuple)):
+            tag = b"l" if isinstance(value, list) else b"u"
+            out.append(tag + struct.pack("<I", len(value)))
+            for item in value:
+                self._encode(item, out)
+        elif isinstance(value, cairo.Surface):
+            out.append(b"h" + struct.pack("<I", self._image(value)))
+        elif isinstance(value, cairo.Pattern):
+            out.append(b"h" + struct.pack("<I", self._pattern(value)))
+        elif isinstance(value, cairo.ToyFontFace):
+            out.extend([b"F", _pack_str(value.get_family()),
+                        struct.pack("<ii", value.get_slant(),
+                                    value.get_weight())])
+        elif isinstance(value, cairo.FontOptions):
+            out.append(b"O" + struct.pack(
+                "<iiii", value.get_antialias(), value.get_subpixel_order(),
+                value.get_hint_style(), value.get_hint_metrics()))
+        else:
+            try:
+                view = memoryview(value)
+            except TypeError:
+                raise TypeError(
+                    f"can't trace argument of type {type(value).__name__}")
+            data = view.tobytes()
+            out.extend([b"a", _pack_str(view.format),
+                        struct.pack("<B", view.ndim),
+                        struct.pack(f"<{view.ndim}I", *view.shape),
+                        struct.pack("<I", len(data)), data])
+
+    def _image(self, surface: cairo.Surface) -> int:
+        image = _snapshot(surface)
+        image.flush()
+        data = bytes(image.get_data())
+        offset = image.get_device_offset()
+        key = (image.get_format(), image.get_width(), image.get_height(),
+               image.get_stride(), offset,
+               hashlib.blake2b(data, digest_size=16).digest())
+        if key not in self._images:
+            handle = self._images[key] = self._new_handle()
+            self._file.write(
+                b"I" + struct.pack("<Iiiii2dI", handle, *key[:4], *offset,
+                                   len(data)) + data)
+        return self._images[key]
+
+    def _pattern(self, pattern: cairo.Pattern) -> int:
+        if isinstance(pattern, cairo.SolidPattern):
+            data = b"s" + struct.pack("<4d", *pattern.get_rgba())
+        else:
+            if isinstance(pattern, cairo.SurfacePattern):
+                data = b"S" + struct.pack(
+                    "<I", self._image(pattern.get_surface()))
+            elif isinstance(pattern, cairo.LinearGradient):
+                data = b"l" + struct.pack("<4d", *pattern.get_linear_points())
+            elif isinstance(pattern, cairo.RadialGradient):
+                data = b"r" + struct.pack("<6d", *pattern.get_radial_circles())
+            else:
+                raise TypeError(
+                    f"can't trace pattern of type {type(pattern).__name__}")
+            if isinstance(pattern, cairo.Gradient):
+                stops = pattern.get_color_stops_rgba()
+                data += struct.pack("<I", len(stops))
+                data += b"".join(struct.pack("<5d", *stop) for stop in stops)
+            data += struct.pack("<6dii", *pattern.get_matrix(),
+                                pattern.get_extend(), pattern.get_filter())
+        if data not in self._patterns:
+            handle = self._patterns[data] = self._new_handle()
+            self._file.write(b"".join([
+                b"P", struct.pack("<II", handle, len(data)), data]))
+        return self._patterns[data]
+
+
+def _snapshot(surface: cairo.Surface) -> cairo.ImageSurface:
+    """Returns the surface, or an image with its contents at the same
+    coordinates"""
+
+    if isinstance(surface, cairo.ImageSurface):
+        return surface
+    if not isinstance(surface, cairo.RecordingSurface):
+        raise TypeError(
+            f"can't trace source surface of type {type(surface).__name__}")
+    extents = surface.get_extents()
+    if extents is None:
+        x, y, width, height = surface.ink_extents()
+    else:
+        x, y, width, height = (extents.x, extents.y, extents.width,
+                               extents.height)
+    image = cairo.ImageSurface(cairo.Format.ARGB32, max(math.ceil(width), 1),
+                               max(math.ceil(height), 1))
+    ctx = cairo.Context(image)
+    ctx.set_source_surface(surface, -x, -y)
+    ctx.paint()
+    image.set_device_offset(-x, -y)
+    return image
+
+
+class _Ref:
+    """Reference to an object returned by an earlier call"""
+
+    def __init__(self, handle: int) -> None:
+        self.handle = handle
+
+
+class Trace:
+    """A parsed trace, ready to be replayed"""
+
+    def __init__(self, data: bytes) -> None:
+        if not data.startswith(MAGIC):
+            raise ValueError("not a pycairo trace")
+        self.format, self.width, self.height = struct.unpack_from(
+            "<iii", data, len(MAGIC))
+        self._data = data
+        self._pos = len(MAGIC) + 12
+        self._names: dict[int, str] = {}
+        self._objects: dict[int, Any] = {}
+        # (name, args, kwargs, result handle, whether args contain _Ref)
+        self.calls: list[tuple[str, tuple, dict, int, bool]] = []
+        self._parse()
+
+    def _unpack(self, fmt: str) -> tuple:
+        values = struct.unpack_from(fmt, self._data, self._pos)
+        self._pos += struct.calcsize(fmt)
+        return values
+
+    def _bytes(self, length: int) -> bytes:
+        data = self._data[self._pos:self._pos + length]
+        self._pos += length
+        return data
+
+    def _str(self) -> str:
+        return self._bytes(self._unpack("<I")[0]).decode("utf-8")
+
+    def _parse(self) -> None:
+        while True:
+            kind = self._bytes(1)
+            if kind == b"E" or not kind:
+                break
+            elif kind == b"N":
+                name_id, = self._unpack("<H")
+                self._names[name_id] = self._str()
+            elif kind == b"I":
+                self._parse_image()
+            elif kind == b"P":
+                handle, length = self._unpack("<II")
+                self._objects[handle] = self._parse_pattern(
+                    io.BytesIO(self._bytes(length)))
+            elif kind == b"C":
+                self._parse_call()
+            else:
+                raise ValueError(f"invalid record {kind!r}")
+
+    def _parse_image(self) -> None:
+        handle, fmt, width, height, stride, dx, dy, length = self._unpack(
+            "<Iiiii2dI")
+        image = cairo.ImageSurface.create_for_data(
+            bytearray(self._bytes(length)), cairo.Format(fmt), width, height,
+            stride)
+        image.set_device_offset(dx, dy)
+        self._objects[handle] = image
+
+    def _parse_pattern(self, data: io.BytesIO) -> cairo.Pattern:
+        def unpack(fmt: str) -> tuple:
+            return struct.unpack(fmt, data.read(struct.calcsize(fmt)))
+
+        kind = data.read(1)
+        pattern: cairo.Pattern
+        if kind == b"s":
+            return cairo.SolidPattern(*unpack("<4d"))
+        elif kind == b"S":
+            pattern = cairo.SurfacePattern(self._objects[unpack("<I")[0]])
+        elif kind == b"l":
+            pattern = cairo.LinearGradient(*unpack("<4d"))
+        else:
+            pattern = cairo.RadialGradient(*unpack("<6d"))
+        if isinstance(pattern, cairo.Gradient):
+            for _ in range(unpack("<I")[0]):
+                pattern.add_color_stop_rgba(*unpack("<5d"))
+        values = unpack("<6dii")
+        pattern.set_matrix(cairo.Matrix(*values[:6]))
+        pattern.set_extend(cairo.Extend(values[6]))
+        pattern.set_filter(cairo.Filter(values[7]))
+        return pattern
+
+    def _parse_value(self) -> Any:
+        tag = self._bytes(1)
+        if tag == b"n":
+            return None
+        elif tag in (b"t", b"f"):
+            return tag == b"t"
+        elif tag == b"i":
+            return self._unpack("<q")[0]
+        elif tag == b"d":
+            return self._unpack("<d")[0]
+        elif tag == b"s":
+            return self._str()
+        elif tag == b"h":
+            handle, = self._unpack("<I")
+            return self._objects.get(handle, _Ref(handle))
+        elif tag == b"m":
+            return cairo.Matrix(*self._unpack("<6d"))
+        elif tag in (b"l", b"u"):
+            items = [self._parse_value() for _ in range(self._unpack("<I")[0])]
+            return items if tag == b"l" else tuple(items)
+        elif tag == b"F":
+            family = self._str()
+            slant, weight = self._unpack("<ii")
+            return cairo.ToyFontFace(family, cairo.FontSlant(slant),
+                                     cairo.FontWeight(weight))
+        elif tag == b"O":
+            values = self._unpack("<iiii")
+            options = cairo.FontOptions()
+            options.set_antialias(cairo.Antialias(values[0]))
+            options.set_subpixel_order(cairo.SubpixelOrder(values[1]))
+            options.set_hint_style(cairo.HintStyle(values[2]))
+            options.set_hint_metrics(cairo.HintMetrics(values[3]))
+            return options
+        elif tag == b"a":
+            fmt = self._str()
+            ndim, = self._unpack("<B")
+            shape = self._unpack(f"<{ndim}I")
+            data = self._bytes(self._unpack("<I")[0])
+            return memoryview(data).cast("B").cast(fmt, shape)
+        raise ValueError(f"invalid value tag {tag!r}")
+
+    def _parse_call(self) -> None:
+        name_id, nargs = self._unpack("<HB")
+        args = tuple(self._parse_value() for _ in range(nargs))
+        kwargs = {}
+        for _ in range(self._unpack("<B")[0]):
+            key = self._str()
+            kwargs[key] = self._parse_value()
+        handle, = self._unpack("<I")
+        has_refs = any(isinstance(value, _Ref)
+                       for value in args + tuple(kwargs.values()))
+        self.calls.append((self._names[name_id], args, kwargs, handle,
+                           has_refs))
+
+    def run(self, ctx: cairo.Context,
+            timings: Optional[dict[str, list[int]]] = None) -> None:
+        """Replays all calls on ctx. If timings is given, the count and
+        wall time in ns of each method are added to it."""
+
+        results: dict[int, Any] = {}
+
+        def resolve(value: Any) -> Any:
+            return results[value.handle] if isinstance(value, _Ref) else value
+
+        clock = time.perf_counter_ns
+        for name, args, kwargs, handle, has_refs in self.calls:
+            method = getattr(ctx, name)
+            if has_refs:
+                args = tuple(resolve(value) for value in args)
+                kwargs = {key: resolve(value)
+                          for key, value in kwargs.items()}
+            if timings is None:
+                result = method(*args, **kwargs)
+            else:
+                start = clock()
+                result = method(*args, **kwargs)
+                elapsed = clock() - start
+                entry = timings.setdefault(
+                    timing_key(name, args, kwargs), [0, 0])
+                entry[0] += 1
+                entry[1] += elapsed
+            if handle:
+                results[handle] = result
+
+
+def create_target(trace: Trace, kind: str) -> cairo.Surface:
+    if kind == "image":
+        return cairo.ImageSurface(cairo.Format(trace.format), trace.width,
+                                  trace.height)
+    elif kind == "recording":
+        return cairo.RecordingSurface(
+            cairo.Content.COLOR_ALPHA,
+            cairo.Rectangle(0, 0, trace.width, trace.height))
+    elif kind == "pdf":
+        return cairo.PDFSurface(None, trace.width, trace.height)
+    return cairo.SVGSurface(None, trace.width, trace.height)
+
+
+def to_script(trace: Trace) -> bytes:
+    """Converts the trace to a cairo-script by replaying it once"""
+
+    fileobj = io.BytesIO()
+    device = cairo.ScriptDevice(fileobj)
+    surface = cairo.ScriptSurface(device, cairo.Content.COLOR_ALPHA,
+                                  trace.width, trace.height)
+    trace.run(cairo.Context(surface))
+    surface.finish()
+    device.finish()
+    return fileobj.getvalue()
+
+
+def main() -> None:
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawTextHelpFormatter)
+    parser.add_argument("trace")
+    parser.add_argument("--repeat", type=int, default=5)
+    parser.add_argument("--target", default="image",
+                        choices=["image", "recording", "pdf", "svg"])
+    args = parser.parse_args()
+
+    with open(args.trace, "rb") as h:
+        trace = Trace(h.read())
+    print(f"{len(trace.calls)} calls, {trace.width}x{trace.height}, "
+          f"cairo {cairo.cairo_version_string()}, "
+          f"pycairo {cairo.version}, target {args.target}")
+
+    # Whole replays without per call timing
+    best = math.inf
+    for _ in range(args.repeat):
+        surface = create_target(trace, args.target)
+        start = time.perf_counter()
+        trace.run(cairo.Context(surface))
+        surface.finish()
+        best = min(best, time.perf_counter() - start)
+    print(f"python replay:  {best * 1000:10.2f} ms (best of {args.repeat})")
+
+    if cairo.HAS_SCRIPT_SURFACE and getattr(
+            cairo, "HAS_SCRIPT_INTERPRETER", False):
+        script = to_script(trace)
+        native = math.inf
+        for _ in range(args.repeat):
+            surface = create_target(trace, args.target)
+            start = time.perf_counter()
+            cairo.replay_script(script, surface)
+            surface.finish()
+            native = min(native, time.perf_counter() - start)
+        print(f"native replay:  {native * 1000:10.2f} ms "
+              f"(cairo-script, {len(script)} bytes)")
+    else:
+        print("native replay:  not available, needs the cairo-script "
+              "interpreter")
+
+    # One replay with per call timing and the cairo side statistics
+    timings: dict[str, list[int]] = {}
+    surface = create_target(trace, args.target)
+    ctx = cairo.Context(surface)
+    ctx.set_stats_enabled(True)
+    trace.run(ctx, timings)
+    surface.finish()
+    cairo_stats = ctx.stats()
+
+    classes: dict[str, list[float]] = {}
+    for name, (count, elapsed) in timings.items():
+        entry = classes.setdefault(CATEGORIES.get(name, "state"), [0, 0.0])
+        entry[0] += count
+        entry[1] += elapsed / 1e9
+
+    print()
+    print(f"{'class':<12} {'calls':>9} {'python ms':>11} {'cairo ms':>11} "
+          f"{'binding us/call':>16}")
+    for category, (count, elapsed) in sorted(
+            classes.items(), key=lambda item: -item[1][1]):
+        if category in cairo_stats:
+            in_cairo = cairo_stats[category][1]
+            overhead = (elapsed - in_cairo) / count * 1e6 if count else 0.0
+            cairo_ms = f"{in_cairo * 1000:11.2f}"
+            binding = f"{overhead:16.2f}"
+        else:
+            # Not timed on the cairo side, nothing to compare with
+            cairo_ms = f"{'-':>11}"
+            binding = f"{'-':>16}"
+        print(f"{category:<12} {int(count):9d} {elapsed * 1000:11.2f} "
+              f"{cairo_ms} {binding}")
+
+
+if __name__ == "__main__":
+    if len(sys.argv) < 2:
+        sys.argv.append("--help")
+    main()
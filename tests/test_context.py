@@ -1,6 +1,8 @@
 import cairo
 import pytest
 import ctypes
+import array
+import math
 
 
 @pytest.fixture
@@ -123,6 +125,56 @@ def test_arc_negative(context: cairo.Context) -> None:
         context.arc_negative(object())  # type: ignore
 
 
+def test_blit_many() -> None:
+    atlas = cairo.ImageSurface(cairo.Format.ARGB32, 4, 2)
+    ctx = cairo.Context(atlas)
+    ctx.set_source_rgb(1, 0, 0)
+    ctx.rectangle(0, 0, 2, 2)
+    ctx.fill()
+    ctx.set_source_rgb(0, 0, 1)
+    ctx.rectangle(2, 0, 2, 2)
+    ctx.fill()
+
+    src = array.array("d", [2, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2])
+    dst = array.array("d", [0, 0, 4, 0, 6, 1])
+    alphas = array.array("d", [1, 0.5, 0])
+
+    expected = cairo.ImageSurface(cairo.Format.ARGB32, 8, 3)
+    ctx = cairo.Context(expected)
+    ctx.set_source_surface(atlas, -2, 0)
+    ctx.rectangle(0, 0, 2, 2)
+    ctx.fill()
+    ctx.set_source_surface(atlas, 4, 0)
+    ctx.rectangle(4, 0, 2, 2)
+    ctx.clip()
+    ctx.paint_with_alpha(0.5)
+    expected.flush()
+
+    surface = cairo.ImageSurface(cairo.Format.ARGB32, 8, 3)
+    ctx = cairo.Context(surface)
+    source = ctx.get_source()
+    ctx.move_to(1, 1)
+    ctx.blit_many(atlas, src, dst, alphas)
+    surface.flush()
+    assert bytes(surface.get_data()) == bytes(expected.get_data())
+    assert ctx.get_source() == source
+    assert not ctx.has_current_point()
+
+    ctx.blit_many(atlas, memoryview(src)[:4], memoryview(dst)[:2])
+    ctx.blit_many(atlas, array.array("d"), array.array("d"))
+
+    with pytest.raises(ValueError):
+        ctx.blit_many(atlas, src, dst[:4])
+    with pytest.raises(ValueError):
+        ctx.blit_many(atlas, src, dst, alphas[:1])
+    with pytest.raises(ValueError):
+        ctx.blit_many(atlas, src[:3], dst)
+    with pytest.raises(TypeError):
+        ctx.blit_many(atlas, array.array("f", src), dst)
+    with pytest.raises(TypeError):
+        ctx.blit_many(atlas, [0, 0, 1, 1], [0, 0])  # type: ignore
+
+
 def test_clip_extents(context: cairo.Context) -> None:
     assert context.clip_extents() == (0.0, 0.0, 42.0, 42.0)
 
@@ -140,6 +192,40 @@ def test_in_clip() -> None:
         context.in_clip(None, None)  # type: ignore
 
 
+def test_in_fill_stroke_clip_many() -> None:
+    surface = cairo.ImageSurface(cairo.FORMAT_ARGB32, 100, 100)
+    context = cairo.Context(surface)
+    context.scale(2, 2)
+    context.rectangle(10, 10, 20, 20)
+    context.set_line_width(2)
+
+    points = array.array("d")
+    for x in range(-5, 45, 3):
+        for y in range(-5, 45, 7):
+            points.extend([x + 0.5, y])
+    coords = list(zip(points[::2], points[1::2]))
+    points.extend([float("nan"), 20])
+
+    result = context.in_fill_many(points)
+    assert isinstance(result, bytes)
+    assert list(result) == [context.in_fill(*p) for p in coords] + [0]
+    assert any(result)
+    result = context.in_stroke_many(points)
+    assert list(result) == [context.in_stroke(*p) for p in coords] + [0]
+    assert any(result)
+
+    context.clip()
+    result = context.in_clip_many(points)
+    assert list(result)[:-1] == [context.in_clip(*p) for p in coords]
+    assert any(result)
+
+    assert context.in_fill_many(array.array("d")) == b""
+    with pytest.raises(ValueError):
+        context.in_fill_many(array.array("d", [1]))
+    with pytest.raises(TypeError):
+        context.in_stroke_many(b"\x00" * 16)
+
+
 def test_device_to_user(context: cairo.Context) -> None:
     assert context.device_to_user(0, 0) == (0, 0)
     with pytest.raises(TypeError):
@@ -152,6 +238,56 @@ def test_device_to_user_distance(context: cairo.Context) -> None:
         context.device_to_user_distance(None, None)  # type: ignore
 
 
+@pytest.mark.parametrize("mode", ["fill", "stroke"])
+def test_draw_instances(mode: str) -> None:
+    shape = cairo.Context(cairo.ImageSurface(cairo.Format.ARGB32, 1, 1))
+    shape.move_to(0, 0)
+    shape.line_to(4, 2)
+    shape.line_to(0, 4)
+    shape.close_path()
+    path = shape.copy_path()
+
+    matrices = [
+        cairo.Matrix(x0=2, y0=3),
+        cairo.Matrix(xx=0, yx=1, xy=-1, yy=0, x0=20, y0=10),
+    ]
+    rgba = [(1, 0, 0, 1), (0, 0, 1, 0.5)]
+
+    expected = cairo.ImageSurface(cairo.Format.ARGB32, 32, 32)
+    ctx = cairo.Context(expected)
+    ctx.scale(1.5, 1.5)
+    for matrix, color in zip(matrices, rgba):
+        ctx.save()
+        ctx.transform(matrix)
+        ctx.append_path(path)
+        ctx.set_source_rgba(*color)
+        getattr(ctx, mode)()
+        ctx.restore()
+    expected.flush()
+
+    surface = cairo.ImageSurface(cairo.Format.ARGB32, 32, 32)
+    ctx = cairo.Context(surface)
+    ctx.scale(1.5, 1.5)
+    transforms = array.array("d", [v for m in matrices for v in m])
+    colors = array.array("d", [v for c in rgba for v in c])
+    ctx.move_to(1, 1)
+    ctx.draw_instances(path, transforms, colors, mode=mode)
+    surface.flush()
+    assert bytes(surface.get_data()) == bytes(expected.get_data())
+    assert ctx.get_matrix() == cairo.Matrix(1.5, 0, 0, 1.5)
+    assert not ctx.has_current_point()
+
+    ctx.draw_instances(path, transforms)
+    with pytest.raises(ValueError):
+        ctx.draw_instances(path, transforms, colors[:4])
+    with pytest.raises(ValueError):
+        ctx.draw_instances(path, transforms[:5])
+    with pytest.raises(ValueError):
+        ctx.draw_instances(path, transforms, mode="paint")
+    with pytest.raises(TypeError):
+        ctx.draw_instances(path, [1, 0, 0, 1, 0, 0])  # type: ignore
+
+
 def test_fill_extents(context: cairo.Context) -> None:
     context.line_to(1, 1)
     context.line_to(1, 0)
@@ -257,6 +393,115 @@ def test_path_extents(context: cairo.Context) -> None:
     assert context.path_extents() == (0.0, 0.0, 1.0, 1.0)
 
 
+def test_polyline(context: cairo.Context) -> None:
+    MOVE_TO = cairo.PathDataType.MOVE_TO
+    LINE_TO = cairo.PathDataType.LINE_TO
+
+    points = array.array("d", [
+        0, 0, 0.25, 5, 0.5, -5, 0.75, 1, 0.875, 2, 1.5, 0])
+    assert context.polyline(points) == 5
+    assert list(context.copy_path()) == [
+        (MOVE_TO, (0, 0)), (LINE_TO, (0.25, 5)), (LINE_TO, (0.5, -5)),
+        (LINE_TO, (0.875, 2)), (LINE_TO, (1.5, 0))]
+
+    context.new_path()
+    assert context.polyline(points, decimate=False) == 6
+    assert len(list(context.copy_path())) == 6
+
+    context.new_path()
+    context.scale(4, 1)
+    assert context.polyline(points) == 6
+
+    context.new_path()
+    context.identity_matrix()
+    nan = float("nan")
+    assert context.polyline(
+        array.array("d", [0, 0, 1, 1, nan, 0, 2, 2, 3, 3])) == 4
+    assert [t for t, p in context.copy_path()] == [
+        MOVE_TO, LINE_TO, MOVE_TO, LINE_TO]
+
+    context.new_path()
+    samples = array.array("d")
+    for i in range(10000):
+        samples.extend([i / 1000, math.sin(i / 100) * 10 + 20])
+    assert context.polyline(samples) <= 4 * 10
+
+    with pytest.raises(ValueError):
+        context.polyline(array.array("d", [1, 2, 3]))
+    with pytest.raises(TypeError):
+        context.polyline([0, 0, 1, 1])  # type: ignore
+
+
+def test_polyline_device_offset() -> None:
+    surface = cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10)
+    context = cairo.Context(surface)
+    points = array.array("d", [0, 0, 0.25, 1, 0.5, 0, 0.75, 1])
+    assert context.polyline(points) == 3
+
+    # the offset moves half of the points into the next device pixel
+    context.new_path()
+    surface.set_device_offset(0.5, 0)
+    assert context.polyline(points) == 4
+
+    context.new_path()
+    surface.set_device_offset(0, 0)
+    context.push_group()
+    assert context.polyline(points) == 3
+    context.pop_group()
+
+
+def test_pick_buffer() -> None:
+    surface = cairo.ImageSurface(cairo.FORMAT_ARGB32, 40, 40)
+    context = cairo.Context(surface)
+    pick = cairo.PickBuffer(40, 40)
+    assert context.get_pick_buffer() is None
+    assert context.get_pick_id() == 0
+
+    context.set_pick_buffer(pick)
+    assert context.get_pick_buffer() is pick
+
+    context.rectangle(0, 0, 10, 10)
+    context.fill()
+    assert pick.lookup(5, 5) == 0
+
+    context.set_pick_id(0x123456)
+    context.rectangle(0, 0, 10, 10)
+    context.fill_preserve()
+    context.save()
+    context.set_pick_id(7)
+    context.restore()
+    context.translate(20, 0)
+    context.rectangle(0, 0, 10, 10)
+    context.set_line_width(4)
+    context.stroke()
+    context.identity_matrix()
+
+    context.rectangle(0, 20, 40, 20)
+    context.clip()
+    context.set_pick_id(0xffffff)
+    context.rectangle(30, 10, 10, 20)
+    context.fill()
+
+    assert pick.lookup(5, 5) == 0x123456
+    assert pick.lookup(20, 5) == 7
+    assert pick.lookup(25, 5) == 0
+    assert pick.lookup(35, 15) == 0
+    assert pick.lookup(35, 25) == 0xffffff
+    assert pick.lookup(-1, 0) == 0
+    assert pick.lookup(0, 40) == 0
+    assert isinstance(pick.get_surface(), cairo.ImageSurface)
+
+    pick.clear()
+    assert pick.lookup(5, 5) == 0
+
+    with pytest.raises(ValueError):
+        context.set_pick_id(0x1000000)
+    with pytest.raises(TypeError):
+        context.set_pick_buffer(surface)  # type: ignore
+    context.set_pick_buffer(None)
+    assert context.get_pick_buffer() is None
+
+
 def test_push_pop_group(context: cairo.Context) -> None:
     context.push_group()
     context.pop_group()
@@ -551,3 +796,62 @@ def test_hairline(context: cairo.Context) -> None:
     context.set_hairline(True)
     assert isinstance(context.get_hairline(), bool)
     assert context.get_hairline()
+
+
+def test_stats(context: cairo.Context) -> None:
+    assert not context.get_stats_enabled()
+    with pytest.raises(RuntimeError):
+        context.stats()
+    with pytest.raises(TypeError):
+        context.set_stats_enabled(1)  # type: ignore
+
+    context.set_stats_enabled(True)
+    assert context.get_stats_enabled()
+    context.rectangle(0, 0, 10, 10)
+    context.fill()
+    context.move_to(0, 0)
+    context.line_to(10, 10)
+    context.stroke()
+    context.paint()
+
+    stats = context.stats()
+    assert set(stats) == {
+        "path", "fill", "stroke", "paint", "mask", "clip", "show_text",
+        "show_glyphs", "show_page"}
+    assert stats["path"][0] == 3
+    assert stats["fill"][0] == 1
+    assert stats["stroke"][0] == 1
+    assert stats["paint"][0] == 1
+    assert stats["mask"] == (0, 0.0)
+    assert isinstance(stats["fill"][1], float)
+    assert stats["fill"][1] >= 0.0
+
+    context.set_stats_enabled(False)
+    assert not context.get_stats_enabled()
+    context.fill()
+    context.set_stats_enabled(True)
+    assert context.stats()["fill"] == (0, 0.0)
+
+
+def test_context_stats(context: cairo.Context) -> None:
+    cairo.reset_context_stats()
+    context.paint()
+    assert cairo.context_stats()["paint"] == (0, 0.0)
+
+    context.set_stats_enabled(True)
+    context.paint()
+    context.paint_with_alpha(0.5)
+    assert cairo.context_stats()["paint"][0] == 2
+
+    cairo.reset_context_stats()
+    assert cairo.context_stats()["paint"] == (0, 0.0)
+    assert context.stats()["paint"][0] == 2
+
+    # counters of disabled or freed contexts stay in the totals
+    context.paint()
+    other = cairo.Context(context.get_target())
+    other.set_stats_enabled(True)
+    other.paint()
+    del other
+    context.set_stats_enabled(False)
+    assert cairo.context_stats()["paint"][0] == 2
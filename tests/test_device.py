@@ -41,6 +41,7 @@ def test_type() -> None:
 
 def test_has() -> None:
     assert hasattr(cairo, "HAS_SCRIPT_SURFACE")
+    assert hasattr(cairo, "HAS_SCRIPT_INTERPRETER")
 
 
 def test_script_device() -> None:
@@ -127,3 +128,68 @@ def test_script_device_to_path() -> None:
         cairo.ScriptDevice(fname).finish()
     finally:
         os.unlink(fname)
+
+
+@pytest.mark.skipif(not cairo.HAS_SCRIPT_INTERPRETER,
+                    reason="no cairo-script-interpreter")
+def test_replay_script() -> None:
+    f = io.BytesIO()
+    dev = cairo.ScriptDevice(f)
+    surface = cairo.ScriptSurface(dev, cairo.Content.COLOR_ALPHA, 4, 4)
+    ctx = cairo.Context(surface)
+    ctx.set_source_rgb(1, 0, 0)
+    ctx.rectangle(0, 0, 2, 4)
+    ctx.fill()
+    del ctx
+    surface.finish()
+    dev.finish()
+    script = f.getvalue()
+
+    def check(target: cairo.ImageSurface) -> None:
+        target.flush()
+        data = bytes(target.get_data())
+        stride = target.get_stride()
+        assert data[:4] == b"\x00\x00\xff\xff" or \
+            data[:4] == b"\xff\xff\x00\x00"
+        assert data[stride - 4:stride] == b"\x00" * 4
+
+    target = cairo.ImageSurface(cairo.Format.ARGB32, 4, 4)
+    cairo.replay_script(script, target)
+    check(target)
+
+    target = cairo.ImageSurface(cairo.Format.ARGB32, 4, 4)
+    cairo.replay_script(io.BytesIO(script), target)
+    check(target)
+
+    with tempfile.TemporaryDirectory() as dirname:
+        path = os.path.join(dirname, "chart.cs")
+        with open(path, "wb") as h:
+            h.write(script)
+        target = cairo.ImageSurface(cairo.Format.ARGB32, 4, 4)
+        cairo.replay_script(path, target)
+        check(target)
+
+    # only the first surface of the script draws onto the target
+    f = io.BytesIO()
+    dev = cairo.ScriptDevice(f)
+    first = cairo.ScriptSurface(dev, cairo.Content.COLOR_ALPHA, 4, 4)
+    second = cairo.ScriptSurface(dev, cairo.Content.COLOR_ALPHA, 4, 4)
+    ctx = cairo.Context(first)
+    ctx.set_source_rgb(1, 0, 0)
+    ctx.rectangle(0, 0, 2, 4)
+    ctx.fill()
+    ctx = cairo.Context(second)
+    ctx.set_source_rgb(0, 1, 0)
+    ctx.paint()
+    del ctx
+    first.finish()
+    second.finish()
+    dev.finish()
+    target = cairo.ImageSurface(cairo.Format.ARGB32, 4, 4)
+    cairo.replay_script(f.getvalue(), target)
+    check(target)
+
+    with pytest.raises(cairo.Error):
+        cairo.replay_script(b"%!CairoScript\nno-such-operator", target)
+    with pytest.raises(TypeError):
+        cairo.replay_script(script, object())  # type: ignore
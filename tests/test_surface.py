@@ -1,9 +1,12 @@
 import io
 import os
+import asyncio
 import sys
 import array
 import tempfile
 import struct
+import ctypes
+import platform
 
 import cairo
 import pytest
@@ -587,6 +590,69 @@ def test_image_surface_write_to_png_error() -> None:
         surface.write_to_png("\x00")
 
 
+def test_queue_page() -> None:
+    fileobj = io.BytesIO()
+    surface = cairo.PSSurface(fileobj, 100, 100)
+    page = cairo.RecordingSurface(cairo.Content.COLOR_ALPHA, None)
+    for i in range(20):
+        ctx = cairo.Context(page)
+        ctx.set_operator(cairo.Operator.CLEAR)
+        ctx.paint()
+        ctx.set_operator(cairo.Operator.OVER)
+        ctx.rectangle(i, i, 10, 10)
+        ctx.fill()
+        surface.queue_page(page, max_pending=i % 3 + 1)
+    surface.wait_pages()
+    surface.finish()
+    assert fileobj.getvalue().count(b"%%Page:") == 20
+
+    with pytest.raises(cairo.Error):
+        surface.queue_page(page)
+    surface.wait_pages()
+
+    fileobj = io.BytesIO()
+    with cairo.PDFSurface(fileobj, 100, 100) as surface:
+        with pytest.raises(ValueError):
+            surface.queue_page(page, max_pending=0)
+        with pytest.raises(TypeError):
+            surface.queue_page(  # type: ignore
+                cairo.ImageSurface(cairo.FORMAT_RGB24, 1, 1))
+        surface.queue_page(page)
+    assert fileobj.getvalue().startswith(b"%PDF")
+
+    # drawing directly after queueing waits for the queued pages first
+    fileobj = io.BytesIO()
+    surface = cairo.PSSurface(fileobj, 100, 100)
+    for i in range(3):
+        surface.queue_page(page)
+        surface.dsc_comment("%%Title: test")
+        surface.set_eps(False)
+        ctx = cairo.Context(surface)
+        ctx.rectangle(0, 0, 10, 10)
+        ctx.fill()
+        ctx.show_page()
+    surface.finish()
+    assert fileobj.getvalue().count(b"%%Page:") == 6
+
+    fileobj = io.BytesIO()
+    with cairo.PDFSurface(fileobj, 100, 100) as surface:
+        surface.queue_page(page)
+        surface.set_fallback_resolution(150, 150)
+        surface.show_page()
+        surface.queue_page(page)
+        surface.copy_page()
+    assert fileobj.getvalue().startswith(b"%PDF")
+
+    # dropping the surface without finish() still writes all queued pages
+    fileobj = io.BytesIO()
+    surface = cairo.PSSurface(fileobj, 100, 100)
+    for i in range(5):
+        surface.queue_page(page)
+    del surface
+    assert fileobj.getvalue().count(b"%%Page:") == 5
+    assert b"%%EOF" in fileobj.getvalue()
+
+
 def test_surface_from_stream_closed_before_finished() -> None:
     for _ in [cairo.PDFSurface, cairo.PSSurface, cairo.SVGSurface]:
         fileobj = io.BytesIO()
@@ -705,6 +771,118 @@ def test_write_to_png(image_surface: cairo.ImageSurface) -> None:
         image_surface.write_to_png(object())  # type: ignore
 
 
+def test_png_async(tmp_path) -> None:
+    surface = cairo.ImageSurface(cairo.Format.ARGB32, 30, 20)
+    ctx = cairo.Context(surface)
+    ctx.set_source_rgb(0.5, 0.2, 0.1)
+    ctx.paint()
+    path = str(tmp_path / "image.png")
+
+    async def run() -> None:
+        fileobj = io.BytesIO()
+        await asyncio.gather(
+            surface.write_to_png_async(path),
+            surface.write_to_png_async(fileobj))
+        fileobj.seek(0)
+        images = await asyncio.gather(
+            cairo.ImageSurface.create_from_png_async(path),
+            cairo.ImageSurface.create_from_png_async(fileobj))
+        for image in images:
+            assert image.get_data() == surface.get_data()
+
+        with pytest.raises(cairo.Error):
+            await cairo.ImageSurface.create_from_png_async(io.BytesIO(b"x"))
+        with pytest.raises(TypeError):
+            surface.write_to_png_async(object())  # type: ignore
+
+        pdf_file = io.BytesIO()
+        pdf = cairo.PDFSurface(pdf_file, 100, 100)
+        cairo.Context(pdf).paint()
+        await pdf.finish_async()
+        assert pdf_file.getvalue().startswith(b"%PDF")
+        with pytest.raises(cairo.Error):
+            cairo.Context(pdf)
+
+    asyncio.run(run())
+
+    with pytest.raises(RuntimeError):
+        surface.write_to_png_async(path)
+
+
+def test_finish_async_blocks_exports() -> None:
+    surface = cairo.ImageSurface(cairo.Format.ARGB32, 30, 20)
+
+    async def run() -> None:
+        future = surface.finish_async()
+        with pytest.raises(BufferError):
+            memoryview(surface)
+        with pytest.warns(DeprecationWarning):
+            assert len(surface.get_data()) == 0
+        with pytest.raises(RuntimeError):
+            surface.finish_async()
+        await future
+
+    asyncio.run(run())
+    with pytest.raises(BufferError):
+        memoryview(surface)
+
+
+@pytest.mark.skipif(not hasattr(os, "fork"), reason="no fork")
+@pytest.mark.filterwarnings("ignore:.*fork.*:DeprecationWarning")
+def test_png_async_after_fork() -> None:
+    surface = cairo.ImageSurface(cairo.Format.ARGB32, 30, 20)
+
+    async def run() -> None:
+        for i in range(4):
+            await surface.write_to_png_async(io.BytesIO())
+
+    # start the workers in the parent, the child needs its own
+    asyncio.run(run())
+    pid = os.fork()
+    if pid == 0:
+        try:
+            asyncio.run(asyncio.wait_for(run(), 10))
+        except BaseException:
+            os._exit(1)
+        os._exit(0)
+    _, status = os.waitpid(pid, 0)
+    assert os.WIFEXITED(status) and os.WEXITSTATUS(status) == 0
+
+
+def test_write_pngs(tmp_path) -> None:
+    surfaces = []
+    for i in range(5):
+        surface = cairo.ImageSurface(cairo.Format.ARGB32, 10 + i, 10)
+        ctx = cairo.Context(surface)
+        ctx.set_source_rgb(i / 5, 0.5, 0.2)
+        ctx.paint()
+        surfaces.append(surface)
+
+    paths = [str(tmp_path / f"{i}.png") for i in range(4)]
+    fileobj = io.BytesIO()
+    finished = cairo.ImageSurface(cairo.Format.ARGB32, 10, 10)
+    finished.finish()
+    items = list(zip(surfaces, paths + [fileobj]))  # type: ignore
+    items.append((finished, str(tmp_path / "finished.png")))
+
+    result = cairo.write_pngs(items, threads=3)
+    assert result[:5] == [cairo.Status.SUCCESS] * 5
+    assert result[5] != cairo.Status.SUCCESS
+    for surface, target in items[:5]:
+        if not isinstance(target, str):
+            target.seek(0)
+        image = cairo.ImageSurface.create_from_png(target)
+        assert image.get_data() == surface.get_data()
+
+    assert cairo.write_pngs([]) == []
+    with pytest.raises(ValueError):
+        cairo.write_pngs([], threads=-1)
+    with pytest.raises(TypeError):
+        cairo.write_pngs([surfaces[0]])  # type: ignore
+    with pytest.raises(TypeError):
+        cairo.write_pngs([(surfaces[0], object())])  # type: ignore
+
+
 def test_image_surface() -> None:
     with pytest.raises(TypeError):
         cairo.ImageSurface(cairo.FORMAT_ARGB32, 3, object())  # type: ignore
@@ -805,6 +983,56 @@ def test_recording_surface() -> None:
     assert surface.ink_extents() == (0.0, 0.0, 0.0, 0.0)
 
 
+def test_recording_surface_render_parallel() -> None:
+    recording = cairo.RecordingSurface(cairo.Content.COLOR_ALPHA, None)
+    ctx = cairo.Context(recording)
+    ctx.set_source_rgb(0.2, 0.4, 0.6)
+    ctx.rectangle(3, 2, 20, 15)
+    ctx.fill()
+    ctx.set_source_rgba(1, 0.5, 0, 0.5)
+    ctx.arc(20, 15, 10, 0, 6.3)
+    ctx.fill()
+
+    def render(parallel: bool, **kwargs: int) -> bytes:
+        image = cairo.ImageSurface(cairo.Format.ARGB32, 61, 47)
+        image.set_device_scale(1.5, 1.5)
+        image.set_device_offset(2, 3)
+        if parallel:
+            recording.render_parallel(image, **kwargs)
+        else:
+            ctx = cairo.Context(image)
+            ctx.set_source_surface(recording, 0, 0)
+            ctx.paint()
+        image.flush()
+        return bytes(image.get_data())
+
+    expected = render(False)
+    assert any(expected)
+    assert render(True) == expected
+    assert render(True, tile_size=7, threads=4) == expected
+    assert render(True, tile_size=1000, threads=0) == expected
+    for i in range(20):
+        assert render(True, tile_size=3, threads=8) == expected
+
+    # the per-thread copies don't keep stale snapshots of the recording
+    ctx.set_source_rgb(0, 1, 0)
+    ctx.rectangle(0, 0, 5, 5)
+    ctx.fill()
+    expected = render(False)
+    assert render(True, tile_size=5, threads=4) == expected
+
+    image = cairo.ImageSurface(cairo.Format.ARGB32, 10, 10)
+    with pytest.raises(ValueError):
+        recording.render_parallel(image, tile_size=0)
+    with pytest.raises(ValueError):
+        recording.render_parallel(image, threads=-1)
+    with pytest.raises(TypeError):
+        recording.render_parallel(recording)  # type: ignore
+    image.finish()
+    with pytest.raises(cairo.Error):
+        recording.render_parallel(image)
+
+
 @pytest.mark.skipif(not hasattr(cairo.Format, "RGB96F"), reason="too old cairo")
 def test_format_rgbf() -> None:
     surface = cairo.ImageSurface(cairo.Format.RGB96F, 3, 3)
@@ -824,3 +1052,730 @@ def test_image_surface_release_on_finish() -> None:
     # after the surface is finished, there should be nothing exported from the
     # memoryview anymore
     mem.release()
+
+
+def test_image_surface_buffer_protocol() -> None:
+    surface = cairo.ImageSurface(cairo.Format.ARGB32, 3, 2)
+    with memoryview(surface) as view:
+        assert view.format == "B"
+        assert view.shape == (2, 3, 4)
+        assert view.strides == (surface.get_stride(), 4, 1)
+        assert not view.readonly
+        view[0, 0, 0] = 42
+    assert surface.get_data()[0] == 42
+
+    surface = cairo.ImageSurface(cairo.Format.A8, 3, 2)
+    with memoryview(surface) as view:
+        assert view.shape == (2, 3, 1)
+        assert view.strides == (surface.get_stride(), 1, 1)
+        assert not view.c_contiguous
+
+    surface = cairo.ImageSurface(cairo.Format.RGB16_565, 2, 2)
+    with memoryview(surface) as view:
+        assert view.format == "H"
+        assert view.shape == (2, 2, 1)
+
+    surface = cairo.ImageSurface(cairo.Format.A1, 3, 2)
+    with memoryview(surface) as view:
+        assert view.shape == (2, surface.get_stride())
+
+
+def test_image_surface_buffer_protocol_len() -> None:
+    # the padding at the end of each row isn't part of the exported data
+    surface = cairo.ImageSurface(cairo.Format.A8, 3, 2)
+    assert surface.get_stride() > 3
+    with memoryview(surface) as view:
+        assert view.nbytes == 6
+        assert len(view.tobytes()) == 6
+
+
+class _PyBuffer(ctypes.Structure):
+    _fields_ = [
+        ("buf", ctypes.c_void_p), ("obj", ctypes.py_object),
+        ("len", ctypes.c_ssize_t), ("itemsize", ctypes.c_ssize_t),
+        ("readonly", ctypes.c_int), ("ndim", ctypes.c_int),
+        ("format", ctypes.c_char_p), ("shape", ctypes.c_void_p),
+        ("strides", ctypes.c_void_p), ("suboffsets", ctypes.c_void_p),
+        ("internal", ctypes.c_void_p)]
+
+
+@pytest.mark.skipif(
+    platform.python_implementation() != "CPython", reason="CPython only")
+def test_image_surface_buffer_protocol_fortran() -> None:
+    PyBUF_F_CONTIGUOUS = 0x0040 | 0x0008 | 0x0010
+    get_buffer = ctypes.pythonapi.PyObject_GetBuffer
+    get_buffer.argtypes = [
+        ctypes.py_object, ctypes.POINTER(_PyBuffer), ctypes.c_int]
+    release = ctypes.pythonapi.PyBuffer_Release
+    release.argtypes = [ctypes.POINTER(_PyBuffer)]
+
+    def is_fortran(surface: cairo.ImageSurface) -> bool:
+        view = _PyBuffer()
+        try:
+            get_buffer(surface, ctypes.byref(view), PyBUF_F_CONTIGUOUS)
+        except BufferError:
+            return False
+        release(ctypes.byref(view))
+        return True
+
+    # a single row still has width and channels
+    assert not is_fortran(cairo.ImageSurface(cairo.Format.ARGB32, 3, 1))
+    assert not is_fortran(cairo.ImageSurface(cairo.Format.A8, 4, 2))
+    assert is_fortran(cairo.ImageSurface(cairo.Format.A8, 4, 1))
+    # a single column without padding
+    assert is_fortran(cairo.ImageSurface(cairo.Format.RGB30, 1, 4))
+    assert not is_fortran(cairo.ImageSurface(cairo.Format.A8, 1, 4))
+
+
+@pytest.mark.skipif(not hasattr(cairo.Format, "RGB96F"), reason="too old cairo")
+def test_image_surface_buffer_protocol_float() -> None:
+    surface = cairo.ImageSurface(cairo.Format.RGB96F, 3, 2)
+    with memoryview(surface) as view:
+        assert view.format == "f"
+        assert view.shape == (2, 3, 3)
+        assert view.strides == (surface.get_stride(), 12, 4)
+
+    surface = cairo.ImageSurface(cairo.Format.RGBA128F, 3, 2)
+    with memoryview(surface) as view:
+        assert view.shape == (2, 3, 4)
+        assert view.strides[1:] == (16, 4)
+
+
+def test_image_surface_finish_exported() -> None:
+    surface = cairo.ImageSurface(cairo.Format.ARGB32, 3, 2)
+    view = memoryview(surface)
+    data = surface.get_data()
+    with pytest.raises(BufferError):
+        surface.finish()
+    view.release()
+    with pytest.raises(BufferError):
+        surface.__exit__(None, None, None)
+    data.release()
+    surface.finish()
+    with pytest.raises(BufferError):
+        memoryview(surface)
+
+
+def test_image_surface_unmap_exported() -> None:
+    surface = cairo.ImageSurface(cairo.Format.ARGB32, 3, 2)
+    mapped = surface.map_to_image(None)
+    view = memoryview(mapped)
+    with pytest.raises(BufferError):
+        surface.unmap_image(mapped)
+    view.release()
+    surface.unmap_image(mapped)
+
+
+def test_image_surface_convert_to() -> None:
+    surface = cairo.ImageSurface(cairo.Format.ARGB32, 5, 2)
+    ctx = cairo.Context(surface)
+    ctx.set_source_rgba(1, 0.5, 0, 0.5)
+    ctx.paint()
+    ctx.set_source_rgba(0, 0, 1, 1)
+    ctx.rectangle(0, 0, 1, 1)
+    ctx.fill()
+
+    rgba = bytearray(5 * 2 * 4)
+    surface.convert_to(rgba, "RGBA")
+    assert rgba[:4] == b"\x00\x00\xff\xff"
+    assert rgba[4:8] == b"\xff\x80\x00\x80"
+
+    bgra = bytearray(5 * 2 * 4)
+    surface.convert_to(bgra, "BGRA")
+    assert bgra[4:8] == b"\x00\x80\xff\x80"
+
+    argb = bytearray(5 * 2 * 4)
+    surface.convert_to(argb, "ARGB")
+    assert argb[4:8] == b"\x80\xff\x80\x00"
+
+    rgb = bytearray(5 * 2 * 3)
+    surface.convert_to(rgb, "RGB")
+    assert rgb[:6] == b"\x00\x00\xff\xff\x80\x00"
+
+    gray = bytearray(5 * 2)
+    surface.convert_to(gray, "L")
+    assert gray[0] == 29
+
+    padded = bytearray(2 * 32)
+    surface.convert_to(padded, "RGBA", 32)
+    assert padded[:20] == rgba[:20]
+    assert padded[32:52] == rgba[20:]
+
+    alpha = bytearray(cairo.Format.A8.stride_for_width(5) * 2)
+    surface.convert_to(alpha, cairo.Format.A8)
+    assert alpha[:2] == b"\xff\x80"
+
+    with pytest.raises(TypeError):
+        surface.convert_to(bytearray(10), "RGBA")
+    with pytest.raises(ValueError):
+        surface.convert_to(rgba, "RGBA", 4)
+    with pytest.raises(ValueError):
+        surface.convert_to(rgba, "CMYK")
+    with pytest.raises(ValueError):
+        surface.convert_to(rgba, cairo.Format.A1)
+    with pytest.raises(TypeError):
+        surface.convert_to(rgba, object())  # type: ignore
+    with pytest.raises(BufferError):
+        surface.convert_to(b"", "RGBA")  # type: ignore
+
+    surface.finish()
+    with pytest.raises(cairo.Error):
+        surface.convert_to(rgba, "RGBA")
+
+
+def test_image_surface_create_from_pixels() -> None:
+    data = bytes(range(256)) * 4
+    surface = cairo.ImageSurface.create_from_pixels(data, "RGBA", 16, 16)
+    assert surface.get_format() == cairo.Format.ARGB32
+    assert (surface.get_width(), surface.get_height()) == (16, 16)
+    out = bytearray(len(data))
+    surface.convert_to(out, "RGBA")
+    # only opaque pixels survive the premultiplication unchanged
+    for i in range(0, len(data), 4):
+        if data[i + 3] == 255:
+            assert out[i:i + 4] == data[i:i + 4]
+
+    pixel = cairo.ImageSurface.create_from_pixels(
+        b"\xff\x80\x00\x80", "RGBA", 1, 1)
+    assert bytes(pixel.get_data()) == (
+        b"\x00\x40\x80\x80" if sys.byteorder == "little"
+        else b"\x80\x80\x40\x00")
+
+    rgb = cairo.ImageSurface.create_from_pixels(
+        b"\x01\x02\x03\x04\x05\x06", "BGR", 2, 1)
+    assert rgb.get_format() == cairo.Format.RGB24
+    out = bytearray(6)
+    rgb.convert_to(out, "BGR")
+    assert out == b"\x01\x02\x03\x04\x05\x06"
+
+    gray = cairo.ImageSurface.create_from_pixels(b"\x10\x20", "L", 1, 2)
+    out = bytearray(2)
+    gray.convert_to(out, "L")
+    assert out == b"\x10\x20"
+
+    a8 = cairo.ImageSurface.create_from_pixels(
+        b"\x01\x02\x03\x04", cairo.Format.A8, 4, 1)
+    assert a8.get_format() == cairo.Format.A8
+    assert bytes(a8.get_data())[:4] == b"\x01\x02\x03\x04"
+
+    empty = cairo.ImageSurface.create_from_pixels(b"", "RGBA", 0, 0)
+    assert empty.get_width() == 0
+
+    with pytest.raises(TypeError):
+        cairo.ImageSurface.create_from_pixels(b"\x00" * 3, "RGBA", 1, 1)
+    with pytest.raises(ValueError):
+        cairo.ImageSurface.create_from_pixels(b"", "RGBA", -1, 1)
+    with pytest.raises(ValueError):
+        cairo.ImageSurface.create_from_pixels(b"", "RGBA", 1, -1)
+
+
+def test_image_surface_convert_formats() -> None:
+    surface = cairo.ImageSurface(cairo.Format.RGB16_565, 2, 1)
+    ctx = cairo.Context(surface)
+    ctx.set_source_rgb(1, 0, 1)
+    ctx.paint()
+    rgba = bytearray(8)
+    surface.convert_to(rgba, "RGBA")
+    assert rgba == b"\xff\x00\xff\xff" * 2
+
+    if hasattr(cairo.Format, "RGBA128F"):
+        floats = array.array("f", [0.0] * 8)
+        surface.convert_to(floats, cairo.Format.RGBA128F)
+        assert list(floats) == [1.0, 0.0, 1.0, 1.0] * 2
+
+
+@pytest.mark.skipif(not hasattr(cairo.Surface, "set_mime_data_from_file"),
+                    reason="no mmap support")
+def test_set_mime_data_from_file() -> None:
+    surface = cairo.ImageSurface(cairo.FORMAT_RGB24, 1, 1)
+    with tempfile.TemporaryDirectory() as dirname:
+        path = os.path.join(dirname, "image.jpg")
+        with open(path, "wb") as h:
+            h.write(b"\xff\xd8" + b"jpeg" * 1000)
+        surface.set_mime_data(cairo.MIME_TYPE_JPEG, b"old")
+        surface.set_mime_data_from_file(cairo.MIME_TYPE_JPEG, path)
+        os.unlink(path)
+        assert surface.get_mime_data(cairo.MIME_TYPE_JPEG) == \
+            b"\xff\xd8" + b"jpeg" * 1000
+
+        empty = os.path.join(dirname, "empty.jpg")
+        open(empty, "wb").close()
+        with pytest.raises(ValueError):
+            surface.set_mime_data_from_file(cairo.MIME_TYPE_JPEG, empty)
+        with pytest.raises(OSError):
+            surface.set_mime_data_from_file(cairo.MIME_TYPE_JPEG, path)
+
+    surface.set_mime_data(cairo.MIME_TYPE_JPEG, None)
+    assert surface.get_mime_data(cairo.MIME_TYPE_JPEG) is None
+    surface.finish()
+
+
+@pytest.mark.skipif(not hasattr(cairo.ImageSurface, "create_for_mmap"),
+                    reason="no mmap support")
+def test_image_surface_create_for_mmap() -> None:
+    with tempfile.TemporaryDirectory() as dirname:
+        path = os.path.join(dirname, "canvas.raw")
+        stride = cairo.Format.ARGB32.stride_for_width(4)
+        white = b"\xff" * (stride * 3)
+
+        surface = cairo.ImageSurface.create_for_mmap(
+            path, cairo.Format.ARGB32, 4, 3, mode="w+", sync=True)
+        assert os.path.getsize(path) == stride * 3
+        ctx = cairo.Context(surface)
+        ctx.set_source_rgb(1, 1, 1)
+        ctx.paint()
+        surface.flush()
+        with open(path, "rb") as h:
+            assert h.read() == white
+        surface.finish()
+
+        surface = cairo.ImageSurface.create_for_mmap(
+            path, cairo.Format.ARGB32, 4, 3, mode="c")
+        ctx = cairo.Context(surface)
+        ctx.set_operator(cairo.Operator.CLEAR)
+        ctx.paint()
+        surface.flush()
+        assert bytes(surface.get_data()) == b"\x00" * (stride * 3)
+        surface.finish()
+        with open(path, "rb") as h:
+            assert h.read() == white
+
+        with cairo.ImageSurface.create_for_mmap(
+                path, cairo.Format.ARGB32, 4, 3) as surface:
+            assert bytes(surface.get_data()) == white
+
+        with pytest.raises(ValueError):
+            cairo.ImageSurface.create_for_mmap(
+                path, cairo.Format.ARGB32, 4, 4)
+        with pytest.raises(ValueError):
+            cairo.ImageSurface.create_for_mmap(
+                path, cairo.Format.ARGB32, 4, 3, mode="r")
+        with pytest.raises(OSError):
+            cairo.ImageSurface.create_for_mmap(
+                os.path.join(dirname, "missing.raw"),
+                cairo.Format.ARGB32, 4, 3)
+
+        empty = cairo.ImageSurface.create_for_mmap(
+            os.path.join(dirname, "empty.raw"), cairo.Format.ARGB32, 0, 0,
+            mode="w+")
+        assert empty.get_width() == 0
+        empty.finish()
+
+
+@pytest.mark.parametrize("allocator", ["default", "aligned64", "hugepage"])
+def test_image_surface_allocator(allocator: str) -> None:
+    surface = cairo.ImageSurface(
+        cairo.Format.ARGB32, 33, 5, allocator=allocator)
+    assert surface.get_width() == 33
+    stride = surface.get_stride()
+    assert stride >= cairo.Format.ARGB32.stride_for_width(33)
+    if allocator != "default":
+        assert stride % 64 == 0
+    assert bytes(surface.get_data()) == b"\x00" * (stride * 5)
+
+    ctx = cairo.Context(surface)
+    ctx.set_source_rgb(1, 1, 1)
+    ctx.paint()
+    surface.flush()
+    assert bytes(surface.get_data())[:4] == b"\xff" * 4
+    surface.finish()
+
+
+def test_image_surface_allocator_invalid() -> None:
+    with pytest.raises(ValueError):
+        cairo.ImageSurface(cairo.Format.ARGB32, 4, 4, allocator="foo")
+    with pytest.raises(TypeError):
+        cairo.ImageSurface(
+            cairo.Format.ARGB32, 4, 4, allocator=42)  # type: ignore
+    with pytest.raises(cairo.Error):
+        cairo.ImageSurface(cairo.Format.ARGB32, -1, 4, allocator="aligned64")
+
+
+def test_image_surface_shared() -> None:
+    surface = cairo.ImageSurface.create_shared(cairo.Format.ARGB32, 4, 3)
+    shm = surface.get_shared_memory()
+    assert shm is not None
+    try:
+        assert shm.size >= surface.get_stride() * 3
+
+        other = cairo.ImageSurface.open_shared(
+            shm.name, cairo.Format.ARGB32, 4, 3)
+        assert other.get_shared_memory() is not shm
+        ctx = cairo.Context(other)
+        ctx.set_source_rgb(1, 1, 1)
+        ctx.paint()
+        other.flush()
+        other.finish()
+
+        surface.mark_dirty()
+        assert bytes(surface.get_data()) == b"\xff" * (4 * 4 * 3)
+
+        with pytest.raises(TypeError):
+            cairo.ImageSurface.open_shared(
+                shm.name, cairo.Format.ARGB32, 4, 300)
+        with pytest.raises(FileExistsError):
+            cairo.ImageSurface.create_shared(
+                cairo.Format.ARGB32, 4, 3, name=shm.name)
+        with pytest.raises(ValueError):
+            cairo.ImageSurface.create_shared(cairo.Format.ARGB32, -1, 3)
+        surface.finish()
+    finally:
+        shm.unlink()
+
+    if sys.platform != "win32":
+        with pytest.raises(FileNotFoundError):
+            cairo.ImageSurface.open_shared(
+                shm.name, cairo.Format.ARGB32, 4, 3)
+
+    assert cairo.ImageSurface(cairo.Format.A8, 1, 1).get_shared_memory() is None
+
+
+def test_surface_pool() -> None:
+    pool = cairo.SurfacePool(max_size=1)
+    fmt = cairo.Format.ARGB32
+
+    with pool.acquire(fmt, 4, 3) as surface:
+        assert isinstance(surface, cairo.ImageSurface)
+        assert surface.get_width() == 4
+        ctx = cairo.Context(surface)
+        ctx.set_source_rgb(1, 1, 1)
+        ctx.paint()
+    assert pool.stats() == {
+        "hits": 0, "misses": 1, "discarded": 0,
+        "idle": 1, "idle_bytes": 4 * 4 * 3}
+
+    surface = pool.acquire(fmt, 4, 3)
+    assert bytes(surface.get_data()) == b"\x00" * (4 * 4 * 3)
+    assert pool.stats()["hits"] == 1
+    assert pool.stats()["idle"] == 0
+    pool.release(surface)
+    with pytest.raises(ValueError):
+        pool.release(surface)
+    with pytest.raises(ValueError):
+        pool.release(cairo.ImageSurface(fmt, 4, 3))
+
+    surface = pool.acquire(fmt, 2, 2)
+    del surface
+    stats = pool.stats()
+    assert stats["misses"] == 2
+    assert stats["discarded"] == 1
+    assert stats["idle_bytes"] == 2 * 4 * 2
+
+    pool.clear()
+    assert pool.stats()["idle"] == 0
+
+    with pytest.raises(ValueError):
+        pool.acquire(fmt, -1, 3)
+    with pytest.raises(ValueError):
+        cairo.SurfacePool(-1)
+
+
+def test_surface_pool_memory() -> None:
+    import tracemalloc
+
+    fmt = cairo.Format.ARGB32
+    size = 16 * 16 * 4
+    pool = cairo.SurfacePool()
+    idle_bytes = cairo.memory_stats()["pool_idle_bytes"]
+
+    tracemalloc.start()
+    try:
+        pool.acquire(fmt, 16, 16).finish()
+        assert cairo.memory_stats()["pool_idle_bytes"] == idle_bytes + size
+        snapshot = tracemalloc.take_snapshot().filter_traces(
+            [tracemalloc.DomainFilter(True, cairo.TRACEMALLOC_DOMAIN)])
+        assert sum(t.size for t in snapshot.traces) == size
+    finally:
+        tracemalloc.stop()
+
+    # idle buffers count against the limit and get dropped to make room
+    in_use = cairo.memory_stats()["pixel_bytes"]
+    cairo.set_image_memory_limit(in_use + idle_bytes + size)
+    try:
+        cairo.ImageSurface(fmt, 16, 16).finish()
+        assert cairo.memory_stats()["pool_idle_bytes"] == idle_bytes
+        assert pool.stats()["idle"] == 0
+
+        # a failed acquire isn't counted as a hit or miss
+        with pool.acquire(fmt, 16, 16):
+            with pytest.raises(MemoryError):
+                pool.acquire(fmt, 16, 16)
+        stats = pool.stats()
+        assert stats["hits"] == 0
+        assert stats["misses"] == 2
+    finally:
+        cairo.set_image_memory_limit(None)
+    pool.clear()
+
+
+def test_output_sink(tmp_path) -> None:
+    cairo.reset_output_stats()
+
+    fileobj = io.BytesIO()
+    surface = cairo.PDFSurface(fileobj, 100, 100)
+    ctx = cairo.Context(surface)
+    for i in range(100):
+        ctx.rectangle(i, i, 10, 10)
+        ctx.show_page()
+    surface.finish()
+    data = fileobj.getvalue()
+    assert data.startswith(b"%PDF")
+    assert data.rstrip().endswith(b"%%EOF")
+
+    fname = str(tmp_path / "out.pdf")
+    with open(fname, "wb") as fileobj:
+        fileobj.write(b"")
+        surface = cairo.PDFSurface(fileobj, 100, 100)
+        ctx = cairo.Context(surface)
+        for i in range(100):
+            ctx.rectangle(i, i, 10, 10)
+            ctx.show_page()
+        surface.finish()
+        # the file position is up to date while the surface is still alive
+        assert fileobj.tell() == os.fstat(fileobj.fileno()).st_size > 0
+        fileobj.write(b"trailer")
+        del surface, ctx
+    with open(fname, "rb") as fileobj:
+        written = fileobj.read()
+        assert written.startswith(b"%PDF")
+        assert written[:-len(b"trailer")].rstrip().endswith(b"%%EOF")
+        assert written.endswith(b"trailer")
+
+    fname = str(tmp_path / "out.png")
+    with open(fname, "wb") as fileobj:
+        cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10).write_to_png(fileobj)
+        assert fileobj.tell() == os.fstat(fileobj.fileno()).st_size > 0
+
+    stats = cairo.output_stats()
+    assert set(stats) == {"fragments", "bytes", "python_writes",
+                          "direct_writes", "python_writes_saved"}
+    assert stats["bytes"] >= 2 * len(data) - 1000
+    assert stats["python_writes"] < stats["fragments"]
+    assert stats["python_writes_saved"] > 0
+
+    cairo.reset_output_stats()
+    assert cairo.output_stats()["fragments"] == 0
+
+
+def test_set_unique_id_from_content() -> None:
+    pixels = os.urandom(32 * 4 * 32)
+    first = cairo.ImageSurface.create_for_data(
+        bytearray(pixels), cairo.FORMAT_ARGB32, 32, 32)
+    second = cairo.ImageSurface.create_for_data(
+        bytearray(pixels), cairo.FORMAT_ARGB32, 32, 32)
+    first.set_unique_id_from_content()
+    second.set_unique_id_from_content()
+    first_id = first.get_mime_data(cairo.MIME_TYPE_UNIQUE_ID)
+    assert first_id is not None
+    assert first_id == second.get_mime_data(cairo.MIME_TYPE_UNIQUE_ID)
+
+    ctx = cairo.Context(second)
+    ctx.rectangle(0, 0, 1, 1)
+    ctx.fill()
+    second.set_unique_id_from_content()
+    assert first_id != second.get_mime_data(cairo.MIME_TYPE_UNIQUE_ID)
+
+
+def test_deduplicate_images() -> None:
+    pixels = os.urandom(64 * 4 * 64)
+
+    def render(deduplicate: bool) -> bytes:
+        fileobj = io.BytesIO()
+        surface = cairo.PDFSurface(fileobj, 100, 100)
+        assert not surface.get_deduplicate_images()
+        surface.set_deduplicate_images(deduplicate)
+        assert surface.get_deduplicate_images() == deduplicate
+        ctx = cairo.Context(surface)
+        for i in range(10):
+            image = cairo.ImageSurface.create_for_data(
+                bytearray(pixels), cairo.FORMAT_ARGB32, 64, 64)
+            ctx.set_source_surface(image, i, i)
+            ctx.paint()
+            ctx.show_page()
+        surface.finish()
+        return fileobj.getvalue()
+
+    assert len(render(True)) * 3 < len(render(False))
+
+    surface = cairo.PDFSurface(None, 100, 100)
+    surface.set_deduplicate_images(True)
+    image = cairo.ImageSurface(cairo.FORMAT_ARGB32, 4, 4)
+    image.set_mime_data(cairo.MIME_TYPE_UNIQUE_ID, b"mine")
+    cairo.Context(surface).set_source_surface(image)
+    assert image.get_mime_data(cairo.MIME_TYPE_UNIQUE_ID) == b"mine"
+
+    # the content ID is reused until the image changes
+    buf = bytearray(4 * 4 * 4)
+    image = cairo.ImageSurface.create_for_data(buf, cairo.FORMAT_ARGB32, 4, 4)
+    ctx = cairo.Context(surface)
+    ctx.set_source_surface(image)
+    first_id = image.get_mime_data(cairo.MIME_TYPE_UNIQUE_ID)
+    assert first_id is not None
+    ctx.set_source_surface(image)
+    assert image.get_mime_data(cairo.MIME_TYPE_UNIQUE_ID) == first_id
+    buf[0] = 0xff
+    image.mark_dirty()
+    ctx.set_source_surface(image)
+    assert image.get_mime_data(cairo.MIME_TYPE_UNIQUE_ID) != first_id
+
+
+def test_memory_stats() -> None:
+    stats = cairo.memory_stats()
+    assert set(stats) == {
+        "surfaces", "pixel_bytes", "peak_pixel_bytes", "pool_idle_bytes"}
+    live_images = stats["surfaces"].get("image", 0)
+    pixel_bytes = stats["pixel_bytes"]
+
+    surface = cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 20)
+    stats = cairo.memory_stats()
+    assert stats["surfaces"]["image"] == live_images + 1
+    assert stats["pixel_bytes"] == pixel_bytes + 10 * 20 * 4
+    assert stats["peak_pixel_bytes"] >= stats["pixel_bytes"]
+
+    # wrapping the same surface again doesn't count it twice
+    cairo.Context(surface).get_target()
+    assert cairo.memory_stats()["pixel_bytes"] == pixel_bytes + 10 * 20 * 4
+
+    surface.finish()
+    stats = cairo.memory_stats()
+    assert stats["surfaces"]["image"] == live_images + 1
+    assert stats["pixel_bytes"] == pixel_bytes
+
+    del surface
+    assert cairo.memory_stats()["surfaces"].get("image", 0) == live_images
+
+
+def test_memory_stats_create_for_data() -> None:
+    pixel_bytes = cairo.memory_stats()["pixel_bytes"]
+    buf = bytearray(10 * 10 * 4)
+    surface = cairo.ImageSurface.create_for_data(
+        buf, cairo.FORMAT_ARGB32, 10, 10)
+    assert cairo.memory_stats()["pixel_bytes"] == pixel_bytes
+    surface.finish()
+
+    # images pycairo didn't allocate only count as live surfaces
+    ctx = cairo.Context(cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10))
+    pixel_bytes = cairo.memory_stats()["pixel_bytes"]
+    ctx.push_group()
+    target = ctx.get_group_target()
+    assert isinstance(target, cairo.ImageSurface)
+    assert cairo.memory_stats()["pixel_bytes"] == pixel_bytes
+    ctx.pop_group()
+
+
+def test_memory_stats_map_to_image() -> None:
+    stats = cairo.memory_stats()
+    live_images = stats["surfaces"].get("image", 0)
+    pixel_bytes = stats["pixel_bytes"]
+
+    recording = cairo.RecordingSurface(
+        cairo.Content.COLOR_ALPHA, cairo.Rectangle(0, 0, 10, 20))
+    mapped = recording.map_to_image(None)
+    stats = cairo.memory_stats()
+    assert stats["surfaces"]["image"] == live_images + 1
+    assert stats["pixel_bytes"] == pixel_bytes + 10 * 20 * 4
+    recording.unmap_image(mapped)
+    stats = cairo.memory_stats()
+    assert stats["surfaces"].get("image", 0) == live_images
+    assert stats["pixel_bytes"] == pixel_bytes
+
+    # mapping an image surface shares its memory
+    surface = cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 20)
+    with surface.map_to_image(None):
+        stats = cairo.memory_stats()
+        assert stats["surfaces"]["image"] == live_images + 2
+        assert stats["pixel_bytes"] == pixel_bytes + 10 * 20 * 4
+    surface.finish()
+
+
+def test_memory_stats_tracemalloc() -> None:
+    import tracemalloc
+
+    tracemalloc.start()
+    try:
+        surface = cairo.ImageSurface(cairo.FORMAT_ARGB32, 16, 16)
+        snapshot = tracemalloc.take_snapshot().filter_traces(
+            [tracemalloc.DomainFilter(True, cairo.TRACEMALLOC_DOMAIN)])
+        assert sum(t.size for t in snapshot.traces) == 16 * 16 * 4
+        surface.finish()
+        snapshot = tracemalloc.take_snapshot().filter_traces(
+            [tracemalloc.DomainFilter(True, cairo.TRACEMALLOC_DOMAIN)])
+        assert sum(t.size for t in snapshot.traces) == 0
+    finally:
+        tracemalloc.stop()
+
+
+def test_image_memory_limit() -> None:
+    assert cairo.get_image_memory_limit() is None
+    with pytest.raises(ValueError):
+        cairo.set_image_memory_limit(-1)
+    with pytest.raises(ValueError):
+        cairo.set_image_memory_limit(100, -1.0)
+
+    in_use = cairo.memory_stats()["pixel_bytes"]
+    cairo.set_image_memory_limit(in_use + 100 * 4)
+    try:
+        assert cairo.get_image_memory_limit() == in_use + 100 * 4
+        surface = cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10)
+        with pytest.raises(cairo.Error) as excinfo:
+            cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10)
+        assert isinstance(excinfo.value, MemoryError)
+        assert excinfo.value.status == cairo.Status.NO_MEMORY
+        with pytest.raises(MemoryError):
+            surface.create_similar_image(cairo.FORMAT_ARGB32, 10, 10)
+        surface.finish()
+        cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10).finish()
+    finally:
+        cairo.set_image_memory_limit(None)
+    assert cairo.get_image_memory_limit() is None
+
+
+def test_image_memory_limit_map_to_image() -> None:
+    recording = cairo.RecordingSurface(
+        cairo.Content.COLOR_ALPHA, cairo.Rectangle(0, 0, 10, 10))
+    other = cairo.RecordingSurface(
+        cairo.Content.COLOR_ALPHA, cairo.Rectangle(0, 0, 10, 10))
+    in_use = cairo.memory_stats()["pixel_bytes"]
+    cairo.set_image_memory_limit(in_use + 100 * 4)
+    try:
+        # the size is known without extents, and stays reserved while mapped
+        mapped = recording.map_to_image(None)
+        with pytest.raises(MemoryError):
+            other.map_to_image(None)
+        with pytest.raises(MemoryError):
+            cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10)
+        recording.unmap_image(mapped)
+        other.unmap_image(other.map_to_image(None))
+        cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10).finish()
+    finally:
+        cairo.set_image_memory_limit(None)
+
+
+def test_image_memory_limit_wait() -> None:
+    import threading
+
+    in_use = cairo.memory_stats()["pixel_bytes"]
+    cairo.set_image_memory_limit(in_use + 100 * 4, timeout=None)
+    try:
+        surface = cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10)
+        timer = threading.Timer(0.05, surface.finish)
+        timer.start()
+        # blocks until the timer has released the first surface
+        cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10).finish()
+        timer.join()
+
+        cairo.set_image_memory_limit(in_use + 100 * 4, timeout=0.01)
+        surface = cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10)
+        with pytest.raises(MemoryError):
+            cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10)
+
+        # raising the limit wakes up waiters as well
+        cairo.set_image_memory_limit(in_use + 100 * 4, timeout=None)
+        timer = threading.Timer(
+            0.05, cairo.set_image_memory_limit, (in_use + 200 * 4, None))
+        timer.start()
+        cairo.ImageSurface(cairo.FORMAT_ARGB32, 10, 10).finish()
+        timer.join()
+        surface.finish()
+    finally:
+        cairo.set_image_memory_limit(None)
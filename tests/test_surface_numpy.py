@@ -59,3 +59,20 @@ def test_image_surface_get_data_to_numpy_array() -> None:
     os.close(fd)
     surface.write_to_png(filename)
     os.unlink(filename)
+
+
+def test_image_surface_buffer_to_numpy_array() -> None:
+    w, h = 5, 3
+    surface = cairo.ImageSurface(cairo.FORMAT_ARGB32, w, h)
+    ctx = cairo.Context(surface)
+    ctx.set_source_rgb(1, 0, 0)
+    ctx.paint()
+    surface.flush()
+
+    a = numpy.asarray(surface)
+    assert a.shape == (h, w, 4)
+    assert a.dtype == numpy.uint8
+    pixel = a[0, 0].view(numpy.uint32)[0]
+    assert pixel == 0xffff0000
+    del a, pixel
+    surface.finish()